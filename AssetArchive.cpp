@@ -0,0 +1,226 @@
+#include "AssetArchive.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+
+namespace gps {
+
+    static const char ASSET_ARCHIVE_MAGIC[8] = { 'G', 'P', 'S', 'P', 'A', 'C', 'K', 0 };
+
+    struct AssetArchiveHeader {
+
+        char magic[8];
+        uint32_t version;
+        uint32_t entryCount;
+        uint64_t fileSize;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+    };
+
+    static uint64_t AlignOffset(uint64_t offset) {
+
+        return (offset + ASSET_ARCHIVE_ALIGNMENT - 1) & ~(uint64_t)(ASSET_ARCHIVE_ALIGNMENT - 1);
+    }
+
+    AssetArchive::AssetArchive() {
+
+        entries = NULL;
+        entryCount = 0;
+        names = NULL;
+    }
+
+    std::string AssetArchive::NormalizePath(std::string path) {
+
+        std::replace(path.begin(), path.end(), '\\', '/');
+        while (path.compare(0, 2, "./") == 0) {
+            path = path.substr(2);
+        }
+        while (path.size() > 1 && path[path.size() - 1] == '/') {
+            path.erase(path.size() - 1);
+        }
+        return path;
+    }
+
+    // 64-bit FNV-1a over the normalized path
+    uint64_t AssetArchive::HashPath(const std::string& path) {
+
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < path.size(); i++) {
+
+            hash ^= (unsigned char)path[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    bool AssetArchive::Open(std::string fileName) {
+
+        std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+        if (!mapping->Open(fileName)) {
+            return false;
+        }
+
+        const unsigned char* data = mapping->GetData();
+        size_t size = mapping->GetSize();
+
+        AssetArchiveHeader header;
+        if (size < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (memcmp(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(ASSET_ARCHIVE_MAGIC)) != 0 || header.version != ASSET_ARCHIVE_VERSION
+            || header.fileSize != size || header.tocOffset % sizeof(uint64_t) != 0
+            || header.tocOffset > size || header.entryCount > (size - header.tocOffset) / sizeof(AssetArchiveEntry)
+            || header.namesOffset > size || header.namesSize > size - header.namesOffset) {
+            return false;
+        }
+
+        // the table is used in place, the mapping is page aligned and so is every entry
+        const AssetArchiveEntry* table = (const AssetArchiveEntry*)(data + header.tocOffset);
+        for (uint32_t i = 0; i < header.entryCount; i++) {
+
+            if (table[i].offset > size || table[i].size > size - table[i].offset
+                || table[i].nameOffset > header.namesSize || table[i].nameLength > header.namesSize - table[i].nameOffset
+                || (i > 0 && table[i].pathHash < table[i - 1].pathHash)) {
+                return false;
+            }
+        }
+
+        file = mapping;
+        entries = table;
+        entryCount = header.entryCount;
+        names = (const char*)data + header.namesOffset;
+
+        return true;
+    }
+
+    const AssetArchiveEntry* AssetArchive::Find(std::string path) const {
+
+        if (entries == NULL) {
+            return NULL;
+        }
+
+        path = NormalizePath(path);
+        uint64_t hash = HashPath(path);
+
+        const AssetArchiveEntry* end = entries + entryCount;
+        const AssetArchiveEntry* entry = std::lower_bound(entries, end, hash, [](const AssetArchiveEntry& first, uint64_t value) {
+            return first.pathHash < value;
+        });
+
+        for (; entry != end && entry->pathHash == hash; ++entry) {
+
+            if (entry->nameLength == path.size() && memcmp(names + entry->nameOffset, path.data(), path.size()) == 0) {
+                return entry;
+            }
+        }
+        return NULL;
+    }
+
+    bool AssetArchive::OpenFile(const AssetArchiveEntry* entry, MappedFile& view) const {
+
+        return entry != NULL && file && view.OpenView(file, (size_t)entry->offset, (size_t)entry->size);
+    }
+
+    size_t AssetArchive::GetFileCount() const {
+
+        return entryCount;
+    }
+
+    bool AssetArchive::Write(std::string archiveFileName, const std::vector<std::string>& fileNames) {
+
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < fileNames.size(); i++) {
+            paths.push_back(NormalizePath(fileNames[i]));
+        }
+        std::sort(paths.begin(), paths.end());
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+        std::stable_sort(paths.begin(), paths.end(), [](const std::string& first, const std::string& second) {
+            return HashPath(first) < HashPath(second);
+        });
+
+        AssetArchiveHeader header;
+        memcpy(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(ASSET_ARCHIVE_MAGIC));
+        header.version = ASSET_ARCHIVE_VERSION;
+        header.entryCount = (uint32_t)paths.size();
+        header.tocOffset = AlignOffset(sizeof(header));
+        header.namesOffset = header.tocOffset + paths.size() * sizeof(AssetArchiveEntry);
+        header.namesSize = 0;
+
+        std::vector<AssetArchiveEntry> table(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) {
+
+            FileInfo info;
+            if (!MappedFile::GetFileInfo(paths[i], info)) {
+                fprintf(stderr, "ERROR: could not pack %s\n", paths[i].c_str());
+                return false;
+            }
+
+            table[i].pathHash = HashPath(paths[i]);
+            table[i].size = info.size;
+            table[i].modifiedTime = info.modifiedTime;
+            table[i].nameOffset = (uint32_t)header.namesSize;
+            table[i].nameLength = (uint32_t)paths[i].size();
+            header.namesSize += paths[i].size();
+        }
+
+        uint64_t offset = AlignOffset(header.namesOffset + header.namesSize);
+        for (size_t i = 0; i < table.size(); i++) {
+
+            table[i].offset = offset;
+            offset = AlignOffset(offset + table[i].size);
+        }
+        header.fileSize = offset;
+
+        // write to a temporary file so a crash never leaves a truncated archive behind
+        std::string tempFileName = archiveFileName + ".tmp";
+        std::ofstream output(tempFileName.c_str(), std::ios::binary | std::ios::trunc);
+        if (!output) {
+            return false;
+        }
+
+        static const char padding[ASSET_ARCHIVE_ALIGNMENT] = { 0 };
+
+        output.write((const char*)&header, sizeof(header));
+        output.write(padding, header.tocOffset - sizeof(header));
+        output.write((const char*)table.data(), table.size() * sizeof(AssetArchiveEntry));
+        for (size_t i = 0; i < paths.size(); i++) {
+            output.write(paths[i].data(), paths[i].size());
+        }
+        uint64_t written = header.namesOffset + header.namesSize;
+
+        bool complete = true;
+        for (size_t i = 0; i < table.size() && complete; i++) {
+
+            output.write(padding, table[i].offset - written);
+
+            MappedFile source;
+            complete = source.Open(paths[i]) && source.GetSize() == table[i].size;
+            if (complete) {
+                output.write((const char*)source.GetData(), source.GetSize());
+            }
+            written = table[i].offset + table[i].size;
+        }
+        output.write(padding, header.fileSize - written);
+
+        output.close();
+        if (!complete || !output) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        remove(archiveFileName.c_str());
+        if (rename(tempFileName.c_str(), archiveFileName.c_str()) != 0) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        return true;
+    }
+}
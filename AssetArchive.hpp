@@ -0,0 +1,70 @@
+#ifndef AssetArchive_hpp
+#define AssetArchive_hpp
+
+#include "MappedFile.hpp"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Bump whenever the layout of the archive changes
+    const uint32_t ASSET_ARCHIVE_VERSION = 1;
+
+    // Alignment of the file data inside the archive, enough for the 16-byte aligned mesh cache arrays
+    const size_t ASSET_ARCHIVE_ALIGNMENT = 64;
+
+    // One file of the table of contents, as stored in the archive
+    struct AssetArchiveEntry {
+
+        uint64_t pathHash;
+        uint64_t offset;
+        uint64_t size;
+        // of the packed file, so caches keyed on their source still validate
+        int64_t modifiedTime;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+    };
+
+    // Read-only pack of many small files, mapped once
+    //
+    // Layout: header, the table of contents sorted by path hash, the path
+    // names, then the files one after another at ASSET_ARCHIVE_ALIGNMENT.
+    // The table is searched where it lies in the mapping and the files are
+    // handed out as views of it, so nothing is read or copied up front.
+    class AssetArchive {
+
+    public:
+        AssetArchive();
+
+        // Maps the archive and checks its header and table, returns false if it is unusable
+        bool Open(std::string fileName);
+
+        // Entry of a file, NULL if the archive does not hold it
+        const AssetArchiveEntry* Find(std::string path) const;
+
+        // Points file at the data of an entry without copying it
+        bool OpenFile(const AssetArchiveEntry* entry, MappedFile& file) const;
+
+        size_t GetFileCount() const;
+
+        // Packs the given files, stored under their normalized relative paths
+        static bool Write(std::string archiveFileName, const std::vector<std::string>& fileNames);
+
+        // Forward slashes, no leading "./" - the form paths are stored and looked up in
+        static std::string NormalizePath(std::string path);
+
+    private:
+        std::shared_ptr<MappedFile> file;
+        const AssetArchiveEntry* entries;
+        size_t entryCount;
+        const char* names;
+
+        static uint64_t HashPath(const std::string& path);
+    };
+}
+
+#endif /* AssetArchive_hpp */
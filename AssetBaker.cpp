@@ -0,0 +1,617 @@
+#include "AssetBaker.hpp"
+#include "AssetArchive.hpp"
+#include "AssetRegistry.hpp"
+#include "MappedFile.hpp"
+#include "MeshBuilder.hpp"
+#include "SceneManifest.hpp"
+#include "TextureCache.hpp"
+#include "ThreadPool.hpp"
+#include "stb_image.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined (_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+    #include <direct.h>
+#else
+    #include <dirent.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+
+namespace gps {
+
+    // Option bits of a texture, as the runtime asks for it
+    static const uint32_t BAKE_FLAG_FLIPPED = 1;
+    static const uint32_t BAKE_FLAG_MIPMAPS = 2;
+
+    static const char* const BAKE_KIND_NAMES[] = { "mesh", "texture", "face", "scene" };
+    static const size_t BAKE_KIND_COUNT = sizeof(BAKE_KIND_NAMES) / sizeof(BAKE_KIND_NAMES[0]);
+
+    enum BakeResult { BAKE_RESULT_BUILT, BAKE_RESULT_SKIPPED, BAKE_RESULT_FAILED };
+
+    static std::string GetExtension(std::string fileName) {
+
+        size_t dot = fileName.find_last_of('.');
+        size_t slash = fileName.find_last_of('/');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return "";
+        }
+
+        std::string extension = fileName.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+        return extension;
+    }
+
+    static bool IsImage(std::string fileName) {
+
+        std::string extension = GetExtension(fileName);
+        return extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp";
+    }
+
+    // Directory part of a path with its trailing '/', as the loader passes it
+    static std::string GetBasePath(std::string fileName) {
+
+        size_t slash = fileName.find_last_of('/');
+        return slash == std::string::npos ? "" : fileName.substr(0, slash + 1);
+    }
+
+    static bool IsUnderRoot(std::string fileName, std::string root) {
+
+        return fileName.compare(0, root.size(), root) == 0 && (fileName.size() == root.size() || fileName[root.size()] == '/');
+    }
+
+    AssetBaker::AssetBaker() {
+
+        force = false;
+        threadCount = 0;
+    }
+
+    void AssetBaker::SetForce(bool force) {
+
+        this->force = force;
+    }
+
+    void AssetBaker::SetThreadCount(unsigned int threadCount) {
+
+        this->threadCount = threadCount;
+    }
+
+    void AssetBaker::AddModelRoot(std::string root) {
+
+        modelRoots.push_back(AssetArchive::NormalizePath(root));
+    }
+
+    void AssetBaker::AddCubemapRoot(std::string root) {
+
+        cubemapRoots.push_back(AssetArchive::NormalizePath(root));
+    }
+
+    void AssetBaker::AddSceneRoot(std::string root) {
+
+        sceneRoots.push_back(AssetArchive::NormalizePath(root));
+    }
+
+    std::string AssetBaker::GetBakedFileName(std::string fileName) {
+
+        fileName = AssetArchive::NormalizePath(fileName);
+
+        // absolute paths and paths leaving the working directory have no place in the mirror
+        if (fileName.empty() || fileName[0] == '/' || (fileName.size() > 1 && fileName[1] == ':')
+            || fileName.compare(0, 3, "../") == 0 || fileName.find("/../") != std::string::npos) {
+            return "";
+        }
+        return BAKED_ASSET_DIRECTORY + fileName;
+    }
+
+    void AssetBaker::CollectJobs(std::vector<BakeJob>& jobs) {
+
+        std::vector<std::string> files;
+
+        for (size_t r = 0; r < modelRoots.size(); r++) {
+
+            files.clear();
+            ListFiles(modelRoots[r], files);
+
+            for (size_t f = 0; f < files.size(); f++) {
+
+                BakeJob job;
+                job.sourceFileName = files[f];
+                job.inputHash = 0;
+
+                if (GetExtension(files[f]) == "obj") {
+
+                    job.kind = BAKE_MESH;
+                    job.bakedFileName = GetBakedFileName(MeshCache::GetCacheFileName(files[f]));
+                    job.version = MESH_CACHE_VERSION;
+                    job.flags = 0;
+                } else if (IsImage(files[f])) {
+
+                    // TextureStreamer loads model textures flipped and mipmapped
+                    job.kind = BAKE_TEXTURE;
+                    job.bakedFileName = GetBakedFileName(TextureCache::GetCacheFileName(files[f]));
+                    job.version = TEXTURE_CACHE_VERSION;
+                    job.flags = BAKE_FLAG_FLIPPED | BAKE_FLAG_MIPMAPS;
+                } else {
+                    continue;
+                }
+
+                if (!job.bakedFileName.empty()) {
+                    jobs.push_back(job);
+                }
+            }
+        }
+
+        for (size_t r = 0; r < cubemapRoots.size(); r++) {
+
+            files.clear();
+            ListFiles(cubemapRoots[r], files);
+
+            for (size_t f = 0; f < files.size(); f++) {
+
+                if (!IsImage(files[f])) {
+                    continue;
+                }
+
+                // SkyBox keeps its faces as they are, one level each
+                BakeJob job;
+                job.kind = BAKE_CUBEMAP_FACE;
+                job.sourceFileName = files[f];
+                job.bakedFileName = GetBakedFileName(TextureCache::GetCacheFileName(files[f]));
+                job.version = TEXTURE_CACHE_VERSION;
+                job.flags = 0;
+                job.inputHash = 0;
+
+                if (!job.bakedFileName.empty()) {
+                    jobs.push_back(job);
+                }
+            }
+        }
+
+        for (size_t r = 0; r < sceneRoots.size(); r++) {
+
+            files.clear();
+            ListFiles(sceneRoots[r], files);
+
+            for (size_t f = 0; f < files.size(); f++) {
+
+                if (GetExtension(files[f]) != "scene") {
+                    continue;
+                }
+
+                BakeJob job;
+                job.kind = BAKE_SCENE;
+                job.sourceFileName = files[f];
+                job.bakedFileName = GetBakedFileName(SceneManifest::GetCompiledFileName(files[f]));
+                job.version = SCENE_MANIFEST_VERSION;
+                job.flags = 0;
+                job.inputHash = 0;
+
+                if (!job.bakedFileName.empty()) {
+                    jobs.push_back(job);
+                }
+            }
+        }
+    }
+
+    bool AssetBaker::IsUpToDate(const BakeJob& job) {
+
+        if (force) {
+            return false;
+        }
+
+        std::map<std::string, BakeRecord>::const_iterator record = manifest.find(job.sourceFileName);
+        if (record == manifest.end()) {
+            return false;
+        }
+
+        const BakeRecord& baked = record->second;
+        if (baked.kind != job.kind || baked.version != job.version || baked.flags != job.flags
+            || baked.inputHash != job.inputHash || baked.bakedFileName != job.bakedFileName) {
+            return false;
+        }
+
+        // a deleted output is rebuilt even though its inputs did not change
+        FileInfo info;
+        return MappedFile::GetFileInfo(job.bakedFileName, info);
+    }
+
+    bool AssetBaker::Run(const BakeJob& job) {
+
+        if (!CreateParentDirectories(job.bakedFileName)) {
+            return false;
+        }
+
+        if (job.kind == BAKE_MESH) {
+
+            // the statistics of the build are only interesting when loading at runtime
+            std::ostringstream log;
+            std::vector<PreparedMesh> meshes;
+            if (!MeshBuilder::Load(job.sourceFileName, GetBasePath(job.sourceFileName), meshes, log)) {
+                return false;
+            }
+
+            uint64_t sourceHash;
+            uint64_t materialHash;
+            return MeshBuilder::WriteCache(job.bakedFileName, job.sourceFileName, meshes, sourceHash, materialHash);
+        }
+
+        if (job.kind == BAKE_SCENE) {
+
+            SceneManifest scene;
+            return scene.Parse(job.sourceFileName) && scene.WriteCompiled(job.bakedFileName, job.sourceFileName);
+        }
+
+        bool flipVertically = (job.flags & BAKE_FLAG_FLIPPED) != 0;
+        bool mipmaps = (job.flags & BAKE_FLAG_MIPMAPS) != 0;
+
+        int width, height;
+        unsigned char* pixels = TextureCache::DecodeImage(job.sourceFileName.c_str(), flipVertically, width, height);
+        if (!pixels) {
+            return false;
+        }
+
+        TextureData levels;
+        TextureCache::BuildMipChain(pixels, width, height, mipmaps, MIP_FILTER_KAISER, levels);
+        stbi_image_free(pixels);
+
+        TextureData compressed;
+        TextureCache::Compress(levels, compressed);
+        return TextureCache::Write(job.bakedFileName, job.sourceFileName, flipVertically, mipmaps, compressed);
+    }
+
+    bool AssetBaker::Bake(BakeStats& stats) {
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        stats.built = 0;
+        stats.skipped = 0;
+        stats.failed = 0;
+        stats.removed = 0;
+
+        std::string manifestFileName = std::string(BAKED_ASSET_DIRECTORY) + "manifest.txt";
+        manifest.clear();
+        if (!ReadManifest(manifestFileName) && !force) {
+            std::cout << "No usable manifest in " << BAKED_ASSET_DIRECTORY << ", baking everything" << std::endl;
+        }
+
+        std::vector<BakeJob> jobs;
+        CollectJobs(jobs);
+
+        // hashing the inputs is part of every job, a second run over unchanged files is I/O bound as well
+        std::vector<BakeResult> results(jobs.size(), BAKE_RESULT_FAILED);
+        std::vector<std::future<void> > pending;
+        ThreadPool pool(threadCount);
+
+        for (size_t i = 0; i < jobs.size(); i++) {
+
+            BakeJob* job = &jobs[i];
+            BakeResult* result = &results[i];
+
+            pending.push_back(pool.Submit([this, job, result]() {
+
+                std::chrono::steady_clock::time_point jobStart = std::chrono::steady_clock::now();
+
+                job->inputHash = AssetRegistry::HashFile(job->sourceFileName);
+
+                // texture paths come from the material libraries, a changed .mtl changes the mesh
+                if (job->kind == BAKE_MESH) {
+
+                    std::vector<std::string> siblings;
+                    ListFiles(GetBasePath(job->sourceFileName), siblings);
+                    for (size_t s = 0; s < siblings.size(); s++) {
+
+                        if (GetExtension(siblings[s]) == "mtl" && GetBasePath(siblings[s]) == GetBasePath(job->sourceFileName)) {
+                            job->inputHash = job->inputHash * 31 + AssetRegistry::HashFile(siblings[s]);
+                        }
+                    }
+                }
+
+                if (job->inputHash != 0 && IsUpToDate(*job)) {
+
+                    *result = BAKE_RESULT_SKIPPED;
+                    return;
+                }
+
+                *result = job->inputHash != 0 && Run(*job) ? BAKE_RESULT_BUILT : BAKE_RESULT_FAILED;
+                double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (*result == BAKE_RESULT_BUILT) {
+                    std::cout << "  " << BAKE_KIND_NAMES[job->kind] << " " << job->sourceFileName << " -> " << job->bakedFileName
+                        << " (" << milliseconds << " ms)" << std::endl;
+                } else {
+                    fprintf(stderr, "ERROR: could not bake %s\n", job->sourceFileName.c_str());
+                }
+            }));
+        }
+
+        for (size_t i = 0; i < pending.size(); i++) {
+            pending[i].wait();
+        }
+
+        // sources that disappeared from a baked root take their outputs with them
+        std::map<std::string, BakeRecord> previous;
+        previous.swap(manifest);
+
+        for (std::map<std::string, BakeRecord>::const_iterator record = previous.begin(); record != previous.end(); ++record) {
+
+            bool baked = false;
+            for (size_t r = 0; r < modelRoots.size() && !baked; r++) {
+                baked = IsUnderRoot(record->first, modelRoots[r]);
+            }
+            for (size_t r = 0; r < cubemapRoots.size() && !baked; r++) {
+                baked = IsUnderRoot(record->first, cubemapRoots[r]);
+            }
+            for (size_t r = 0; r < sceneRoots.size() && !baked; r++) {
+                baked = IsUnderRoot(record->first, sceneRoots[r]);
+            }
+
+            // outside this run's roots the record stays as it is
+            if (!baked) {
+                manifest.insert(*record);
+            }
+        }
+
+        for (size_t i = 0; i < jobs.size(); i++) {
+
+            previous.erase(jobs[i].sourceFileName);
+
+            if (results[i] == BAKE_RESULT_FAILED) {
+
+                // left out of the manifest, the next run tries again
+                stats.failed++;
+                continue;
+            }
+            stats.built += results[i] == BAKE_RESULT_BUILT ? 1 : 0;
+            stats.skipped += results[i] == BAKE_RESULT_SKIPPED ? 1 : 0;
+
+            BakeRecord record;
+            record.kind = jobs[i].kind;
+            record.version = jobs[i].version;
+            record.flags = jobs[i].flags;
+            record.inputHash = jobs[i].inputHash;
+            record.bakedFileName = jobs[i].bakedFileName;
+            manifest[jobs[i].sourceFileName] = record;
+        }
+
+        for (std::map<std::string, BakeRecord>::const_iterator record = previous.begin(); record != previous.end(); ++record) {
+
+            if (manifest.find(record->first) == manifest.end() && record->second.bakedFileName.compare(0, strlen(BAKED_ASSET_DIRECTORY), BAKED_ASSET_DIRECTORY) == 0) {
+
+                remove(record->second.bakedFileName.c_str());
+                std::cout << "  removed " << record->second.bakedFileName << " (" << record->first << " is gone)" << std::endl;
+                stats.removed++;
+            }
+        }
+
+        bool written = CreateParentDirectories(manifestFileName) && WriteManifest(manifestFileName);
+        if (!written) {
+            fprintf(stderr, "ERROR: could not write %s\n", manifestFileName.c_str());
+        }
+
+        stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return written && stats.failed == 0;
+    }
+
+    bool AssetBaker::Pack(std::string archiveFileName, const std::vector<std::string>& includeRoots) {
+
+        std::vector<std::string> files;
+        std::vector<std::string> roots(modelRoots);
+        roots.insert(roots.end(), cubemapRoots.begin(), cubemapRoots.end());
+        roots.insert(roots.end(), sceneRoots.begin(), sceneRoots.end());
+        roots.insert(roots.end(), includeRoots.begin(), includeRoots.end());
+
+        for (size_t r = 0; r < roots.size(); r++) {
+            ListFiles(roots[r], files);
+        }
+
+        // caches the runtime left next to the sources are replaced by the baked outputs
+        size_t written = 0;
+        for (size_t f = 0; f < files.size(); f++) {
+
+            std::string extension = GetExtension(files[f]);
+            if (extension != "gpsmesh" && extension != "ktx" && extension != "gpsscene" && extension != "tmp") {
+                files[written++] = files[f];
+            }
+        }
+        files.resize(written);
+
+        FileInfo info;
+        for (std::map<std::string, BakeRecord>::const_iterator record = manifest.begin(); record != manifest.end(); ++record) {
+
+            if (MappedFile::GetFileInfo(record->second.bakedFileName, info)) {
+                files.push_back(record->second.bakedFileName);
+            }
+        }
+
+        if (!AssetArchive::Write(archiveFileName, files)) {
+
+            fprintf(stderr, "ERROR: could not write %s\n", archiveFileName.c_str());
+            return false;
+        }
+
+        MappedFile::GetFileInfo(archiveFileName, info);
+        std::cout << "Packed " << files.size() << " files into " << archiveFileName << " (" << info.size / 1024 << " KB)" << std::endl;
+        return true;
+    }
+
+    // One line per source: kind, version, flags, input hash, source and output, separated by tabs
+    bool AssetBaker::ReadManifest(std::string fileName) {
+
+        std::ifstream input(fileName.c_str());
+        if (!input) {
+            return false;
+        }
+
+        std::string line;
+        if (!std::getline(input, line) || line != "# gps_bake manifest " + std::to_string(BAKE_MANIFEST_VERSION)) {
+            return false;
+        }
+
+        while (std::getline(input, line)) {
+
+            std::vector<std::string> fields;
+            std::istringstream stream(line);
+            std::string field;
+            while (std::getline(stream, field, '\t')) {
+                fields.push_back(field);
+            }
+            if (fields.size() != 6) {
+                continue;
+            }
+
+            BakeRecord record;
+            size_t kind = 0;
+            while (kind < BAKE_KIND_COUNT && fields[0] != BAKE_KIND_NAMES[kind]) {
+                kind++;
+            }
+            if (kind == BAKE_KIND_COUNT) {
+                continue;
+            }
+            record.kind = (BakeKind)kind;
+            record.version = (uint32_t)strtoul(fields[1].c_str(), NULL, 10);
+            record.flags = (uint32_t)strtoul(fields[2].c_str(), NULL, 10);
+            record.inputHash = strtoull(fields[3].c_str(), NULL, 16);
+            record.bakedFileName = fields[5];
+
+            manifest[fields[4]] = record;
+        }
+
+        return true;
+    }
+
+    bool AssetBaker::WriteManifest(std::string fileName) {
+
+        // write to a temporary file so an interrupted bake never leaves half a manifest behind
+        std::string tempFileName = fileName + ".tmp";
+        std::ofstream output(tempFileName.c_str(), std::ios::trunc);
+        if (!output) {
+            return false;
+        }
+
+        output << "# gps_bake manifest " << BAKE_MANIFEST_VERSION << "\n";
+        for (std::map<std::string, BakeRecord>::const_iterator record = manifest.begin(); record != manifest.end(); ++record) {
+
+            char hash[17];
+            snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)record->second.inputHash);
+
+            output << BAKE_KIND_NAMES[record->second.kind] << '\t' << record->second.version << '\t' << record->second.flags << '\t'
+                << hash << '\t' << record->first << '\t' << record->second.bakedFileName << "\n";
+        }
+
+        output.close();
+        if (!output) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        remove(fileName.c_str());
+        if (rename(tempFileName.c_str(), fileName.c_str()) != 0) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    void AssetBaker::ListFiles(std::string directory, std::vector<std::string>& files) {
+
+        std::vector<std::string> directories(1, AssetArchive::NormalizePath(directory));
+        size_t first = files.size();
+
+        while (!directories.empty()) {
+
+            std::string current = directories.back();
+            directories.pop_back();
+            std::string prefix = current.empty() || current == "." ? "" : current + "/";
+
+#if defined (_WIN32)
+            WIN32_FIND_DATAA entry;
+            HANDLE find = FindFirstFileA((prefix + "*").c_str(), &entry);
+            if (find == INVALID_HANDLE_VALUE) {
+                continue;
+            }
+
+            do {
+
+                std::string name = entry.cFileName;
+                if (name == "." || name == "..") {
+                    continue;
+                }
+                if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+                    directories.push_back(prefix + name);
+                } else {
+                    files.push_back(prefix + name);
+                }
+            } while (FindNextFileA(find, &entry));
+
+            FindClose(find);
+#else
+            DIR* handle = opendir(current.empty() ? "." : current.c_str());
+            if (handle == NULL) {
+                continue;
+            }
+
+            struct dirent* entry;
+            while ((entry = readdir(handle)) != NULL) {
+
+                std::string name = entry->d_name;
+                if (name == "." || name == "..") {
+                    continue;
+                }
+
+                struct stat status;
+                if (stat((prefix + name).c_str(), &status) != 0) {
+                    continue;
+                }
+                if (S_ISDIR(status.st_mode)) {
+                    directories.push_back(prefix + name);
+                } else if (S_ISREG(status.st_mode)) {
+                    files.push_back(prefix + name);
+                }
+            }
+
+            closedir(handle);
+#endif
+        }
+
+        // directory order is up to the file system, the manifest should not be
+        std::sort(files.begin() + first, files.end());
+    }
+
+    bool AssetBaker::CreateParentDirectories(std::string fileName) {
+
+        for (size_t slash = fileName.find('/'); slash != std::string::npos; slash = fileName.find('/', slash + 1)) {
+
+            std::string directory = fileName.substr(0, slash);
+            if (directory.empty()) {
+                continue;
+            }
+
+#if defined (_WIN32)
+            if (_mkdir(directory.c_str()) != 0 && errno != EEXIST) {
+                return false;
+            }
+#else
+            if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+                return false;
+            }
+#endif
+        }
+
+        return true;
+    }
+}
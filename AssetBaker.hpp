@@ -0,0 +1,114 @@
+#ifndef AssetBaker_hpp
+#define AssetBaker_hpp
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Directory gps_bake writes to and the loaders look in first, relative to the working directory
+    const char* const BAKED_ASSET_DIRECTORY = "baked/";
+
+    // Bump whenever the manifest or the way its inputs are hashed changes
+    const uint32_t BAKE_MANIFEST_VERSION = 1;
+
+    enum BakeKind { BAKE_MESH, BAKE_TEXTURE, BAKE_CUBEMAP_FACE, BAKE_SCENE };
+
+    // One source file and the runtime asset it is baked into
+    struct BakeJob {
+
+        BakeKind kind;
+        std::string sourceFileName;
+        std::string bakedFileName;
+        // version of the output format and the options it was built with
+        uint32_t version;
+        uint32_t flags;
+        // content hash of every input the output depends on
+        uint64_t inputHash;
+    };
+
+    // Line of the manifest, what the last bake of a source was built from
+    struct BakeRecord {
+
+        BakeKind kind;
+        uint32_t version;
+        uint32_t flags;
+        uint64_t inputHash;
+        std::string bakedFileName;
+    };
+
+    struct BakeStats {
+
+        size_t built;
+        size_t skipped;
+        size_t failed;
+        size_t removed;
+        double milliseconds;
+    };
+
+    // Offline builder of the runtime assets, driven by the gps_bake tool
+    //
+    // Models are welded, optimized and split into meshlets and LODs exactly
+    // as the loader would and written as mesh caches; their images and the
+    // skybox faces become block compressed KTX files and scene manifests are
+    // compiled to their binary form. Everything goes under
+    // BAKED_ASSET_DIRECTORY, mirroring the source tree, where the runtime
+    // finds it before its own caches. A manifest keeps the content hash of
+    // the inputs of every output, so a second run only rebuilds what changed.
+    class AssetBaker {
+
+    public:
+        AssetBaker();
+
+        // Rebuilds every output whatever the manifest says
+        void SetForce(bool force);
+
+        // 0 uses one thread per core
+        void SetThreadCount(unsigned int threadCount);
+
+        // Images under a model root are model textures (flipped, mipmapped), under a cubemap root skybox faces
+        void AddModelRoot(std::string root);
+        void AddCubemapRoot(std::string root);
+
+        // .scene files under a scene root are compiled
+        void AddSceneRoot(std::string root);
+
+        // Bakes every root, returns false if any output failed
+        bool Bake(BakeStats& stats);
+
+        // Packs the roots, the outputs of the last bake and the files under includeRoots into one archive
+        bool Pack(std::string archiveFileName, const std::vector<std::string>& includeRoots);
+
+        // Where gps_bake puts the baked version of a runtime file, empty for paths outside the working directory
+        static std::string GetBakedFileName(std::string fileName);
+
+    private:
+        bool force;
+        unsigned int threadCount;
+        std::vector<std::string> modelRoots;
+        std::vector<std::string> cubemapRoots;
+        std::vector<std::string> sceneRoots;
+
+        // by source file name, as read at the start and written at the end of a bake
+        std::map<std::string, BakeRecord> manifest;
+        std::mutex mutex;
+
+        void CollectJobs(std::vector<BakeJob>& jobs);
+        bool IsUpToDate(const BakeJob& job);
+        bool Run(const BakeJob& job);
+
+        bool ReadManifest(std::string fileName);
+        bool WriteManifest(std::string fileName);
+
+        // Lists the files below a directory, sorted and with '/' separators
+        static void ListFiles(std::string directory, std::vector<std::string>& files);
+
+        // Creates every missing directory on the way to a file
+        static bool CreateParentDirectories(std::string fileName);
+    };
+}
+
+#endif /* AssetBaker_hpp */
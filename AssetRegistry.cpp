@@ -0,0 +1,201 @@
+#include "AssetRegistry.hpp"
+#include "MappedFile.hpp"
+#include "VirtualFileSystem.hpp"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_set>
+
+namespace gps {
+
+    static const char* ASSET_TYPE_NAMES[ASSET_TYPE_COUNT] = { "meshes", "textures", "cubemaps" };
+
+    Asset::Asset() {
+
+        gpuBytes = 0;
+        cpuBytes = 0;
+        savedCpuBytes = 0;
+    }
+
+    Asset::~Asset() {
+
+    }
+
+    TextureAsset::TextureAsset(GLuint id, size_t gpuBytes) {
+
+        this->id = id;
+        this->gpuBytes = gpuBytes;
+    }
+
+    TextureAsset::~TextureAsset() {
+
+        glDeleteTextures(1, &id);
+    }
+
+    AssetRegistry::AssetRegistry() {
+
+        for (int i = 0; i < ASSET_TYPE_COUNT; i++) {
+
+            hitCount[i] = 0;
+            savedBytes[i] = 0;
+        }
+    }
+
+    std::shared_ptr<Asset> AssetRegistry::Find(AssetType type, std::string path) {
+
+        std::string canonicalPath = GetCanonicalPath(path);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::unordered_map<std::string, std::weak_ptr<Asset> >::iterator entry = byPath[type].find(canonicalPath);
+        if (entry == byPath[type].end()) {
+            return std::shared_ptr<Asset>();
+        }
+
+        std::shared_ptr<Asset> asset = entry->second.lock();
+        if (!asset) {
+            byPath[type].erase(entry);
+            return asset;
+        }
+
+        return Hit(type, asset);
+    }
+
+    std::shared_ptr<Asset> AssetRegistry::Find(AssetType type, std::string path, uint64_t contentHash) {
+
+        std::shared_ptr<Asset> asset = Find(type, path);
+        if (asset || contentHash == 0) {
+            return asset;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        std::unordered_map<uint64_t, std::weak_ptr<Asset> >::iterator entry = byHash[type].find(contentHash);
+        if (entry == byHash[type].end()) {
+            return asset;
+        }
+
+        asset = entry->second.lock();
+        if (!asset) {
+            byHash[type].erase(entry);
+            return asset;
+        }
+
+        // remember the new path so the next lookup does not hash the file again
+        byPath[type][GetCanonicalPath(path)] = asset;
+
+        return Hit(type, asset);
+    }
+
+    void AssetRegistry::Add(AssetType type, std::string path, uint64_t contentHash, std::shared_ptr<Asset> asset) {
+
+        std::string canonicalPath = GetCanonicalPath(path);
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        byPath[type][canonicalPath] = asset;
+        if (contentHash != 0) {
+            byHash[type][contentHash] = asset;
+        }
+    }
+
+    void AssetRegistry::PrintReport() {
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        size_t totalSaved = 0;
+
+        std::cout << "Asset registry :" << std::endl;
+        for (int i = 0; i < ASSET_TYPE_COUNT; i++) {
+
+            size_t liveBytes = 0;
+            size_t cpuBytes = 0;
+            size_t cpuSavedBytes = 0;
+
+            // several paths may lead to one asset, it is counted once
+            std::unordered_set<Asset*> live;
+            std::unordered_map<std::string, std::weak_ptr<Asset> >::iterator entry;
+            for (entry = byPath[i].begin(); entry != byPath[i].end(); ++entry) {
+
+                std::shared_ptr<Asset> asset = entry->second.lock();
+                if (asset && live.insert(asset.get()).second) {
+
+                    liveBytes += asset->gpuBytes;
+                    cpuBytes += asset->cpuBytes;
+                    cpuSavedBytes += asset->savedCpuBytes;
+                }
+            }
+
+            std::cout << "  " << ASSET_TYPE_NAMES[i] << " : " << live.size() << " live (" << liveBytes / 1024.0 << " KB), "
+                << hitCount[i] << " shared loads saving " << savedBytes[i] / 1024.0 << " KB, "
+                << cpuBytes / 1024.0 << " KB in system memory (" << cpuSavedBytes / 1024.0 << " KB less than full copies)" << std::endl;
+            totalSaved += savedBytes[i];
+        }
+        std::cout << "  GPU memory saved by deduplication : " << totalSaved / 1024.0 << " KB" << std::endl;
+    }
+
+    AssetRegistry& AssetRegistry::GetShared() {
+
+        static AssetRegistry sharedRegistry;
+        return sharedRegistry;
+    }
+
+    std::string AssetRegistry::GetCanonicalPath(std::string path) {
+
+#if defined (_WIN32)
+        char resolved[_MAX_PATH];
+        if (_fullpath(resolved, path.c_str(), _MAX_PATH) == NULL) {
+            return path;
+        }
+        return std::string(resolved);
+#else
+        char* resolved = realpath(path.c_str(), NULL);
+        if (resolved == NULL) {
+            return path;
+        }
+        std::string canonicalPath(resolved);
+        free(resolved);
+        return canonicalPath;
+#endif
+    }
+
+    // Hashes 8 bytes per step, fast enough to run on the context thread
+    uint64_t AssetRegistry::HashFile(std::string fileName) {
+
+        MappedFile file;
+        if (!VirtualFileSystem::GetShared().Open(fileName, file)) {
+            return 0;
+        }
+
+        const unsigned char* data = file.GetData();
+        size_t size = file.GetSize();
+
+        uint64_t hash = 0x9E3779B97F4A7C15ULL ^ size;
+        size_t i = 0;
+
+        for (; i + 8 <= size; i += 8) {
+
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+            hash ^= hash >> 32;
+        }
+        for (; i < size; i++) {
+
+            hash = (hash ^ data[i]) * 0xC4CEB9FE1A85EC53ULL;
+            hash ^= hash >> 29;
+        }
+
+        // 0 is reserved for unknown contents
+        return hash != 0 ? hash : 1;
+    }
+
+    std::shared_ptr<Asset> AssetRegistry::Hit(AssetType type, std::shared_ptr<Asset> asset) {
+
+        hitCount[type]++;
+        savedBytes[type] += asset->gpuBytes;
+
+        return asset;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef AssetRegistry_hpp
+#define AssetRegistry_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gps {
+
+    enum AssetType { ASSET_MESH, ASSET_TEXTURE, ASSET_CUBEMAP, ASSET_TYPE_COUNT };
+
+    // GL objects created from one source, shared by every user and freed with the last reference
+    class Asset {
+
+    public:
+        Asset();
+        virtual ~Asset();
+
+        // video memory held by the asset, used for the deduplication report
+        size_t gpuBytes;
+        // system memory it holds after loading, and what it saves against keeping a full copy of its source data
+        size_t cpuBytes;
+        size_t savedCpuBytes;
+
+    private:
+        Asset(const Asset&);
+        Asset& operator=(const Asset&);
+    };
+
+    // A 2D texture or a cubemap
+    class TextureAsset : public Asset {
+
+    public:
+        TextureAsset(GLuint id, size_t gpuBytes);
+        ~TextureAsset();
+
+        GLuint id;
+    };
+
+    // Process-wide table of the live assets
+    //
+    // Assets are found in O(1) by canonical path first; a path seen for the
+    // first time is looked up again by content hash, so the same file reached
+    // through another path or copied next to another model is shared as well.
+    // The registry only keeps weak references, an asset dies with its last user.
+    class AssetRegistry {
+
+    public:
+        AssetRegistry();
+
+        // Live asset loaded from the same path, or null
+        std::shared_ptr<Asset> Find(AssetType type, std::string path);
+
+        // Live asset loaded from the same path or from a file with the same contents, or null
+        std::shared_ptr<Asset> Find(AssetType type, std::string path, uint64_t contentHash);
+
+        // Registers a new asset, a content hash of 0 means unknown
+        void Add(AssetType type, std::string path, uint64_t contentHash, std::shared_ptr<Asset> asset);
+
+        // Prints the live assets, the video memory saved by sharing them and the system memory they hold
+        void PrintReport();
+
+        static AssetRegistry& GetShared();
+
+        // Absolute path with links and ./.. resolved, the path itself if the file is missing
+        static std::string GetCanonicalPath(std::string path);
+
+        // 64-bit hash of the contents of a file, 0 if it cannot be read
+        static uint64_t HashFile(std::string fileName);
+
+    private:
+        std::mutex mutex;
+        std::unordered_map<std::string, std::weak_ptr<Asset> > byPath[ASSET_TYPE_COUNT];
+        std::unordered_map<uint64_t, std::weak_ptr<Asset> > byHash[ASSET_TYPE_COUNT];
+        size_t hitCount[ASSET_TYPE_COUNT];
+        size_t savedBytes[ASSET_TYPE_COUNT];
+
+        std::shared_ptr<Asset> Hit(AssetType type, std::shared_ptr<Asset> asset);
+    };
+}
+
+#endif /* AssetRegistry_hpp */
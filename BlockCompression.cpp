@@ -0,0 +1,278 @@
+#include "BlockCompression.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace gps {
+
+    static uint16_t PackColor565(const float* color) {
+
+        int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+
+        r = r < 0 ? 0 : (r > 31 ? 31 : r);
+        g = g < 0 ? 0 : (g > 63 ? 63 : g);
+        b = b < 0 ? 0 : (b > 31 ? 31 : b);
+
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    static void UnpackColor565(uint16_t packed, int* color) {
+
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // Endpoints along the principal axis of the block colors, the classic range fit
+    static void FitColorEndpoints(const unsigned char* block, float* minColor, float* maxColor) {
+
+        float mean[3] = { 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 3; c++) {
+                mean[c] += block[i * 4 + c];
+            }
+        }
+        for (int c = 0; c < 3; c++) {
+            mean[c] /= 16.0f;
+        }
+
+        // covariance: rr, rg, rb, gg, gb, bb
+        float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+        for (int i = 0; i < 16; i++) {
+
+            float r = block[i * 4 + 0] - mean[0];
+            float g = block[i * 4 + 1] - mean[1];
+            float b = block[i * 4 + 2] - mean[2];
+
+            covariance[0] += r * r;
+            covariance[1] += r * g;
+            covariance[2] += r * b;
+            covariance[3] += g * g;
+            covariance[4] += g * b;
+            covariance[5] += b * b;
+        }
+
+        // a few power iterations are plenty for a 3x3 matrix
+        float axis[3] = { 0.9f, 1.0f, 0.7f };
+        for (int iteration = 0; iteration < 4; iteration++) {
+
+            float x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+            float y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+            float z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+
+            // only the direction matters, scale by the largest component to stay in range
+            float extent = x > 0.0f ? x : -x;
+            extent = (y > 0.0f ? y : -y) > extent ? (y > 0.0f ? y : -y) : extent;
+            extent = (z > 0.0f ? z : -z) > extent ? (z > 0.0f ? z : -z) : extent;
+            if (extent < 1e-6f) {
+                break;
+            }
+            axis[0] = x / extent;
+            axis[1] = y / extent;
+            axis[2] = z / extent;
+        }
+
+        float minProjection = 1e30f;
+        float maxProjection = -1e30f;
+        for (int i = 0; i < 16; i++) {
+
+            float projection = (block[i * 4 + 0] - mean[0]) * axis[0]
+                + (block[i * 4 + 1] - mean[1]) * axis[1]
+                + (block[i * 4 + 2] - mean[2]) * axis[2];
+            minProjection = projection < minProjection ? projection : minProjection;
+            maxProjection = projection > maxProjection ? projection : maxProjection;
+        }
+
+        float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        if (axisLength < 1e-12f) {
+            axisLength = 1.0f;
+        }
+
+        // pull the endpoints in a little, the extremes are rarely worth a full palette entry
+        float inset = (maxProjection - minProjection) / 16.0f;
+        minProjection += inset;
+        maxProjection -= inset;
+
+        for (int c = 0; c < 3; c++) {
+
+            minColor[c] = mean[c] + axis[c] * minProjection / axisLength;
+            maxColor[c] = mean[c] + axis[c] * maxProjection / axisLength;
+        }
+    }
+
+    static void WriteColorBlock(const unsigned char* block, unsigned char* output) {
+
+        float minColor[3];
+        float maxColor[3];
+        FitColorEndpoints(block, minColor, maxColor);
+
+        uint16_t color0 = PackColor565(maxColor);
+        uint16_t color1 = PackColor565(minColor);
+
+        // color0 > color1 selects the four color mode
+        if (color0 < color1) {
+
+            uint16_t swap = color0;
+            color0 = color1;
+            color1 = swap;
+        }
+
+        uint32_t indices = 0;
+
+        if (color0 != color1) {
+
+            int palette[4][3];
+            UnpackColor565(color0, palette[0]);
+            UnpackColor565(color1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; i++) {
+
+                int bestIndex = 0;
+                int bestDistance = 0x7fffffff;
+                for (int p = 0; p < 4; p++) {
+
+                    int r = block[i * 4 + 0] - palette[p][0];
+                    int g = block[i * 4 + 1] - palette[p][1];
+                    int b = block[i * 4 + 2] - palette[p][2];
+                    int distance = r * r + g * g + b * b;
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        bestIndex = p;
+                    }
+                }
+                indices |= (uint32_t)bestIndex << (i * 2);
+            }
+        }
+
+        output[0] = (unsigned char)(color0 & 0xff);
+        output[1] = (unsigned char)(color0 >> 8);
+        output[2] = (unsigned char)(color1 & 0xff);
+        output[3] = (unsigned char)(color1 >> 8);
+        output[4] = (unsigned char)(indices & 0xff);
+        output[5] = (unsigned char)((indices >> 8) & 0xff);
+        output[6] = (unsigned char)((indices >> 16) & 0xff);
+        output[7] = (unsigned char)(indices >> 24);
+    }
+
+    static void WriteAlphaBlock(const unsigned char* block, unsigned char* output) {
+
+        int minAlpha = 255;
+        int maxAlpha = 0;
+        for (int i = 0; i < 16; i++) {
+
+            int alpha = block[i * 4 + 3];
+            minAlpha = alpha < minAlpha ? alpha : minAlpha;
+            maxAlpha = alpha > maxAlpha ? alpha : maxAlpha;
+        }
+
+        uint64_t indices = 0;
+
+        // alpha0 > alpha1 selects the eight value mode, equal values leave every index at 0
+        if (maxAlpha != minAlpha) {
+
+            int palette[8];
+            palette[0] = maxAlpha;
+            palette[1] = minAlpha;
+            for (int p = 2; p < 8; p++) {
+                palette[p] = ((8 - p) * maxAlpha + (p - 1) * minAlpha) / 7;
+            }
+
+            for (int i = 0; i < 16; i++) {
+
+                int alpha = block[i * 4 + 3];
+                int bestIndex = 0;
+                int bestDistance = 256;
+                for (int p = 0; p < 8; p++) {
+
+                    int distance = alpha > palette[p] ? alpha - palette[p] : palette[p] - alpha;
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        bestIndex = p;
+                    }
+                }
+                indices |= (uint64_t)bestIndex << (i * 3);
+            }
+        }
+
+        output[0] = (unsigned char)maxAlpha;
+        output[1] = (unsigned char)minAlpha;
+        for (int b = 0; b < 6; b++) {
+            output[2 + b] = (unsigned char)((indices >> (b * 8)) & 0xff);
+        }
+    }
+
+    void CompressBlockBC1(const unsigned char* block, unsigned char* output) {
+
+        WriteColorBlock(block, output);
+    }
+
+    void CompressBlockBC3(const unsigned char* block, unsigned char* output) {
+
+        WriteAlphaBlock(block, output);
+        WriteColorBlock(block, output + 8);
+    }
+
+    // Copies the 4x4 block at (blockX, blockY), clamping at the image edges
+    static void GatherBlock(const unsigned char* pixels, int width, int height, int blockX, int blockY, unsigned char* block) {
+
+        for (int y = 0; y < 4; y++) {
+
+            int row = blockY * 4 + y;
+            row = row < height ? row : height - 1;
+
+            for (int x = 0; x < 4; x++) {
+
+                int column = blockX * 4 + x;
+                column = column < width ? column : width - 1;
+
+                memcpy(block + (y * 4 + x) * 4, pixels + ((size_t)row * width + column) * 4, 4);
+            }
+        }
+    }
+
+    void CompressImageBC1(const unsigned char* pixels, int width, int height, unsigned char* output) {
+
+        int blocksX = (width + 3) / 4;
+        int blocksY = (height + 3) / 4;
+        unsigned char block[64];
+
+        for (int by = 0; by < blocksY; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+
+                GatherBlock(pixels, width, height, bx, by, block);
+                CompressBlockBC1(block, output + ((size_t)by * blocksX + bx) * BC1_BLOCK_SIZE);
+            }
+        }
+    }
+
+    void CompressImageBC3(const unsigned char* pixels, int width, int height, unsigned char* output) {
+
+        int blocksX = (width + 3) / 4;
+        int blocksY = (height + 3) / 4;
+        unsigned char block[64];
+
+        for (int by = 0; by < blocksY; by++) {
+            for (int bx = 0; bx < blocksX; bx++) {
+
+                GatherBlock(pixels, width, height, bx, by, block);
+                CompressBlockBC3(block, output + ((size_t)by * blocksX + bx) * BC3_BLOCK_SIZE);
+            }
+        }
+    }
+
+    size_t GetCompressedSize(int width, int height, size_t blockSize) {
+
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef BlockCompression_hpp
+#define BlockCompression_hpp
+
+#include <stddef.h>
+
+namespace gps {
+
+    // Bytes per 4x4 block
+    const size_t BC1_BLOCK_SIZE = 8;
+    const size_t BC3_BLOCK_SIZE = 16;
+
+    // Encodes a 4x4 block of RGBA8 pixels (row by row) as BC1, alpha is ignored
+    void CompressBlockBC1(const unsigned char* block, unsigned char* output);
+
+    // Encodes a 4x4 block of RGBA8 pixels (row by row) as BC3 - BC1 colors plus interpolated alpha
+    void CompressBlockBC3(const unsigned char* block, unsigned char* output);
+
+    // Encodes a whole RGBA8 image, partial blocks at the edges repeat their last row/column
+    // output must hold ceil(width / 4) * ceil(height / 4) blocks
+    void CompressImageBC1(const unsigned char* pixels, int width, int height, unsigned char* output);
+    void CompressImageBC3(const unsigned char* pixels, int width, int height, unsigned char* output);
+
+    // Size of an image compressed with the given block size
+    size_t GetCompressedSize(int width, int height, size_t blockSize);
+}
+
+#endif /* BlockCompression_hpp */
@@ -0,0 +1,1044 @@
+#include "GltfReader.hpp"
+
+#include "VirtualFileSystem.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace gps {
+
+    static const uint32_t GLB_MAGIC = 0x46546C67;       // "glTF"
+    static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;  // "JSON"
+    static const uint32_t GLB_CHUNK_BIN = 0x004E4942;   // "BIN\0"
+
+    static const int GLTF_MODE_TRIANGLES = 4;
+
+    // Deeper documents are rejected instead of overflowing the stack
+    static const int JSON_MAX_DEPTH = 64;
+
+    // Parsed JSON, only as much of it as the reader needs
+    struct JsonValue {
+
+        enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+        Type type;
+        double number;
+        std::string text;
+        // array items, or object members in the order of keys
+        std::vector<JsonValue> items;
+        std::vector<std::string> keys;
+
+        JsonValue() : type(JSON_NULL), number(0.0) {}
+
+        const JsonValue* Get(const char* key) const {
+
+            if (type != JSON_OBJECT) {
+                return NULL;
+            }
+            for (size_t i = 0; i < keys.size(); i++) {
+                if (keys[i] == key) {
+                    return &items[i];
+                }
+            }
+            return NULL;
+        }
+
+        const JsonValue* At(size_t index) const {
+
+            return type == JSON_ARRAY && index < items.size() ? &items[index] : NULL;
+        }
+
+        size_t Size() const {
+
+            return type == JSON_ARRAY ? items.size() : 0;
+        }
+
+        double Number(const char* key, double fallback) const {
+
+            const JsonValue* value = Get(key);
+            return value != NULL && value->type == JSON_NUMBER ? value->number : fallback;
+        }
+
+        // Index into another array of the document, -1 when missing or not a valid index
+        int Index(const char* key) const {
+
+            double value = Number(key, -1.0);
+            return value >= 0.0 && value < 2147483647.0 && value == floor(value) ? (int)value : -1;
+        }
+
+        std::string String(const char* key) const {
+
+            const JsonValue* value = Get(key);
+            return value != NULL && value->type == JSON_STRING ? value->text : std::string();
+        }
+    };
+
+    // Recursive descent parser for the JSON chunk
+    class JsonParser {
+
+    public:
+        JsonParser(const char* text, size_t length) : cursor(text), end(text + length), depth(0) {}
+
+        bool Parse(JsonValue& value) {
+
+            if (!ParseValue(value)) {
+                return false;
+            }
+            SkipSpace();
+            // the chunk is padded with spaces, anything else is garbage
+            return cursor == end || *cursor == '\0';
+        }
+
+    private:
+        const char* cursor;
+        const char* end;
+        int depth;
+
+        void SkipSpace() {
+
+            while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r')) {
+                cursor++;
+            }
+        }
+
+        bool Match(const char* word) {
+
+            size_t length = strlen(word);
+            if ((size_t)(end - cursor) < length || strncmp(cursor, word, length) != 0) {
+                return false;
+            }
+            cursor += length;
+            return true;
+        }
+
+        bool ParseValue(JsonValue& value) {
+
+            SkipSpace();
+            if (cursor == end) {
+                return false;
+            }
+
+            switch (*cursor) {
+            case '{':
+                return ParseObject(value);
+            case '[':
+                return ParseArray(value);
+            case '"':
+                value.type = JsonValue::JSON_STRING;
+                return ParseString(value.text);
+            case 't':
+                value.type = JsonValue::JSON_BOOL;
+                value.number = 1.0;
+                return Match("true");
+            case 'f':
+                value.type = JsonValue::JSON_BOOL;
+                return Match("false");
+            case 'n':
+                return Match("null");
+            default:
+                return ParseNumber(value);
+            }
+        }
+
+        bool ParseNumber(JsonValue& value) {
+
+            // strtod needs a terminated string, numbers are short
+            char number[64];
+            size_t length = 0;
+            while (cursor + length < end && length + 1 < sizeof(number) && strchr("+-0123456789.eE", cursor[length]) != NULL && cursor[length] != '\0') {
+                number[length] = cursor[length];
+                length++;
+            }
+            number[length] = '\0';
+
+            char* numberEnd = NULL;
+            value.number = strtod(number, &numberEnd);
+            if (length == 0 || numberEnd != number + length) {
+                return false;
+            }
+            value.type = JsonValue::JSON_NUMBER;
+            cursor += length;
+            return true;
+        }
+
+        static void AppendUtf8(std::string& text, unsigned int code) {
+
+            if (code < 0x80) {
+                text += (char)code;
+            } else if (code < 0x800) {
+                text += (char)(0xC0 | (code >> 6));
+                text += (char)(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                text += (char)(0xE0 | (code >> 12));
+                text += (char)(0x80 | ((code >> 6) & 0x3F));
+                text += (char)(0x80 | (code & 0x3F));
+            } else {
+                text += (char)(0xF0 | (code >> 18));
+                text += (char)(0x80 | ((code >> 12) & 0x3F));
+                text += (char)(0x80 | ((code >> 6) & 0x3F));
+                text += (char)(0x80 | (code & 0x3F));
+            }
+        }
+
+        bool ParseHex4(unsigned int& code) {
+
+            if (end - cursor < 4) {
+                return false;
+            }
+            code = 0;
+            for (int i = 0; i < 4; i++) {
+
+                char c = *cursor++;
+                code <<= 4;
+                if (c >= '0' && c <= '9') {
+                    code |= c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    code |= c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    code |= c - 'A' + 10;
+                } else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool ParseString(std::string& text) {
+
+            cursor++;
+            while (cursor < end && *cursor != '"') {
+
+                if (*cursor != '\\') {
+                    text += *cursor++;
+                    continue;
+                }
+
+                cursor++;
+                if (cursor == end) {
+                    return false;
+                }
+                char escape = *cursor++;
+                switch (escape) {
+                case '"': text += '"'; break;
+                case '\\': text += '\\'; break;
+                case '/': text += '/'; break;
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+                case 'u': {
+                    unsigned int code;
+                    if (!ParseHex4(code)) {
+                        return false;
+                    }
+                    // a high surrogate followed by a low one is a single code point
+                    if (code >= 0xD800 && code < 0xDC00 && end - cursor >= 6 && cursor[0] == '\\' && cursor[1] == 'u') {
+
+                        const char* low = cursor;
+                        cursor += 2;
+                        unsigned int lowCode;
+                        if (ParseHex4(lowCode) && lowCode >= 0xDC00 && lowCode < 0xE000) {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (lowCode - 0xDC00);
+                        } else {
+                            cursor = low;
+                        }
+                    }
+                    AppendUtf8(text, code);
+                    break;
+                }
+                default:
+                    return false;
+                }
+            }
+
+            if (cursor == end) {
+                return false;
+            }
+            cursor++;
+            return true;
+        }
+
+        bool ParseArray(JsonValue& value) {
+
+            if (++depth > JSON_MAX_DEPTH) {
+                return false;
+            }
+            value.type = JsonValue::JSON_ARRAY;
+            cursor++;
+
+            SkipSpace();
+            if (cursor < end && *cursor == ']') {
+                cursor++;
+                depth--;
+                return true;
+            }
+
+            while (true) {
+
+                value.items.push_back(JsonValue());
+                if (!ParseValue(value.items.back())) {
+                    return false;
+                }
+                SkipSpace();
+                if (cursor == end) {
+                    return false;
+                }
+                if (*cursor == ']') {
+                    cursor++;
+                    depth--;
+                    return true;
+                }
+                if (*cursor++ != ',') {
+                    return false;
+                }
+            }
+        }
+
+        bool ParseObject(JsonValue& value) {
+
+            if (++depth > JSON_MAX_DEPTH) {
+                return false;
+            }
+            value.type = JsonValue::JSON_OBJECT;
+            cursor++;
+
+            SkipSpace();
+            if (cursor < end && *cursor == '}') {
+                cursor++;
+                depth--;
+                return true;
+            }
+
+            while (true) {
+
+                SkipSpace();
+                if (cursor == end || *cursor != '"') {
+                    return false;
+                }
+                value.keys.push_back(std::string());
+                if (!ParseString(value.keys.back())) {
+                    return false;
+                }
+                SkipSpace();
+                if (cursor == end || *cursor++ != ':') {
+                    return false;
+                }
+                value.items.push_back(JsonValue());
+                if (!ParseValue(value.items.back())) {
+                    return false;
+                }
+                SkipSpace();
+                if (cursor == end) {
+                    return false;
+                }
+                if (*cursor == '}') {
+                    cursor++;
+                    depth--;
+                    return true;
+                }
+                if (*cursor++ != ',') {
+                    return false;
+                }
+            }
+        }
+    };
+
+    // Bytes of a buffer and the file they can be named by
+    struct GltfBuffer {
+
+        const unsigned char* data;
+        size_t size;
+        std::string fileName;
+        // where the buffer starts in fileName
+        size_t fileOffset;
+    };
+
+    // An accessor resolved to the bytes it reads, checked against its buffer
+    struct GltfAccessor {
+
+        const unsigned char* data;
+        size_t count;
+        size_t stride;
+        int componentType;
+        int componentCount;
+        bool normalized;
+        int buffer;
+        // from the start of the buffer
+        size_t offset;
+        const JsonValue* json;
+    };
+
+    static size_t GetComponentSize(int componentType) {
+
+        switch (componentType) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+            return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:
+            return 4;
+        default:
+            return 0;
+        }
+    }
+
+    static int GetComponentCount(const std::string& type) {
+
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        if (type == "MAT4") return 16;
+        return 0;
+    }
+
+    static uint32_t ReadUint32(const unsigned char* data) {
+
+        return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
+    static bool ResolveAccessor(const JsonValue& document, const std::vector<GltfBuffer>& buffers, int index, GltfAccessor& accessor) {
+
+        const JsonValue* accessors = document.Get("accessors");
+        const JsonValue* json = accessors != NULL ? accessors->At(index) : NULL;
+        if (json == NULL || json->Get("sparse") != NULL) {
+            return false;
+        }
+
+        const JsonValue* views = document.Get("bufferViews");
+        const JsonValue* view = views != NULL ? views->At(json->Index("bufferView")) : NULL;
+        if (view == NULL) {
+            return false;
+        }
+
+        accessor.json = json;
+        accessor.count = (size_t)json->Number("count", 0.0);
+        accessor.componentType = json->Index("componentType");
+        accessor.componentCount = GetComponentCount(json->String("type"));
+        accessor.normalized = json->Get("normalized") != NULL && json->Get("normalized")->number != 0.0;
+        accessor.buffer = view->Index("buffer");
+
+        size_t elementSize = GetComponentSize(accessor.componentType) * accessor.componentCount;
+        if (elementSize == 0 || accessor.count == 0 || accessor.buffer < 0 || accessor.buffer >= (int)buffers.size()) {
+            return false;
+        }
+
+        size_t viewOffset = (size_t)view->Number("byteOffset", 0.0);
+        size_t viewLength = (size_t)view->Number("byteLength", 0.0);
+        size_t accessorOffset = (size_t)json->Number("byteOffset", 0.0);
+        accessor.stride = (size_t)view->Number("byteStride", 0.0);
+        if (accessor.stride == 0) {
+            accessor.stride = elementSize;
+        }
+
+        // the last element has to end inside the view, and the view inside the buffer
+        const GltfBuffer& buffer = buffers[accessor.buffer];
+        if (viewOffset > buffer.size || viewLength > buffer.size - viewOffset || accessorOffset > viewLength
+            || elementSize > viewLength - accessorOffset || accessor.stride < elementSize
+            || accessor.count - 1 > (viewLength - accessorOffset - elementSize) / accessor.stride) {
+            return false;
+        }
+
+        accessor.offset = viewOffset + accessorOffset;
+        accessor.data = buffer.data + accessor.offset;
+        return true;
+    }
+
+    // One component of an element as a float, normalized integers are mapped to [0, 1] or [-1, 1]
+    static float ReadComponent(const GltfAccessor& accessor, size_t element, int component) {
+
+        const unsigned char* data = accessor.data + element * accessor.stride + component * GetComponentSize(accessor.componentType);
+        switch (accessor.componentType) {
+        case GL_FLOAT: {
+            float value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        case GL_UNSIGNED_BYTE:
+            return accessor.normalized ? data[0] / 255.0f : (float)data[0];
+        case GL_BYTE:
+            return accessor.normalized ? std::max((signed char)data[0] / 127.0f, -1.0f) : (float)(signed char)data[0];
+        case GL_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, data, sizeof(value));
+            return accessor.normalized ? value / 65535.0f : (float)value;
+        }
+        case GL_SHORT: {
+            int16_t value;
+            memcpy(&value, data, sizeof(value));
+            return accessor.normalized ? std::max(value / 32767.0f, -1.0f) : (float)value;
+        }
+        default: {
+            uint32_t value;
+            memcpy(&value, data, sizeof(value));
+            return (float)value;
+        }
+        }
+    }
+
+    static uint32_t ReadIndex(const GltfAccessor& accessor, size_t element) {
+
+        const unsigned char* data = accessor.data + element * accessor.stride;
+        if (accessor.componentType == GL_UNSIGNED_BYTE) {
+            return data[0];
+        }
+        if (accessor.componentType == GL_UNSIGNED_SHORT) {
+            uint16_t value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    // Local transform of a node, from its matrix or its translation, rotation and scale
+    static glm::mat4 GetNodeTransform(const JsonValue& node) {
+
+        glm::mat4 transform(1.0f);
+
+        const JsonValue* matrix = node.Get("matrix");
+        if (matrix != NULL && matrix->Size() == 16) {
+
+            // column major, as glm stores it
+            for (int c = 0; c < 4; c++) {
+                for (int r = 0; r < 4; r++) {
+                    transform[c][r] = (float)matrix->items[c * 4 + r].number;
+                }
+            }
+            return transform;
+        }
+
+        const JsonValue* translation = node.Get("translation");
+        const JsonValue* rotation = node.Get("rotation");
+        const JsonValue* scale = node.Get("scale");
+
+        if (rotation != NULL && rotation->Size() == 4) {
+
+            float x = (float)rotation->items[0].number;
+            float y = (float)rotation->items[1].number;
+            float z = (float)rotation->items[2].number;
+            float w = (float)rotation->items[3].number;
+
+            transform[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + z * w), 2.0f * (x * z - y * w), 0.0f);
+            transform[1] = glm::vec4(2.0f * (x * y - z * w), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + x * w), 0.0f);
+            transform[2] = glm::vec4(2.0f * (x * z + y * w), 2.0f * (y * z - x * w), 1.0f - 2.0f * (x * x + y * y), 0.0f);
+        }
+        if (scale != NULL && scale->Size() == 3) {
+
+            for (int c = 0; c < 3; c++) {
+                transform[c] = transform[c] * (float)scale->items[c].number;
+            }
+        }
+        if (translation != NULL && translation->Size() == 3) {
+
+            transform[3] = glm::vec4((float)translation->items[0].number, (float)translation->items[1].number, (float)translation->items[2].number, 1.0f);
+        }
+        return transform;
+    }
+
+    // A translation with the same positive scale on every axis, which the position decode constants can hold
+    static bool IsScaleAndTranslation(const glm::mat4& transform, float& scale) {
+
+        scale = glm::length(glm::vec3(transform[0]));
+        float tolerance = 1e-6f * std::max(1.0f, scale);
+        if (!(scale > 0.0f) || transform[0][3] != 0.0f || transform[1][3] != 0.0f || transform[2][3] != 0.0f || transform[3][3] != 1.0f) {
+            return false;
+        }
+        for (int c = 0; c < 3; c++) {
+
+            glm::vec3 expected(0.0f);
+            expected[c] = scale;
+            if (glm::length(glm::vec3(transform[c]) - expected) > tolerance) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Undoes the percent encoding of a relative uri
+    static std::string DecodeUri(const std::string& uri) {
+
+        std::string path;
+        for (size_t i = 0; i < uri.size(); i++) {
+
+            unsigned int code;
+            if (uri[i] == '%' && i + 2 < uri.size() && sscanf(uri.c_str() + i + 1, "%2x", &code) == 1) {
+                path += (char)code;
+                i += 2;
+            } else {
+                path += uri[i];
+            }
+        }
+        return path;
+    }
+
+    // Everything a primitive needs from the document while it is being read
+    struct GltfContext {
+
+        const JsonValue* document;
+        std::vector<GltfBuffer> buffers;
+        std::string basePath;
+        size_t streamedCount;
+        size_t gatheredCount;
+        size_t vertexCount;
+        size_t triangleCount;
+    };
+
+    // File an image can be loaded from, the image file itself or the range of the buffer it is embedded in
+    static std::string GetImageFileName(const GltfContext& context, int imageIndex) {
+
+        const JsonValue* images = context.document->Get("images");
+        const JsonValue* image = images != NULL ? images->At(imageIndex) : NULL;
+        if (image == NULL) {
+            return std::string();
+        }
+
+        std::string uri = image->String("uri");
+        if (!uri.empty()) {
+
+            if (uri.compare(0, 5, "data:") == 0) {
+                fprintf(stderr, "WARNING: image %d is a data uri, which is not supported\n", imageIndex);
+                return std::string();
+            }
+            return context.basePath + DecodeUri(uri);
+        }
+
+        const JsonValue* views = context.document->Get("bufferViews");
+        const JsonValue* view = views != NULL ? views->At(image->Index("bufferView")) : NULL;
+        int bufferIndex = view != NULL ? view->Index("buffer") : -1;
+        if (bufferIndex < 0 || bufferIndex >= (int)context.buffers.size()) {
+            return std::string();
+        }
+
+        const GltfBuffer& buffer = context.buffers[bufferIndex];
+        size_t offset = (size_t)view->Number("byteOffset", 0.0);
+        size_t length = (size_t)view->Number("byteLength", 0.0);
+        if (length == 0 || offset > buffer.size || length > buffer.size - offset) {
+            return std::string();
+        }
+        return VirtualFileSystem::GetRangeFileName(buffer.fileName, buffer.fileOffset + offset, length);
+    }
+
+    static void AddMaterialTextures(const GltfContext& context, int materialIndex, PreparedMesh& preparedMesh) {
+
+        const JsonValue* materials = context.document->Get("materials");
+        const JsonValue* material = materials != NULL ? materials->At(materialIndex) : NULL;
+        const JsonValue* pbr = material != NULL ? material->Get("pbrMetallicRoughness") : NULL;
+        const JsonValue* baseColor = pbr != NULL ? pbr->Get("baseColorTexture") : NULL;
+        if (baseColor == NULL) {
+            return;
+        }
+
+        const JsonValue* textures = context.document->Get("textures");
+        const JsonValue* texture = textures != NULL ? textures->At(baseColor->Index("index")) : NULL;
+        if (texture == NULL) {
+            return;
+        }
+
+        std::string path = GetImageFileName(context, texture->Index("source"));
+        if (!path.empty()) {
+
+            gps::Texture diffuse;
+            diffuse.id = 0;
+            diffuse.type = "diffuseTexture";
+            diffuse.path = path;
+            preparedMesh.textures.push_back(diffuse);
+        }
+    }
+
+    // Points the streams of a mesh into the buffers, false if the layout is not one the GL can take as it is
+    static bool MapStreams(const GltfContext& context, const GltfAccessor* attributes, const bool* present, const GltfAccessor& indices,
+        const glm::mat4& transform, MeshStreams& streams) {
+
+        float scale;
+        if (!IsScaleAndTranslation(transform, scale)) {
+            return false;
+        }
+
+        const GltfAccessor& position = attributes[0];
+        const GltfAccessor& normal = attributes[1];
+        const GltfAccessor& texCoords = attributes[2];
+        if (position.componentType != GL_FLOAT || position.componentCount != 3 || !present[1]
+            || normal.componentType != GL_FLOAT || normal.componentCount != 3 || normal.count != position.count || normal.buffer != position.buffer) {
+            return false;
+        }
+        if (present[2] && (texCoords.componentCount != 2 || texCoords.count != position.count || texCoords.buffer != position.buffer
+            || !(texCoords.componentType == GL_FLOAT || (texCoords.normalized && (texCoords.componentType == GL_UNSIGNED_BYTE || texCoords.componentType == GL_UNSIGNED_SHORT))))) {
+            return false;
+        }
+
+        // the element buffer is uploaded as it is, so the indices have to be packed and in range
+        size_t indexSize = GetComponentSize(indices.componentType);
+        if (indices.componentCount != 1 || indices.stride != indexSize || indices.count % 3 != 0
+            || (indices.componentType != GL_UNSIGNED_BYTE && indices.componentType != GL_UNSIGNED_SHORT && indices.componentType != GL_UNSIGNED_INT)
+            || (indexSize > 1 && indices.offset % indexSize != 0)) {
+            return false;
+        }
+        for (size_t i = 0; i < indices.count; i++) {
+            if (ReadIndex(indices, i) >= position.count) {
+                return false;
+            }
+        }
+
+        // the vertex buffer is the span of the buffer covering every attribute
+        size_t first = (size_t)-1;
+        size_t last = 0;
+        for (int a = 0; a < 3; a++) {
+
+            if (!present[a]) {
+                continue;
+            }
+            size_t elementSize = GetComponentSize(attributes[a].componentType) * attributes[a].componentCount;
+            first = std::min(first, attributes[a].offset);
+            last = std::max(last, attributes[a].offset + (attributes[a].count - 1) * attributes[a].stride + elementSize);
+        }
+
+        streams.vertexData = context.buffers[position.buffer].data + first;
+        streams.vertexBytes = last - first;
+        streams.vertexCount = position.count;
+        for (int a = 0; a < 3; a++) {
+
+            streams.present[a] = present[a];
+            streams.attributes[a] = VertexLayout<Vertex>::attributes[a];
+            if (present[a]) {
+
+                streams.attributes[a].size = attributes[a].componentCount;
+                streams.attributes[a].type = (GLenum)attributes[a].componentType;
+                streams.attributes[a].normalized = attributes[a].normalized ? GL_TRUE : GL_FALSE;
+                streams.attributes[a].offset = attributes[a].offset - first;
+                streams.strides[a] = (GLsizei)attributes[a].stride;
+            } else {
+                streams.strides[a] = 0;
+            }
+        }
+
+        streams.indexData = indices.data;
+        streams.indexCount = indices.count;
+        streams.indexType = (GLenum)indices.componentType;
+        streams.positionScale = glm::vec3(scale);
+        streams.positionOffset = glm::vec3(transform[3]);
+
+        // min and max are required for positions, files missing them cost one pass over the positions
+        const JsonValue* min = position.json->Get("min");
+        const JsonValue* max = position.json->Get("max");
+        glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+        if (min != NULL && max != NULL && min->Size() == 3 && max->Size() == 3) {
+
+            for (int c = 0; c < 3; c++) {
+                boundsMin[c] = (float)min->items[c].number;
+                boundsMax[c] = (float)max->items[c].number;
+            }
+        } else {
+
+            boundsMin = glm::vec3(INFINITY);
+            boundsMax = glm::vec3(-INFINITY);
+            for (size_t v = 0; v < position.count; v++) {
+                for (int c = 0; c < 3; c++) {
+
+                    float value = ReadComponent(position, v, c);
+                    boundsMin[c] = std::min(boundsMin[c], value);
+                    boundsMax[c] = std::max(boundsMax[c], value);
+                }
+            }
+        }
+        streams.boundsMin = boundsMin * scale + streams.positionOffset;
+        streams.boundsMax = boundsMax * scale + streams.positionOffset;
+        return true;
+    }
+
+    // Copies a primitive into Vertex and index arrays with the node transform applied
+    static void GatherPrimitive(const GltfAccessor* attributes, const bool* present, const GltfAccessor* indices,
+        const glm::mat4& transform, PreparedMesh& preparedMesh) {
+
+        const GltfAccessor& position = attributes[0];
+        glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+        preparedMesh.vertices.resize(position.count);
+        for (size_t v = 0; v < position.count; v++) {
+
+            gps::Vertex& vertex = preparedMesh.vertices[v];
+            vertex.Position = glm::vec3(transform * glm::vec4(ReadComponent(position, v, 0), ReadComponent(position, v, 1), ReadComponent(position, v, 2), 1.0f));
+            vertex.Normal = glm::vec3(0.0f);
+            vertex.TexCoords = glm::vec2(0.0f);
+
+            if (present[1] && v < attributes[1].count) {
+
+                glm::vec3 normal = normalTransform * glm::vec3(ReadComponent(attributes[1], v, 0), ReadComponent(attributes[1], v, 1), ReadComponent(attributes[1], v, 2));
+                float length = glm::length(normal);
+                vertex.Normal = length > 0.0f ? normal / length : normal;
+            }
+            if (present[2] && v < attributes[2].count) {
+                vertex.TexCoords = glm::vec2(ReadComponent(attributes[2], v, 0), ReadComponent(attributes[2], v, 1));
+            }
+        }
+
+        // primitives without indices draw their vertices in order
+        size_t indexCount = indices != NULL ? indices->count : position.count;
+        indexCount -= indexCount % 3;
+        preparedMesh.indices.resize(indexCount);
+        for (size_t i = 0; i < indexCount; i++) {
+
+            uint32_t index = indices != NULL ? ReadIndex(*indices, i) : (uint32_t)i;
+            preparedMesh.indices[i] = index < position.count ? index : 0;
+        }
+
+        // a mirroring transform turns the triangles inside out
+        if (glm::determinant(glm::mat3(transform)) < 0.0f) {
+            for (size_t i = 0; i + 2 < indexCount; i += 3) {
+                std::swap(preparedMesh.indices[i + 1], preparedMesh.indices[i + 2]);
+            }
+        }
+
+        // missing normals are the area weighted face normals around each vertex
+        if (!present[1]) {
+
+            for (size_t i = 0; i + 2 < indexCount; i += 3) {
+
+                gps::Vertex& a = preparedMesh.vertices[preparedMesh.indices[i]];
+                gps::Vertex& b = preparedMesh.vertices[preparedMesh.indices[i + 1]];
+                gps::Vertex& c = preparedMesh.vertices[preparedMesh.indices[i + 2]];
+                glm::vec3 faceNormal = glm::cross(b.Position - a.Position, c.Position - a.Position);
+                a.Normal += faceNormal;
+                b.Normal += faceNormal;
+                c.Normal += faceNormal;
+            }
+            for (size_t v = 0; v < preparedMesh.vertices.size(); v++) {
+
+                float length = glm::length(preparedMesh.vertices[v].Normal);
+                preparedMesh.vertices[v].Normal = length > 0.0f ? preparedMesh.vertices[v].Normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+            }
+        }
+
+        preparedMesh.vertexData = preparedMesh.vertices.data();
+        preparedMesh.vertexCount = preparedMesh.vertices.size();
+        preparedMesh.indexData = preparedMesh.indices.data();
+        preparedMesh.indexCount = preparedMesh.indices.size();
+    }
+
+    static void ReadPrimitive(GltfContext& context, const JsonValue& primitive, const glm::mat4& transform, std::vector<PreparedMesh>& meshes) {
+
+        if ((int)primitive.Number("mode", GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES) {
+            fprintf(stderr, "WARNING: skipping a primitive that is not a triangle list\n");
+            return;
+        }
+
+        const JsonValue* attributeNames = primitive.Get("attributes");
+        const char* names[3] = { "POSITION", "NORMAL", "TEXCOORD_0" };
+        GltfAccessor attributes[3];
+        bool present[3];
+        for (int a = 0; a < 3; a++) {
+
+            int index = attributeNames != NULL ? attributeNames->Index(names[a]) : -1;
+            present[a] = index >= 0 && ResolveAccessor(*context.document, context.buffers, index, attributes[a]);
+        }
+        if (!present[0] || attributes[0].componentCount != 3) {
+            fprintf(stderr, "WARNING: skipping a primitive without valid positions\n");
+            return;
+        }
+        present[1] = present[1] && attributes[1].componentCount == 3;
+        present[2] = present[2] && attributes[2].componentCount == 2;
+
+        GltfAccessor indices;
+        int indicesIndex = primitive.Index("indices");
+        bool indexed = indicesIndex >= 0 && ResolveAccessor(*context.document, context.buffers, indicesIndex, indices);
+        if (indicesIndex >= 0 && !indexed) {
+            fprintf(stderr, "WARNING: skipping a primitive with invalid indices\n");
+            return;
+        }
+
+        PreparedMesh preparedMesh;
+        preparedMesh.vertexData = NULL;
+        preparedMesh.packedVertexData = NULL;
+        preparedMesh.vertexCount = 0;
+        preparedMesh.indexData = NULL;
+        preparedMesh.indexCount = 0;
+        preparedMesh.flipTextures = false;
+        preparedMesh.hasStreams = indexed && MapStreams(context, attributes, present, indices, transform, preparedMesh.streams);
+
+        if (preparedMesh.hasStreams) {
+
+            context.streamedCount++;
+            context.vertexCount += preparedMesh.streams.vertexCount;
+            context.triangleCount += preparedMesh.streams.indexCount / 3;
+        } else {
+
+            GatherPrimitive(attributes, present, indexed ? &indices : NULL, transform, preparedMesh);
+            context.gatheredCount++;
+            context.vertexCount += preparedMesh.vertexCount;
+            context.triangleCount += preparedMesh.indexCount / 3;
+        }
+
+        AddMaterialTextures(context, primitive.Index("material"), preparedMesh);
+        meshes.push_back(std::move(preparedMesh));
+    }
+
+    static void ReadNode(GltfContext& context, int nodeIndex, const glm::mat4& parentTransform, int depth, std::vector<PreparedMesh>& meshes) {
+
+        const JsonValue* nodes = context.document->Get("nodes");
+        const JsonValue* node = nodes != NULL ? nodes->At(nodeIndex) : NULL;
+        // a well formed hierarchy is a forest, the depth limit stops cycles
+        if (node == NULL || depth > JSON_MAX_DEPTH) {
+            return;
+        }
+
+        glm::mat4 transform = parentTransform * GetNodeTransform(*node);
+
+        const JsonValue* gltfMeshes = context.document->Get("meshes");
+        const JsonValue* mesh = gltfMeshes != NULL ? gltfMeshes->At(node->Index("mesh")) : NULL;
+        const JsonValue* primitives = mesh != NULL ? mesh->Get("primitives") : NULL;
+        for (size_t p = 0; p < (primitives != NULL ? primitives->Size() : 0); p++) {
+            ReadPrimitive(context, primitives->items[p], transform, meshes);
+        }
+
+        const JsonValue* children = node->Get("children");
+        for (size_t c = 0; c < (children != NULL ? children->Size() : 0); c++) {
+            ReadNode(context, children->items[c].type == JsonValue::JSON_NUMBER ? (int)children->items[c].number : -1, transform, depth + 1, meshes);
+        }
+    }
+
+    bool GltfReader::Read(std::string fileName, std::string basePath, std::vector<PreparedMesh>& meshes, std::ostream& log) {
+
+        Close();
+        log << "Loading : " << fileName << std::endl;
+
+        if (!VirtualFileSystem::GetShared().Open(fileName, file)) {
+            fprintf(stderr, "ERROR: could not open %s\n", fileName.c_str());
+            return false;
+        }
+
+        // 12 byte header, then the JSON chunk and an optional BIN chunk, each with its length and type
+        const unsigned char* data = file.GetData();
+        size_t size = file.GetSize();
+        if (size < 20 || ReadUint32(data) != GLB_MAGIC || ReadUint32(data + 4) != 2 || ReadUint32(data + 8) > size || ReadUint32(data + 8) < 20
+            || ReadUint32(data + 16) != GLB_CHUNK_JSON || ReadUint32(data + 12) > ReadUint32(data + 8) - 20) {
+            fprintf(stderr, "ERROR: %s is not a binary glTF 2.0 file\n", fileName.c_str());
+            Close();
+            return false;
+        }
+        size = ReadUint32(data + 8);
+
+        size_t jsonLength = ReadUint32(data + 12);
+        const char* json = (const char*)data + 20;
+
+        GltfBuffer bin = { NULL, 0, fileName, 0 };
+        size_t binChunk = 20 + ((jsonLength + 3) & ~(size_t)3);
+        if (binChunk + 8 <= size && ReadUint32(data + binChunk + 4) == GLB_CHUNK_BIN && ReadUint32(data + binChunk) <= size - binChunk - 8) {
+
+            bin.data = data + binChunk + 8;
+            bin.size = ReadUint32(data + binChunk);
+            bin.fileOffset = binChunk + 8;
+        }
+
+        JsonValue document;
+        JsonParser parser(json, jsonLength);
+        if (!parser.Parse(document) || document.type != JsonValue::JSON_OBJECT) {
+            fprintf(stderr, "ERROR: malformed JSON in %s\n", fileName.c_str());
+            Close();
+            return false;
+        }
+
+        GltfContext context;
+        context.document = &document;
+        context.basePath = basePath;
+        context.streamedCount = 0;
+        context.gatheredCount = 0;
+        context.vertexCount = 0;
+        context.triangleCount = 0;
+
+        // the first buffer without a uri is the BIN chunk, the others are files next to the model
+        const JsonValue* buffers = document.Get("buffers");
+        for (size_t b = 0; b < (buffers != NULL ? buffers->Size() : 0); b++) {
+
+            std::string uri = buffers->items[b].String("uri");
+            size_t byteLength = (size_t)buffers->items[b].Number("byteLength", 0.0);
+
+            if (uri.empty()) {
+
+                if (b != 0 || bin.data == NULL || byteLength > bin.size) {
+                    fprintf(stderr, "ERROR: buffer %zu of %s has no data\n", b, fileName.c_str());
+                    Close();
+                    return false;
+                }
+                context.buffers.push_back(bin);
+                context.buffers.back().size = byteLength;
+                continue;
+            }
+
+            std::unique_ptr<MappedFile> bufferFile(new MappedFile());
+            std::string bufferFileName = basePath + DecodeUri(uri);
+            if (uri.compare(0, 5, "data:") == 0 || !VirtualFileSystem::GetShared().Open(bufferFileName, *bufferFile) || byteLength > bufferFile->GetSize()) {
+                fprintf(stderr, "ERROR: could not open buffer %s of %s\n", uri.compare(0, 5, "data:") == 0 ? "(data uri)" : uri.c_str(), fileName.c_str());
+                Close();
+                return false;
+            }
+
+            GltfBuffer buffer = { bufferFile->GetData(), byteLength, bufferFileName, 0 };
+            context.buffers.push_back(buffer);
+            externalBuffers.push_back(std::move(bufferFile));
+        }
+
+        // the default scene, or every node nobody has as a child
+        std::vector<int> roots;
+        const JsonValue* scenes = document.Get("scenes");
+        int sceneIndex = document.Index("scene");
+        const JsonValue* scene = scenes != NULL ? scenes->At(sceneIndex >= 0 ? sceneIndex : 0) : NULL;
+        const JsonValue* sceneNodes = scene != NULL ? scene->Get("nodes") : NULL;
+        if (sceneNodes != NULL) {
+
+            for (size_t n = 0; n < sceneNodes->Size(); n++) {
+                roots.push_back(sceneNodes->items[n].type == JsonValue::JSON_NUMBER ? (int)sceneNodes->items[n].number : -1);
+            }
+        } else {
+
+            const JsonValue* nodes = document.Get("nodes");
+            std::vector<bool> isChild(nodes != NULL ? nodes->Size() : 0, false);
+            for (size_t n = 0; n < isChild.size(); n++) {
+
+                const JsonValue* children = nodes->items[n].Get("children");
+                for (size_t c = 0; c < (children != NULL ? children->Size() : 0); c++) {
+
+                    int child = (int)children->items[c].number;
+                    if (child >= 0 && child < (int)isChild.size()) {
+                        isChild[child] = true;
+                    }
+                }
+            }
+            for (size_t n = 0; n < isChild.size(); n++) {
+                if (!isChild[n]) {
+                    roots.push_back((int)n);
+                }
+            }
+        }
+
+        size_t firstMesh = meshes.size();
+        for (size_t r = 0; r < roots.size(); r++) {
+            ReadNode(context, roots[r], glm::mat4(1.0f), 0, meshes);
+        }
+
+        log << "# of primitives : " << meshes.size() - firstMesh << " (" << context.streamedCount << " uploaded as stored, "
+            << context.gatheredCount << " gathered)" << std::endl;
+        log << "# of vertices  : " << context.vertexCount << ", triangles : " << context.triangleCount << std::endl;
+
+        if (meshes.size() == firstMesh) {
+            fprintf(stderr, "ERROR: %s has no triangles to draw\n", fileName.c_str());
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void GltfReader::Close() {
+
+        file.Close();
+        externalBuffers.clear();
+    }
+}
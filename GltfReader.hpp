@@ -0,0 +1,44 @@
+#ifndef GltfReader_hpp
+#define GltfReader_hpp
+
+#include "MappedFile.hpp"
+#include "MeshBuilder.hpp"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Reader for binary glTF 2.0 (.glb) files
+    //
+    // Every triangle primitive placed by a node of the scene becomes one
+    // mesh. When its attributes are float positions and normals with float
+    // or normalized integer UVs in one buffer, and its node transform is a
+    // translation with a uniform scale, the mesh only points into the mapped
+    // file: the buffers are uploaded byte for byte and the transform becomes
+    // the position decode constants. Anything else (rotated or mirrored
+    // nodes, missing normals or indices, other component types) is gathered
+    // into Vertex arrays with the transform applied.
+    //
+    // The base color texture of a material is used as the diffuse texture;
+    // images embedded in a buffer are loaded through VirtualFileSystem range
+    // names, so they are streamed, cached and shared like image files.
+    class GltfReader {
+
+    public:
+        // Maps the file and appends the meshes of its scene, progress and statistics go to log
+        // Streams point into the mapped buffers, which stay open until Close
+        bool Read(std::string fileName, std::string basePath, std::vector<PreparedMesh>& meshes, std::ostream& log);
+
+        void Close();
+
+    private:
+        MappedFile file;
+        // buffers stored next to the .gltf data instead of in its BIN chunk
+        std::vector<std::unique_ptr<MappedFile> > externalBuffers;
+    };
+}
+
+#endif /* GltfReader_hpp */
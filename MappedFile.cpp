@@ -0,0 +1,202 @@
+#include "MappedFile.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined (_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace gps {
+
+    MappedFile::MappedFile() {
+
+        data = NULL;
+        size = 0;
+#if defined (_WIN32)
+        fileHandle = INVALID_HANDLE_VALUE;
+        mappingHandle = NULL;
+#else
+        fileDescriptor = -1;
+#endif
+    }
+
+    MappedFile::~MappedFile() {
+
+        Close();
+    }
+
+    bool MappedFile::Open(std::string fileName) {
+
+        Close();
+
+#if defined (_WIN32)
+        fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) {
+            Close();
+            return false;
+        }
+        size = (size_t)fileSize.QuadPart;
+
+        //empty files cannot be mapped, but are still valid
+        if (size == 0) {
+            return true;
+        }
+
+        mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mappingHandle == NULL) {
+            Close();
+            return false;
+        }
+
+        data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+        if (data == NULL) {
+            Close();
+            return false;
+        }
+#else
+        fileDescriptor = open(fileName.c_str(), O_RDONLY);
+        if (fileDescriptor == -1) {
+            return false;
+        }
+
+        struct stat status;
+        if (fstat(fileDescriptor, &status) != 0) {
+            Close();
+            return false;
+        }
+        size = (size_t)status.st_size;
+
+        //empty files cannot be mapped, but are still valid
+        if (size == 0) {
+            return true;
+        }
+
+        void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+        if (mapping == MAP_FAILED) {
+            Close();
+            return false;
+        }
+        data = (const unsigned char*)mapping;
+
+        //the whole file is read front to back
+        madvise(mapping, size, MADV_SEQUENTIAL);
+#endif
+
+        return true;
+    }
+
+    bool MappedFile::OpenView(std::shared_ptr<const MappedFile> owner, size_t offset, size_t size) {
+
+        Close();
+
+        if (!owner || offset > owner->GetSize() || size > owner->GetSize() - offset) {
+            return false;
+        }
+
+        this->owner = owner;
+        data = owner->GetData() + offset;
+        this->size = size;
+
+        return true;
+    }
+
+    void MappedFile::Close() {
+
+        if (owner) {
+
+            owner.reset();
+            data = NULL;
+            size = 0;
+            return;
+        }
+
+#if defined (_WIN32)
+        if (data != NULL) {
+            UnmapViewOfFile(data);
+        }
+        if (mappingHandle != NULL) {
+            CloseHandle(mappingHandle);
+        }
+        if (fileHandle != INVALID_HANDLE_VALUE) {
+            CloseHandle(fileHandle);
+        }
+        fileHandle = INVALID_HANDLE_VALUE;
+        mappingHandle = NULL;
+#else
+        if (data != NULL) {
+            munmap((void*)data, size);
+        }
+        if (fileDescriptor != -1) {
+            close(fileDescriptor);
+        }
+        fileDescriptor = -1;
+#endif
+
+        data = NULL;
+        size = 0;
+    }
+
+    bool MappedFile::IsOpen() const {
+
+        if (owner) {
+            return true;
+        }
+
+#if defined (_WIN32)
+        return fileHandle != INVALID_HANDLE_VALUE;
+#else
+        return fileDescriptor != -1;
+#endif
+    }
+
+    const unsigned char* MappedFile::GetData() const {
+
+        return data;
+    }
+
+    size_t MappedFile::GetSize() const {
+
+        return size;
+    }
+
+    bool MappedFile::GetFileInfo(std::string fileName, FileInfo& info) {
+
+#if defined (_WIN32)
+        WIN32_FILE_ATTRIBUTE_DATA attributes;
+        if (!GetFileAttributesExA(fileName.c_str(), GetFileExInfoStandard, &attributes)) {
+            return false;
+        }
+
+        info.size = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+        // 100ns ticks
+        info.modifiedTime = (int64_t)(((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime);
+#else
+        struct stat status;
+        if (stat(fileName.c_str(), &status) != 0) {
+            return false;
+        }
+
+        info.size = (uint64_t)status.st_size;
+        // nanoseconds, so rewrites within the same second are still noticed
+#if defined (__APPLE__)
+        info.modifiedTime = (int64_t)status.st_mtimespec.tv_sec * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+        info.modifiedTime = (int64_t)status.st_mtim.tv_sec * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+#endif
+
+        return true;
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+namespace gps {
+
+    // Size and last modification time of a file on disk
+    struct FileInfo {
+
+        uint64_t size;
+        // platform specific resolution, only compared for equality
+        int64_t modifiedTime;
+    };
+
+    // Read-only memory mapping of a whole file
+    class MappedFile {
+
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        // Maps the file into memory, returns false if it cannot be opened
+        bool Open(std::string fileName);
+
+        // Views a range of another mapping, which stays mapped as long as the view is open
+        bool OpenView(std::shared_ptr<const MappedFile> owner, size_t offset, size_t size);
+
+        void Close();
+
+        bool IsOpen() const;
+        const unsigned char* GetData() const;
+        size_t GetSize() const;
+
+        // Reads the size and modification time of a file without opening it
+        static bool GetFileInfo(std::string fileName, FileInfo& info);
+
+    private:
+        const unsigned char* data;
+        size_t size;
+        // set for views, which own nothing of the mapping themselves
+        std::shared_ptr<const MappedFile> owner;
+#if defined (_WIN32)
+        void* fileHandle;
+        void* mappingHandle;
+#else
+        int fileDescriptor;
+#endif
+
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+    };
+}
+
+#endif /* MappedFile_hpp */
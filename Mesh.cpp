@@ -1,47 +1,624 @@
 #include "Mesh.hpp"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
 namespace gps {
 
+	unsigned int Mesh::textureBindCount = 0;
+	unsigned int Mesh::unbatchedTextureBindCount = 0;
+	unsigned int Mesh::drawCount = 0;
+	unsigned long Mesh::triangleCount = 0;
+	unsigned long Mesh::fullDetailTriangleCount = 0;
+	unsigned long Mesh::frustumCulledTriangleCount = 0;
+	unsigned long Mesh::backfaceCulledTriangleCount = 0;
+
+	// Index runs of the visible meshlets, reused by every multi-draw
+	static std::vector<GLsizei> multiDrawCounts;
+	static std::vector<GLvoid*> multiDrawOffsets;
+	static std::vector<GLint> multiDrawBaseVertices;
+
+	const VertexAttribute VertexLayout<Vertex>::attributes[] = {
+		{ 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position) },
+		{ 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal) },
+		{ 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoords) }
+	};
+
+	const VertexAttribute VertexLayout<PackedVertex>::attributes[] = {
+		{ 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(PackedVertex, Position) },
+		{ 1, 2, GL_SHORT, GL_TRUE, offsetof(PackedVertex, Normal) },
+		{ 2, 2, GL_HALF_FLOAT, GL_FALSE, offsetof(PackedVertex, TexCoords) }
+	};
+
+	// Half floats step by 1/2048 in [0.5, 1) and by 1/1024 in [1, 2), up to a texel of a 2048 texture
+	// below this, twice as coarse past it, so models with larger UVs keep float vertices
+	static const float PACKED_TEXCOORD_LIMIT = 1.0f;
+
+	// Round to nearest, overflow goes to infinity and tiny values to zero
+	static GLushort FloatToHalf(float value) {
+
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		uint32_t sign = (bits >> 16) & 0x8000;
+		int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+		uint32_t mantissa = bits & 0x7fffff;
+
+		if (exponent >= 31) {
+			return (GLushort)(sign | 0x7c00);
+		}
+		if (exponent <= 0) {
+
+			// subnormal half, or zero
+			if (exponent < -10) {
+				return (GLushort)sign;
+			}
+			mantissa |= 0x800000;
+			uint32_t shift = (uint32_t)(14 - exponent);
+			uint32_t half = mantissa >> shift;
+			if ((mantissa >> (shift - 1)) & 1) {
+				half++;
+			}
+			return (GLushort)(sign | half);
+		}
+
+		uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+		// a carry out of the mantissa correctly bumps the exponent
+		if (mantissa & 0x1000) {
+			half++;
+		}
+		return (GLushort)half;
+	}
+
+	static GLshort FloatToSnorm16(float value) {
+
+		value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+		return (GLshort)floorf(value * 32767.0f + 0.5f);
+	}
+
+	// Projects the normal onto an octahedron and unfolds the lower half over the corners
+	static void EncodeOctahedral(const glm::vec3& normal, GLshort* encoded) {
+
+		float length = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+		if (length == 0.0f) {
+
+			encoded[0] = 0;
+			encoded[1] = 0;
+			return;
+		}
+
+		float x = normal.x / length;
+		float y = normal.y / length;
+		if (normal.z < 0.0f) {
+
+			float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+
+		encoded[0] = FloatToSnorm16(x);
+		encoded[1] = FloatToSnorm16(y);
+	}
+
+	MeshBuffers::MeshBuffers() {
+
+		this->VAO = 0;
+		this->VBO = 0;
+		this->EBO = 0;
+		this->indexType = GL_UNSIGNED_INT;
+	}
+
+	MeshBuffers::~MeshBuffers() {
+
+		// names of 0 are ignored, so a moved-from mesh deletes nothing
+		glDeleteBuffers(1, &this->VBO);
+		glDeleteBuffers(1, &this->EBO);
+		glDeleteVertexArrays(1, &this->VAO);
+	}
+
+	MeshBuffers::MeshBuffers(MeshBuffers&& other) noexcept : Buffers(other) {
+
+		other.VAO = 0;
+		other.VBO = 0;
+		other.EBO = 0;
+	}
+
+	MeshBuffers& MeshBuffers::operator=(MeshBuffers&& other) noexcept {
+
+		if (this != &other) {
+
+			glDeleteBuffers(1, &this->VBO);
+			glDeleteBuffers(1, &this->EBO);
+			glDeleteVertexArrays(1, &this->VAO);
+
+			Buffers::operator=(other);
+			other.VAO = 0;
+			other.VBO = 0;
+			other.EBO = 0;
+		}
+		return *this;
+	}
+
 	/* Mesh Constructor */
-	Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures) {
+	Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets, const VertexPacking* packing) {
+
+		this->vertices = std::move(vertices);
+		this->indices = std::move(indices);
+		this->textures = std::move(textures);
+
+		this->setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), std::move(lods), std::move(meshlets), packing);
+	}
+
+	/* Mesh Constructor - geometry is only uploaded, not retained */
+	Mesh::Mesh(const Vertex* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount, std::vector<Texture> textures, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets, const VertexPacking* packing) {
 
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		this->textures = std::move(textures);
 
-		this->setupMesh();
+		this->setupMesh(vertexData, vertexCount, indexData, indexCount, std::move(lods), std::move(meshlets), packing);
 	}
 
-	Buffers Mesh::getBuffers() {
+	/* Mesh Constructor - vertices were quantized when they were stored */
+	Mesh::Mesh(const PackedVertex* vertexData, size_t vertexCount, glm::vec3 rangeMin, glm::vec3 rangeMax, glm::vec3 boundsMin, glm::vec3 boundsMax,
+		const GLuint* indexData, size_t indexCount, std::vector<Texture> textures, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets) {
+
+		this->textures = std::move(textures);
+
+		this->setupMesh(vertexData, vertexCount, rangeMin, rangeMax, boundsMin, boundsMax, indexData, indexCount, std::move(lods), std::move(meshlets));
+	}
+
+	/* Mesh Constructor - buffers go to the GL without touching a single vertex */
+	Mesh::Mesh(const MeshStreams& streams, std::vector<Texture> textures) {
+
+		this->textures = std::move(textures);
+		this->indexCount = (GLsizei)streams.indexCount;
+		this->decodeScale = glm::vec4(streams.positionScale, 0.0f);
+		this->decodeOffset = streams.positionOffset;
+
+		MeshLod full = { 0, (uint32_t)streams.indexCount, 0.0f };
+		this->lods.push_back(full);
+
+		this->boundsCenter = (streams.boundsMin + streams.boundsMax) * 0.5f;
+		this->boundsRadius = glm::length(streams.boundsMax - streams.boundsMin) * 0.5f;
+		this->vertexFormat = VERTEX_FORMAT_FLOAT;
+
+		size_t indexSize = streams.indexType == GL_UNSIGNED_BYTE ? sizeof(GLubyte) : streams.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		this->vertexBytes = streams.vertexBytes;
+		this->indexBytes = streams.indexCount * indexSize;
+
+		glGenVertexArrays(1, &this->buffers.VAO);
+		glGenBuffers(1, &this->buffers.VBO);
+		glGenBuffers(1, &this->buffers.EBO);
+
+		glBindVertexArray(this->buffers.VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffers.VBO);
+		glBufferData(GL_ARRAY_BUFFER, this->vertexBytes, streams.vertexData, GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers.EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indexBytes, streams.indexData, GL_STATIC_DRAW);
+
+		this->buffers.indexType = streams.indexType;
+		IndexRange range = { (GLsizei)streams.indexCount, 0, 0 };
+		this->indexRanges.push_back(range);
+		this->lodFirstRange.push_back(0);
+		this->lodFirstRange.push_back(1);
+		this->setupMeshletRanges();
+
+		for (size_t a = 0; a < 3; a++) {
+
+			const VertexAttribute& attribute = streams.attributes[a];
+			if (!streams.present[a]) {
+
+				glDisableVertexAttribArray(VertexLayout<Vertex>::attributes[a].location);
+				continue;
+			}
+			glEnableVertexAttribArray(attribute.location);
+			glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, streams.strides[a], (GLvoid*)attribute.offset);
+		}
+
+		glBindVertexArray(0);
+	}
+
+	Buffers Mesh::getBuffers() const {
 	    return this->buffers;
 	}
 
 	/* Mesh drawing function - also applies associated textures */
-	void Mesh::Draw(gps::Shader shader)	{
+	void Mesh::Draw(const gps::Shader& shader)	{
 
 		shader.useShaderProgram();
 
-		//set textures
+		this->BindTextures(shader);
+		this->DrawElements();
+		UnbindTextures(0, (GLuint)this->textures.size());
+	}
+
+	void Mesh::BindTextures(const gps::Shader& shader) {
+
 		for (GLuint i = 0; i < textures.size(); i++) {
 
 			glActiveTexture(GL_TEXTURE0 + i);
-			glUniform1i(glGetUniformLocation(shader.shaderProgram, this->textures[i].type.c_str()), i);
+			shader.SetUniform(this->textures[i].type, (GLint)i);
 			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
 		}
+		textureBindCount += (unsigned int)textures.size();
+	}
+
+	void Mesh::DrawElements(size_t lod) {
+
+		lod = lod < lods.size() ? lod : lods.size() - 1;
+		unbatchedTextureBindCount += (unsigned int)textures.size();
+
+		// constant attributes are context state, not part of the VAO
+		glVertexAttrib4f(VERTEX_DECODE_SCALE_LOCATION, decodeScale.x, decodeScale.y, decodeScale.z, decodeScale.w);
+		glVertexAttrib3f(VERTEX_DECODE_OFFSET_LOCATION, decodeOffset.x, decodeOffset.y, decodeOffset.z);
+
+		glBindVertexArray(this->buffers.VAO);
+		for (size_t r = lodFirstRange[lod]; r < lodFirstRange[lod + 1]; r++) {
+
+			const IndexRange& range = indexRanges[r];
+			if (range.baseVertex == 0) {
+				glDrawElements(GL_TRIANGLES, range.count, this->buffers.indexType, (GLvoid*)range.offset);
+			} else {
+				glDrawElementsBaseVertex(GL_TRIANGLES, range.count, this->buffers.indexType, (GLvoid*)range.offset, range.baseVertex);
+			}
+		}
+		glBindVertexArray(0);
+		drawCount += (unsigned int)(lodFirstRange[lod + 1] - lodFirstRange[lod]);
+		triangleCount += lods[lod].indexCount / 3;
+		fullDetailTriangleCount += lods[0].indexCount / 3;
+	}
+
+	// Sphere against the six planes
+	static bool IsSphereInFrustum(const CullView& view, const glm::vec3& center, float radius) {
+
+		for (int p = 0; p < 6; p++) {
+
+			if (glm::dot(glm::vec3(view.planes[p]), center) + view.planes[p].w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Every point of the sphere sees every normal of the cone from behind
+	static bool IsConeBackfacing(const CullView& view, const Meshlet& meshlet) {
+
+		if (!view.backfaces || meshlet.coneCutoff >= 1.0f) {
+			return false;
+		}
+
+		glm::vec3 toCenter = meshlet.center * view.viewPoint.w - glm::vec3(view.viewPoint);
+		return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius * view.viewPoint.w;
+	}
+
+	bool Mesh::CullBounds(size_t lod, const CullView& view) {
+
+		lod = lod < lods.size() ? lod : lods.size() - 1;
+
+		if (IsSphereInFrustum(view, boundsCenter, boundsRadius)) {
+			return false;
+		}
+		frustumCulledTriangleCount += lods[lod].indexCount / 3;
+		return true;
+	}
+
+	void Mesh::DrawElements(size_t lod, const CullView& view) {
+
+		lod = lod < lods.size() ? lod : lods.size() - 1;
+
+		// coarser levels are drawn far away, where a mesh is small on screen anyway
+		if (lod != 0 || meshlets.size() < 2) {
+
+			DrawElements(lod);
+			return;
+		}
+		unbatchedTextureBindCount += (unsigned int)textures.size();
+
+		multiDrawCounts.clear();
+		multiDrawOffsets.clear();
+		multiDrawBaseVertices.clear();
+
+		size_t indexSize = this->buffers.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		GLsizei drawnIndices = 0;
+
+		for (size_t m = 0; m < meshlets.size(); m++) {
+
+			const Meshlet& meshlet = meshlets[m];
+
+			if (!IsSphereInFrustum(view, meshlet.center, meshlet.radius)) {
+
+				frustumCulledTriangleCount += meshlet.indexCount / 3;
+				continue;
+			}
+			if (IsConeBackfacing(view, meshlet)) {
+
+				backfaceCulledTriangleCount += meshlet.indexCount / 3;
+				continue;
+			}
+
+			for (size_t r = meshletFirstRange[m]; r < meshletFirstRange[m + 1]; r++) {
+
+				const IndexRange& range = meshletRanges[r];
+				drawnIndices += range.count;
+
+				// runs of visible meshlets are one draw
+				size_t last = multiDrawCounts.size() - 1;
+				if (!multiDrawCounts.empty() && multiDrawBaseVertices[last] == range.baseVertex &&
+					(size_t)multiDrawOffsets[last] + multiDrawCounts[last] * indexSize == range.offset) {
+
+					multiDrawCounts[last] += range.count;
+					continue;
+				}
+
+				multiDrawCounts.push_back(range.count);
+				multiDrawOffsets.push_back((GLvoid*)range.offset);
+				multiDrawBaseVertices.push_back(range.baseVertex);
+			}
+		}
+
+		fullDetailTriangleCount += drawnIndices / 3;
+		if (multiDrawCounts.empty()) {
+			return;
+		}
+
+		glVertexAttrib4f(VERTEX_DECODE_SCALE_LOCATION, decodeScale.x, decodeScale.y, decodeScale.z, decodeScale.w);
+		glVertexAttrib3f(VERTEX_DECODE_OFFSET_LOCATION, decodeOffset.x, decodeOffset.y, decodeOffset.z);
 
 		glBindVertexArray(this->buffers.VAO);
-		glDrawElements(GL_TRIANGLES, (GLsizei)this->indices.size(), GL_UNSIGNED_INT, 0);
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, multiDrawCounts.data(), this->buffers.indexType, multiDrawOffsets.data(),
+			(GLsizei)multiDrawCounts.size(), multiDrawBaseVertices.data());
 		glBindVertexArray(0);
+		drawCount++;
+		triangleCount += drawnIndices / 3;
+	}
 
-        for(GLuint i = 0; i < this->textures.size(); i++) {
+	size_t Mesh::GetMeshletCount() const {
+		return meshlets.size();
+	}
+
+	size_t Mesh::GetLodCount() const {
+		return lods.size();
+	}
+
+	float Mesh::GetLodError(size_t lod) const {
+		return lods[lod < lods.size() ? lod : lods.size() - 1].error;
+	}
 
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
+	glm::vec3 Mesh::GetBoundsCenter() const {
+		return boundsCenter;
+	}
 
-    }
+	float Mesh::GetBoundsRadius() const {
+		return boundsRadius;
+	}
+
+	VertexFormat Mesh::GetVertexFormat() const {
+		return vertexFormat;
+	}
+
+	size_t Mesh::GetGpuBytes() const {
+		return vertexBytes + indexBytes;
+	}
+
+	size_t Mesh::GetVertexBytes() const {
+		return vertexBytes;
+	}
+
+	size_t Mesh::GetIndexBytes() const {
+		return indexBytes;
+	}
+
+	void Mesh::ReleaseCpuGeometry(CpuGeometry keep) {
+
+		if (keep == CPU_GEOMETRY_KEEP) {
+			return;
+		}
+
+		// swapping with an empty vector is the only sure way to hand the memory back
+		std::vector<Vertex>().swap(this->vertices);
+		if (keep == CPU_GEOMETRY_NONE) {
+
+			std::vector<GLuint>().swap(this->indices);
+			std::vector<glm::vec3>().swap(this->positions);
+		}
+	}
+
+	size_t Mesh::GetCpuBytes() const {
+
+		return this->vertices.capacity() * sizeof(Vertex) + this->indices.capacity() * sizeof(GLuint) + this->positions.capacity() * sizeof(glm::vec3);
+	}
+
+	bool Mesh::HasSameTextures(const Mesh& other) const {
+
+		if (this->textures.size() != other.textures.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < this->textures.size(); i++) {
+
+			if (this->textures[i].id != other.textures[i].id || this->textures[i].type != other.textures[i].type) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void Mesh::UnbindTextures(GLuint first, GLuint count) {
+
+		for (GLuint i = first; i < first + count; i++) {
+
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, 0);
+		}
+	}
+
+	unsigned int Mesh::GetTextureBindCount() {
+		return textureBindCount;
+	}
+
+	unsigned int Mesh::GetUnbatchedTextureBindCount() {
+		return unbatchedTextureBindCount;
+	}
+
+	unsigned int Mesh::GetDrawCount() {
+		return drawCount;
+	}
+
+	unsigned long Mesh::GetTriangleCount() {
+		return triangleCount;
+	}
+
+	unsigned long Mesh::GetFullDetailTriangleCount() {
+		return fullDetailTriangleCount;
+	}
+
+	unsigned long Mesh::GetFrustumCulledTriangleCount() {
+		return frustumCulledTriangleCount;
+	}
+
+	unsigned long Mesh::GetBackfaceCulledTriangleCount() {
+		return backfaceCulledTriangleCount;
+	}
+
+	void Mesh::ResetStats() {
+
+		textureBindCount = 0;
+		unbatchedTextureBindCount = 0;
+		drawCount = 0;
+		triangleCount = 0;
+		fullDetailTriangleCount = 0;
+		frustumCulledTriangleCount = 0;
+		backfaceCulledTriangleCount = 0;
+	}
+
+	VertexPacking Mesh::GetPacking(const Vertex* vertexData, size_t vertexCount, VertexFormat format) {
+
+		VertexPacking packing;
+		packing.format = format;
+		packing.rangeMin = glm::vec3(0.0f);
+		packing.rangeMax = glm::vec3(0.0f);
+		packing.empty = true;
+
+		AddToPacking(vertexData, vertexCount, packing);
+		return packing;
+	}
+
+	void Mesh::AddToPacking(const Vertex* vertexData, size_t vertexCount, VertexPacking& packing) {
+
+		if (vertexCount > 0 && packing.empty) {
+
+			packing.rangeMin = packing.rangeMax = vertexData[0].Position;
+			packing.empty = false;
+		}
+		for (size_t v = 0; v < vertexCount; v++) {
+
+			packing.rangeMin = glm::min(packing.rangeMin, vertexData[v].Position);
+			packing.rangeMax = glm::max(packing.rangeMax, vertexData[v].Position);
+
+			if (fabsf(vertexData[v].TexCoords.x) > PACKED_TEXCOORD_LIMIT || fabsf(vertexData[v].TexCoords.y) > PACKED_TEXCOORD_LIMIT) {
+				packing.format = VERTEX_FORMAT_FLOAT;
+			}
+		}
+	}
+
+	void Mesh::GetBounds(const Vertex* vertexData, size_t vertexCount, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+
+		VertexPacking packing = GetPacking(vertexData, vertexCount);
+		boundsMin = packing.rangeMin;
+		boundsMax = packing.rangeMax;
+	}
+
+	void Mesh::QuantizeVertices(const Vertex* vertexData, size_t vertexCount, const VertexPacking& packing, std::vector<PackedVertex>& packed) {
+
+		glm::vec3 extent = packing.rangeMax - packing.rangeMin;
+		glm::vec3 quantize(0.0f);
+		for (int c = 0; c < 3; c++) {
+			quantize[c] = extent[c] > 0.0f ? 65535.0f / extent[c] : 0.0f;
+		}
+
+		packed.resize(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) {
+
+			const Vertex& vertex = vertexData[v];
+			PackedVertex& packedVertex = packed[v];
+
+			for (int c = 0; c < 3; c++) {
+
+				// a range built from other vertices may not cover these ones
+				float position = (vertex.Position[c] - packing.rangeMin[c]) * quantize[c] + 0.5f;
+				packedVertex.Position[c] = (GLushort)glm::clamp(position, 0.0f, 65535.0f);
+			}
+			packedVertex.Position[3] = 0;
+
+			EncodeOctahedral(vertex.Normal, packedVertex.Normal);
+			packedVertex.TexCoords[0] = FloatToHalf(vertex.TexCoords.x);
+			packedVertex.TexCoords[1] = FloatToHalf(vertex.TexCoords.y);
+		}
+	}
+
+	void Mesh::setupLevels(size_t indexCount, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets, glm::vec3 boundsMin, glm::vec3 boundsMax) {
+
+		this->indexCount = (GLsizei)indexCount;
+
+		this->lods = std::move(lods);
+		if (this->lods.empty()) {
+
+			MeshLod full = { 0, (uint32_t)indexCount, 0.0f };
+			this->lods.push_back(full);
+		}
+		this->meshlets = std::move(meshlets);
+
+		this->boundsCenter = (boundsMin + boundsMax) * 0.5f;
+		this->boundsRadius = glm::length(boundsMax - boundsMin) * 0.5f;
+	}
 
 	// Initializes all the buffer objects/arrays
-	void Mesh::setupMesh() {
+	void Mesh::setupMesh(const Vertex* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets,
+		const VertexPacking* packing) {
+
+		VertexPacking ownPacking;
+		if (!packing) {
+
+			ownPacking = GetPacking(vertexData, vertexCount);
+			packing = &ownPacking;
+		}
+
+		glm::vec3 boundsMin, boundsMax;
+		GetBounds(vertexData, vertexCount, boundsMin, boundsMax);
+
+		if (packing->format == VERTEX_FORMAT_PACKED) {
+
+			std::vector<PackedVertex> packed;
+			QuantizeVertices(vertexData, vertexCount, *packing, packed);
+			this->setupMesh(packed.data(), vertexCount, packing->rangeMin, packing->rangeMax, boundsMin, boundsMax, indexData, indexCount, std::move(lods), std::move(meshlets));
+			return;
+		}
+
+		this->setupLevels(indexCount, std::move(lods), std::move(meshlets), boundsMin, boundsMax);
+		this->vertexFormat = VERTEX_FORMAT_FLOAT;
+		this->decodeScale = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+		this->decodeOffset = glm::vec3(0.0f);
+
+		this->uploadGeometry(vertexData, vertexCount, indexData, indexCount);
+	}
+
+	void Mesh::setupMesh(const PackedVertex* vertexData, size_t vertexCount, glm::vec3 rangeMin, glm::vec3 rangeMax, glm::vec3 boundsMin, glm::vec3 boundsMax,
+		const GLuint* indexData, size_t indexCount, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets) {
+
+		this->setupLevels(indexCount, std::move(lods), std::move(meshlets), boundsMin, boundsMax);
+		this->vertexFormat = VERTEX_FORMAT_PACKED;
+		this->decodeScale = glm::vec4(rangeMax - rangeMin, 0.0f);
+		this->decodeOffset = rangeMin;
+
+		this->uploadGeometry(vertexData, vertexCount, indexData, indexCount);
+	}
+
+	template <typename V> void Mesh::uploadGeometry(const V* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount) {
+
+		this->vertexBytes = vertexCount * sizeof(V);
+		this->decodeScale.w = VertexLayout<V>::octahedralNormals ? 1.0f : 0.0f;
 
 		// Create buffers/arrays
 		glGenVertexArrays(1, &this->buffers.VAO);
@@ -51,22 +628,148 @@ namespace gps {
 		glBindVertexArray(this->buffers.VAO);
 		// Load data into vertex buffers
 		glBindBuffer(GL_ARRAY_BUFFER, this->buffers.VBO);
-		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(V), vertexData, GL_STATIC_DRAW);
 
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers.EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
-
-		// Set the vertex attribute pointers
-		// Vertex Positions
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-		// Vertex Normals
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
-		// Vertex Texture Coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
+		this->uploadIndices(indexData, indexCount, vertexCount);
+		this->setupMeshletRanges();
+
+		// Set the vertex attribute pointers - positions, normals and texture coords
+		for (size_t a = 0; a < VertexLayout<V>::attributeCount; a++) {
+
+			const VertexAttribute& attribute = VertexLayout<V>::attributes[a];
+			glEnableVertexAttribArray(attribute.location);
+			glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, sizeof(V), (GLvoid*)attribute.offset);
+		}
 
 		glBindVertexArray(0);
 	}
+
+	void Mesh::uploadIndices(const GLuint* indexData, size_t indexCount, size_t vertexCount) {
+
+		const size_t window = 65536;
+		std::vector<IndexRange> ranges;
+		std::vector<size_t> firstRange;
+		bool shortIndices = true;
+
+		for (size_t l = 0; l < lods.size(); l++) {
+
+			size_t lodStart = lods[l].indexOffset;
+			size_t lodEnd = lodStart + lods[l].indexCount;
+			firstRange.push_back(ranges.size());
+
+			if (vertexCount <= window) {
+
+				IndexRange range = { (GLsizei)lods[l].indexCount, lodStart * sizeof(GLushort), 0 };
+				ranges.push_back(range);
+				continue;
+			}
+
+			// split the triangle list wherever the vertices it references stop fitting in a 16-bit window;
+			// the fetch optimized vertex order keeps those windows long
+			size_t rangeStart = lodStart;
+			GLuint rangeMin = 0;
+			GLuint rangeMax = 0;
+
+			for (size_t t = lodStart; t + 2 < lodEnd && shortIndices; t += 3) {
+
+				GLuint triangleMin = std::min(indexData[t], std::min(indexData[t + 1], indexData[t + 2]));
+				GLuint triangleMax = std::max(indexData[t], std::max(indexData[t + 1], indexData[t + 2]));
+
+				if (t > rangeStart && std::max(rangeMax, triangleMax) - std::min(rangeMin, triangleMin) >= window) {
+
+					IndexRange range = { (GLsizei)(t - rangeStart), rangeStart * sizeof(GLushort), (GLint)rangeMin };
+					ranges.push_back(range);
+					rangeStart = t;
+				}
+				if (t == rangeStart) {
+
+					rangeMin = triangleMin;
+					rangeMax = triangleMax;
+				}
+				rangeMin = std::min(rangeMin, triangleMin);
+				rangeMax = std::max(rangeMax, triangleMax);
+
+				// a single triangle spanning the whole window
+				shortIndices = rangeMax - rangeMin < window;
+			}
+			if (lodEnd > rangeStart) {
+
+				IndexRange range = { (GLsizei)(lodEnd - rangeStart), rangeStart * sizeof(GLushort), (GLint)rangeMin };
+				ranges.push_back(range);
+			}
+
+			// a handful of extra draws is worth half the index memory, many are not
+			shortIndices = shortIndices && ranges.size() - firstRange.back() <= 1 + lods[l].indexCount / 3 / 16384;
+		}
+		firstRange.push_back(ranges.size());
+
+		if (shortIndices) {
+
+			std::vector<GLushort> packedIndices(indexCount);
+			for (size_t r = 0; r < ranges.size(); r++) {
+
+				size_t first = ranges[r].offset / sizeof(GLushort);
+				for (size_t i = first; i < first + ranges[r].count; i++) {
+					packedIndices[i] = (GLushort)(indexData[i] - ranges[r].baseVertex);
+				}
+			}
+
+			this->buffers.indexType = GL_UNSIGNED_SHORT;
+			this->indexBytes = indexCount * sizeof(GLushort);
+			this->indexRanges = ranges;
+			this->lodFirstRange = firstRange;
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indexBytes, packedIndices.data(), GL_STATIC_DRAW);
+		} else {
+
+			this->buffers.indexType = GL_UNSIGNED_INT;
+			this->indexBytes = indexCount * sizeof(GLuint);
+			this->indexRanges.clear();
+			this->lodFirstRange.clear();
+			for (size_t l = 0; l < lods.size(); l++) {
+
+				IndexRange range = { (GLsizei)lods[l].indexCount, lods[l].indexOffset * sizeof(GLuint), 0 };
+				this->lodFirstRange.push_back(this->indexRanges.size());
+				this->indexRanges.push_back(range);
+			}
+			this->lodFirstRange.push_back(this->indexRanges.size());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indexBytes, indexData, GL_STATIC_DRAW);
+		}
+	}
+
+	void Mesh::setupMeshletRanges() {
+
+		meshletRanges.clear();
+		meshletFirstRange.clear();
+
+		size_t indexSize = this->buffers.indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+		size_t r = lodFirstRange[0];
+
+		// meshlets and ranges both follow the index order, a meshlet across a 16-bit window boundary gets one run per side
+		for (size_t m = 0; m < meshlets.size(); m++) {
+
+			size_t meshletStart = meshlets[m].indexOffset;
+			size_t meshletEnd = meshletStart + meshlets[m].indexCount;
+			meshletFirstRange.push_back(meshletRanges.size());
+
+			for (; r < lodFirstRange[1]; r++) {
+
+				const IndexRange& range = indexRanges[r];
+				size_t rangeStart = range.offset / indexSize;
+				size_t rangeEnd = rangeStart + range.count;
+
+				size_t start = std::max(meshletStart, rangeStart);
+				size_t end = std::min(meshletEnd, rangeEnd);
+				if (start < end) {
+
+					IndexRange piece = { (GLsizei)(end - start), start * indexSize, range.baseVertex };
+					meshletRanges.push_back(piece);
+				}
+				if (rangeEnd > meshletEnd) {
+					break;
+				}
+			}
+		}
+		meshletFirstRange.push_back(meshletRanges.size());
+	}
 }
@@ -13,6 +13,7 @@
 
 #include "Shader.hpp"
 
+#include <stdint.h>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,94 @@ namespace gps {
         glm::vec2 TexCoords;
     };
 
+    // 16 byte vertex - position quantized to the bounds of the model, octahedral normal and half float UVs
+    struct PackedVertex {
+
+        // x, y, z as fractions of the bounds, w only pads the normal to 4 bytes
+        GLushort Position[4];
+        GLshort Normal[2];
+        GLushort TexCoords[2];
+    };
+
+    // Which of the vertex types a mesh keeps in its VBO
+    enum VertexFormat { VERTEX_FORMAT_FLOAT, VERTEX_FORMAT_PACKED };
+
+    // Format and position range vertices are packed with
+    // The meshes of a model share one, so the vertices on the seams between them snap to the same grid
+    struct VertexPacking {
+
+        // float once any vertex has UVs out of the range half floats keep precise
+        VertexFormat format;
+        glm::vec3 rangeMin;
+        glm::vec3 rangeMax;
+        // nothing added yet, the range is meaningless
+        bool empty;
+    };
+
+    // What a mesh keeps in system memory once its buffers are uploaded
+    enum CpuGeometry {
+        // the vertices and indices it was built from, meshes uploaded from pointers never had any
+        CPU_GEOMETRY_KEEP,
+        // positions and the indices of the full level, enough for collision and picking
+        CPU_GEOMETRY_POSITIONS,
+        // nothing, the GL buffers are the only copy
+        CPU_GEOMETRY_NONE
+    };
+
+    // Generic attributes holding the dequantization constants, left disabled so every draw can set them
+    const GLuint VERTEX_DECODE_SCALE_LOCATION = 3;
+    const GLuint VERTEX_DECODE_OFFSET_LOCATION = 4;
+
+    // One vertex attribute as glVertexAttribPointer sees it
+    struct VertexAttribute {
+
+        GLuint location;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        size_t offset;
+    };
+
+    // GPU layout of a vertex type, specialized for every type a VBO can hold
+    template <typename V> struct VertexLayout;
+
+    template <> struct VertexLayout<Vertex> {
+
+        static const size_t attributeCount = 3;
+        static const VertexAttribute attributes[attributeCount];
+        static const bool octahedralNormals = false;
+    };
+
+    template <> struct VertexLayout<PackedVertex> {
+
+        static const size_t attributeCount = 3;
+        static const VertexAttribute attributes[attributeCount];
+        static const bool octahedralNormals = true;
+    };
+
+    // Vertex and index data already laid out for the GL, such as the buffers of a glTF file
+    struct MeshStreams {
+
+        // one buffer holding every attribute, each at its own offset and stride
+        const unsigned char* vertexData;
+        size_t vertexBytes;
+        size_t vertexCount;
+        // position, normal and texture coordinates, missing ones are left disabled
+        VertexAttribute attributes[3];
+        GLsizei strides[3];
+        bool present[3];
+        const void* indexData;
+        size_t indexCount;
+        // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        GLenum indexType;
+        // applied in the vertex shader as for packed vertices, so a translated and uniformly scaled copy costs nothing
+        glm::vec3 positionScale;
+        glm::vec3 positionOffset;
+        // after the scale and offset
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+    };
+
     struct Texture {
 
         GLuint id;
@@ -45,27 +134,214 @@ namespace gps {
         GLuint VAO;
         GLuint VBO;
         GLuint EBO;
+        // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        GLenum indexType;
     };
 
+    // The buffers of one mesh, deleted with it and handed over when it is moved
+    class MeshBuffers : public Buffers {
+
+    public:
+        MeshBuffers();
+        ~MeshBuffers();
+
+        MeshBuffers(MeshBuffers&& other) noexcept;
+        MeshBuffers& operator=(MeshBuffers&& other) noexcept;
+
+    private:
+        MeshBuffers(const MeshBuffers&);
+        MeshBuffers& operator=(const MeshBuffers&);
+    };
+
+    // A run of the index buffer drawn with one call, 16-bit indices are relative to baseVertex
+    struct IndexRange {
+
+        GLsizei count;
+        size_t offset;
+        GLint baseVertex;
+    };
+
+    // One level of detail - a run of the mesh's index list and how far it strays from the full surface
+    struct MeshLod {
+
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        // object space distance
+        float error;
+    };
+
+    // A cluster of nearby triangles of the full level, culled on its own
+    struct Meshlet {
+
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        // bounding sphere, object space
+        glm::vec3 center;
+        float radius;
+        // every face normal lies within the cone around coneAxis, coneCutoff is the sine of its half angle (1 - no cone)
+        glm::vec3 coneAxis;
+        float coneCutoff;
+    };
+
+    // What meshes and meshlets are culled against, in the object space of the mesh
+    struct CullView {
+
+        // frustum planes, normalized so the sphere test measures distances
+        glm::vec4 planes[6];
+        // the eye, or with w = 0 the direction towards it for orthographic views
+        glm::vec4 viewPoint;
+        // back-facing meshlets are only dropped while GL culls back faces too
+        bool backfaces;
+    };
+
+    // Move-only, a mesh owns its GL objects and frees them when it is destroyed
     class Mesh {
 
     public:
+        // CPU copy of the geometry, what is left of it depends on ReleaseCpuGeometry
         std::vector<Vertex> vertices;
         std::vector<GLuint> indices;
+        std::vector<glm::vec3> positions;
         std::vector<Texture> textures;
 
-	    Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures);
+	    // Packed with the packing of the whole model, or without one with a packing of its own
+	    // Without lods the whole index list is the only level, without meshlets the full level is culled as a whole
+	    Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures,
+	        std::vector<MeshLod> lods = std::vector<MeshLod>(), std::vector<Meshlet> meshlets = std::vector<Meshlet>(),
+	        const VertexPacking* packing = NULL);
+
+	    // Uploads geometry owned by the caller (e.g. a mapped cache file) without keeping a CPU copy
+	    Mesh(const Vertex* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount, std::vector<Texture> textures,
+	        std::vector<MeshLod> lods = std::vector<MeshLod>(), std::vector<Meshlet> meshlets = std::vector<Meshlet>(),
+	        const VertexPacking* packing = NULL);
+
+	    // Uploads vertices already quantized to the given range, such as those of the mesh cache
+	    // The bounds are those of the mesh itself, the range may be the whole model's
+	    Mesh(const PackedVertex* vertexData, size_t vertexCount, glm::vec3 rangeMin, glm::vec3 rangeMax, glm::vec3 boundsMin, glm::vec3 boundsMax,
+	        const GLuint* indexData, size_t indexCount, std::vector<Texture> textures,
+	        std::vector<MeshLod> lods = std::vector<MeshLod>(), std::vector<Meshlet> meshlets = std::vector<Meshlet>());
+
+	    // Uploads the streams byte for byte, the mesh has a single level and no meshlets
+	    Mesh(const MeshStreams& streams, std::vector<Texture> textures);
+
+	    Mesh(Mesh&& other) = default;
+	    Mesh& operator=(Mesh&& other) = default;
+
+	    // Packing of a single set of vertices, packed unless format says otherwise or the UVs do not fit
+	    static VertexPacking GetPacking(const Vertex* vertexData, size_t vertexCount, VertexFormat format = VERTEX_FORMAT_PACKED);
+
+	    // Grows the range of a packing to the vertices, and falls back to floats for UVs that do not fit
+	    static void AddToPacking(const Vertex* vertexData, size_t vertexCount, VertexPacking& packing);
+
+	    // CPU half of packing, quantizes to the range of a packed packing exactly as an upload of the floats would
+	    static void QuantizeVertices(const Vertex* vertexData, size_t vertexCount, const VertexPacking& packing, std::vector<PackedVertex>& packed);
+
+	    static void GetBounds(const Vertex* vertexData, size_t vertexCount, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+	    Buffers getBuffers() const;
+
+	    // Binds the textures, draws and unbinds them again
+	    void Draw(const gps::Shader& shader);
 
-	    Buffers getBuffers();
+	    // Binds the textures to units 0..n-1 and points the samplers at them
+	    void BindTextures(const gps::Shader& shader);
 
-	    void Draw(gps::Shader shader);
+	    // Draws the geometry of a level of detail with whatever textures are bound
+	    void DrawElements(size_t lod = 0);
+
+	    // Whether the bounding sphere is outside the frustum, the triangles of the level then count as culled
+	    bool CullBounds(size_t lod, const CullView& view);
+
+	    // Same as DrawElements for a mesh that passed CullBounds, the full level is culled meshlet by meshlet and drawn in one multi-draw
+	    void DrawElements(size_t lod, const CullView& view);
+
+	    size_t GetMeshletCount() const;
+
+	    size_t GetLodCount() const;
+	    float GetLodError(size_t lod) const;
+
+	    // Bounding sphere of the positions, for the LOD selection
+	    glm::vec3 GetBoundsCenter() const;
+	    float GetBoundsRadius() const;
+
+	    VertexFormat GetVertexFormat() const;
+
+	    // Size of the vertex and index buffers
+	    size_t GetGpuBytes() const;
+	    size_t GetVertexBytes() const;
+	    size_t GetIndexBytes() const;
+
+	    // Frees the parts of the CPU copy that keep does not cover, positions have to be filled in by the caller
+	    void ReleaseCpuGeometry(CpuGeometry keep);
+
+	    // System memory held by the CPU copy
+	    size_t GetCpuBytes() const;
+
+	    // Whether both meshes sample exactly the same textures, so one bind serves both
+	    bool HasSameTextures(const Mesh& other) const;
+
+	    // Binds texture 0 to the units [first, first + count)
+	    static void UnbindTextures(GLuint first, GLuint count);
+
+	    // Texture binds, draw calls and triangles issued since the last reset, for the frame statistics
+	    static unsigned int GetTextureBindCount();
+	    // binds the same draws would have cost binding every mesh's textures, as before the material sort
+	    static unsigned int GetUnbatchedTextureBindCount();
+	    static unsigned int GetDrawCount();
+	    static unsigned long GetTriangleCount();
+	    // triangles the same draws would have cost at full detail
+	    static unsigned long GetFullDetailTriangleCount();
+	    // triangles of culled meshes and meshlets, by the test that rejected them
+	    static unsigned long GetFrustumCulledTriangleCount();
+	    static unsigned long GetBackfaceCulledTriangleCount();
+	    static void ResetStats();
 
     private:
         /*  Render data  */
-        Buffers buffers;
+        MeshBuffers buffers;
+        GLsizei indexCount;
+        std::vector<IndexRange> indexRanges;
+        // ranges of level i are [lodFirstRange[i], lodFirstRange[i + 1])
+        std::vector<size_t> lodFirstRange;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        // index runs of meshlet i are [meshletFirstRange[i], meshletFirstRange[i + 1]) of meshletRanges
+        std::vector<IndexRange> meshletRanges;
+        std::vector<size_t> meshletFirstRange;
+        glm::vec3 boundsCenter;
+        float boundsRadius;
+        VertexFormat vertexFormat;
+        size_t vertexBytes;
+        size_t indexBytes;
+        // position = decodeOffset + position * decodeScale.xyz, decodeScale.w is 1 for octahedral normals
+        glm::vec4 decodeScale;
+        glm::vec3 decodeOffset;
 
 	    // Initializes all the buffer objects/arrays
-	    void setupMesh();
+	    void setupMesh(const Vertex* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets,
+	        const VertexPacking* packing);
+	    void setupMesh(const PackedVertex* vertexData, size_t vertexCount, glm::vec3 rangeMin, glm::vec3 rangeMax, glm::vec3 boundsMin, glm::vec3 boundsMax,
+	        const GLuint* indexData, size_t indexCount, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets);
+
+	    // Levels, meshlets and bounding sphere, shared by both vertex formats
+	    void setupLevels(size_t indexCount, std::vector<MeshLod> lods, std::vector<Meshlet> meshlets, glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+	    // Creates the buffers and points the attributes described by VertexLayout<V> at them
+	    template <typename V> void uploadGeometry(const V* vertexData, size_t vertexCount, const GLuint* indexData, size_t indexCount);
+
+	    // Uploads the indices as 16-bit ranges when the vertex spans allow it, 32-bit otherwise
+	    void uploadIndices(const GLuint* indexData, size_t indexCount, size_t vertexCount);
+
+	    // Cuts the index ranges of the full level at the meshlet boundaries
+	    void setupMeshletRanges();
+
+	    static unsigned int textureBindCount;
+	    static unsigned int unbatchedTextureBindCount;
+	    static unsigned int drawCount;
+	    static unsigned long triangleCount;
+	    static unsigned long fullDetailTriangleCount;
+	    static unsigned long frustumCulledTriangleCount;
+	    static unsigned long backfaceCulledTriangleCount;
 
     };
 
@@ -0,0 +1,221 @@
+#include "MeshBuilder.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "MeshletBuilder.hpp"
+
+#include <string.h>
+
+namespace gps {
+
+    bool MeshBuilder::Load(std::string fileName, std::string basePath, std::vector<PreparedMesh>& meshes, std::ostream& log) {
+
+        log << "Loading : " << fileName << std::endl;
+        ObjModel model;
+        ObjReader reader;
+
+        if (!reader.Read(fileName, basePath, model)) {
+            return false;
+        }
+
+        log << "# of shapes    : " << model.shapes.size() << std::endl;
+        log << "# of materials : " << model.materials.size() << std::endl;
+        log << "parse speed    : " << reader.GetThroughput() << " MB/s" << std::endl;
+
+        Build(model, basePath, meshes, log);
+        return true;
+    }
+
+    void MeshBuilder::Build(ObjModel& model, std::string basePath, std::vector<PreparedMesh>& meshes, std::ostream& log) {
+
+        size_t totalCorners = 0;
+        size_t totalVertices = 0;
+
+        // Loop over shapes
+        for (size_t s = 0; s < model.shapes.size(); s++) {
+
+            ObjShape& shape = model.shapes[s];
+            PreparedMesh preparedMesh;
+
+            log << "  shape " << s << " (" << shape.name << ") : " << shape.indices.size() << " corners -> "
+                << shape.vertices.size() << " welded vertices" << std::endl;
+            totalCorners += shape.indices.size();
+            totalVertices += shape.vertices.size();
+
+            // triangle and vertex order for the post-transform cache, overdraw and vertex fetch
+            VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(shape.indices.data(), shape.indices.size(), shape.vertices.size(), VERTEX_CACHE_SIZE);
+            MeshOptimizer::Optimize(shape.vertices, shape.indices);
+
+            // meshlets regroup the triangles, the vertex fetch order has to follow
+            MeshletBuilder::Build(shape.vertices, shape.indices, preparedMesh.meshlets);
+            MeshOptimizer::OptimizeVertexFetch(shape.vertices, shape.indices);
+            VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(shape.indices.data(), shape.indices.size(), shape.vertices.size(), VERTEX_CACHE_SIZE);
+
+            log << "    ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+
+            // index-only levels of detail behind the full index list
+            MeshSimplifier::BuildLodChain(shape.vertices, shape.indices, preparedMesh.lods);
+
+            log << "    LODs";
+            for (size_t l = 0; l < preparedMesh.lods.size(); l++) {
+                log << (l == 0 ? " " : " / ") << preparedMesh.lods[l].indexCount / 3 << " (" << preparedMesh.lods[l].error << ")";
+            }
+            log << " triangles (error)" << std::endl;
+
+            size_t conedMeshlets = 0;
+            for (size_t m = 0; m < preparedMesh.meshlets.size(); m++) {
+                conedMeshlets += preparedMesh.meshlets[m].coneCutoff < 1.0f ? 1 : 0;
+            }
+            log << "    meshlets " << preparedMesh.meshlets.size() << " ("
+                << (preparedMesh.meshlets.empty() ? 0.0 : (double)preparedMesh.lods[0].indexCount / 3 / preparedMesh.meshlets.size())
+                << " triangles each, " << conedMeshlets << " with a normal cone)" << std::endl;
+
+            // get material id
+            // Only try to read materials if the .mtl file is present
+            int materialId = shape.materialId;
+
+            if (materialId != -1 && materialId < (int)model.materials.size()) {
+
+                const ObjMaterial& material = model.materials[materialId];
+                gps::Texture texture;
+                texture.id = 0;
+
+                //ambient texture
+                if (!material.ambientTexture.empty()) {
+
+                    texture.type = "ambientTexture";
+                    texture.path = basePath + material.ambientTexture;
+                    preparedMesh.textures.push_back(texture);
+                }
+
+                //diffuse texture
+                if (!material.diffuseTexture.empty()) {
+
+                    texture.type = "diffuseTexture";
+                    texture.path = basePath + material.diffuseTexture;
+                    preparedMesh.textures.push_back(texture);
+                }
+
+                //specular texture
+                if (!material.specularTexture.empty()) {
+
+                    texture.type = "specularTexture";
+                    texture.path = basePath + material.specularTexture;
+                    preparedMesh.textures.push_back(texture);
+                }
+            }
+
+            // the shape's arrays are moved, not copied; the data pointers survive the move
+            preparedMesh.vertices = std::move(shape.vertices);
+            preparedMesh.indices = std::move(shape.indices);
+            preparedMesh.vertexData = preparedMesh.vertices.data();
+            preparedMesh.packedVertexData = NULL;
+            preparedMesh.vertexCount = preparedMesh.vertices.size();
+            preparedMesh.indexData = preparedMesh.indices.data();
+            preparedMesh.indexCount = preparedMesh.indices.size();
+            preparedMesh.flipTextures = true;
+            preparedMesh.hasStreams = false;
+
+            meshes.push_back(std::move(preparedMesh));
+        }
+
+        log << "# of vertices  : " << totalVertices << " (" << totalCorners << " before welding, VBO "
+            << totalCorners * sizeof(gps::Vertex) / 1024 << " KB -> " << totalVertices * sizeof(gps::Vertex) / 1024 << " KB)" << std::endl;
+    }
+
+    VertexPacking MeshBuilder::GetPacking(const std::vector<PreparedMesh>& meshes) {
+
+        VertexPacking packing = Mesh::GetPacking(NULL, 0);
+        for (size_t i = 0; i < meshes.size(); i++) {
+
+            if (!meshes[i].hasStreams && !meshes[i].packedVertexData) {
+                Mesh::AddToPacking(meshes[i].vertexData, meshes[i].vertexCount, packing);
+            }
+        }
+        return packing;
+    }
+
+    bool MeshBuilder::WriteCache(std::string cacheFileName, std::string sourceFileName, const std::vector<PreparedMesh>& meshes, uint64_t& sourceHash, uint64_t& materialHash) {
+
+        std::vector<MeshCacheMesh> cachedMeshes;
+        // the cache stores what the upload would make of the floats, so a hit skips the quantization too
+        std::vector<std::vector<PackedVertex> > packedVertices(meshes.size());
+        VertexPacking packing = GetPacking(meshes);
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+
+            const PreparedMesh& preparedMesh = meshes[i];
+
+            MeshCacheMesh cachedMesh;
+            cachedMesh.vertexFormat = packing.format;
+            if (packing.format == VERTEX_FORMAT_PACKED) {
+                Mesh::QuantizeVertices(preparedMesh.vertexData, preparedMesh.vertexCount, packing, packedVertices[i]);
+            }
+            cachedMesh.rangeMin = packing.rangeMin;
+            cachedMesh.rangeMax = packing.rangeMax;
+            Mesh::GetBounds(preparedMesh.vertexData, preparedMesh.vertexCount, cachedMesh.boundsMin, cachedMesh.boundsMax);
+            cachedMesh.vertices = preparedMesh.vertexData;
+            cachedMesh.packedVertices = packedVertices[i].data();
+            cachedMesh.vertexCount = (uint32_t)preparedMesh.vertexCount;
+            cachedMesh.indices = preparedMesh.indexData;
+            cachedMesh.indexCount = (uint32_t)preparedMesh.indexCount;
+            cachedMesh.lods = preparedMesh.lods;
+            cachedMesh.meshlets = preparedMesh.meshlets;
+            cachedMesh.textures = preparedMesh.textures;
+
+            cachedMeshes.push_back(cachedMesh);
+        }
+
+        return MeshCache::Write(cacheFileName, sourceFileName, cachedMeshes, sourceHash, materialHash);
+    }
+
+    void MeshBuilder::GetPositions(const PreparedMesh& mesh, std::vector<glm::vec3>& positions, std::vector<GLuint>& indices) {
+
+        if (mesh.hasStreams) {
+
+            // the positions are floats wherever the stream puts them, scaled like in the vertex shader
+            const MeshStreams& streams = mesh.streams;
+            positions.resize(streams.vertexCount);
+            for (size_t v = 0; v < streams.vertexCount; v++) {
+
+                float position[3];
+                memcpy(position, streams.vertexData + streams.attributes[0].offset + v * streams.strides[0], sizeof(position));
+                positions[v] = streams.positionOffset + glm::vec3(position[0], position[1], position[2]) * streams.positionScale;
+            }
+
+            indices.resize(streams.indexCount);
+            for (size_t i = 0; i < streams.indexCount; i++) {
+
+                if (streams.indexType == GL_UNSIGNED_BYTE) {
+                    indices[i] = ((const GLubyte*)streams.indexData)[i];
+                } else if (streams.indexType == GL_UNSIGNED_SHORT) {
+                    indices[i] = ((const GLushort*)streams.indexData)[i];
+                } else {
+                    indices[i] = ((const GLuint*)streams.indexData)[i];
+                }
+            }
+            return;
+        }
+
+        positions.resize(mesh.vertexCount);
+        if (mesh.packedVertexData) {
+
+            // the same dequantization as the vertex shader, the positions match what is drawn
+            glm::vec3 extent = mesh.rangeMax - mesh.rangeMin;
+            for (size_t v = 0; v < mesh.vertexCount; v++) {
+
+                const GLushort* position = mesh.packedVertexData[v].Position;
+                positions[v] = mesh.rangeMin + glm::vec3(position[0], position[1], position[2]) / 65535.0f * extent;
+            }
+        } else {
+
+            for (size_t v = 0; v < mesh.vertexCount; v++) {
+                positions[v] = mesh.vertexData[v].Position;
+            }
+        }
+
+        // the coarser levels follow the full one in the index list
+        size_t offset = mesh.lods.empty() ? 0 : mesh.lods[0].indexOffset;
+        size_t count = mesh.lods.empty() ? mesh.indexCount : mesh.lods[0].indexCount;
+        indices.assign(mesh.indexData + offset, mesh.indexData + offset + count);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef MeshBuilder_hpp
+#define MeshBuilder_hpp
+
+#include "Mesh.hpp"
+#include "MeshCache.hpp"
+#include "ObjReader.hpp"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Geometry of one mesh between Prepare and Upload
+    struct PreparedMesh {
+
+        // owned arrays of a freshly parsed mesh, empty when it comes from the cache
+        std::vector<gps::Vertex> vertices;
+        std::vector<GLuint> indices;
+        // what gets uploaded - the arrays above or the geometry decoded from the cache
+        const gps::Vertex* vertexData;
+        // set instead of vertexData for cached meshes stored quantized to the range of the model
+        const gps::PackedVertex* packedVertexData;
+        glm::vec3 rangeMin;
+        glm::vec3 rangeMax;
+        // of the mesh alone, only known for cached meshes
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        size_t vertexCount;
+        const GLuint* indexData;
+        size_t indexCount;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        // only type and path are known until the textures are created
+        std::vector<gps::Texture> textures;
+        // OBJ images start at the bottom row, glTF ones at the top
+        bool flipTextures;
+        // set for glTF primitives uploaded as they are, the fields above are then unused
+        bool hasStreams;
+        MeshStreams streams;
+    };
+
+    // CPU side of turning an .obj file into runtime meshes, shared by the loader and gps_bake
+    //
+    // Every shape is optimized for the vertex cache, overdraw and vertex
+    // fetch, split into meshlets and given its levels of detail. Nothing here
+    // touches the GL, so it runs on worker threads and without a context.
+    class MeshBuilder {
+
+    public:
+        // Parses the model and builds every mesh, progress and statistics go to log
+        static bool Load(std::string fileName, std::string basePath, std::vector<PreparedMesh>& meshes, std::ostream& log);
+
+        // Builds the meshes of a parsed model, its shapes are moved out
+        static void Build(ObjModel& model, std::string basePath, std::vector<PreparedMesh>& meshes, std::ostream& log);
+
+        // Packing shared by the float meshes of a model, so they quantize to one grid and their seams stay closed
+        static VertexPacking GetPacking(const std::vector<PreparedMesh>& meshes);
+
+        // Stores built meshes in a mesh cache file, also returning the hashes of the source and its material libraries
+        static bool WriteCache(std::string cacheFileName, std::string sourceFileName, const std::vector<PreparedMesh>& meshes, uint64_t& sourceHash, uint64_t& materialHash);
+
+        // Object space positions and full detail triangles of a mesh in any of its forms, what CPU_GEOMETRY_POSITIONS keeps
+        static void GetPositions(const PreparedMesh& mesh, std::vector<glm::vec3>& positions, std::vector<GLuint>& indices);
+    };
+}
+
+#endif /* MeshBuilder_hpp */
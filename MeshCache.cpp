@@ -0,0 +1,527 @@
+#include "MeshCache.hpp"
+#include "MeshCodec.hpp"
+#include "MappedFile.hpp"
+#include "VirtualFileSystem.hpp"
+
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+
+namespace gps {
+
+    static const char MESH_CACHE_MAGIC[8] = { 'G', 'P', 'S', 'M', 'E', 'S', 'H', 0 };
+
+    struct MeshCacheHeader {
+
+        char magic[8];
+        uint32_t version;
+        uint32_t meshCount;
+        uint64_t fileSize;
+        uint64_t sourceSize;
+        int64_t sourceModifiedTime;
+        uint64_t sourceHash;
+        uint64_t materialSize;
+        uint64_t materialModifiedTime;
+        uint64_t materialHash;
+        // names follow the mesh table as (length, path) pairs
+        uint64_t materialLibraryBytes;
+        uint32_t materialLibraryCount;
+        uint32_t padding;
+    };
+
+    struct MeshCacheEntry {
+
+        // offsets and sizes of the encoded geometry
+        uint64_t vertexOffset;
+        uint64_t vertexBytes;
+        uint64_t indexOffset;
+        uint64_t indexBytes;
+        uint64_t textureOffset;
+        uint64_t lodOffset;
+        uint64_t meshletOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t lodCount;
+        uint32_t meshletCount;
+        uint32_t vertexFormat;
+        float rangeMin[3];
+        float rangeMax[3];
+        float boundsMin[3];
+        float boundsMax[3];
+    };
+
+    // 64-bit FNV-1a over the whole source file
+    static uint64_t HashBytes(const unsigned char* data, size_t size) {
+
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; i++) {
+
+            hash ^= data[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // Whether bytes starting at offset lie inside a file of the given size, without overflowing on corrupt values
+    static bool FitsIn(uint64_t offset, uint64_t bytes, size_t size) {
+
+        return offset <= size && bytes <= size - offset;
+    }
+
+    // The libraries of the mtllib lines of an .obj, relative to its directory as ObjReader resolves them
+    static void FindMaterialLibraries(std::string sourceFileName, const unsigned char* data, size_t size, std::vector<std::string>& materialLibraries) {
+
+        std::string basePath = sourceFileName.substr(0, sourceFileName.find_last_of('/')) + "/";
+        const char* text = (const char*)data;
+
+        for (size_t lineStart = 0; lineStart < size; ) {
+
+            size_t lineEnd = lineStart;
+            while (lineEnd < size && text[lineEnd] != '\n') {
+                lineEnd++;
+            }
+
+            size_t token = lineStart;
+            while (token < lineEnd && (text[token] == ' ' || text[token] == '\t')) {
+                token++;
+            }
+            if (lineEnd - token > 7 && memcmp(text + token, "mtllib", 6) == 0 && (text[token + 6] == ' ' || text[token + 6] == '\t')) {
+
+                size_t nameStart = token + 7;
+                while (nameStart < lineEnd && (text[nameStart] == ' ' || text[nameStart] == '\t')) {
+                    nameStart++;
+                }
+                size_t nameEnd = nameStart;
+                while (nameEnd < lineEnd && text[nameEnd] != ' ' && text[nameEnd] != '\t' && text[nameEnd] != '\r') {
+                    nameEnd++;
+                }
+                if (nameEnd > nameStart) {
+                    materialLibraries.push_back(basePath + std::string(text + nameStart, nameEnd - nameStart));
+                }
+            }
+            lineStart = lineEnd + 1;
+        }
+    }
+
+    std::string MeshCache::GetCacheFileName(std::string sourceFileName) {
+
+        size_t dot = sourceFileName.find_last_of('.');
+        size_t slash = sourceFileName.find_last_of('/');
+
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return sourceFileName + ".gpsmesh";
+        }
+        return sourceFileName.substr(0, dot) + ".gpsmesh";
+    }
+
+    bool MeshCache::ComputeKey(std::string sourceFileName, bool hashContents, MeshCacheKey& key, std::vector<std::string>& materialLibraries) {
+
+        FileInfo info;
+        if (!VirtualFileSystem::GetShared().GetFileInfo(sourceFileName, info)) {
+            return false;
+        }
+
+        key.sourceSize = info.size;
+        key.sourceModifiedTime = info.modifiedTime;
+        key.sourceHash = 0;
+
+        if (hashContents) {
+
+            MappedFile source;
+            if (!VirtualFileSystem::GetShared().Open(sourceFileName, source)) {
+                return false;
+            }
+            key.sourceHash = HashBytes(source.GetData(), source.GetSize());
+
+            materialLibraries.clear();
+            FindMaterialLibraries(sourceFileName, source.GetData(), source.GetSize(), materialLibraries);
+        }
+
+        return true;
+    }
+
+    void MeshCache::ComputeMaterialKey(const std::vector<std::string>& materialLibraries, bool hashContents, MeshCacheKey& key) {
+
+        key.materialSize = 0;
+        key.materialModifiedTime = 0;
+        key.materialHash = 0;
+
+        for (size_t i = 0; i < materialLibraries.size(); i++) {
+
+            FileInfo info;
+            if (!VirtualFileSystem::GetShared().GetFileInfo(materialLibraries[i], info)) {
+                info.size = 0;
+                info.modifiedTime = 0;
+            }
+            key.materialSize = key.materialSize * 31 + info.size;
+            key.materialModifiedTime = key.materialModifiedTime * 31 + (uint64_t)info.modifiedTime;
+
+            uint64_t hash = 0;
+            MappedFile library;
+            if (hashContents && VirtualFileSystem::GetShared().Open(materialLibraries[i], library)) {
+                hash = HashBytes(library.GetData(), library.GetSize());
+            }
+            key.materialHash = key.materialHash * 31 + hash;
+        }
+    }
+
+    bool MeshCache::Open(std::string cacheFileName, std::string sourceFileName) {
+
+        Close();
+
+        MappedFile file;
+        if (!VirtualFileSystem::GetShared().Open(cacheFileName, file)) {
+            return false;
+        }
+
+        const unsigned char* data = file.GetData();
+        size_t size = file.GetSize();
+
+        MeshCacheHeader header;
+        if (size < sizeof(header)) {
+            Close();
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 || header.version != MESH_CACHE_VERSION || header.fileSize != size) {
+            Close();
+            return false;
+        }
+
+        if (!FitsIn(sizeof(header), (uint64_t)header.meshCount * sizeof(MeshCacheEntry), size)) {
+            Close();
+            return false;
+        }
+
+        // material libraries the source named when the cache was written
+        std::vector<std::string> materialLibraries;
+        uint64_t libraryOffset = sizeof(header) + (uint64_t)header.meshCount * sizeof(MeshCacheEntry);
+        if (!FitsIn(libraryOffset, header.materialLibraryBytes, size)) {
+            Close();
+            return false;
+        }
+        uint64_t libraryEnd = libraryOffset + header.materialLibraryBytes;
+        for (uint32_t i = 0; i < header.materialLibraryCount; i++) {
+
+            uint32_t length;
+            if (!FitsIn(libraryOffset, sizeof(length), (size_t)libraryEnd)) {
+                Close();
+                return false;
+            }
+            memcpy(&length, data + libraryOffset, sizeof(length));
+            libraryOffset += sizeof(length);
+
+            if (!FitsIn(libraryOffset, length, (size_t)libraryEnd)) {
+                Close();
+                return false;
+            }
+            materialLibraries.push_back(std::string((const char*)data + libraryOffset, length));
+            libraryOffset += length;
+        }
+
+        // a matching size and timestamp is trusted, otherwise the contents decide
+        MeshCacheKey key;
+        std::vector<std::string> sourceLibraries;
+        if (!ComputeKey(sourceFileName, false, key, sourceLibraries) || key.sourceSize != header.sourceSize) {
+            Close();
+            return false;
+        }
+        if (key.sourceModifiedTime != header.sourceModifiedTime) {
+
+            // the libraries are the ones the source names today, unchanged when its hash matches
+            if (!ComputeKey(sourceFileName, true, key, sourceLibraries) || key.sourceHash != header.sourceHash || sourceLibraries != materialLibraries) {
+                Close();
+                return false;
+            }
+        }
+
+        ComputeMaterialKey(materialLibraries, false, key);
+        if (key.materialSize != header.materialSize) {
+            Close();
+            return false;
+        }
+        if (key.materialModifiedTime != header.materialModifiedTime) {
+
+            ComputeMaterialKey(materialLibraries, true, key);
+            if (key.materialHash != header.materialHash) {
+                Close();
+                return false;
+            }
+        }
+
+        const MeshCacheEntry* entries = (const MeshCacheEntry*)(data + sizeof(header));
+
+        // the encoded streams of the meshes do not overlap, together they fit in the file
+        uint64_t encodedBytes = 0;
+        for (uint32_t i = 0; i < header.meshCount; i++) {
+
+            const MeshCacheEntry& entry = entries[i];
+            encodedBytes += entry.vertexBytes + entry.indexBytes;
+
+            if (!FitsIn(entry.vertexOffset, entry.vertexBytes, size) ||
+                !FitsIn(entry.indexOffset, entry.indexBytes, size) ||
+                entry.vertexFormat > VERTEX_FORMAT_PACKED ||
+                entry.textureOffset > size ||
+                !FitsIn(entry.lodOffset, (uint64_t)entry.lodCount * sizeof(MeshLod), size) ||
+                !FitsIn(entry.meshletOffset, (uint64_t)entry.meshletCount * sizeof(Meshlet), size)) {
+                Close();
+                return false;
+            }
+
+            // the geometry is decoded here, off the GL thread, and the file can go right after
+            MeshCacheMesh mesh;
+            mesh.vertexFormat = (VertexFormat)entry.vertexFormat;
+            size_t vertexSize = mesh.vertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+
+            // counts no stream of that size can encode are corrupt, and would be allocated before the decode notices
+            if (encodedBytes > size ||
+                entry.vertexCount > MeshCodec::GetMaxVertexCount((size_t)entry.vertexBytes, vertexSize) ||
+                entry.indexCount > MeshCodec::GetMaxIndexCount((size_t)entry.indexBytes)) {
+                Close();
+                return false;
+            }
+
+            vertexStorage.push_back(std::vector<unsigned char>((size_t)entry.vertexCount * vertexSize));
+            indexStorage.push_back(std::vector<GLuint>(entry.indexCount));
+            if (!MeshCodec::DecodeVertices(vertexStorage.back().data(), entry.vertexCount, vertexSize, data + entry.vertexOffset, (size_t)entry.vertexBytes) ||
+                !MeshCodec::DecodeIndices(indexStorage.back().data(), entry.indexCount, data + entry.indexOffset, (size_t)entry.indexBytes)) {
+                Close();
+                return false;
+            }
+
+            mesh.vertices = mesh.vertexFormat == VERTEX_FORMAT_FLOAT ? (const Vertex*)vertexStorage.back().data() : NULL;
+            mesh.packedVertices = mesh.vertexFormat == VERTEX_FORMAT_PACKED ? (const PackedVertex*)vertexStorage.back().data() : NULL;
+            mesh.vertexCount = entry.vertexCount;
+            mesh.indices = indexStorage.back().data();
+            mesh.indexCount = entry.indexCount;
+            mesh.lods.resize(entry.lodCount);
+            if (entry.lodCount > 0) {
+                memcpy(mesh.lods.data(), data + entry.lodOffset, entry.lodCount * sizeof(MeshLod));
+            }
+            for (uint32_t l = 0; l < entry.lodCount; l++) {
+
+                if ((uint64_t)mesh.lods[l].indexOffset + mesh.lods[l].indexCount > entry.indexCount) {
+                    Close();
+                    return false;
+                }
+            }
+
+            // meshlets have to stay inside the full level
+            mesh.meshlets.resize(entry.meshletCount);
+            if (entry.meshletCount > 0) {
+                memcpy(mesh.meshlets.data(), data + entry.meshletOffset, entry.meshletCount * sizeof(Meshlet));
+            }
+            uint64_t fullCount = mesh.lods.empty() ? entry.indexCount : mesh.lods[0].indexCount;
+            for (uint32_t m = 0; m < entry.meshletCount; m++) {
+
+                if ((uint64_t)mesh.meshlets[m].indexOffset + mesh.meshlets[m].indexCount > fullCount) {
+                    Close();
+                    return false;
+                }
+            }
+
+            mesh.rangeMin = glm::vec3(entry.rangeMin[0], entry.rangeMin[1], entry.rangeMin[2]);
+            mesh.rangeMax = glm::vec3(entry.rangeMax[0], entry.rangeMax[1], entry.rangeMax[2]);
+            mesh.boundsMin = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+            mesh.boundsMax = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+
+            // texture references are stored as (type length, path length, type, path)
+            uint64_t offset = entry.textureOffset;
+            for (uint32_t t = 0; t < entry.textureCount; t++) {
+
+                uint32_t lengths[2];
+                if (!FitsIn(offset, sizeof(lengths), size)) {
+                    Close();
+                    return false;
+                }
+                memcpy(lengths, data + offset, sizeof(lengths));
+                offset += sizeof(lengths);
+
+                if (!FitsIn(offset, (uint64_t)lengths[0] + lengths[1], size)) {
+                    Close();
+                    return false;
+                }
+
+                Texture texture;
+                texture.id = 0;
+                texture.type = std::string((const char*)data + offset, lengths[0]);
+                texture.path = std::string((const char*)data + offset + lengths[0], lengths[1]);
+                offset += lengths[0] + lengths[1];
+
+                mesh.textures.push_back(texture);
+            }
+
+            meshes.push_back(mesh);
+        }
+
+        sourceHash = header.sourceHash;
+        materialHash = header.materialHash;
+
+        return true;
+    }
+
+    void MeshCache::Close() {
+
+        meshes.clear();
+        vertexStorage.clear();
+        indexStorage.clear();
+    }
+
+    size_t MeshCache::GetMeshCount() const {
+
+        return meshes.size();
+    }
+
+    MeshCacheMesh MeshCache::GetMesh(size_t index) const {
+
+        return meshes[index];
+    }
+
+    uint64_t MeshCache::GetSourceHash() const {
+
+        return sourceHash;
+    }
+
+    uint64_t MeshCache::GetMaterialHash() const {
+
+        return materialHash;
+    }
+
+    bool MeshCache::Write(std::string cacheFileName, std::string sourceFileName, const std::vector<MeshCacheMesh>& meshes, uint64_t& sourceHash, uint64_t& materialHash) {
+
+        MeshCacheKey key;
+        std::vector<std::string> materialLibraries;
+        if (!ComputeKey(sourceFileName, true, key, materialLibraries)) {
+            return false;
+        }
+        ComputeMaterialKey(materialLibraries, true, key);
+        sourceHash = key.sourceHash;
+        materialHash = key.materialHash;
+
+        MeshCacheHeader header;
+        memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+        header.version = MESH_CACHE_VERSION;
+        header.meshCount = (uint32_t)meshes.size();
+        header.sourceSize = key.sourceSize;
+        header.sourceModifiedTime = key.sourceModifiedTime;
+        header.sourceHash = key.sourceHash;
+        header.materialSize = key.materialSize;
+        header.materialModifiedTime = key.materialModifiedTime;
+        header.materialHash = key.materialHash;
+        header.materialLibraryCount = (uint32_t)materialLibraries.size();
+        header.materialLibraryBytes = 0;
+        header.padding = 0;
+        for (size_t i = 0; i < materialLibraries.size(); i++) {
+            header.materialLibraryBytes += sizeof(uint32_t) + materialLibraries[i].size();
+        }
+
+        // the geometry is encoded up front, its sizes decide the layout
+        std::vector<std::vector<unsigned char> > encodedVertices(meshes.size());
+        std::vector<std::vector<unsigned char> > encodedIndices(meshes.size());
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+
+            if (meshes[i].vertexFormat == VERTEX_FORMAT_PACKED) {
+                MeshCodec::EncodeVertices(meshes[i].packedVertices, meshes[i].vertexCount, sizeof(PackedVertex), encodedVertices[i]);
+            } else {
+                MeshCodec::EncodeVertices(meshes[i].vertices, meshes[i].vertexCount, sizeof(Vertex), encodedVertices[i]);
+            }
+            MeshCodec::EncodeIndices(meshes[i].indices, meshes[i].indexCount, encodedIndices[i]);
+        }
+
+        // lay out the library names, texture references, LOD and meshlet tables first, then the geometry
+        std::vector<MeshCacheEntry> entries(meshes.size());
+        uint64_t offset = sizeof(header) + entries.size() * sizeof(MeshCacheEntry) + header.materialLibraryBytes;
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+
+            entries[i].textureOffset = offset;
+            entries[i].textureCount = (uint32_t)meshes[i].textures.size();
+            for (size_t t = 0; t < meshes[i].textures.size(); t++) {
+                offset += 2 * sizeof(uint32_t) + meshes[i].textures[t].type.size() + meshes[i].textures[t].path.size();
+            }
+
+            entries[i].lodOffset = offset;
+            entries[i].lodCount = (uint32_t)meshes[i].lods.size();
+            offset += meshes[i].lods.size() * sizeof(MeshLod);
+
+            entries[i].meshletOffset = offset;
+            entries[i].meshletCount = (uint32_t)meshes[i].meshlets.size();
+            offset += meshes[i].meshlets.size() * sizeof(Meshlet);
+        }
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+
+            entries[i].vertexOffset = offset;
+            entries[i].vertexBytes = encodedVertices[i].size();
+            entries[i].vertexCount = meshes[i].vertexCount;
+            entries[i].vertexFormat = (uint32_t)meshes[i].vertexFormat;
+            offset += encodedVertices[i].size();
+
+            entries[i].indexOffset = offset;
+            entries[i].indexBytes = encodedIndices[i].size();
+            entries[i].indexCount = meshes[i].indexCount;
+            offset += encodedIndices[i].size();
+
+            for (int c = 0; c < 3; c++) {
+                entries[i].rangeMin[c] = meshes[i].rangeMin[c];
+                entries[i].rangeMax[c] = meshes[i].rangeMax[c];
+                entries[i].boundsMin[c] = meshes[i].boundsMin[c];
+                entries[i].boundsMax[c] = meshes[i].boundsMax[c];
+            }
+        }
+        header.fileSize = offset;
+
+        // write to a temporary file so a crash never leaves a truncated cache behind
+        std::string tempFileName = cacheFileName + ".tmp";
+        std::ofstream output(tempFileName.c_str(), std::ios::binary | std::ios::trunc);
+        if (!output) {
+            return false;
+        }
+
+        output.write((const char*)&header, sizeof(header));
+        output.write((const char*)entries.data(), entries.size() * sizeof(MeshCacheEntry));
+
+        for (size_t i = 0; i < materialLibraries.size(); i++) {
+
+            uint32_t length = (uint32_t)materialLibraries[i].size();
+            output.write((const char*)&length, sizeof(length));
+            output.write(materialLibraries[i].data(), materialLibraries[i].size());
+        }
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+            for (size_t t = 0; t < meshes[i].textures.size(); t++) {
+
+                const Texture& texture = meshes[i].textures[t];
+                uint32_t lengths[2] = { (uint32_t)texture.type.size(), (uint32_t)texture.path.size() };
+                output.write((const char*)lengths, sizeof(lengths));
+                output.write(texture.type.data(), texture.type.size());
+                output.write(texture.path.data(), texture.path.size());
+            }
+            output.write((const char*)meshes[i].lods.data(), meshes[i].lods.size() * sizeof(MeshLod));
+            output.write((const char*)meshes[i].meshlets.data(), meshes[i].meshlets.size() * sizeof(Meshlet));
+        }
+
+        for (size_t i = 0; i < meshes.size(); i++) {
+
+            output.write((const char*)encodedVertices[i].data(), (std::streamsize)encodedVertices[i].size());
+            output.write((const char*)encodedIndices[i].data(), (std::streamsize)encodedIndices[i].size());
+        }
+
+        output.close();
+        if (!output) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        remove(cacheFileName.c_str());
+        if (rename(tempFileName.c_str(), cacheFileName.c_str()) != 0) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef MeshCache_hpp
+#define MeshCache_hpp
+
+#include "Mesh.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Bump whenever the layout of the cache file or the way meshes are built changes
+    const uint32_t MESH_CACHE_VERSION = 8;
+
+    // Identifies the source file a cache was built from, with the material libraries it references
+    struct MeshCacheKey {
+
+        uint64_t sourceSize;
+        int64_t sourceModifiedTime;
+        uint64_t sourceHash;
+        // every .mtl named by the source folded together, missing ones count as empty
+        uint64_t materialSize;
+        uint64_t materialModifiedTime;
+        uint64_t materialHash;
+    };
+
+    // One mesh as stored in (or written to) the cache
+    struct MeshCacheMesh {
+
+        // packed vertices are quantized to the range below, a model with UVs that do not fit keeps float ones
+        VertexFormat vertexFormat;
+        const Vertex* vertices;
+        const PackedVertex* packedVertices;
+        uint32_t vertexCount;
+        // every level of detail, the full mesh first
+        const GLuint* indices;
+        uint32_t indexCount;
+        std::vector<MeshLod> lods;
+        // clusters of the full level
+        std::vector<Meshlet> meshlets;
+        // shared by every mesh of the model
+        glm::vec3 rangeMin;
+        glm::vec3 rangeMax;
+        // of this mesh alone
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // only type and path are meaningful, ids are resolved on load
+        std::vector<Texture> textures;
+    };
+
+    // Versioned binary cache of a parsed model, stored next to the source file
+    //
+    // Materials and texture paths come from the .mtl libraries, so the cache
+    // is checked against them as well as the .obj and their names are kept
+    // in the file to check them without reading the source.
+    //
+    // Layout: header, mesh table, material library names, texture references, LOD and meshlet tables, then
+    // the vertex and index arrays of every mesh compressed with MeshCodec. They
+    // are decoded when the cache is opened, on the loading thread, so the GL
+    // thread still gets arrays it can hand straight to glBufferData.
+    class MeshCache {
+
+    public:
+        // Maps the cache, checks it against the source file and decodes the geometry, returns false on a miss
+        bool Open(std::string cacheFileName, std::string sourceFileName);
+        void Close();
+
+        size_t GetMeshCount() const;
+        // Returned pointers stay valid until the cache is closed
+        MeshCacheMesh GetMesh(size_t index) const;
+
+        // Content hash of the source file the open cache was built from
+        uint64_t GetSourceHash() const;
+        // Combined content hash of its material libraries
+        uint64_t GetMaterialHash() const;
+
+        // Writes the meshes of a freshly parsed source file to disk, also returning the hashes of the source and its materials
+        static bool Write(std::string cacheFileName, std::string sourceFileName, const std::vector<MeshCacheMesh>& meshes, uint64_t& sourceHash, uint64_t& materialHash);
+
+        // Cache file used for a given source file
+        static std::string GetCacheFileName(std::string sourceFileName);
+
+    private:
+        std::vector<MeshCacheMesh> meshes;
+        // decoded geometry the meshes point into, the file itself is closed once Open is done
+        std::vector<std::vector<unsigned char> > vertexStorage;
+        std::vector<std::vector<GLuint> > indexStorage;
+        uint64_t sourceHash;
+        uint64_t materialHash;
+
+        // Hashing the contents also lists the material libraries the source names
+        static bool ComputeKey(std::string sourceFileName, bool hashContents, MeshCacheKey& key, std::vector<std::string>& materialLibraries);
+        static void ComputeMaterialKey(const std::vector<std::string>& materialLibraries, bool hashContents, MeshCacheKey& key);
+    };
+}
+
+#endif /* MeshCache_hpp */
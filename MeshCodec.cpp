@@ -0,0 +1,434 @@
+#include "MeshCodec.hpp"
+
+#include <string.h>
+
+#include <algorithm>
+
+// x86-64 always has SSE2, 32-bit x86 only when the compiler is told so
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GPS_MESH_CODEC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace gps {
+
+    static const size_t VERTEX_BLOCK_SIZE = 256;
+    static const size_t GROUP_SIZE = 16;
+
+    // Payload bytes of a vertex group for each 2-bit header code (0, 2, 4 or 8 bits per byte)
+    static const size_t VERTEX_GROUP_BYTES[4] = { 0, 4, 8, 16 };
+    // Bytes per index of an index group for each header code
+    static const size_t INDEX_GROUP_WIDTH[4] = { 0, 1, 2, 4 };
+
+    bool MeshCodec::simdEnabled = true;
+
+    static unsigned char ZigzagByte(unsigned char delta) {
+
+        return (unsigned char)((delta << 1) ^ ((signed char)delta >> 7));
+    }
+
+    static unsigned char UnzigzagByte(unsigned char value) {
+
+        return (unsigned char)((value >> 1) ^ (0 - (value & 1)));
+    }
+
+    static uint32_t Zigzag(uint32_t delta) {
+
+        return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+    }
+
+    static uint32_t Unzigzag(uint32_t value) {
+
+        return (value >> 1) ^ (0 - (value & 1));
+    }
+
+    // Packs 16 zigzagged bytes, value i of a 2-bit group sits in byte i % 4, of a 4-bit group in byte i % 8
+    static void EncodeVertexGroup(const unsigned char* values, int code, std::vector<unsigned char>& encoded) {
+
+        if (code == 1) {
+            for (size_t j = 0; j < 4; j++) {
+                encoded.push_back((unsigned char)(values[j] | (values[j + 4] << 2) | (values[j + 8] << 4) | (values[j + 12] << 6)));
+            }
+        } else if (code == 2) {
+            for (size_t j = 0; j < 8; j++) {
+                encoded.push_back((unsigned char)(values[j] | (values[j + 8] << 4)));
+            }
+        } else if (code == 3) {
+            encoded.insert(encoded.end(), values, values + GROUP_SIZE);
+        }
+    }
+
+    static unsigned char DecodeVertexGroupScalar(const unsigned char* payload, int code, unsigned char previous, unsigned char* output) {
+
+        for (size_t i = 0; i < GROUP_SIZE; i++) {
+
+            unsigned char value = 0;
+            if (code == 1) {
+                value = (payload[i % 4] >> (2 * (i / 4))) & 3;
+            } else if (code == 2) {
+                value = (payload[i % 8] >> (4 * (i / 8))) & 15;
+            } else if (code == 3) {
+                value = payload[i];
+            }
+            previous = (unsigned char)(previous + UnzigzagByte(value));
+            output[i] = previous;
+        }
+        return previous;
+    }
+
+#if defined (GPS_MESH_CODEC_SSE2)
+    // previous holds the last byte of the previous group in every lane, the result does the same for the next group
+    static __m128i DecodeVertexGroupSse2(const unsigned char* payload, int code, __m128i previous, unsigned char* output) {
+
+        __m128i values = _mm_setzero_si128();
+        if (code == 1) {
+
+            int32_t bits;
+            memcpy(&bits, payload, sizeof(bits));
+            __m128i packed = _mm_cvtsi32_si128(bits);
+            __m128i mask = _mm_set1_epi8(3);
+            __m128i first = _mm_unpacklo_epi32(_mm_and_si128(packed, mask), _mm_and_si128(_mm_srli_epi16(packed, 2), mask));
+            __m128i second = _mm_unpacklo_epi32(_mm_and_si128(_mm_srli_epi16(packed, 4), mask), _mm_and_si128(_mm_srli_epi16(packed, 6), mask));
+            values = _mm_unpacklo_epi64(first, second);
+        } else if (code == 2) {
+
+            __m128i packed = _mm_loadl_epi64((const __m128i*)payload);
+            __m128i mask = _mm_set1_epi8(15);
+            values = _mm_unpacklo_epi64(_mm_and_si128(packed, mask), _mm_and_si128(_mm_srli_epi16(packed, 4), mask));
+        } else if (code == 3) {
+
+            values = _mm_loadu_si128((const __m128i*)payload);
+        }
+
+        // zigzag back to signed steps, there is no byte shift so the word shift is masked
+        __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(values, _mm_set1_epi8(1)));
+        __m128i deltas = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(values, 1), _mm_set1_epi8(0x7F)), sign);
+
+        // running sum of the steps in four shifted adds, on top of the last byte of the previous group
+        deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 1));
+        deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 2));
+        deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 4));
+        deltas = _mm_add_epi8(deltas, _mm_slli_si128(deltas, 8));
+        deltas = _mm_add_epi8(deltas, previous);
+
+        _mm_storeu_si128((__m128i*)output, deltas);
+
+        // byte 15 to every lane, only the carry waits for the previous group
+        __m128i last = _mm_shufflehi_epi16(_mm_unpackhi_epi8(deltas, deltas), 0xFF);
+        return _mm_shuffle_epi32(last, 0xFF);
+    }
+
+    // Interleaves 16 byte planes of 16 vertices back into their vertices, a 16x16 byte transpose in four rounds of unpacks
+    static void TransposeGroupSse2(const unsigned char* planes, size_t planeStride, unsigned char* vertices, size_t vertexSize) {
+
+        __m128i rows[16];
+        for (size_t k = 0; k < 16; k++) {
+            rows[k] = _mm_loadu_si128((const __m128i*)(planes + k * planeStride));
+        }
+
+        // pairs of planes for vertices 0-7 and 8-15
+        __m128i pairs[16];
+        for (size_t k = 0; k < 8; k++) {
+
+            pairs[2 * k] = _mm_unpacklo_epi8(rows[2 * k], rows[2 * k + 1]);
+            pairs[2 * k + 1] = _mm_unpackhi_epi8(rows[2 * k], rows[2 * k + 1]);
+        }
+
+        // four planes of four vertices, quads[4 * j + q] holds planes 4j-4j+3 of vertices 4q-4q+3
+        __m128i quads[16];
+        for (size_t j = 0; j < 4; j++) {
+
+            quads[4 * j] = _mm_unpacklo_epi16(pairs[4 * j], pairs[4 * j + 2]);
+            quads[4 * j + 1] = _mm_unpackhi_epi16(pairs[4 * j], pairs[4 * j + 2]);
+            quads[4 * j + 2] = _mm_unpacklo_epi16(pairs[4 * j + 1], pairs[4 * j + 3]);
+            quads[4 * j + 3] = _mm_unpackhi_epi16(pairs[4 * j + 1], pairs[4 * j + 3]);
+        }
+
+        for (size_t q = 0; q < 4; q++) {
+
+            // planes 0-7 and 8-15 of two vertices each
+            __m128i low0 = _mm_unpacklo_epi32(quads[q], quads[4 + q]);
+            __m128i low1 = _mm_unpackhi_epi32(quads[q], quads[4 + q]);
+            __m128i high0 = _mm_unpacklo_epi32(quads[8 + q], quads[12 + q]);
+            __m128i high1 = _mm_unpackhi_epi32(quads[8 + q], quads[12 + q]);
+
+            _mm_storeu_si128((__m128i*)(vertices + (4 * q) * vertexSize), _mm_unpacklo_epi64(low0, high0));
+            _mm_storeu_si128((__m128i*)(vertices + (4 * q + 1) * vertexSize), _mm_unpackhi_epi64(low0, high0));
+            _mm_storeu_si128((__m128i*)(vertices + (4 * q + 2) * vertexSize), _mm_unpacklo_epi64(low1, high1));
+            _mm_storeu_si128((__m128i*)(vertices + (4 * q + 3) * vertexSize), _mm_unpackhi_epi64(low1, high1));
+        }
+    }
+#endif
+
+    void MeshCodec::EncodeVertices(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<unsigned char>& encoded) {
+
+        const unsigned char* data = (const unsigned char*)vertices;
+        unsigned char last[MESH_CODEC_MAX_VERTEX_SIZE] = { 0 };
+        unsigned char values[VERTEX_BLOCK_SIZE];
+
+        for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VERTEX_BLOCK_SIZE) {
+
+            size_t count = std::min(VERTEX_BLOCK_SIZE, vertexCount - blockStart);
+            size_t groupCount = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+
+            for (size_t k = 0; k < vertexSize; k++) {
+
+                // the last group is padded with copies of the last vertex, steps of 0
+                unsigned char previous = last[k];
+                for (size_t i = 0; i < groupCount * GROUP_SIZE; i++) {
+
+                    unsigned char value = data[(blockStart + std::min(i, count - 1)) * vertexSize + k];
+                    values[i] = ZigzagByte((unsigned char)(value - previous));
+                    previous = value;
+                }
+                last[k] = previous;
+
+                size_t header = encoded.size();
+                encoded.resize(header + (groupCount + 3) / 4, 0);
+
+                for (size_t g = 0; g < groupCount; g++) {
+
+                    const unsigned char* group = values + g * GROUP_SIZE;
+                    unsigned char largest = *std::max_element(group, group + GROUP_SIZE);
+                    int code = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+
+                    encoded[header + g / 4] |= (unsigned char)(code << (2 * (g % 4)));
+                    EncodeVertexGroup(group, code, encoded);
+                }
+            }
+        }
+    }
+
+    bool MeshCodec::DecodeVertices(void* vertices, size_t vertexCount, size_t vertexSize, const unsigned char* encoded, size_t encodedSize) {
+
+        if (vertexSize == 0 || vertexSize % 4 != 0 || vertexSize > MESH_CODEC_MAX_VERTEX_SIZE) {
+            return false;
+        }
+
+        unsigned char* output = (unsigned char*)vertices;
+        const unsigned char* cursor = encoded;
+        const unsigned char* end = encoded + encodedSize;
+        unsigned char last[MESH_CODEC_MAX_VERTEX_SIZE] = { 0 };
+        // one block, plane after plane
+        unsigned char planes[MESH_CODEC_MAX_VERTEX_SIZE * VERTEX_BLOCK_SIZE];
+
+#if defined (GPS_MESH_CODEC_SSE2)
+        bool simd = simdEnabled;
+#endif
+
+        for (size_t blockStart = 0; blockStart < vertexCount; blockStart += VERTEX_BLOCK_SIZE) {
+
+            size_t count = std::min(VERTEX_BLOCK_SIZE, vertexCount - blockStart);
+            size_t groupCount = (count + GROUP_SIZE - 1) / GROUP_SIZE;
+
+            for (size_t k = 0; k < vertexSize; k++) {
+
+                const unsigned char* header = cursor;
+                size_t headerSize = (groupCount + 3) / 4;
+                if ((size_t)(end - cursor) < headerSize) {
+                    return false;
+                }
+                cursor += headerSize;
+
+                unsigned char previous = last[k];
+                unsigned char* plane = planes + k * VERTEX_BLOCK_SIZE;
+
+                // the payload of every group is checked up front so the decode loops stay branch free
+                size_t payloadSize = 0;
+                for (size_t g = 0; g < groupCount; g++) {
+                    payloadSize += VERTEX_GROUP_BYTES[(header[g / 4] >> (2 * (g % 4))) & 3];
+                }
+                if ((size_t)(end - cursor) < payloadSize) {
+                    return false;
+                }
+
+#if defined (GPS_MESH_CODEC_SSE2)
+                if (simd) {
+
+                    __m128i carry = _mm_set1_epi8((char)previous);
+                    for (size_t g = 0; g < groupCount; g++) {
+
+                        int code = (header[g / 4] >> (2 * (g % 4))) & 3;
+                        carry = DecodeVertexGroupSse2(cursor, code, carry, plane + g * GROUP_SIZE);
+                        cursor += VERTEX_GROUP_BYTES[code];
+                    }
+                } else
+#endif
+                {
+                    for (size_t g = 0; g < groupCount; g++) {
+
+                        int code = (header[g / 4] >> (2 * (g % 4))) & 3;
+                        previous = DecodeVertexGroupScalar(cursor, code, previous, plane + g * GROUP_SIZE);
+                        cursor += VERTEX_GROUP_BYTES[code];
+                    }
+                }
+                last[k] = plane[count - 1];
+            }
+
+            // planes back to vertices, 16 bytes of 16 vertices at a time
+            unsigned char* blockOutput = output + blockStart * vertexSize;
+            size_t v = 0;
+#if defined (GPS_MESH_CODEC_SSE2)
+            if (simd && vertexSize % 16 == 0) {
+                for (; v + GROUP_SIZE <= count; v += GROUP_SIZE) {
+                    for (size_t k = 0; k < vertexSize; k += 16) {
+                        TransposeGroupSse2(planes + k * VERTEX_BLOCK_SIZE + v, VERTEX_BLOCK_SIZE, blockOutput + v * vertexSize + k, vertexSize);
+                    }
+                }
+            }
+#endif
+            for (; v < count; v++) {
+                for (size_t k = 0; k < vertexSize; k++) {
+                    blockOutput[v * vertexSize + k] = planes[k * VERTEX_BLOCK_SIZE + v];
+                }
+            }
+        }
+
+        return cursor == end;
+    }
+
+    void MeshCodec::EncodeIndices(const uint32_t* indices, size_t indexCount, std::vector<unsigned char>& encoded) {
+
+        size_t groupCount = (indexCount + GROUP_SIZE - 1) / GROUP_SIZE;
+        size_t header = encoded.size();
+        encoded.resize(header + (groupCount + 3) / 4, 0);
+
+        uint32_t previous = 0;
+        for (size_t g = 0; g < groupCount; g++) {
+
+            // the last group is padded with repeats of the last index, steps of 0
+            uint32_t values[GROUP_SIZE];
+            uint32_t largest = 0;
+            for (size_t i = 0; i < GROUP_SIZE; i++) {
+
+                uint32_t index = indices[std::min(g * GROUP_SIZE + i, indexCount - 1)];
+                values[i] = Zigzag(index - previous);
+                previous = index;
+                largest = std::max(largest, values[i]);
+            }
+
+            int code = largest == 0 ? 0 : largest < 0x100 ? 1 : largest < 0x10000 ? 2 : 3;
+            encoded[header + g / 4] |= (unsigned char)(code << (2 * (g % 4)));
+
+            // byte planes, the low bytes of all 16 first
+            for (size_t b = 0; b < INDEX_GROUP_WIDTH[code]; b++) {
+                for (size_t i = 0; i < GROUP_SIZE; i++) {
+                    encoded.push_back((unsigned char)(values[i] >> (8 * b)));
+                }
+            }
+        }
+    }
+
+    bool MeshCodec::DecodeIndices(uint32_t* indices, size_t indexCount, const unsigned char* encoded, size_t encodedSize) {
+
+        size_t groupCount = (indexCount + GROUP_SIZE - 1) / GROUP_SIZE;
+        size_t headerSize = (groupCount + 3) / 4;
+        if (encodedSize < headerSize) {
+            return false;
+        }
+
+        const unsigned char* header = encoded;
+        const unsigned char* cursor = encoded + headerSize;
+        const unsigned char* end = encoded + encodedSize;
+        uint32_t previous = 0;
+
+#if defined (GPS_MESH_CODEC_SSE2)
+        bool simd = simdEnabled;
+        __m128i carry = _mm_setzero_si128();
+#endif
+
+        for (size_t g = 0; g < groupCount; g++) {
+
+            int code = (header[g / 4] >> (2 * (g % 4))) & 3;
+            size_t width = INDEX_GROUP_WIDTH[code];
+            if ((size_t)(end - cursor) < width * GROUP_SIZE) {
+                return false;
+            }
+
+            // the padded last group is decoded aside
+            uint32_t tail[GROUP_SIZE];
+            bool full = (g + 1) * GROUP_SIZE <= indexCount;
+            uint32_t* output = full ? indices + g * GROUP_SIZE : tail;
+
+#if defined (GPS_MESH_CODEC_SSE2)
+            if (simd) {
+
+                __m128i zero = _mm_setzero_si128();
+                __m128i p0 = width > 0 ? _mm_loadu_si128((const __m128i*)cursor) : zero;
+                __m128i p1 = width > 1 ? _mm_loadu_si128((const __m128i*)(cursor + GROUP_SIZE)) : zero;
+                __m128i p2 = width > 2 ? _mm_loadu_si128((const __m128i*)(cursor + 2 * GROUP_SIZE)) : zero;
+                __m128i p3 = width > 2 ? _mm_loadu_si128((const __m128i*)(cursor + 3 * GROUP_SIZE)) : zero;
+
+                // byte planes back to 32-bit values, four per register
+                __m128i low01 = _mm_unpacklo_epi8(p0, p1);
+                __m128i high01 = _mm_unpackhi_epi8(p0, p1);
+                __m128i low23 = _mm_unpacklo_epi8(p2, p3);
+                __m128i high23 = _mm_unpackhi_epi8(p2, p3);
+                __m128i values[4] = {
+                    _mm_unpacklo_epi16(low01, low23), _mm_unpackhi_epi16(low01, low23),
+                    _mm_unpacklo_epi16(high01, high23), _mm_unpackhi_epi16(high01, high23)
+                };
+
+                for (size_t r = 0; r < 4; r++) {
+
+                    __m128i sign = _mm_sub_epi32(zero, _mm_and_si128(values[r], _mm_set1_epi32(1)));
+                    __m128i deltas = _mm_xor_si128(_mm_srli_epi32(values[r], 1), sign);
+
+                    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 4));
+                    deltas = _mm_add_epi32(deltas, _mm_slli_si128(deltas, 8));
+                    deltas = _mm_add_epi32(deltas, carry);
+                    carry = _mm_shuffle_epi32(deltas, 0xFF);
+
+                    _mm_storeu_si128((__m128i*)(output + r * 4), deltas);
+                }
+            } else
+#endif
+            {
+                for (size_t i = 0; i < GROUP_SIZE; i++) {
+
+                    uint32_t value = 0;
+                    for (size_t b = 0; b < width; b++) {
+                        value |= (uint32_t)cursor[b * GROUP_SIZE + i] << (8 * b);
+                    }
+                    previous += Unzigzag(value);
+                    output[i] = previous;
+                }
+            }
+
+            if (!full) {
+                memcpy(indices + g * GROUP_SIZE, tail, (indexCount - g * GROUP_SIZE) * sizeof(uint32_t));
+            }
+            cursor += width * GROUP_SIZE;
+        }
+
+        return cursor == end;
+    }
+
+    // a header byte covers four groups of every plane
+    size_t MeshCodec::GetMaxVertexCount(size_t encodedSize, size_t vertexSize) {
+
+        if (vertexSize == 0) {
+            return 0;
+        }
+        return encodedSize / vertexSize * GROUP_SIZE * 4;
+    }
+
+    size_t MeshCodec::GetMaxIndexCount(size_t encodedSize) {
+
+        return encodedSize * GROUP_SIZE * 4;
+    }
+
+    bool MeshCodec::IsSimdAvailable() {
+
+#if defined (GPS_MESH_CODEC_SSE2)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void MeshCodec::SetSimdEnabled(bool enabled) {
+
+        simdEnabled = enabled;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef MeshCodec_hpp
+#define MeshCodec_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace gps {
+
+    // Widest vertex the codec takes, in bytes
+    const size_t MESH_CODEC_MAX_VERTEX_SIZE = 64;
+
+    // Lossless compression of the vertex and index buffers of the mesh cache
+    //
+    // Vertices are cut into blocks of 256 and each block into byte planes,
+    // the n-th byte of every vertex in a row. A plane stores the difference
+    // of each byte to the same byte of the previous vertex, zigzag mapped so
+    // small steps either way are small numbers, in groups of 16 packed to
+    // 0, 2, 4 or 8 bits. Fetch ordered vertices change slowly, so most of
+    // the high bytes of positions and normals and many of the low ones pack
+    // tightly.
+    //
+    // Indices are stored as zigzag mapped differences to the previous index
+    // in groups of 16 of 0, 1, 2 or 4 bytes; after the vertex cache and
+    // fetch optimizations nearly all of them fit in one byte.
+    //
+    // Decoding runs group by group with SSE2 where the compiler targets it
+    // and with plain C++ everywhere else; both read the same format.
+    class MeshCodec {
+
+    public:
+        // vertexSize has to be a multiple of 4 up to MESH_CODEC_MAX_VERTEX_SIZE
+        static void EncodeVertices(const void* vertices, size_t vertexCount, size_t vertexSize, std::vector<unsigned char>& encoded);
+
+        // Returns false for truncated or corrupt data, which must be exactly encodedSize bytes
+        static bool DecodeVertices(void* vertices, size_t vertexCount, size_t vertexSize, const unsigned char* encoded, size_t encodedSize);
+
+        static void EncodeIndices(const uint32_t* indices, size_t indexCount, std::vector<unsigned char>& encoded);
+
+        static bool DecodeIndices(uint32_t* indices, size_t indexCount, const unsigned char* encoded, size_t encodedSize);
+
+        // Most vertices or indices encodedSize bytes can hold, every group at 0 bits still costs its header
+        // Counts above it are corrupt, checking them first keeps a bad file from sizing the output
+        static size_t GetMaxVertexCount(size_t encodedSize, size_t vertexSize);
+        static size_t GetMaxIndexCount(size_t encodedSize);
+
+        // Whether this build decodes with SIMD at all, and a switch back to the scalar decoder for benchmarks
+        static bool IsSimdAvailable();
+        static void SetSimdEnabled(bool enabled);
+
+    private:
+        static bool simdEnabled;
+    };
+}
+
+#endif /* MeshCodec_hpp */
@@ -0,0 +1,265 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+
+namespace gps {
+
+    void MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<GLuint>& indices) {
+
+        if (indices.size() < 3 || vertices.empty()) {
+            return;
+        }
+
+        std::vector<GLuint> ordered(indices.size());
+        std::vector<size_t> clusters;
+        OptimizeVertexCache(indices.data(), indices.size(), vertices.size(), VERTEX_CACHE_SIZE, ordered.data(), clusters);
+        OptimizeOverdraw(vertices.data(), ordered.data(), ordered.size(), clusters);
+
+        indices.swap(ordered);
+        OptimizeVertexFetch(vertices, indices);
+    }
+
+    // Tipsify - Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+    //
+    // Triangles are emitted as fans around one vertex at a time; the next fan
+    // is the most recently used vertex that still has triangles left and will
+    // not leave the cache while they are emitted.
+    void MeshOptimizer::OptimizeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize, GLuint* destination, std::vector<size_t>& clusters) {
+
+        size_t triangleCount = indexCount / 3;
+        clusters.clear();
+
+        // triangles around every vertex, packed in one array
+        std::vector<GLuint> liveCount(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            liveCount[indices[i]]++;
+        }
+
+        std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+        }
+
+        std::vector<GLuint> adjacency(triangleCount * 3);
+        std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[indices[t * 3 + k]]++] = (GLuint)t;
+            }
+        }
+
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<GLuint> deadEnd;
+        std::vector<GLuint> candidates;
+        unsigned int timeStamp = cacheSize + 1;
+        size_t cursor = 0;
+        size_t written = 0;
+
+        // a mesh starts with its first vertex that has triangles
+        long fanning = -1;
+        while (cursor < vertexCount && liveCount[cursor] == 0) {
+            cursor++;
+        }
+        if (cursor < vertexCount) {
+            fanning = (long)cursor;
+        }
+        clusters.push_back(0);
+
+        while (fanning >= 0) {
+
+            candidates.clear();
+
+            for (size_t a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++) {
+
+                GLuint triangle = adjacency[a];
+                if (emitted[triangle]) {
+                    continue;
+                }
+
+                for (int k = 0; k < 3; k++) {
+
+                    GLuint vertex = indices[triangle * 3 + k];
+                    destination[written++] = vertex;
+                    deadEnd.push_back(vertex);
+                    candidates.push_back(vertex);
+                    liveCount[vertex]--;
+
+                    if (timeStamp - cacheTime[vertex] > cacheSize) {
+                        cacheTime[vertex] = timeStamp++;
+                    }
+                }
+                emitted[triangle] = true;
+            }
+
+            // prefer the oldest candidate that survives its whole fan in the cache
+            long best = -1;
+            int bestPriority = -1;
+            for (size_t c = 0; c < candidates.size(); c++) {
+
+                GLuint vertex = candidates[c];
+                if (liveCount[vertex] == 0) {
+                    continue;
+                }
+
+                int priority = 0;
+                if (timeStamp - cacheTime[vertex] + 2 * liveCount[vertex] <= cacheSize) {
+                    priority = (int)(timeStamp - cacheTime[vertex]);
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    best = vertex;
+                }
+            }
+
+            if (best < 0) {
+
+                // dead end - back to a recently used vertex, or on to the next unprocessed one
+                while (!deadEnd.empty() && best < 0) {
+
+                    GLuint vertex = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveCount[vertex] > 0) {
+                        best = vertex;
+                    }
+                }
+                while (best < 0 && cursor < vertexCount) {
+
+                    if (liveCount[cursor] > 0) {
+                        best = (long)cursor;
+                    }
+                    cursor++;
+                }
+
+                // the cache is as good as cold from here on, a natural cluster boundary
+                if (best >= 0 && written / 3 > clusters.back()) {
+                    clusters.push_back(written / 3);
+                }
+            }
+
+            fanning = best;
+        }
+    }
+
+    // Fast approximation of the Tipsify overdraw pass: clusters whose surface
+    // faces away from the mesh centroid are likely in front, so they go first
+    void MeshOptimizer::OptimizeOverdraw(const Vertex* vertices, GLuint* indices, size_t indexCount, const std::vector<size_t>& clusters) {
+
+        size_t triangleCount = indexCount / 3;
+        if (clusters.size() < 2) {
+            return;
+        }
+
+        // area weighted centroid of the whole mesh
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+
+        std::vector<glm::vec3> clusterCentroid(clusters.size(), glm::vec3(0.0f));
+        std::vector<glm::vec3> clusterNormal(clusters.size(), glm::vec3(0.0f));
+        std::vector<float> clusterArea(clusters.size(), 0.0f);
+
+        for (size_t c = 0; c < clusters.size(); c++) {
+
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+            for (size_t t = clusters[c]; t < end; t++) {
+
+                const glm::vec3& p0 = vertices[indices[t * 3 + 0]].Position;
+                const glm::vec3& p1 = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3& p2 = vertices[indices[t * 3 + 2]].Position;
+
+                // the cross product is twice the area along the face normal
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float area = glm::length(normal);
+                glm::vec3 centroid = (p0 + p1 + p2) / 3.0f;
+
+                clusterCentroid[c] += centroid * area;
+                clusterNormal[c] += normal;
+                clusterArea[c] += area;
+            }
+
+            meshCentroid += clusterCentroid[c];
+            meshArea += clusterArea[c];
+        }
+
+        if (meshArea > 0.0f) {
+            meshCentroid /= meshArea;
+        }
+
+        std::vector<float> outwardness(clusters.size(), 0.0f);
+        for (size_t c = 0; c < clusters.size(); c++) {
+
+            if (clusterArea[c] > 0.0f) {
+                outwardness[c] = glm::dot(clusterCentroid[c] / clusterArea[c] - meshCentroid, clusterNormal[c] / clusterArea[c]);
+            }
+        }
+
+        std::vector<size_t> order(clusters.size());
+        for (size_t c = 0; c < order.size(); c++) {
+            order[c] = c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&outwardness](size_t first, size_t second) {
+            return outwardness[first] > outwardness[second];
+        });
+
+        std::vector<GLuint> sorted;
+        sorted.reserve(triangleCount * 3);
+        for (size_t o = 0; o < order.size(); o++) {
+
+            size_t c = order[o];
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+            sorted.insert(sorted.end(), indices + clusters[c] * 3, indices + end * 3);
+        }
+        std::copy(sorted.begin(), sorted.end(), indices);
+    }
+
+    void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices) {
+
+        const GLuint unused = (GLuint)-1;
+        std::vector<GLuint> remap(vertices.size(), unused);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+
+        for (size_t i = 0; i < indices.size(); i++) {
+
+            GLuint& index = indices[i];
+            if (remap[index] == unused) {
+
+                remap[index] = (GLuint)ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+
+        vertices.swap(ordered);
+    }
+
+    VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize) {
+
+        VertexCacheStats stats;
+        stats.acmr = 0.0f;
+        stats.atvr = 0.0f;
+
+        if (indexCount < 3 || vertexCount == 0) {
+            return stats;
+        }
+
+        // a vertex stays cached until cacheSize newer vertices were pushed after it
+        std::vector<unsigned int> missTime(vertexCount, 0);
+        unsigned int misses = 0;
+
+        for (size_t i = 0; i < indexCount; i++) {
+
+            GLuint vertex = indices[i];
+            if (missTime[vertex] == 0 || misses - missTime[vertex] >= cacheSize) {
+
+                misses++;
+                missTime[vertex] = misses;
+            }
+        }
+
+        stats.acmr = (float)misses / (indexCount / 3);
+        stats.atvr = (float)misses / vertexCount;
+        return stats;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef MeshOptimizer_hpp
+#define MeshOptimizer_hpp
+
+#include "Mesh.hpp"
+
+#include <stddef.h>
+#include <vector>
+
+namespace gps {
+
+    // Post-transform cache size the triangle order is tuned for, a safe figure for current GPUs
+    const unsigned int VERTEX_CACHE_SIZE = 16;
+
+    // Efficiency of a triangle order on a FIFO vertex cache
+    struct VertexCacheStats {
+
+        // vertices transformed per triangle - 0.5 is ideal, 3 means no reuse at all
+        float acmr;
+        // vertices transformed per vertex of the mesh - 1 is ideal
+        float atvr;
+    };
+
+    // Reorders welded geometry for the GPU
+    //
+    // Triangles are first ordered for the post-transform cache (Tipsify), the
+    // cache flushes of that order split the mesh into clusters which are then
+    // drawn outermost first to cut overdraw, and the vertices are finally
+    // renumbered in first use order so the vertex fetch walks the VBO forward.
+    class MeshOptimizer {
+
+    public:
+        // Runs the three passes in place
+        static void Optimize(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+        // Tipsify ordering of indices into destination, clusters receives the first triangle of every cluster
+        static void OptimizeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize, GLuint* destination, std::vector<size_t>& clusters);
+
+        // Sorts the clusters so the ones facing away from the mesh center are drawn first
+        static void OptimizeOverdraw(const Vertex* vertices, GLuint* indices, size_t indexCount, const std::vector<size_t>& clusters);
+
+        // Renumbers the vertices in the order the indices first reference them, unused vertices are dropped
+        static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+        // Simulates a FIFO cache of cacheSize entries over the triangle list
+        static VertexCacheStats AnalyzeVertexCache(const GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize);
+    };
+}
+
+#endif /* MeshOptimizer_hpp */
@@ -0,0 +1,337 @@
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace gps {
+
+    // Squared distances to a set of planes, as the symmetric 4x4 matrix of Garland and Heckbert
+    struct Quadric {
+
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+        // number of planes, the error is their mean squared distance
+        double weight;
+
+        void Clear() {
+            a2 = ab = ac = ad = b2 = bc = bd = c2 = cd = d2 = weight = 0.0;
+        }
+
+        void AddPlane(double a, double b, double c, double d) {
+
+            a2 += a * a; ab += a * b; ac += a * c; ad += a * d;
+            b2 += b * b; bc += b * c; bd += b * d;
+            c2 += c * c; cd += c * d;
+            d2 += d * d;
+            weight += 1.0;
+        }
+
+        void Add(const Quadric& other) {
+
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+            weight += other.weight;
+        }
+
+        double Evaluate(const glm::vec3& p) const {
+
+            double x = p.x, y = p.y, z = p.z;
+            double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+                + b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+                + c2 * z * z + 2.0 * cd * z
+                + d2;
+            return error > 0.0 && weight > 0.0 ? error / weight : 0.0;
+        }
+    };
+
+    // Collapse of vertex "from" onto vertex "to"
+    struct Collapse {
+
+        GLuint from;
+        GLuint to;
+        double cost;
+    };
+
+    // Vertices sharing a position get the same id, seams are where one position has several vertices
+    static size_t BuildPositionIds(const Vertex* vertices, size_t vertexCount, std::vector<GLuint>& positionIds) {
+
+        struct PositionHash {
+            size_t operator()(const glm::vec3& p) const {
+
+                // adding zero turns -0 into +0, which compares equal and must hash the same
+                float components[3] = { p.x + 0.0f, p.y + 0.0f, p.z + 0.0f };
+                uint32_t bits[3];
+                memcpy(bits, components, sizeof(bits));
+                return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+            }
+        };
+
+        std::unordered_map<glm::vec3, GLuint, PositionHash> table;
+        table.reserve(vertexCount);
+        positionIds.resize(vertexCount);
+
+        for (size_t v = 0; v < vertexCount; v++) {
+
+            std::pair<std::unordered_map<glm::vec3, GLuint, PositionHash>::iterator, bool> inserted =
+                table.insert(std::make_pair(vertices[v].Position, (GLuint)table.size()));
+            positionIds[v] = inserted.first->second;
+        }
+
+        return table.size();
+    }
+
+    float MeshSimplifier::Simplify(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, size_t targetIndexCount, float maxError, std::vector<GLuint>& destination) {
+
+        destination.assign(indices, indices + indexCount);
+
+        if (indexCount <= targetIndexCount || vertexCount == 0) {
+            return 0.0f;
+        }
+
+        std::vector<GLuint> positionIds;
+        size_t positionCount = BuildPositionIds(vertices, vertexCount, positionIds);
+
+        // a position with several vertices lies on a seam, an edge used by one triangle on a border
+        std::vector<GLuint> wedgeCount(positionCount, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            wedgeCount[positionIds[v]]++;
+        }
+
+        std::unordered_map<uint64_t, GLuint> edgeUses;
+        edgeUses.reserve(indexCount);
+        for (size_t i = 0; i < indexCount; i += 3) {
+            for (int k = 0; k < 3; k++) {
+
+                GLuint a = positionIds[indices[i + k]];
+                GLuint b = positionIds[indices[i + (k + 1) % 3]];
+                uint64_t key = a < b ? ((uint64_t)a << 32 | b) : ((uint64_t)b << 32 | a);
+                edgeUses[key]++;
+            }
+        }
+
+        std::vector<bool> locked(positionCount, false);
+        for (size_t p = 0; p < positionCount; p++) {
+            locked[p] = wedgeCount[p] > 1;
+        }
+        for (std::unordered_map<uint64_t, GLuint>::const_iterator edge = edgeUses.begin(); edge != edgeUses.end(); ++edge) {
+
+            if (edge->second == 1) {
+
+                locked[(GLuint)(edge->first >> 32)] = true;
+                locked[(GLuint)(edge->first & 0xffffffff)] = true;
+            }
+        }
+
+        // every position starts with the planes of the triangles around it
+        std::vector<Quadric> quadrics(positionCount);
+        for (size_t p = 0; p < positionCount; p++) {
+            quadrics[p].Clear();
+        }
+        for (size_t i = 0; i < indexCount; i += 3) {
+
+            const glm::vec3& p0 = vertices[indices[i + 0]].Position;
+            const glm::vec3& p1 = vertices[indices[i + 1]].Position;
+            const glm::vec3& p2 = vertices[indices[i + 2]].Position;
+
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            float length = glm::length(normal);
+            if (length == 0.0f) {
+                continue;
+            }
+            normal /= length;
+
+            Quadric plane;
+            plane.Clear();
+            plane.AddPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+
+            for (int k = 0; k < 3; k++) {
+                quadrics[positionIds[indices[i + k]]].Add(plane);
+            }
+        }
+
+        double maxCost = (double)maxError * maxError;
+        double resultCost = 0.0;
+
+        std::vector<Collapse> collapses;
+        std::vector<size_t> adjacencyOffset;
+        std::vector<GLuint> adjacency;
+        std::vector<GLuint> remap(vertexCount);
+        std::vector<bool> touched(positionCount);
+
+        // each pass collapses a set of independent edges, cheapest first
+        while (destination.size() > targetIndexCount) {
+
+            size_t triangleCount = destination.size() / 3;
+
+            // triangles around every vertex
+            adjacencyOffset.assign(vertexCount + 1, 0);
+            for (size_t i = 0; i < destination.size(); i++) {
+                adjacencyOffset[destination[i] + 1]++;
+            }
+            for (size_t v = 0; v < vertexCount; v++) {
+                adjacencyOffset[v + 1] += adjacencyOffset[v];
+            }
+            adjacency.resize(destination.size());
+            std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i = 0; i < destination.size(); i++) {
+                adjacency[fill[destination[i]]++] = (GLuint)(i / 3);
+            }
+
+            collapses.clear();
+            for (size_t i = 0; i < destination.size(); i += 3) {
+                for (int k = 0; k < 3; k++) {
+
+                    GLuint from = destination[i + k];
+                    GLuint to = destination[i + (k + 1) % 3];
+                    if (locked[positionIds[from]] || positionIds[from] == positionIds[to]) {
+                        continue;
+                    }
+
+                    Quadric quadric = quadrics[positionIds[from]];
+                    quadric.Add(quadrics[positionIds[to]]);
+
+                    Collapse collapse;
+                    collapse.from = from;
+                    collapse.to = to;
+                    collapse.cost = quadric.Evaluate(vertices[to].Position);
+                    collapses.push_back(collapse);
+                }
+            }
+
+            if (collapses.empty()) {
+                break;
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& first, const Collapse& second) {
+                return first.cost < second.cost;
+            });
+
+            for (size_t v = 0; v < vertexCount; v++) {
+                remap[v] = (GLuint)v;
+            }
+            std::fill(touched.begin(), touched.end(), false);
+
+            // a collapse removes about two triangles
+            size_t wanted = (triangleCount - targetIndexCount / 3 + 1) / 2;
+            size_t collapsed = 0;
+
+            for (size_t c = 0; c < collapses.size() && collapsed < wanted; c++) {
+
+                const Collapse& collapse = collapses[c];
+                if (collapse.cost > maxCost) {
+                    break;
+                }
+                if (touched[positionIds[collapse.from]] || touched[positionIds[collapse.to]]) {
+                    continue;
+                }
+
+                // reject collapses that would fold a surviving triangle over
+                const glm::vec3& target = vertices[collapse.to].Position;
+                bool flips = false;
+
+                for (size_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1] && !flips; a++) {
+
+                    const GLuint* triangle = &destination[adjacency[a] * 3];
+                    if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                        continue;
+                    }
+
+                    glm::vec3 before[3];
+                    glm::vec3 after[3];
+                    for (int k = 0; k < 3; k++) {
+
+                        before[k] = vertices[triangle[k]].Position;
+                        after[k] = triangle[k] == collapse.from ? target : before[k];
+                    }
+
+                    glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                    glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                    flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+                }
+                if (flips) {
+                    continue;
+                }
+
+                remap[collapse.from] = collapse.to;
+                quadrics[positionIds[collapse.to]].Add(quadrics[positionIds[collapse.from]]);
+                resultCost = std::max(resultCost, collapse.cost);
+                collapsed++;
+
+                // the neighbourhood changed, leave it alone until the next pass
+                for (size_t a = adjacencyOffset[collapse.from]; a < adjacencyOffset[collapse.from + 1]; a++) {
+
+                    const GLuint* triangle = &destination[adjacency[a] * 3];
+                    for (int k = 0; k < 3; k++) {
+                        touched[positionIds[triangle[k]]] = true;
+                    }
+                }
+            }
+
+            if (collapsed == 0) {
+                break;
+            }
+
+            // apply the collapses and drop the triangles that became degenerate
+            size_t written = 0;
+            for (size_t i = 0; i < destination.size(); i += 3) {
+
+                GLuint a = remap[destination[i + 0]];
+                GLuint b = remap[destination[i + 1]];
+                GLuint c = remap[destination[i + 2]];
+
+                if (a == b || b == c || a == c) {
+                    continue;
+                }
+                destination[written++] = a;
+                destination[written++] = b;
+                destination[written++] = c;
+            }
+            destination.resize(written);
+        }
+
+        return (float)sqrt(resultCost);
+    }
+
+    void MeshSimplifier::BuildLodChain(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<MeshLod>& lods) {
+
+        lods.clear();
+
+        MeshLod full;
+        full.indexOffset = 0;
+        full.indexCount = (uint32_t)indices.size();
+        full.error = 0.0f;
+        lods.push_back(full);
+
+        size_t fullCount = indices.size();
+        std::vector<GLuint> simplified;
+        std::vector<GLuint> ordered;
+        std::vector<size_t> clusters;
+
+        for (size_t level = 1; level <= LOD_LEVEL_COUNT; level++) {
+
+            // every level starts from the full mesh so its error is measured against the original surface
+            size_t target = (fullCount >> level) / 3 * 3;
+            float error = Simplify(vertices.data(), vertices.size(), indices.data(), fullCount, target, 1e30f, simplified);
+
+            // locked borders and seams stop small or fragmented meshes early, such a level would gain nothing
+            if (simplified.empty() || simplified.size() * 10 > lods.back().indexCount * 9) {
+                break;
+            }
+
+            ordered.resize(simplified.size());
+            MeshOptimizer::OptimizeVertexCache(simplified.data(), simplified.size(), vertices.size(), VERTEX_CACHE_SIZE, ordered.data(), clusters);
+
+            MeshLod lod;
+            lod.indexOffset = (uint32_t)indices.size();
+            lod.indexCount = (uint32_t)ordered.size();
+            lod.error = error;
+            lods.push_back(lod);
+
+            indices.insert(indices.end(), ordered.begin(), ordered.end());
+        }
+    }
+}
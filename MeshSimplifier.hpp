@@ -0,0 +1,33 @@
+#ifndef MeshSimplifier_hpp
+#define MeshSimplifier_hpp
+
+#include "Mesh.hpp"
+
+#include <stddef.h>
+#include <vector>
+
+namespace gps {
+
+    // Number of simplified levels built below the full mesh
+    const size_t LOD_LEVEL_COUNT = 3;
+
+    // Quadric error mesh simplification producing index-only LODs
+    //
+    // Edges are collapsed onto one of their endpoints (Garland and Heckbert
+    // quadrics, no new vertices), so every level indexes the vertex buffer of
+    // the full mesh. Vertices on open borders and on UV/normal seams never
+    // move, which keeps neighbouring shapes and texture islands closed.
+    class MeshSimplifier {
+
+    public:
+        // Collapses edges until at most targetIndexCount indices remain or the next collapse would cost more than maxError
+        // Returns the object space error of the result
+        static float Simplify(const Vertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, size_t targetIndexCount, float maxError, std::vector<GLuint>& destination);
+
+        // Appends up to LOD_LEVEL_COUNT levels, each with half the triangles of the previous, behind the full index list
+        // lods receives every level, the full mesh first
+        static void BuildLodChain(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<MeshLod>& lods);
+    };
+}
+
+#endif /* MeshSimplifier_hpp */
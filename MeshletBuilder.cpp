@@ -0,0 +1,247 @@
+#include "MeshletBuilder.hpp"
+#include "MeshOptimizer.hpp"
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+
+namespace gps {
+
+    // Unit face normal, zero for degenerate triangles
+    static glm::vec3 FaceNormal(const Vertex* vertices, const GLuint* triangle) {
+
+        const glm::vec3& p0 = vertices[triangle[0]].Position;
+        const glm::vec3& p1 = vertices[triangle[1]].Position;
+        const glm::vec3& p2 = vertices[triangle[2]].Position;
+
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3(0.0f);
+    }
+
+    void MeshletBuilder::Build(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<Meshlet>& meshlets) {
+
+        meshlets.clear();
+
+        size_t triangleCount = indices.size() / 3;
+        size_t vertexCount = vertices.size();
+        if (triangleCount == 0 || vertexCount == 0) {
+            return;
+        }
+
+        // triangles around every vertex, packed in one array
+        std::vector<size_t> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            adjacencyOffset[indices[i] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        }
+        std::vector<GLuint> adjacency(triangleCount * 3);
+        std::vector<size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            adjacency[fill[indices[i]]++] = (GLuint)(i / 3);
+        }
+
+        std::vector<glm::vec3> faceNormals(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            faceNormals[t] = FaceNormal(vertices.data(), &indices[t * 3]);
+        }
+
+        const GLuint unused = (GLuint)-1;
+        // slot of every vertex in the meshlet being built
+        std::vector<GLuint> localIndex(vertexCount, unused);
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<GLuint> meshletVertices;
+        std::vector<GLuint> meshletTriangles;
+        std::vector<GLuint> localIndices;
+        std::vector<GLuint> localOrdered;
+        std::vector<size_t> clusters;
+        std::vector<GLuint> ordered;
+        ordered.reserve(triangleCount * 3);
+
+        size_t seed = 0;
+
+        while (true) {
+
+            // seeds follow the incoming order, which keeps the overdraw order roughly intact
+            while (seed < triangleCount && emitted[seed]) {
+                seed++;
+            }
+            if (seed == triangleCount) {
+                break;
+            }
+
+            meshletVertices.clear();
+            meshletTriangles.clear();
+            glm::vec3 normalSum(0.0f);
+            size_t last = seed;
+
+            while (true) {
+
+                emitted[last] = true;
+                meshletTriangles.push_back((GLuint)last);
+                normalSum += faceNormals[last];
+
+                for (int k = 0; k < 3; k++) {
+
+                    GLuint vertex = indices[last * 3 + k];
+                    if (localIndex[vertex] == unused) {
+
+                        localIndex[vertex] = (GLuint)meshletVertices.size();
+                        meshletVertices.push_back(vertex);
+                    }
+                }
+
+                if (meshletTriangles.size() >= MESHLET_MAX_TRIANGLES) {
+                    break;
+                }
+
+                float normalLength = glm::length(normalSum);
+                glm::vec3 axis = normalLength > 0.0f ? normalSum / normalLength : glm::vec3(0.0f);
+
+                // neighbours of the last triangle first, the whole meshlet once those are used up
+                long best = -1;
+                float bestScore = FLT_MAX;
+
+                for (int pass = 0; pass < 2 && best < 0; pass++) {
+
+                    const GLuint* candidates = pass == 0 ? &indices[last * 3] : meshletVertices.data();
+                    size_t candidateCount = pass == 0 ? 3 : meshletVertices.size();
+
+                    for (size_t c = 0; c < candidateCount; c++) {
+                        for (size_t a = adjacencyOffset[candidates[c]]; a < adjacencyOffset[candidates[c] + 1]; a++) {
+
+                            GLuint triangle = adjacency[a];
+                            if (emitted[triangle]) {
+                                continue;
+                            }
+
+                            size_t newVertices = 0;
+                            for (int k = 0; k < 3; k++) {
+                                newVertices += localIndex[indices[triangle * 3 + k]] == unused ? 1 : 0;
+                            }
+                            if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES) {
+                                continue;
+                            }
+
+                            // few new vertices keep the sphere small, a matching normal keeps the cone narrow
+                            float score = (float)newVertices + (1.0f - glm::dot(axis, faceNormals[triangle]));
+                            if (score < bestScore) {
+
+                                bestScore = score;
+                                best = triangle;
+                            }
+                        }
+                    }
+                }
+
+                // a piece of its own (a leaf, a pane) joins the meshlet with whatever follows it in the incoming order
+                while (best < 0 && seed < triangleCount) {
+
+                    if (!emitted[seed]) {
+
+                        size_t newVertices = 0;
+                        for (int k = 0; k < 3; k++) {
+                            newVertices += localIndex[indices[seed * 3 + k]] == unused ? 1 : 0;
+                        }
+                        if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES) {
+                            break;
+                        }
+                        best = (long)seed;
+                    }
+                    seed++;
+                }
+
+                if (best < 0) {
+                    break;
+                }
+                last = (size_t)best;
+            }
+
+            // Tipsify inside the meshlet, on indices local to it so the cost stays proportional to its size
+            localIndices.clear();
+            for (size_t t = 0; t < meshletTriangles.size(); t++) {
+                for (int k = 0; k < 3; k++) {
+                    localIndices.push_back(localIndex[indices[meshletTriangles[t] * 3 + k]]);
+                }
+            }
+            localOrdered.resize(localIndices.size());
+            MeshOptimizer::OptimizeVertexCache(localIndices.data(), localIndices.size(), meshletVertices.size(), VERTEX_CACHE_SIZE, localOrdered.data(), clusters);
+
+            Meshlet meshlet;
+            meshlet.indexOffset = (uint32_t)ordered.size();
+            meshlet.indexCount = (uint32_t)localOrdered.size();
+            meshlets.push_back(meshlet);
+
+            for (size_t i = 0; i < localOrdered.size(); i++) {
+                ordered.push_back(meshletVertices[localOrdered[i]]);
+            }
+            for (size_t v = 0; v < meshletVertices.size(); v++) {
+                localIndex[meshletVertices[v]] = unused;
+            }
+        }
+
+        indices.swap(ordered);
+
+        for (size_t m = 0; m < meshlets.size(); m++) {
+            ComputeBounds(vertices.data(), indices.data(), meshlets[m]);
+        }
+    }
+
+    // The cone test follows meshoptimizer: a meshlet is back-facing when its
+    // sphere lies entirely in the region behind every plane the cone allows
+    void MeshletBuilder::ComputeBounds(const Vertex* vertices, const GLuint* indices, Meshlet& meshlet) {
+
+        const GLuint* first = indices + meshlet.indexOffset;
+        size_t count = meshlet.indexCount;
+
+        meshlet.center = glm::vec3(0.0f);
+        meshlet.radius = 0.0f;
+        meshlet.coneAxis = glm::vec3(0.0f);
+        meshlet.coneCutoff = 1.0f;
+
+        if (count < 3) {
+            return;
+        }
+
+        glm::vec3 boundsMin = vertices[first[0]].Position;
+        glm::vec3 boundsMax = boundsMin;
+        for (size_t i = 1; i < count; i++) {
+
+            boundsMin = glm::min(boundsMin, vertices[first[i]].Position);
+            boundsMax = glm::max(boundsMax, vertices[first[i]].Position);
+        }
+
+        meshlet.center = (boundsMin + boundsMax) * 0.5f;
+        for (size_t i = 0; i < count; i++) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(vertices[first[i]].Position - meshlet.center));
+        }
+
+        glm::vec3 normalSum(0.0f);
+        for (size_t i = 0; i + 2 < count; i += 3) {
+            normalSum += FaceNormal(vertices, first + i);
+        }
+        float normalLength = glm::length(normalSum);
+        if (normalLength == 0.0f) {
+            return;
+        }
+        meshlet.coneAxis = normalSum / normalLength;
+
+        float minimumDot = 1.0f;
+        for (size_t i = 0; i + 2 < count; i += 3) {
+
+            glm::vec3 normal = FaceNormal(vertices, first + i);
+            if (normal != glm::vec3(0.0f)) {
+                minimumDot = std::min(minimumDot, glm::dot(normal, meshlet.coneAxis));
+            }
+        }
+
+        // a cone wider than about 84 degrees would almost never cull, keep it out of the test
+        if (minimumDot > 0.1f) {
+            meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+        }
+    }
+}
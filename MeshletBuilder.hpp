@@ -0,0 +1,33 @@
+#ifndef MeshletBuilder_hpp
+#define MeshletBuilder_hpp
+
+#include "Mesh.hpp"
+
+#include <stddef.h>
+#include <vector>
+
+namespace gps {
+
+    // Limits of one meshlet, the sizes mesh shading hardware is built around
+    const size_t MESHLET_MAX_VERTICES = 64;
+    const size_t MESHLET_MAX_TRIANGLES = 124;
+
+    // Splits a triangle list into meshlets the CPU can cull one by one
+    //
+    // A meshlet grows from the first free triangle of the current order by
+    // adding neighbouring triangles that bring in few new vertices and face
+    // the same way as the ones already in, so the bounding spheres stay small
+    // and the normal cones narrow. The triangles are then stored meshlet by
+    // meshlet, each one Tipsify ordered, so a meshlet is one run of indices.
+    class MeshletBuilder {
+
+    public:
+        // Reorders the triangles of indices into meshlets, meshlets receives their runs and bounds
+        static void Build(const std::vector<Vertex>& vertices, std::vector<GLuint>& indices, std::vector<Meshlet>& meshlets);
+
+        // Bounding sphere and normal cone of the triangles of a meshlet
+        static void ComputeBounds(const Vertex* vertices, const GLuint* indices, Meshlet& meshlet);
+    };
+}
+
+#endif /* MeshletBuilder_hpp */
@@ -1,256 +1,564 @@
 #include "Model3D.hpp"
 
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
 namespace gps {
 
+	// Screen space error allowed for a level of detail, in pixels
+	static const float LOD_PIXEL_ERROR = 1.0f;
+	// A coarser level is only taken once its error drops this far under the limit, so levels do not flicker
+	static const float LOD_HYSTERESIS = 0.75f;
+
+	glm::vec3 Model3D::lodCameraPosition(0.0f);
+	float Model3D::lodPixelScale = 0.0f;
+	bool Model3D::lodEnabled = true;
+
+	glm::mat4 Model3D::cullViewProjection(1.0f);
+	glm::vec4 Model3D::cullViewPoint(0.0f, 0.0f, 0.0f, 1.0f);
+	bool Model3D::cullViewSet = false;
+	bool Model3D::cullingEnabled = true;
+	bool Model3D::faceCulling = true;
+
+	LodState::LodState() {
+
+		inverseValid = false;
+	}
+
+	Model3D::Model3D() {
+
+		cpuGeometry = CPU_GEOMETRY_KEEP;
+	}
+
+	void Model3D::SetCpuGeometry(CpuGeometry cpuGeometry) {
+
+		this->cpuGeometry = cpuGeometry;
+	}
+
 	void Model3D::LoadModel(std::string fileName) {
 
         std::string basePath = fileName.substr(0, fileName.find_last_of('/')) + "/";
-		ReadOBJ(fileName, basePath);
+		LoadModel(fileName, basePath);
 	}
 
     void Model3D::LoadModel(std::string fileName, std::string basePath)	{
 
-		ReadOBJ(fileName, basePath);
+		Prepare(fileName, basePath);
+		Upload();
 	}
 
-	// Draw each mesh from the model
-	void Model3D::Draw(gps::Shader shaderProgram) {
+	// CPU half of loading - parses the model or maps its cache, safe on a worker thread
+	void Model3D::Prepare(std::string fileName, std::string basePath) {
 
-		for (int i = 0; i < meshes.size(); i++)
-			meshes[i].Draw(shaderProgram);
-	}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-	// Does the parsing of the .obj file and fills in the data structure
-	void Model3D::ReadOBJ(std::string fileName, std::string basePath) {
+		preparedFileName = fileName;
+		// textures resolve against the base path, so the same file loaded from elsewhere is another model
+		preparedAssetName = fileName + "#" + basePath;
+		prepareFailed = false;
+		sourceHash = 0;
+		materialHash = 0;
+		meshHash = 0;
+		preparedTextures.clear();
+		loadStats.cacheHit = false;
+		loadStats.baked = false;
+		loadStats.gltf = false;
 
-        std::cout << "Loading : " << fileName << std::endl;
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		int materialId;
+		// a model already on the GPU is not read again
+		asset = std::static_pointer_cast<ModelAsset>(AssetRegistry::GetShared().Find(ASSET_MESH, preparedAssetName));
+		loadStats.shared = asset != NULL;
 
-		std::string err;
-		bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, fileName.c_str(), basePath.c_str(), GL_TRUE);
+		if (!loadStats.shared) {
 
-		if (!err.empty()) {
+			// glTF buffers are already in the layout the GL takes, a cache would only copy them
+			loadStats.gltf = fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, ".glb") == 0;
+			if (loadStats.gltf) {
 
-			// `err` may contain warning message.
-			std::cerr << err << std::endl;
+				ReadGLB(fileName, basePath);
+				if (prepareFailed) {
+					return;
+				}
+			} else {
+
+				loadStats.cacheHit = ReadCache(fileName);
+				if (!loadStats.cacheHit) {
+
+					ReadOBJ(fileName, basePath);
+					if (prepareFailed) {
+						return;
+					}
+					WriteCache(fileName);
+				}
+			}
+
+			// float meshes are packed against the bounds of the whole model, not their own
+			packing = MeshBuilder::GetPacking(preparedMeshes);
+
+			// a copy of the .obj with other materials, or resolving its textures elsewhere, does not share the meshes
+			if (sourceHash != 0) {
+				meshHash = sourceHash * 31 + materialHash;
+				meshHash = meshHash * 31 + std::hash<std::string>()(basePath);
+			}
+
+			PrepareTextures();
 		}
 
-		if (!ret) {
+		loadStats.loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
 
-			exit(1);
+	// Orders the meshes by the textures they sample so each material is bound once per draw
+	static bool CompareMaterials(const gps::Mesh& first, const gps::Mesh& second) {
+
+		size_t count = std::min(first.textures.size(), second.textures.size());
+		for (size_t i = 0; i < count; i++) {
+
+			if (first.textures[i].id != second.textures[i].id) {
+				return first.textures[i].id < second.textures[i].id;
+			}
 		}
+		return first.textures.size() < second.textures.size();
+	}
 
-		std::cout << "# of shapes    : " << shapes.size() << std::endl;
-		std::cout << "# of materials : " << materials.size() << std::endl;
+	// GL half of loading - creates the buffers and starts streaming the textures, must run on the context thread
+	void Model3D::Upload() {
 
-		// Loop over shapes
-		for (size_t s = 0; s < shapes.size(); s++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-			std::vector<gps::Vertex> vertices;
-			std::vector<GLuint> indices;
-			std::vector<gps::Texture> textures;
+		std::cout << loadLog.str();
+		loadLog.str("");
 
-			// Loop over faces(polygon)
-			size_t index_offset = 0;
-			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
+		if (prepareFailed) {
+			exit(1);
+		}
 
-				int fv = shapes[s].mesh.num_face_vertices[f];
+		// another model of the batch may have uploaded the same file (or an identical copy) meanwhile
+		if (!asset) {
+			asset = std::static_pointer_cast<ModelAsset>(AssetRegistry::GetShared().Find(ASSET_MESH, preparedAssetName, meshHash));
+			loadStats.shared = asset != NULL;
+		}
 
-				//gps::Texture currentTexture = LoadTexture("index1.png", "ambientTexture");
-				//textures.push_back(currentTexture);
+		if (!loadStats.shared) {
 
-				// Loop over vertices in the face.
-				for (size_t v = 0; v < fv; v++) {
+			asset = std::make_shared<ModelAsset>();
 
-					// access to vertex
-					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+			size_t packedCount = 0;
+			size_t vertexCount = 0;
+			size_t vertexBytes = 0;
+			size_t floatBytes = 0;
+			size_t indexBytes = 0;
+			size_t wideIndexBytes = 0;
 
-					float vx = attrib.vertices[3 * idx.vertex_index + 0];
-					float vy = attrib.vertices[3 * idx.vertex_index + 1];
-					float vz = attrib.vertices[3 * idx.vertex_index + 2];
-					float nx = attrib.normals[3 * idx.normal_index + 0];
-					float ny = attrib.normals[3 * idx.normal_index + 1];
-					float nz = attrib.normals[3 * idx.normal_index + 2];
-					float tx = 0.0f;
-					float ty = 0.0f;
+			for (size_t i = 0; i < preparedMeshes.size(); i++) {
 
-					if (idx.texcoord_index != -1) {
+				PreparedMesh& preparedMesh = preparedMeshes[i];
 
-						tx = attrib.texcoords[2 * idx.texcoord_index + 0];
-						ty = attrib.texcoords[2 * idx.texcoord_index + 1];
-					}
+				std::vector<gps::Texture> textures;
+				for (size_t t = 0; t < preparedMesh.textures.size(); t++) {
+					textures.push_back(LoadTexture(preparedMesh.textures[t].path, preparedMesh.textures[t].type, preparedMesh.flipTextures));
+				}
+
+				// taken while the prepared data is still there, the mesh may move it away
+				std::vector<glm::vec3> positions;
+				std::vector<GLuint> fullIndices;
+				if (cpuGeometry == CPU_GEOMETRY_POSITIONS) {
+					MeshBuilder::GetPositions(preparedMesh, positions, fullIndices);
+				}
+
+				if (preparedMesh.hasStreams) {
 
-					glm::vec3 vertexPosition(vx, vy, vz);
-					glm::vec3 vertexNormal(nx, ny, nz);
-					glm::vec2 vertexTexCoords(tx, ty);
+					// the glTF buffers go to the GL as they are in the file
+					asset->meshes.push_back(gps::Mesh(preparedMesh.streams, std::move(textures)));
+				} else if (!preparedMesh.vertices.empty()) {
 
-					gps::Vertex currentVertex;
-					currentVertex.Position = vertexPosition;
-					currentVertex.Normal = vertexNormal;
-					currentVertex.TexCoords = vertexTexCoords;
+					// the parsed arrays are moved, not copied, into the mesh
+					asset->meshes.push_back(gps::Mesh(std::move(preparedMesh.vertices), std::move(preparedMesh.indices), std::move(textures), std::move(preparedMesh.lods), std::move(preparedMesh.meshlets), &packing));
+				} else if (preparedMesh.packedVertexData) {
 
-					vertices.push_back(currentVertex);
+					// the cache holds the vertices already quantized, they go to the GL as they are
+					asset->meshes.push_back(gps::Mesh(preparedMesh.packedVertexData, preparedMesh.vertexCount, preparedMesh.rangeMin, preparedMesh.rangeMax, preparedMesh.boundsMin, preparedMesh.boundsMax,
+						preparedMesh.indexData, preparedMesh.indexCount, std::move(textures), std::move(preparedMesh.lods), std::move(preparedMesh.meshlets)));
+				} else {
 
-					indices.push_back((GLuint)(index_offset + v));
+					// the decoded cache arrays go straight to the GL buffers
+					asset->meshes.push_back(gps::Mesh(preparedMesh.vertexData, preparedMesh.vertexCount, preparedMesh.indexData, preparedMesh.indexCount, std::move(textures), std::move(preparedMesh.lods), std::move(preparedMesh.meshlets), &packing));
 				}
 
-				index_offset += fv;
+				gps::Mesh& mesh = asset->meshes.back();
+				if (cpuGeometry == CPU_GEOMETRY_POSITIONS) {
+
+					mesh.positions = std::move(positions);
+					mesh.indices = std::move(fullIndices);
+				}
+				mesh.ReleaseCpuGeometry(cpuGeometry);
+
+				size_t meshVertexCount = preparedMesh.hasStreams ? preparedMesh.streams.vertexCount : preparedMesh.vertexCount;
+				size_t meshIndexCount = preparedMesh.hasStreams ? preparedMesh.streams.indexCount : preparedMesh.indexCount;
+
+				// counted against a full float copy, what a parsed mesh holds when it keeps everything
+				size_t fullCpuBytes = meshVertexCount * sizeof(gps::Vertex) + meshIndexCount * sizeof(GLuint);
+				asset->cpuBytes += mesh.GetCpuBytes();
+				asset->savedCpuBytes += fullCpuBytes > mesh.GetCpuBytes() ? fullCpuBytes - mesh.GetCpuBytes() : 0;
+				asset->gpuBytes += mesh.GetGpuBytes();
+				vertexBytes += mesh.GetVertexBytes();
+				indexBytes += mesh.GetIndexBytes();
+				floatBytes += meshVertexCount * sizeof(gps::Vertex);
+				wideIndexBytes += meshIndexCount * sizeof(GLuint);
+				vertexCount += meshVertexCount;
+				if (mesh.GetVertexFormat() == VERTEX_FORMAT_PACKED) {
+					packedCount++;
+				}
 			}
 
-			// get material id
-			// Only try to read materials if the .mtl file is present
-			size_t a = shapes[s].mesh.material_ids.size();
+			std::stable_sort(asset->meshes.begin(), asset->meshes.end(), CompareMaterials);
+
+			// models with UVs beyond what half floats hold keep 32 byte vertices
+			std::cout << "Vertex buffers of " << preparedFileName << " : " << packedCount << " of " << asset->meshes.size() << " meshes packed, "
+				<< floatBytes / 1024 << " KB -> " << vertexBytes / 1024 << " KB ("
+				<< (vertexCount > 0 ? (double)vertexBytes / vertexCount : 0.0) << " bytes per vertex), indices "
+				<< wideIndexBytes / 1024 << " KB -> " << indexBytes / 1024 << " KB, CPU geometry "
+				<< asset->cpuBytes / 1024 << " KB (" << asset->savedCpuBytes / 1024 << " KB less than a full copy)" << std::endl;
 
-			if (a > 0 && materials.size()>0) {
+			AssetRegistry::GetShared().Add(ASSET_MESH, preparedAssetName, meshHash, asset);
+		}
+		preparedMeshes.clear();
+		preparedTextures.clear();
+		cache.Close();
+		gltfReader.Close();
+
+		loadStats.loadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Loaded " << preparedFileName << " in " << loadStats.loadMilliseconds << " ms ("
+			<< (loadStats.shared ? "shared" : loadStats.gltf ? "glb" : loadStats.baked ? "baked" : loadStats.cacheHit ? "cache hit" : "cache miss") << ")" << std::endl;
+	}
 
-				materialId = shapes[s].mesh.material_ids[0];
-				if (materialId != -1) {
+	ModelLoadStats Model3D::GetLoadStats() {
 
-					gps::Material currentMaterial;
-					currentMaterial.ambient = glm::vec3(materials[materialId].ambient[0], materials[materialId].ambient[1], materials[materialId].ambient[2]);
-					currentMaterial.diffuse = glm::vec3(materials[materialId].diffuse[0], materials[materialId].diffuse[1], materials[materialId].diffuse[2]);
-					currentMaterial.specular = glm::vec3(materials[materialId].specular[0], materials[materialId].specular[1], materials[materialId].specular[2]);
+		return loadStats;
+	}
 
-					//ambient texture
-					std::string ambientTexturePath = materials[materialId].ambient_texname;
+	// Draw each mesh from the model
+	void Model3D::Draw(const gps::Shader& shaderProgram) {
 
-					if (!ambientTexturePath.empty()) {
+		DrawMeshes(shaderProgram, NULL, NULL);
+	}
 
-						gps::Texture currentTexture;
-						currentTexture = LoadTexture(basePath + ambientTexturePath, "ambientTexture");
-						textures.push_back(currentTexture);
-					}
+	void Model3D::Draw(const gps::Shader& shaderProgram, const glm::mat4& modelMatrix) {
 
-					//diffuse texture
-					std::string diffuseTexturePath = materials[materialId].diffuse_texname;
+		Draw(shaderProgram, modelMatrix, lodState);
+	}
 
-					if (!diffuseTexturePath.empty()) {
+	void Model3D::Draw(const gps::Shader& shaderProgram, const glm::mat4& modelMatrix, LodState& lodState) {
 
-						gps::Texture currentTexture;
-						currentTexture = LoadTexture(basePath + diffuseTexturePath, "diffuseTexture");
-						textures.push_back(currentTexture);
-					}
+		CullView cullView;
+		bool culling = cullingEnabled && cullViewSet;
+		if (culling) {
+			BuildCullView(modelMatrix, lodState, cullView);
+		}
 
-					//specular texture
-					std::string specularTexturePath = materials[materialId].specular_texname;
+		if (!asset || !lodEnabled) {
+			DrawMeshes(shaderProgram, NULL, culling ? &cullView : NULL);
+			return;
+		}
 
-					if (!specularTexturePath.empty()) {
+		SelectLods(modelMatrix, lodState);
+		DrawMeshes(shaderProgram, lodState.levels.data(), culling ? &cullView : NULL);
+	}
 
-						gps::Texture currentTexture;
-						currentTexture = LoadTexture(basePath + specularTexturePath, "specularTexture");
-						textures.push_back(currentTexture);
-					}
-				}
+	void Model3D::SetLodView(glm::vec3 cameraPosition, const glm::mat4& projection, int viewportHeight) {
+
+		lodCameraPosition = cameraPosition;
+		// projection[1][1] is cot(fov / 2), half the viewport spans tan(fov / 2) at distance 1
+		lodPixelScale = projection[1][1] * viewportHeight * 0.5f;
+	}
+
+	void Model3D::SetLodEnabled(bool enabled) {
+
+		lodEnabled = enabled;
+	}
+
+	bool Model3D::IsLodEnabled() {
+
+		return lodEnabled;
+	}
+
+	void Model3D::SetCullView(const glm::mat4& viewProjection, glm::vec4 viewPoint) {
+
+		cullViewProjection = viewProjection;
+		cullViewPoint = viewPoint;
+		cullViewSet = true;
+	}
+
+	void Model3D::SetCullingEnabled(bool enabled) {
+
+		cullingEnabled = enabled;
+	}
+
+	bool Model3D::IsCullingEnabled() {
+
+		return cullingEnabled;
+	}
+
+	void Model3D::SetFaceCulling(bool enabled) {
+
+		if (enabled) {
+			glEnable(GL_CULL_FACE);
+		} else {
+			glDisable(GL_CULL_FACE);
+		}
+		faceCulling = enabled;
+	}
+
+	// Planes taken from the clip matrix of the instance are already in its object space (Gribb and Hartmann),
+	// so spheres and cones are tested without transforming a single meshlet
+	void Model3D::BuildCullView(const glm::mat4& modelMatrix, LodState& lodState, CullView& cullView) {
+
+		glm::mat4 clip = cullViewProjection * modelMatrix;
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; r++) {
+			rows[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+		}
+
+		for (int p = 0; p < 6; p++) {
+
+			glm::vec4 plane = (p & 1) ? rows[3] - rows[p / 2] : rows[3] + rows[p / 2];
+			float length = glm::length(glm::vec3(plane));
+			cullView.planes[p] = length > 0.0f ? plane / length : plane;
+		}
+
+		// static instances invert their matrix once, not in every pass
+		if (!lodState.inverseValid || lodState.cachedModelMatrix != modelMatrix) {
+
+			lodState.cachedModelMatrix = modelMatrix;
+			lodState.inverseModelMatrix = glm::affineInverse(modelMatrix);
+			lodState.inverseValid = true;
+		}
+
+		// facing is kept by any affine transform, the cone test works in object space as it is
+		cullView.viewPoint = lodState.inverseModelMatrix * cullViewPoint;
+		// double sided geometry (the trees) is drawn with face culling off and must keep its back faces
+		cullView.backfaces = faceCulling;
+	}
+
+	void Model3D::SelectLods(const glm::mat4& modelMatrix, LodState& lodState) {
+
+		lodState.levels.resize(asset->meshes.size(), 0);
+
+		// the largest axis scale keeps the error estimate conservative
+		float scale = std::max(glm::length(glm::vec3(modelMatrix[0])), std::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+		for (size_t i = 0; i < asset->meshes.size(); i++) {
+
+			const gps::Mesh& mesh = asset->meshes[i];
+			size_t levelCount = mesh.GetLodCount();
+			if (levelCount < 2) {
+				continue;
+			}
+
+			glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(mesh.GetBoundsCenter(), 1.0f));
+			float distance = glm::length(center - lodCameraPosition) - mesh.GetBoundsRadius() * scale;
+
+			// inside the bounds every level is too coarse
+			if (distance <= 0.0f || lodPixelScale <= 0.0f) {
+				lodState.levels[i] = 0;
+				continue;
+			}
+
+			float pixelsPerUnit = lodPixelScale * scale / distance;
+			size_t level = std::min((size_t)lodState.levels[i], levelCount - 1);
+
+			while (level > 0 && mesh.GetLodError(level) * pixelsPerUnit > LOD_PIXEL_ERROR) {
+				level--;
+			}
+			while (level + 1 < levelCount && mesh.GetLodError(level + 1) * pixelsPerUnit <= LOD_PIXEL_ERROR * LOD_HYSTERESIS) {
+				level++;
 			}
 
-			meshes.push_back(gps::Mesh(vertices, indices, textures));
+			lodState.levels[i] = (unsigned char)level;
 		}
 	}
 
-	// Retrieves a texture associated with the object - by its name and type
-	gps::Texture Model3D::LoadTexture(std::string path, std::string type) {
+	// The meshes are sorted by material, textures are only bound when they change
+	void Model3D::DrawMeshes(const gps::Shader& shaderProgram, const unsigned char* levels, const CullView* cullView) {
 
-			for (int i = 0; i < loadedTextures.size(); i++) {
+		if (!asset || asset->meshes.empty()) {
+			return;
+		}
 
-				if (loadedTextures[i].path == path)	{
+		shaderProgram.useShaderProgram();
 
-					//already loaded texture
-					return loadedTextures[i];
-				}
+		const gps::Mesh* boundMesh = NULL;
+		GLuint boundCount = 0;
+
+		for (size_t i = 0; i < asset->meshes.size(); i++) {
+
+			gps::Mesh& mesh = asset->meshes[i];
+			size_t level = levels != NULL ? levels[i] : 0;
+
+			// a mesh outside the frustum does not get its material bound
+			if (cullView != NULL && mesh.CullBounds(level, *cullView)) {
+				continue;
 			}
 
-			gps::Texture currentTexture;
-			currentTexture.id = ReadTextureFromFile(path.c_str());
-			currentTexture.type = std::string(type);
-			currentTexture.path = path;
+			if (boundMesh == NULL || !mesh.HasSameTextures(*boundMesh)) {
+
+				mesh.BindTextures(shaderProgram);
 
-			loadedTextures.push_back(currentTexture);
+				// units the previous material used beyond this one's would still sample its textures
+				GLuint textureCount = (GLuint)mesh.textures.size();
+				if (boundCount > textureCount) {
+					gps::Mesh::UnbindTextures(textureCount, boundCount - textureCount);
+				}
+				boundMesh = &mesh;
+				boundCount = textureCount;
+			}
 
-			return currentTexture;
+			if (cullView != NULL) {
+				mesh.DrawElements(level, *cullView);
+			} else {
+				mesh.DrawElements(level);
+			}
 		}
 
-	// Reads the pixel data from an image file and loads it into the video memory
-	GLuint Model3D::ReadTextureFromFile(const char* file_name) {
+		gps::Mesh::UnbindTextures(0, boundCount);
+	}
+
+	// Decodes the baked mesh or the binary cache next to the .obj file, returns false on a miss
+	bool Model3D::ReadCache(std::string fileName) {
 
-		int x, y, n;
-		int force_channels = 4;
-		unsigned char* image_data = stbi_load(file_name, &x, &y, &n, force_channels);
+		// a mesh baked by gps_bake wins over the cache the loader writes itself
+		std::string bakedFileName = AssetBaker::GetBakedFileName(MeshCache::GetCacheFileName(fileName));
+		loadStats.baked = !bakedFileName.empty() && cache.Open(bakedFileName, fileName);
 
-		if (!image_data) {
-			fprintf(stderr, "ERROR: could not load %s\n", file_name);
+		if (!loadStats.baked && !cache.Open(MeshCache::GetCacheFileName(fileName), fileName)) {
 			return false;
 		}
-		// NPOT check
-		if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0) {
-			fprintf(
-				stderr, "WARNING: texture %s is not power-of-2 dimensions\n", file_name
-			);
+		sourceHash = cache.GetSourceHash();
+		materialHash = cache.GetMaterialHash();
+
+		for (size_t i = 0; i < cache.GetMeshCount(); i++) {
+
+			MeshCacheMesh cachedMesh = cache.GetMesh(i);
+
+			PreparedMesh preparedMesh;
+			preparedMesh.vertexData = cachedMesh.vertices;
+			preparedMesh.packedVertexData = cachedMesh.packedVertices;
+			preparedMesh.rangeMin = cachedMesh.rangeMin;
+			preparedMesh.rangeMax = cachedMesh.rangeMax;
+			preparedMesh.boundsMin = cachedMesh.boundsMin;
+			preparedMesh.boundsMax = cachedMesh.boundsMax;
+			preparedMesh.vertexCount = cachedMesh.vertexCount;
+			preparedMesh.indexData = cachedMesh.indices;
+			preparedMesh.indexCount = cachedMesh.indexCount;
+			preparedMesh.lods = cachedMesh.lods;
+			preparedMesh.meshlets = cachedMesh.meshlets;
+			preparedMesh.textures = cachedMesh.textures;
+			preparedMesh.flipTextures = true;
+			preparedMesh.hasStreams = false;
+
+			preparedMeshes.push_back(std::move(preparedMesh));
+		}
+
+		return true;
+	}
+
+	// Stores the freshly parsed meshes in the binary cache
+	void Model3D::WriteCache(std::string fileName) {
+
+		if (!MeshBuilder::WriteCache(MeshCache::GetCacheFileName(fileName), fileName, preparedMeshes, sourceHash, materialHash)) {
+			fprintf(stderr, "WARNING: could not write mesh cache for %s\n", fileName.c_str());
 		}
+	}
 
-		int width_in_bytes = x * 4;
-		unsigned char *top = NULL;
-		unsigned char *bottom = NULL;
-		unsigned char temp = 0;
-		int half_height = y / 2;
+	// Does the parsing of the .obj file and fills in the data structure
+	void Model3D::ReadOBJ(std::string fileName, std::string basePath) {
 
-		for (int row = 0; row < half_height; row++) {
+		// exiting is left to Upload, a worker thread must not tear the process down
+		prepareFailed = !MeshBuilder::Load(fileName, basePath, preparedMeshes, loadLog);
+	}
 
-			top = image_data + row * width_in_bytes;
-			bottom = image_data + (y - row - 1) * width_in_bytes;
+	// Maps the .glb file, its meshes point into it until Upload
+	void Model3D::ReadGLB(std::string fileName, std::string basePath) {
 
-			for (int col = 0; col < width_in_bytes; col++) {
+		prepareFailed = !gltfReader.Read(fileName, basePath, preparedMeshes, loadLog);
+		// the file is hashed like a mesh cache hashes its .obj, so identical copies share their buffers
+		sourceHash = prepareFailed ? 0 : AssetRegistry::HashFile(fileName);
+	}
 
-				temp = *top;
-				*top = *bottom;
-				*bottom = temp;
-				top++;
-				bottom++;
-			}
+	std::string Model3D::GetTextureAssetName(std::string path, bool flipVertically) {
+
+		return flipVertically ? path : path + "#top";
+	}
+
+	PreparedTexture Model3D::ReadTextureInfo(std::string path, bool flipVertically) {
+
+		PreparedTexture info;
+		// the unflipped image gets its own hash as well as its own name
+		info.contentHash = AssetRegistry::HashFile(path) ^ (flipVertically ? 0 : 0x9E3779B97F4A7C15ull);
+		info.width = 0;
+		info.height = 0;
+		info.channels = 0;
+
+		MappedFile image;
+		if (VirtualFileSystem::GetShared().Open(path, image)) {
+			stbi_info_from_memory(image.GetData(), (int)image.GetSize(), &info.width, &info.height, &info.channels);
 		}
+		return info;
+	}
+
+	void Model3D::PrepareTextures() {
 
-		GLuint textureID;
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RGBA, //GL_SRGB, //GL_SRGB, //GL_RGBA,
-			x,
-			y,
-			0,
-			GL_RGBA,
-			GL_UNSIGNED_BYTE,
-			image_data
-		);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
-
-		return textureID;
+		for (size_t i = 0; i < preparedMeshes.size(); i++) {
+			for (size_t t = 0; t < preparedMeshes[i].textures.size(); t++) {
+
+				std::string path = preparedMeshes[i].textures[t].path;
+				bool flipVertically = preparedMeshes[i].flipTextures;
+				std::string assetName = GetTextureAssetName(path, flipVertically);
+
+				// the path alone finds textures already loaded, only a new path costs reading the file
+				if (preparedTextures.count(assetName) == 0 && !AssetRegistry::GetShared().Find(ASSET_TEXTURE, assetName)) {
+					preparedTextures[assetName] = ReadTextureInfo(path, flipVertically);
+				}
+			}
+		}
 	}
 
-	Model3D::~Model3D() {
+	// Retrieves a texture associated with the object - by its name and type, shared through the registry
+	gps::Texture Model3D::LoadTexture(std::string path, std::string type, bool flipVertically) {
+
+		AssetRegistry& registry = AssetRegistry::GetShared();
+		std::string assetName = GetTextureAssetName(path, flipVertically);
+
+		std::shared_ptr<TextureAsset> texture = std::static_pointer_cast<TextureAsset>(registry.Find(ASSET_TEXTURE, assetName));
+		if (!texture) {
+
+			// read by Prepare, unless the texture was loaded then and has been released since
+			std::map<std::string, PreparedTexture>::iterator prepared = preparedTextures.find(assetName);
+			PreparedTexture info = prepared != preparedTextures.end() ? prepared->second : ReadTextureInfo(path, flipVertically);
+			texture = std::static_pointer_cast<TextureAsset>(registry.Find(ASSET_TEXTURE, assetName, info.contentHash));
+
+			if (!texture) {
 
-        for (size_t i = 0; i < loadedTextures.size(); i++) {
+				// the placeholder is bound until the image is decoded and streamed in
+				// BC1/BC3 (half a byte/one byte per pixel) or RGBA8, plus the mip chain
+				size_t gpuBytes = (size_t)info.width * info.height * 4 * 4 / 3;
+				if (TextureCache::IsFormatSupported(GL_COMPRESSED_RGB_S3TC_DXT1_EXT)) {
+					gpuBytes = (info.channels == 2 || info.channels == 4) ? gpuBytes / 4 : gpuBytes / 8;
+				}
+
+				texture = std::make_shared<TextureAsset>(TextureStreamer::GetShared().Load(path, flipVertically), gpuBytes);
+				registry.Add(ASSET_TEXTURE, assetName, info.contentHash, texture);
+			}
+		}
 
-            glDeleteTextures(1, &loadedTextures.at(i).id);
-        }
+		asset->textures.push_back(texture);
 
-        for (size_t i = 0; i < meshes.size(); i++) {
+		gps::Texture currentTexture;
+		currentTexture.id = texture->id;
+		currentTexture.type = std::string(type);
+		currentTexture.path = path;
 
-            GLuint VBO = meshes.at(i).getBuffers().VBO;
-            GLuint EBO = meshes.at(i).getBuffers().EBO;
-            GLuint VAO = meshes.at(i).getBuffers().VAO;
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
-            glDeleteVertexArrays(1, &VAO);
-        }
+		return currentTexture;
 	}
 }
@@ -3,40 +3,198 @@
 
 #include "Mesh.hpp"
 
-#include "tiny_obj_loader.h"
+#include "AssetBaker.hpp"
+#include "AssetRegistry.hpp"
+#include "GltfReader.hpp"
+#include "MeshBuilder.hpp"
+#include "MeshCache.hpp"
+#include "TextureStreamer.hpp"
+#include "VirtualFileSystem.hpp"
 #include "stb_image.h"
 
 #include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <vector>
 
 namespace gps {
 
+    // How a model was loaded, for startup profiling
+    struct ModelLoadStats {
+
+        bool cacheHit;
+        // the cache hit came from the assets baked by gps_bake
+        bool baked;
+        // read from a .glb file, which has no cache
+        bool gltf;
+        // the model was already loaded and its GL objects are shared
+        bool shared;
+        double loadMilliseconds;
+    };
+
+    // GL side of a loaded model, shared by every Model3D loading the same file
+    class ModelAsset : public Asset {
+
+    public:
+		// Component meshes - group of objects, each frees its own GL objects
+        std::vector<gps::Mesh> meshes;
+		// Associated textures, kept alive as long as the meshes use them
+        std::vector<std::shared_ptr<TextureAsset> > textures;
+    };
+
+    // What Upload needs of a texture file before creating its asset, read by Prepare on the loading thread
+    struct PreparedTexture {
+
+        uint64_t contentHash;
+        int width;
+        int height;
+        int channels;
+    };
+
+    // Levels of detail in use by one drawn instance of a model, one per mesh
+    // Kept between frames so a level only changes once the error is clearly past the threshold
+    struct LodState {
+
+        LodState();
+
+        std::vector<unsigned char> levels;
+        // model matrix the cached inverse below was computed from, the instance's matrix when it was last culled
+        glm::mat4 cachedModelMatrix;
+        // inverse of cachedModelMatrix, only recomputed once the instance moves
+        glm::mat4 inverseModelMatrix;
+        bool inverseValid;
+    };
+
     class Model3D {
 
     public:
-        ~Model3D();
+		Model3D();
+
+		// What the meshes keep in system memory after the upload, set before loading
+		// A model sharing the meshes of an earlier load gets whatever that load kept
+		void SetCpuGeometry(CpuGeometry cpuGeometry);
 
 		void LoadModel(std::string fileName);
 
 		void LoadModel(std::string fileName, std::string basePath);
 
-		void Draw(gps::Shader shaderProgram);
+		// CPU half of loading - parses the model or maps its cache, safe on a worker thread
+		void Prepare(std::string fileName, std::string basePath);
+
+		// GL half of loading - creates the buffers and starts streaming the textures, must run on the context thread
+		void Upload();
+
+		// Draws every mesh at full detail
+		void Draw(const gps::Shader& shaderProgram);
+
+		// Draws each mesh at the coarsest level whose error stays under a pixel on screen
+		// Models drawn several times per frame pass one state per instance
+		void Draw(const gps::Shader& shaderProgram, const glm::mat4& modelMatrix);
+		void Draw(const gps::Shader& shaderProgram, const glm::mat4& modelMatrix, LodState& lodState);
+
+		// Camera the levels of detail are chosen for, set once per frame
+		static void SetLodView(glm::vec3 cameraPosition, const glm::mat4& projection, int viewportHeight);
+
+		// Disabled, every Draw uses the full meshes
+		static void SetLodEnabled(bool enabled);
+		static bool IsLodEnabled();
+
+		// Frustum and eye meshes and meshlets are culled against, set before every pass
+		// viewPoint is the eye, or for orthographic views (w = 0) the direction towards it
+		static void SetCullView(const glm::mat4& viewProjection, glm::vec4 viewPoint);
+
+		// Disabled, every mesh and meshlet is drawn
+		static void SetCullingEnabled(bool enabled);
+		static bool IsCullingEnabled();
+
+		// Turns GL_CULL_FACE on or off and remembers it, back-facing meshlets are only dropped while it is on
+		// Toggling it through the GL directly leaves the meshlet culling out of step
+		static void SetFaceCulling(bool enabled);
+
+		ModelLoadStats GetLoadStats();
 
     private:
-		// Component meshes - group of objects
-        std::vector<gps::Mesh> meshes;
-		// Associated textures
-        std::vector<gps::Texture> loadedTextures;
+		// Meshes and textures, possibly shared with other models
+        std::shared_ptr<ModelAsset> asset;
+
+		ModelLoadStats loadStats;
+
+		CpuGeometry cpuGeometry;
+
+		// levels for callers that draw this model once per frame
+		LodState lodState;
+
+		static glm::vec3 lodCameraPosition;
+		// pixels covered by one world unit at distance 1
+		static float lodPixelScale;
+		static bool lodEnabled;
+
+		static glm::mat4 cullViewProjection;
+		static glm::vec4 cullViewPoint;
+		// nothing is culled before the first SetCullView
+		static bool cullViewSet;
+		static bool cullingEnabled;
+		static bool faceCulling;
+
+		// State handed from Prepare to Upload
+		std::string preparedFileName;
+		bool prepareFailed;
+		std::vector<PreparedMesh> preparedMeshes;
+		// what the float meshes are packed with, one grid for the whole model
+		VertexPacking packing;
+		// registry name of the meshes, the file and the base path its textures are resolved against
+		std::string preparedAssetName;
+		// content hash of the .obj file, 0 if unknown
+		uint64_t sourceHash;
+		// combined content hash of its material libraries
+		uint64_t materialHash;
+		// source, material libraries and base path together, what identical models share their meshes by
+		uint64_t meshHash;
+		// textures not loaded yet when Prepare ran, by asset name
+		std::map<std::string, PreparedTexture> preparedTextures;
+		// holds the geometry decoded from the cache until Upload
+		MeshCache cache;
+		// keeps the buffers of a .glb file mapped until Upload
+		GltfReader gltfReader;
+		// output of Prepare, printed in one piece so concurrent loads do not interleave
+		std::ostringstream loadLog;
+
+		// Decodes the baked mesh or the binary cache next to the .obj file, returns false on a miss
+		bool ReadCache(std::string fileName);
+
+		// Stores the freshly parsed meshes in the binary cache
+		void WriteCache(std::string fileName);
 
 		// Does the parsing of the .obj file and fills in the data structure
 		void ReadOBJ(std::string fileName, std::string basePath);
 
-		// Retrieves a texture associated with the object - by its name and type
-		gps::Texture LoadTexture(std::string path, std::string type);
+		// Maps the .glb file, its meshes point into it until Upload
+		void ReadGLB(std::string fileName, std::string basePath);
+
+		// Hashes and measures the texture files of the prepared meshes that are not loaded yet
+		void PrepareTextures();
+
+		// Retrieves a texture associated with the object - by its name and type, shared through the registry
+		// glTF images are stored top row first and are not flipped
+		gps::Texture LoadTexture(std::string path, std::string type, bool flipVertically);
+
+		// Registry name of a texture, an image loaded both ways is two textures
+		static std::string GetTextureAssetName(std::string path, bool flipVertically);
+
+		// Content hash and size of a texture file, full file reads that belong on the loading thread
+		static PreparedTexture ReadTextureInfo(std::string path, bool flipVertically);
+
+		// Binds each material once and draws the meshes at the given levels, or at full detail without levels
+		// With a cull view only what can be seen from it is drawn
+		void DrawMeshes(const gps::Shader& shaderProgram, const unsigned char* levels, const CullView* cullView);
+
+		// Brings the cull view into the object space of an instance at modelMatrix
+		static void BuildCullView(const glm::mat4& modelMatrix, LodState& lodState, CullView& cullView);
 
-		// Reads the pixel data from an image file and loads it into the video memory
-		GLuint ReadTextureFromFile(const char* file_name);
+		// Picks the level of every mesh for an instance at modelMatrix
+		void SelectLods(const glm::mat4& modelMatrix, LodState& lodState);
     };
 }
 
@@ -0,0 +1,408 @@
+#include "ModelBenchmark.hpp"
+#include "GltfReader.hpp"
+#include "MeshBuilder.hpp"
+#include "MeshCache.hpp"
+#include "MeshCodec.hpp"
+#include "VirtualFileSystem.hpp"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+namespace gps {
+
+    // best of a few runs, the first one also pays for the disk cache
+    static const int BENCHMARK_RUNS = 3;
+    // small models decode in microseconds, so the codec is timed over this many passes
+    static const int CODEC_PASSES = 20;
+
+    static double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    struct LoadTimes {
+
+        double prepare;
+        double upload;
+    };
+
+    static void KeepBest(LoadTimes& best, const LoadTimes& run) {
+
+        best.prepare = run.prepare < best.prepare ? run.prepare : best.prepare;
+        best.upload = run.upload < best.upload ? run.upload : best.upload;
+    }
+
+    static void PrintTimes(const char* name, const LoadTimes& times, size_t fileBytes) {
+
+        printf("  %-20s prepare %8.2f  upload %8.2f  total %8.2f ms  %8zu KB\n", name,
+            times.prepare, times.upload, times.prepare + times.upload, fileBytes / 1024);
+    }
+
+    static size_t GetFileSize(const std::string& fileName) {
+
+        FileInfo info;
+        return MappedFile::GetFileInfo(fileName, info) ? (size_t)info.size : 0;
+    }
+
+    static void AppendPadding(std::string& data, char padding) {
+
+        while (data.size() % 4 != 0) {
+            data += padding;
+        }
+    }
+
+    static void AppendUint32(std::string& data, uint32_t value) {
+
+        for (int i = 0; i < 4; i++) {
+            data += (char)((value >> (i * 8)) & 0xFF);
+        }
+    }
+
+    // Writes the full detail level of built meshes as a .glb file with interleaved 32 byte vertices
+    // UVs are flipped to the glTF convention and the images are embedded in the binary chunk
+    static bool WriteGlb(const std::string& fileName, const std::vector<PreparedMesh>& meshes) {
+
+        std::string bin;
+        std::ostringstream views, accessors, gltfMeshes, nodes, images, materials;
+        std::map<std::string, int> imageMaterials;
+        int viewCount = 0;
+        // bounds are read back as they are written, they must not lose digits
+        accessors.precision(9);
+
+        for (size_t m = 0; m < meshes.size(); m++) {
+
+            const PreparedMesh& mesh = meshes[m];
+            uint32_t firstIndex = mesh.lods.empty() ? 0 : mesh.lods[0].indexOffset;
+            uint32_t indexCount = mesh.lods.empty() ? (uint32_t)mesh.indexCount : mesh.lods[0].indexCount;
+            bool shortIndices = mesh.vertexCount <= 65536;
+
+            glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+            size_t vertexOffset = bin.size();
+            for (size_t v = 0; v < mesh.vertexCount; v++) {
+
+                gps::Vertex vertex = mesh.vertexData[v];
+                vertex.TexCoords.y = 1.0f - vertex.TexCoords.y;
+                bin.append((const char*)&vertex, sizeof(vertex));
+                boundsMin = glm::min(boundsMin, vertex.Position);
+                boundsMax = glm::max(boundsMax, vertex.Position);
+            }
+
+            size_t indexOffset = bin.size();
+            for (uint32_t i = 0; i < indexCount; i++) {
+
+                uint32_t index = mesh.indexData[firstIndex + i];
+                if (shortIndices) {
+                    uint16_t shortIndex = (uint16_t)index;
+                    bin.append((const char*)&shortIndex, sizeof(shortIndex));
+                } else {
+                    bin.append((const char*)&index, sizeof(index));
+                }
+            }
+            size_t indexBytes = bin.size() - indexOffset;
+            AppendPadding(bin, '\0');
+
+            views << (viewCount > 0 ? "," : "") << "{\"buffer\":0,\"byteOffset\":" << vertexOffset << ",\"byteLength\":" << indexOffset - vertexOffset
+                << ",\"byteStride\":" << sizeof(gps::Vertex) << ",\"target\":34962}";
+            views << ",{\"buffer\":0,\"byteOffset\":" << indexOffset << ",\"byteLength\":" << indexBytes << ",\"target\":34963}";
+
+            accessors << (m > 0 ? "," : "")
+                << "{\"bufferView\":" << viewCount << ",\"byteOffset\":0,\"componentType\":5126,\"count\":" << mesh.vertexCount << ",\"type\":\"VEC3\""
+                << ",\"min\":[" << boundsMin.x << "," << boundsMin.y << "," << boundsMin.z << "],\"max\":[" << boundsMax.x << "," << boundsMax.y << "," << boundsMax.z << "]}"
+                << ",{\"bufferView\":" << viewCount << ",\"byteOffset\":12,\"componentType\":5126,\"count\":" << mesh.vertexCount << ",\"type\":\"VEC3\"}"
+                << ",{\"bufferView\":" << viewCount << ",\"byteOffset\":24,\"componentType\":5126,\"count\":" << mesh.vertexCount << ",\"type\":\"VEC2\"}"
+                << ",{\"bufferView\":" << viewCount + 1 << ",\"componentType\":" << (shortIndices ? 5123 : 5125) << ",\"count\":" << indexCount << ",\"type\":\"SCALAR\"}";
+            viewCount += 2;
+
+            // one material per diffuse image, its bytes go into the binary chunk once
+            int material = -1;
+            for (size_t t = 0; t < mesh.textures.size(); t++) {
+
+                if (mesh.textures[t].type != "diffuseTexture") {
+                    continue;
+                }
+
+                std::map<std::string, int>::iterator found = imageMaterials.find(mesh.textures[t].path);
+                if (found != imageMaterials.end()) {
+                    material = found->second;
+                    break;
+                }
+
+                MappedFile image;
+                if (!VirtualFileSystem::GetShared().Open(mesh.textures[t].path, image)) {
+                    break;
+                }
+                std::string extension = mesh.textures[t].path.substr(mesh.textures[t].path.find_last_of('.') + 1);
+                std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+                material = (int)imageMaterials.size();
+                imageMaterials[mesh.textures[t].path] = material;
+
+                views << ",{\"buffer\":0,\"byteOffset\":" << bin.size() << ",\"byteLength\":" << image.GetSize() << "}";
+                bin.append((const char*)image.GetData(), image.GetSize());
+                AppendPadding(bin, '\0');
+
+                images << (material > 0 ? "," : "") << "{\"bufferView\":" << viewCount << ",\"mimeType\":\"image/" << (extension == "png" ? "png" : "jpeg") << "\"}";
+                materials << (material > 0 ? "," : "") << "{\"pbrMetallicRoughness\":{\"baseColorTexture\":{\"index\":" << material << "}}}";
+                viewCount++;
+                break;
+            }
+
+            gltfMeshes << (m > 0 ? "," : "") << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << m * 4 << ",\"NORMAL\":" << m * 4 + 1
+                << ",\"TEXCOORD_0\":" << m * 4 + 2 << "},\"indices\":" << m * 4 + 3;
+            if (material >= 0) {
+                gltfMeshes << ",\"material\":" << material;
+            }
+            gltfMeshes << "}]}";
+            nodes << (m > 0 ? "," : "") << "{\"mesh\":" << m << "}";
+        }
+
+        std::ostringstream textures;
+        for (size_t i = 0; i < imageMaterials.size(); i++) {
+            textures << (i > 0 ? "," : "") << "{\"source\":" << i << "}";
+        }
+
+        std::ostringstream sceneNodes;
+        for (size_t m = 0; m < meshes.size(); m++) {
+            sceneNodes << (m > 0 ? "," : "") << m;
+        }
+
+        std::ostringstream document;
+        document.precision(9);
+        document << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"gps ModelBenchmark\"},\"scene\":0,\"scenes\":[{\"nodes\":[" << sceneNodes.str() << "]}]"
+            << ",\"nodes\":[" << nodes.str() << "],\"meshes\":[" << gltfMeshes.str() << "]";
+        if (!imageMaterials.empty()) {
+            document << ",\"materials\":[" << materials.str() << "],\"textures\":[" << textures.str() << "],\"images\":[" << images.str() << "]";
+        }
+        document << ",\"buffers\":[{\"byteLength\":" << bin.size() << "}],\"bufferViews\":[" << views.str() << "],\"accessors\":[" << accessors.str() << "]}";
+
+        std::string json = document.str();
+        AppendPadding(json, ' ');
+
+        std::string glb;
+        AppendUint32(glb, 0x46546C67);
+        AppendUint32(glb, 2);
+        AppendUint32(glb, (uint32_t)(12 + 8 + json.size() + 8 + bin.size()));
+        AppendUint32(glb, (uint32_t)json.size());
+        AppendUint32(glb, 0x4E4F534A);
+        glb += json;
+        AppendUint32(glb, (uint32_t)bin.size());
+        AppendUint32(glb, 0x004E4942);
+        glb += bin;
+
+        std::ofstream file(fileName.c_str(), std::ios::binary);
+        file.write(glb.data(), glb.size());
+        return file.good();
+    }
+
+    // parse, weld, optimize and build every level, then upload the arrays
+    static LoadTimes RunObjPath(const std::string& fileName, const std::string& basePath) {
+
+        LoadTimes times;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<PreparedMesh> prepared;
+        std::ostringstream log;
+        MeshBuilder::Load(fileName, basePath, prepared, log);
+        times.prepare = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<gps::Mesh> meshes;
+        VertexPacking packing = MeshBuilder::GetPacking(prepared);
+        for (size_t i = 0; i < prepared.size(); i++) {
+            meshes.push_back(gps::Mesh(std::move(prepared[i].vertices), std::move(prepared[i].indices), std::vector<Texture>(), std::move(prepared[i].lods), std::move(prepared[i].meshlets), &packing));
+        }
+        glFinish();
+        times.upload = MillisecondsSince(start);
+
+        return times;
+    }
+
+    // decode the cache and upload its arrays
+    static LoadTimes RunCachePath(const std::string& cacheFileName, const std::string& fileName) {
+
+        LoadTimes times;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        MeshCache cache;
+        cache.Open(cacheFileName, fileName);
+        std::vector<MeshCacheMesh> cached;
+        for (size_t i = 0; i < cache.GetMeshCount(); i++) {
+            cached.push_back(cache.GetMesh(i));
+        }
+        times.prepare = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<gps::Mesh> meshes;
+        for (size_t i = 0; i < cached.size(); i++) {
+
+            if (cached[i].vertexFormat == VERTEX_FORMAT_PACKED) {
+                meshes.push_back(gps::Mesh(cached[i].packedVertices, cached[i].vertexCount, cached[i].rangeMin, cached[i].rangeMax, cached[i].boundsMin, cached[i].boundsMax,
+                    cached[i].indices, cached[i].indexCount, std::vector<Texture>(), cached[i].lods, cached[i].meshlets));
+            } else {
+                // the cache only stores floats when the model as a whole does not pack
+                VertexPacking packing = Mesh::GetPacking(NULL, 0, VERTEX_FORMAT_FLOAT);
+                meshes.push_back(gps::Mesh(cached[i].vertices, cached[i].vertexCount, cached[i].indices, cached[i].indexCount, std::vector<Texture>(), cached[i].lods, cached[i].meshlets, &packing));
+            }
+        }
+        glFinish();
+        times.upload = MillisecondsSince(start);
+
+        return times;
+    }
+
+    // map the file and upload its buffers as they are
+    static LoadTimes RunGlbPath(const std::string& fileName, const std::string& basePath) {
+
+        LoadTimes times;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        GltfReader reader;
+        std::vector<PreparedMesh> prepared;
+        std::ostringstream log;
+        reader.Read(fileName, basePath, prepared, log);
+        times.prepare = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        std::vector<gps::Mesh> meshes;
+        for (size_t i = 0; i < prepared.size(); i++) {
+
+            if (prepared[i].hasStreams) {
+                meshes.push_back(gps::Mesh(prepared[i].streams, std::vector<Texture>()));
+            } else {
+                meshes.push_back(gps::Mesh(std::move(prepared[i].vertices), std::move(prepared[i].indices), std::vector<Texture>()));
+            }
+        }
+        glFinish();
+        times.upload = MillisecondsSince(start);
+
+        reader.Close();
+        return times;
+    }
+
+    // best time of decoding every encoded mesh once
+    static double TimeDecode(const std::vector<std::vector<unsigned char> >& encodedVertices, const std::vector<size_t>& vertexSizes, const std::vector<size_t>& vertexCounts,
+        const std::vector<std::vector<unsigned char> >& encodedIndices, const std::vector<PreparedMesh>& prepared) {
+
+        std::vector<unsigned char> vertices;
+        std::vector<uint32_t> indices;
+        double best = 1e30;
+
+        for (int pass = 0; pass < CODEC_PASSES; pass++) {
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < prepared.size(); i++) {
+
+                vertices.resize(vertexCounts[i] * vertexSizes[i]);
+                indices.resize(prepared[i].indexCount);
+                MeshCodec::DecodeVertices(vertices.data(), vertexCounts[i], vertexSizes[i], encodedVertices[i].data(), encodedVertices[i].size());
+                MeshCodec::DecodeIndices(indices.data(), prepared[i].indexCount, encodedIndices[i].data(), encodedIndices[i].size());
+            }
+            best = std::min(best, MillisecondsSince(start));
+        }
+        return best;
+    }
+
+    // sizes of the geometry as the version 5 cache stored it, quantized and encoded, and how fast it decodes
+    static void PrintCodecStats(const std::vector<PreparedMesh>& prepared) {
+
+        std::vector<std::vector<unsigned char> > encodedVertices(prepared.size());
+        std::vector<std::vector<unsigned char> > encodedIndices(prepared.size());
+        std::vector<size_t> vertexSizes(prepared.size());
+        std::vector<size_t> vertexCounts(prepared.size());
+        size_t rawBytes = 0;
+        size_t quantizedBytes = 0;
+        size_t encodedBytes = 0;
+
+        VertexPacking packing = MeshBuilder::GetPacking(prepared);
+        for (size_t i = 0; i < prepared.size(); i++) {
+
+            std::vector<PackedVertex> packed;
+            VertexFormat format = packing.format;
+            if (format == VERTEX_FORMAT_PACKED) {
+                Mesh::QuantizeVertices(prepared[i].vertexData, prepared[i].vertexCount, packing, packed);
+            }
+
+            vertexSizes[i] = format == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
+            vertexCounts[i] = prepared[i].vertexCount;
+            const void* vertices = format == VERTEX_FORMAT_PACKED ? (const void*)packed.data() : (const void*)prepared[i].vertexData;
+            MeshCodec::EncodeVertices(vertices, vertexCounts[i], vertexSizes[i], encodedVertices[i]);
+            MeshCodec::EncodeIndices(prepared[i].indexData, prepared[i].indexCount, encodedIndices[i]);
+
+            rawBytes += prepared[i].vertexCount * sizeof(Vertex) + prepared[i].indexCount * sizeof(GLuint);
+            quantizedBytes += vertexCounts[i] * vertexSizes[i] + prepared[i].indexCount * sizeof(GLuint);
+            encodedBytes += encodedVertices[i].size() + encodedIndices[i].size();
+        }
+
+        printf("  %-20s raw %8zu KB  quantized %8zu KB  encoded %8zu KB  (%.2fx)\n", "geometry codec",
+            rawBytes / 1024, quantizedBytes / 1024, encodedBytes / 1024, encodedBytes > 0 ? (double)rawBytes / encodedBytes : 0.0);
+
+        // throughput is counted in decoded bytes
+        bool simdAvailable = MeshCodec::IsSimdAvailable();
+        for (int simd = simdAvailable ? 1 : 0; simd >= 0; simd--) {
+
+            MeshCodec::SetSimdEnabled(simd != 0);
+            double milliseconds = TimeDecode(encodedVertices, vertexSizes, vertexCounts, encodedIndices, prepared);
+            printf("  %-20s decode %8.3f ms  %6.2f GB/s\n", simd ? "codec simd" : "codec scalar",
+                milliseconds, milliseconds > 0.0 ? quantizedBytes / (milliseconds * 1e6) : 0.0);
+        }
+        MeshCodec::SetSimdEnabled(true);
+    }
+
+    void RunModelBenchmark(const std::vector<std::string>& fileNames) {
+
+        std::cout << "Model load benchmark, best of " << BENCHMARK_RUNS << " runs" << std::endl;
+
+        for (size_t f = 0; f < fileNames.size(); f++) {
+
+            const std::string& fileName = fileNames[f];
+            std::string basePath = fileName.substr(0, fileName.find_last_of('/') + 1);
+            std::string stem = fileName.substr(0, fileName.find_last_of('.'));
+            std::string glbFileName = stem + ".bench.glb";
+            std::string cacheFileName = stem + ".bench.gpsmesh";
+
+            std::vector<PreparedMesh> prepared;
+            std::ostringstream log;
+            uint64_t sourceHash = 0;
+            uint64_t materialHash = 0;
+            if (!MeshBuilder::Load(fileName, basePath, prepared, log)) {
+                fprintf(stderr, "ERROR: could not load %s\n", fileName.c_str());
+                continue;
+            }
+            if (!WriteGlb(glbFileName, prepared) || !MeshBuilder::WriteCache(cacheFileName, fileName, prepared, sourceHash, materialHash)) {
+                fprintf(stderr, "ERROR: could not convert %s\n", fileName.c_str());
+                remove(glbFileName.c_str());
+                remove(cacheFileName.c_str());
+                continue;
+            }
+
+            LoadTimes objPath = { 1e30, 1e30 };
+            LoadTimes cachePath = { 1e30, 1e30 };
+            LoadTimes glbPath = { 1e30, 1e30 };
+
+            for (int run = 0; run < BENCHMARK_RUNS; run++) {
+
+                KeepBest(objPath, RunObjPath(fileName, basePath));
+                KeepBest(cachePath, RunCachePath(cacheFileName, fileName));
+                KeepBest(glbPath, RunGlbPath(glbFileName, basePath));
+            }
+
+            // the .obj size leaves out the .mtl and images, the .glb embeds the images, the cache also holds the coarser levels
+            std::cout << fileName << " (" << prepared.size() << " meshes)" << std::endl;
+            PrintTimes("obj", objPath, GetFileSize(fileName));
+            PrintTimes("mesh cache", cachePath, GetFileSize(cacheFileName));
+            PrintTimes("glb", glbPath, GetFileSize(glbFileName));
+            PrintCodecStats(prepared);
+
+            remove(glbFileName.c_str());
+            remove(cacheFileName.c_str());
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef ModelBenchmark_hpp
+#define ModelBenchmark_hpp
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Converts each .obj model to a binary glTF file holding the same full
+    // detail meshes and embedded images, then times loading it as OBJ (parse
+    // and build), from the mesh cache and as GLB, split into the CPU side and
+    // the buffer uploads. Textures are left out, only geometry is timed.
+    // Also prints how much the mesh cache codec shrinks the geometry and how
+    // fast it decodes with and without SIMD. Needs a current GL context.
+    void RunModelBenchmark(const std::vector<std::string>& fileNames);
+}
+
+#endif /* ModelBenchmark_hpp */
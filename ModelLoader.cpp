@@ -0,0 +1,75 @@
+#include "ModelLoader.hpp"
+
+namespace gps {
+
+    ModelLoader::ModelLoader() {
+
+        start = std::chrono::steady_clock::now();
+    }
+
+    void ModelLoader::Add(Model3D& model, std::string fileName) {
+
+        std::string basePath = fileName.substr(0, fileName.find_last_of('/')) + "/";
+        Add(model, fileName, basePath);
+    }
+
+    void ModelLoader::Add(Model3D& model, std::string fileName, std::string basePath) {
+
+        if (pending.empty()) {
+            start = std::chrono::steady_clock::now();
+        }
+
+        // a file already in the batch is prepared after the first copy, so it finds
+        // the mesh cache written by it instead of racing on the same cache file
+        std::shared_future<void> previous;
+        for (size_t i = 0; i < pending.size(); i++) {
+
+            if (pending[i].fileName == fileName) {
+                previous = pending[i].prepared;
+            }
+        }
+
+        Model3D* target = &model;
+        PendingModel pendingModel;
+        pendingModel.model = target;
+        pendingModel.fileName = fileName;
+        pendingModel.prepared = ThreadPool::GetShared().Submit([target, fileName, basePath, previous]() {
+
+            if (previous.valid()) {
+                previous.wait();
+            }
+            target->Prepare(fileName, basePath);
+        }).share();
+
+        pending.push_back(pendingModel);
+    }
+
+    void ModelLoader::Finish() {
+
+        size_t modelCount = pending.size();
+        double preparedMilliseconds = 0.0;
+
+        while (!pending.empty()) {
+
+            // upload whichever model is ready, blocking on the oldest one only when none is
+            size_t ready = 0;
+            for (size_t i = 0; i < pending.size(); i++) {
+
+                if (pending[i].prepared.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    ready = i;
+                    break;
+                }
+            }
+
+            pending[ready].prepared.wait();
+            pending[ready].model->Upload();
+            preparedMilliseconds += pending[ready].model->GetLoadStats().loadMilliseconds;
+
+            pending.erase(pending.begin() + ready);
+        }
+
+        double wallMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Loaded " << modelCount << " models in " << wallMilliseconds << " ms ("
+            << preparedMilliseconds << " ms one after another, " << ThreadPool::GetShared().GetThreadCount() << " threads)" << std::endl;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef ModelLoader_hpp
+#define ModelLoader_hpp
+
+#include "Model3D.hpp"
+#include "ThreadPool.hpp"
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Loads a batch of models concurrently
+    //
+    // Every model is handed to the shared thread pool as soon as it is added,
+    // so parsing and texture decoding of the whole batch overlap. Finish runs
+    // on the context thread and creates the GL objects of each model as soon
+    // as its CPU work is done.
+    class ModelLoader {
+
+    public:
+        ModelLoader();
+
+        void Add(Model3D& model, std::string fileName);
+
+        void Add(Model3D& model, std::string fileName, std::string basePath);
+
+        // Uploads every model of the batch, must be called on the context thread
+        void Finish();
+
+    private:
+        struct PendingModel {
+
+            Model3D* model;
+            std::string fileName;
+            std::shared_future<void> prepared;
+        };
+
+        std::vector<PendingModel> pending;
+        std::chrono::steady_clock::time_point start;
+    };
+}
+
+#endif /* ModelLoader_hpp */
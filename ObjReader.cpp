@@ -0,0 +1,1010 @@
+#include "ObjReader.hpp"
+#include "MappedFile.hpp"
+#include "ThreadPool.hpp"
+#include "VirtualFileSystem.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace gps {
+
+    static const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    static bool IsSpace(char c) {
+
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static bool IsDigit(char c) {
+
+        return c >= '0' && c <= '9';
+    }
+
+    static const char* SkipSpaces(const char* p, const char* end) {
+
+        while (p < end && IsSpace(*p)) {
+            p++;
+        }
+        return p;
+    }
+
+    static const char* SkipToken(const char* p, const char* end) {
+
+        while (p < end && !IsSpace(*p)) {
+            p++;
+        }
+        return p;
+    }
+
+    // Rest of the line without surrounding whitespace
+    static std::string ReadRestOfLine(const char* p, const char* end) {
+
+        p = SkipSpaces(p, end);
+        while (end > p && IsSpace(end[-1])) {
+            end--;
+        }
+        return std::string(p, end - p);
+    }
+
+    static std::string ReadToken(const char* p, const char* end) {
+
+        p = SkipSpaces(p, end);
+        return std::string(p, SkipToken(p, end) - p);
+    }
+
+    static bool StartsWithKeyword(const char* p, const char* end, const char* keyword, size_t length) {
+
+        return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && IsSpace(p[length]);
+    }
+
+    // Decimal float parser - accumulates up to 19 significant digits and scales once
+    static const char* ParseFloat(const char* p, const char* end, float& value) {
+
+        p = SkipSpaces(p, end);
+        const char* start = p;
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            p++;
+        }
+
+        uint64_t mantissa = 0;
+        int significantDigits = 0;
+        int exponent = 0;
+        bool anyDigits = false;
+
+        while (p < end && IsDigit(*p)) {
+
+            if (significantDigits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0) {
+                    significantDigits++;
+                }
+            }
+            else {
+                exponent++;
+            }
+            anyDigits = true;
+            p++;
+        }
+
+        if (p < end && *p == '.') {
+
+            p++;
+            while (p < end && IsDigit(*p)) {
+
+                if (significantDigits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                    if (mantissa != 0) {
+                        significantDigits++;
+                    }
+                }
+                anyDigits = true;
+                p++;
+            }
+        }
+
+        if (!anyDigits) {
+
+            // nan, inf and other oddities go through the C library
+            char buffer[64];
+            size_t length = SkipToken(start, end) - start;
+            if (length == 0 || length >= sizeof(buffer)) {
+                value = 0.0f;
+                return start + length;
+            }
+            memcpy(buffer, start, length);
+            buffer[length] = 0;
+            value = (float)strtod(buffer, NULL);
+            return start + length;
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E')) {
+
+            const char* exponentStart = p;
+            p++;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negativeExponent = (*p == '-');
+                p++;
+            }
+
+            if (p < end && IsDigit(*p)) {
+
+                int explicitExponent = 0;
+                while (p < end && IsDigit(*p)) {
+                    if (explicitExponent < 10000) {
+                        explicitExponent = explicitExponent * 10 + (*p - '0');
+                    }
+                    p++;
+                }
+                exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            }
+            else {
+                p = exponentStart;
+            }
+        }
+
+        double result = (double)mantissa;
+        if (exponent < 0 && exponent >= -22) {
+            result /= POWERS_OF_TEN[-exponent];
+        }
+        else if (exponent > 0 && exponent <= 22) {
+            result *= POWERS_OF_TEN[exponent];
+        }
+        else if (exponent != 0) {
+            result *= pow(10.0, exponent);
+        }
+
+        value = (float)(negative ? -result : result);
+        return p;
+    }
+
+    static const char* ParseInt(const char* p, const char* end, int& value) {
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            p++;
+        }
+
+        int result = 0;
+        while (p < end && IsDigit(*p)) {
+            result = result * 10 + (*p - '0');
+            p++;
+        }
+
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // .obj indices are 1-based, negative values count back from the last element
+    static int FixIndex(int index, size_t count) {
+
+        if (index > 0) {
+            return index - 1;
+        }
+        if (index == 0) {
+            return 0;
+        }
+        return (int)count + index;
+    }
+
+    // Parses one "v", "v/vt", "v//vn" or "v/vt/vn" face corner
+    static const char* ParseCorner(const char* p, const char* end, size_t positionCount, size_t normalCount, size_t texcoordCount, ObjIndex& index) {
+
+        int value;
+        p = ParseInt(p, end, value);
+        index.vertexIndex = FixIndex(value, positionCount);
+        index.normalIndex = -1;
+        index.texcoordIndex = -1;
+
+        if (p >= end || *p != '/') {
+            return p;
+        }
+        p++;
+
+        if (p < end && *p != '/') {
+            p = ParseInt(p, end, value);
+            index.texcoordIndex = FixIndex(value, texcoordCount);
+        }
+
+        if (p >= end || *p != '/') {
+            return p;
+        }
+        p++;
+
+        p = ParseInt(p, end, value);
+        index.normalIndex = FixIndex(value, normalCount);
+        return p;
+    }
+
+    ObjVertexTable::ObjVertexTable() {
+
+        count = 0;
+    }
+
+    size_t ObjVertexTable::Hash(const ObjIndex& key, size_t mask) {
+
+        uint64_t hash = (uint64_t)(uint32_t)key.vertexIndex | ((uint64_t)(uint32_t)key.texcoordIndex << 32);
+        hash ^= (uint64_t)(uint32_t)key.normalIndex * 0x9E3779B97F4A7C15ULL;
+        hash *= 0xBF58476D1CE4E5B9ULL;
+        return (size_t)(hash >> 32) & mask;
+    }
+
+    GLuint ObjVertexTable::Insert(const ObjIndex& key, GLuint nextIndex, bool& inserted) {
+
+        // keep the load factor under one half
+        if ((count + 1) * 2 > slots.size()) {
+            Grow();
+        }
+
+        size_t mask = slots.size() - 1;
+        size_t slot = Hash(key, mask);
+
+        while (slots[slot].index != (GLuint)-1) {
+
+            const ObjIndex& existing = slots[slot].key;
+            if (existing.vertexIndex == key.vertexIndex && existing.normalIndex == key.normalIndex && existing.texcoordIndex == key.texcoordIndex) {
+                inserted = false;
+                return slots[slot].index;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        slots[slot].key = key;
+        slots[slot].index = nextIndex;
+        count++;
+        inserted = true;
+        return nextIndex;
+    }
+
+    void ObjVertexTable::Clear() {
+
+        // large tables are released, small ones are reused by the next shape
+        if (slots.size() > 65536) {
+            std::vector<Slot>().swap(slots);
+        }
+        else {
+            for (size_t i = 0; i < slots.size(); i++) {
+                slots[i].index = (GLuint)-1;
+            }
+        }
+        count = 0;
+    }
+
+    void ObjVertexTable::Grow() {
+
+        std::vector<Slot> oldSlots;
+        oldSlots.swap(slots);
+
+        Slot empty;
+        empty.index = (GLuint)-1;
+        slots.assign(oldSlots.empty() ? 1024 : oldSlots.size() * 2, empty);
+
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < oldSlots.size(); i++) {
+
+            if (oldSlots[i].index == (GLuint)-1) {
+                continue;
+            }
+
+            size_t slot = Hash(oldSlots[i].key, mask);
+            while (slots[slot].index != (GLuint)-1) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = oldSlots[i];
+        }
+    }
+
+    static void ReadMaterialLibrary(std::string fileName, ObjModel& model, std::map<std::string, int>& materialMap) {
+
+        MappedFile file;
+        if (!VirtualFileSystem::GetShared().Open(fileName, file)) {
+            std::cerr << "WARN: Material file [ " << fileName << " ] not found." << std::endl;
+            return;
+        }
+
+        const char* p = (const char*)file.GetData();
+        const char* end = p + file.GetSize();
+        ObjMaterial* material = NULL;
+
+        while (p < end) {
+
+            const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+            if (lineEnd == NULL) {
+                lineEnd = end;
+            }
+
+            const char* token = SkipSpaces(p, lineEnd);
+            p = lineEnd + 1;
+
+            if (token == lineEnd || token[0] == '#') {
+                continue;
+            }
+
+            if (StartsWithKeyword(token, lineEnd, "newmtl", 6)) {
+
+                ObjMaterial newMaterial;
+                newMaterial.name = ReadToken(token + 7, lineEnd);
+                newMaterial.ambient = glm::vec3(0.0f);
+                newMaterial.diffuse = glm::vec3(0.0f);
+                newMaterial.specular = glm::vec3(0.0f);
+
+                materialMap[newMaterial.name] = (int)model.materials.size();
+                model.materials.push_back(newMaterial);
+                material = &model.materials.back();
+                continue;
+            }
+
+            if (material == NULL) {
+                continue;
+            }
+
+            glm::vec3* color = NULL;
+            if (StartsWithKeyword(token, lineEnd, "Ka", 2)) {
+                color = &material->ambient;
+            }
+            else if (StartsWithKeyword(token, lineEnd, "Kd", 2)) {
+                color = &material->diffuse;
+            }
+            else if (StartsWithKeyword(token, lineEnd, "Ks", 2)) {
+                color = &material->specular;
+            }
+
+            if (color != NULL) {
+
+                token = ParseFloat(token + 3, lineEnd, color->x);
+                token = ParseFloat(token, lineEnd, color->y);
+                ParseFloat(token, lineEnd, color->z);
+                continue;
+            }
+
+            if (StartsWithKeyword(token, lineEnd, "map_Ka", 6)) {
+                material->ambientTexture = ReadRestOfLine(token + 7, lineEnd);
+            }
+            else if (StartsWithKeyword(token, lineEnd, "map_Kd", 6)) {
+                material->diffuseTexture = ReadRestOfLine(token + 7, lineEnd);
+            }
+            else if (StartsWithKeyword(token, lineEnd, "map_Ks", 6)) {
+                material->specularTexture = ReadRestOfLine(token + 7, lineEnd);
+            }
+        }
+    }
+
+    // Appends a face corner to the shape, reusing the vertex if the corner was seen before
+    static void WeldCorner(ObjShape& shape, ObjVertexTable& table, const std::vector<float>& positions, const std::vector<float>& normals, const std::vector<float>& texcoords, const ObjIndex& index) {
+
+        bool inserted;
+        GLuint welded = table.Insert(index, (GLuint)shape.vertices.size(), inserted);
+        shape.indices.push_back(welded);
+
+        if (!inserted) {
+            return;
+        }
+
+        Vertex vertex;
+        vertex.Position = glm::vec3(0.0f);
+        vertex.Normal = glm::vec3(0.0f);
+        vertex.TexCoords = glm::vec2(0.0f);
+
+        if (index.vertexIndex >= 0 && (size_t)index.vertexIndex * 3 < positions.size()) {
+            vertex.Position = glm::vec3(positions[3 * index.vertexIndex + 0], positions[3 * index.vertexIndex + 1], positions[3 * index.vertexIndex + 2]);
+        }
+        if (index.normalIndex >= 0 && (size_t)index.normalIndex * 3 < normals.size()) {
+            vertex.Normal = glm::vec3(normals[3 * index.normalIndex + 0], normals[3 * index.normalIndex + 1], normals[3 * index.normalIndex + 2]);
+        }
+        if (index.texcoordIndex >= 0 && (size_t)index.texcoordIndex * 2 < texcoords.size()) {
+            vertex.TexCoords = glm::vec2(texcoords[2 * index.texcoordIndex + 0], texcoords[2 * index.texcoordIndex + 1]);
+        }
+
+        shape.vertices.push_back(vertex);
+    }
+
+    static void FinishShape(ObjShape& shape, ObjModel& model) {
+
+        shape.vertices.shrink_to_fit();
+        shape.indices.shrink_to_fit();
+        model.shapes.push_back(ObjShape());
+        model.shapes.back().name = shape.name;
+        model.shapes.back().materialId = shape.materialId;
+        model.shapes.back().vertices.swap(shape.vertices);
+        model.shapes.back().indices.swap(shape.indices);
+    }
+
+    // Walks the lines of [p, end) and reports every record to the sink
+    //
+    // The sink decides where attributes go and what happens to faces, so the
+    // serial and the chunked pass share the exact same tokenizer.
+    template<typename Sink>
+    static void ParseLines(const char* p, const char* end, Sink& sink) {
+
+        std::vector<ObjIndex> face;
+
+        while (p < end) {
+
+            const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+            if (lineEnd == NULL) {
+                lineEnd = end;
+            }
+
+            const char* token = SkipSpaces(p, lineEnd);
+            p = lineEnd + 1;
+
+            if (token == lineEnd || token[0] == '#') {
+                continue;
+            }
+
+            // vertex
+            if (StartsWithKeyword(token, lineEnd, "v", 1)) {
+
+                float x = 0.0f, y = 0.0f, z = 0.0f;
+                token = ParseFloat(token + 2, lineEnd, x);
+                token = ParseFloat(token, lineEnd, y);
+                ParseFloat(token, lineEnd, z);
+                sink.AddPosition(x, y, z);
+                continue;
+            }
+
+            // normal
+            if (StartsWithKeyword(token, lineEnd, "vn", 2)) {
+
+                float x = 0.0f, y = 0.0f, z = 0.0f;
+                token = ParseFloat(token + 3, lineEnd, x);
+                token = ParseFloat(token, lineEnd, y);
+                ParseFloat(token, lineEnd, z);
+                sink.AddNormal(x, y, z);
+                continue;
+            }
+
+            // texcoord
+            if (StartsWithKeyword(token, lineEnd, "vt", 2)) {
+
+                float x = 0.0f, y = 0.0f;
+                token = ParseFloat(token + 3, lineEnd, x);
+                ParseFloat(token, lineEnd, y);
+                sink.AddTexcoord(x, y);
+                continue;
+            }
+
+            // face
+            if (StartsWithKeyword(token, lineEnd, "f", 1)) {
+
+                face.clear();
+                token = SkipSpaces(token + 2, lineEnd);
+
+                while (token < lineEnd) {
+
+                    ObjIndex index;
+                    token = ParseCorner(token, lineEnd, sink.GetPositionCount(), sink.GetNormalCount(), sink.GetTexcoordCount(), index);
+                    face.push_back(index);
+                    token = SkipSpaces(SkipToken(token, lineEnd), lineEnd);
+                }
+
+                sink.AddFace(face);
+                continue;
+            }
+
+            // use mtl
+            if (StartsWithKeyword(token, lineEnd, "usemtl", 6)) {
+
+                sink.UseMaterial(ReadToken(token + 7, lineEnd));
+                continue;
+            }
+
+            // load mtl
+            if (StartsWithKeyword(token, lineEnd, "mtllib", 6)) {
+
+                sink.LoadMaterialLibrary(ReadToken(token + 7, lineEnd));
+                continue;
+            }
+
+            // group or object name - starts a new shape
+            if (StartsWithKeyword(token, lineEnd, "g", 1) || StartsWithKeyword(token, lineEnd, "o", 1)) {
+
+                sink.BeginShape(ReadToken(token + 2, lineEnd));
+                continue;
+            }
+        }
+    }
+
+    // Serial pass - welds every face as soon as it is read
+    //
+    // A group using several materials is split into one shape per material,
+    // each with its own vertex table, so every shape is drawn with one set of
+    // textures.
+    struct ObjStreamSink {
+
+        ObjModel& model;
+        std::string basePath;
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+        std::map<std::string, int> materialMap;
+        // shapes of the current group, in order of first use of their material
+        std::vector<ObjShape> groupShapes;
+        std::vector<ObjVertexTable> groupTables;
+        std::string groupName;
+        size_t currentShape;
+        int currentMaterial;
+
+        ObjStreamSink(ObjModel& model, std::string basePath) : model(model), basePath(basePath) {
+
+            currentShape = 0;
+            currentMaterial = -1;
+        }
+
+        size_t GetPositionCount() const { return positions.size() / 3; }
+        size_t GetNormalCount() const { return normals.size() / 3; }
+        size_t GetTexcoordCount() const { return texcoords.size() / 2; }
+
+        void AddPosition(float x, float y, float z) {
+
+            positions.push_back(x);
+            positions.push_back(y);
+            positions.push_back(z);
+        }
+
+        void AddNormal(float x, float y, float z) {
+
+            normals.push_back(x);
+            normals.push_back(y);
+            normals.push_back(z);
+        }
+
+        void AddTexcoord(float x, float y) {
+
+            texcoords.push_back(x);
+            texcoords.push_back(y);
+        }
+
+        // triangulated as a fan around the first corner
+        void AddFace(const std::vector<ObjIndex>& face) {
+
+            // materials rarely change between faces, the last shape is checked first
+            if (currentShape >= groupShapes.size() || groupShapes[currentShape].materialId != currentMaterial) {
+
+                currentShape = 0;
+                while (currentShape < groupShapes.size() && groupShapes[currentShape].materialId != currentMaterial) {
+                    currentShape++;
+                }
+                if (currentShape == groupShapes.size()) {
+
+                    groupShapes.push_back(ObjShape());
+                    groupShapes.back().name = groupName;
+                    groupShapes.back().materialId = currentMaterial;
+                    groupTables.push_back(ObjVertexTable());
+                }
+            }
+
+            ObjShape& shape = groupShapes[currentShape];
+            ObjVertexTable& table = groupTables[currentShape];
+
+            for (size_t k = 2; k < face.size(); k++) {
+
+                WeldCorner(shape, table, positions, normals, texcoords, face[0]);
+                WeldCorner(shape, table, positions, normals, texcoords, face[k - 1]);
+                WeldCorner(shape, table, positions, normals, texcoords, face[k]);
+            }
+        }
+
+        void UseMaterial(const std::string& name) {
+
+            std::map<std::string, int>::iterator found = materialMap.find(name);
+            currentMaterial = (found != materialMap.end()) ? found->second : -1;
+        }
+
+        void LoadMaterialLibrary(const std::string& name) {
+
+            ReadMaterialLibrary(basePath + name, model, materialMap);
+        }
+
+        void BeginShape(const std::string& name) {
+
+            Flush();
+            groupName = name;
+        }
+
+        void Flush() {
+
+            for (size_t s = 0; s < groupShapes.size(); s++) {
+
+                if (!groupShapes[s].indices.empty()) {
+                    FinishShape(groupShapes[s], model);
+                }
+            }
+
+            groupShapes.clear();
+            groupTables.clear();
+            groupName.clear();
+            currentShape = 0;
+        }
+    };
+
+    // Non-attribute record of a chunk, kept in file order
+    struct ObjChunkEvent {
+
+        enum Type { FACES, USE_MATERIAL, MATERIAL_LIBRARY, BEGIN_SHAPE };
+
+        Type type;
+        // triangle corners of consecutive faces
+        size_t cornerBegin;
+        size_t cornerEnd;
+        std::string name;
+    };
+
+    // Chunked pass - attributes go to their final global slot, faces are buffered
+    struct ObjChunkSink {
+
+        const char* begin;
+        const char* end;
+        // global counts before the chunk and local counts inside it
+        size_t positionBase, normalBase, texcoordBase;
+        size_t positionCount, normalCount, texcoordCount;
+        float* positions;
+        float* normals;
+        float* texcoords;
+        std::vector<ObjIndex> corners;
+        std::vector<ObjChunkEvent> events;
+
+        size_t GetPositionCount() const { return positionBase + positionCount; }
+        size_t GetNormalCount() const { return normalBase + normalCount; }
+        size_t GetTexcoordCount() const { return texcoordBase + texcoordCount; }
+
+        void AddPosition(float x, float y, float z) {
+
+            float* destination = positions + 3 * (positionBase + positionCount++);
+            destination[0] = x;
+            destination[1] = y;
+            destination[2] = z;
+        }
+
+        void AddNormal(float x, float y, float z) {
+
+            float* destination = normals + 3 * (normalBase + normalCount++);
+            destination[0] = x;
+            destination[1] = y;
+            destination[2] = z;
+        }
+
+        void AddTexcoord(float x, float y) {
+
+            float* destination = texcoords + 2 * (texcoordBase + texcoordCount++);
+            destination[0] = x;
+            destination[1] = y;
+        }
+
+        void AddFace(const std::vector<ObjIndex>& face) {
+
+            if (face.size() < 3) {
+                return;
+            }
+
+            if (events.empty() || events.back().type != ObjChunkEvent::FACES) {
+                AddEvent(ObjChunkEvent::FACES, std::string());
+            }
+
+            for (size_t k = 2; k < face.size(); k++) {
+
+                corners.push_back(face[0]);
+                corners.push_back(face[k - 1]);
+                corners.push_back(face[k]);
+            }
+            events.back().cornerEnd = corners.size();
+        }
+
+        void UseMaterial(const std::string& name) { AddEvent(ObjChunkEvent::USE_MATERIAL, name); }
+        void LoadMaterialLibrary(const std::string& name) { AddEvent(ObjChunkEvent::MATERIAL_LIBRARY, name); }
+        void BeginShape(const std::string& name) { AddEvent(ObjChunkEvent::BEGIN_SHAPE, name); }
+
+        void AddEvent(ObjChunkEvent::Type type, const std::string& name) {
+
+            ObjChunkEvent event;
+            event.type = type;
+            event.cornerBegin = corners.size();
+            event.cornerEnd = corners.size();
+            event.name = name;
+            events.push_back(event);
+        }
+    };
+
+    // Counts the v/vn/vt records of a chunk so every chunk knows its global base indices
+    static void CountAttributes(ObjChunkSink& chunk) {
+
+        const char* p = chunk.begin;
+        chunk.positionCount = chunk.normalCount = chunk.texcoordCount = 0;
+
+        while (p < chunk.end) {
+
+            const char* lineEnd = (const char*)memchr(p, '\n', chunk.end - p);
+            if (lineEnd == NULL) {
+                lineEnd = chunk.end;
+            }
+
+            const char* token = SkipSpaces(p, lineEnd);
+            p = lineEnd + 1;
+
+            if (token == lineEnd || token[0] != 'v') {
+                continue;
+            }
+
+            if (StartsWithKeyword(token, lineEnd, "v", 1)) {
+                chunk.positionCount++;
+            }
+            else if (StartsWithKeyword(token, lineEnd, "vn", 2)) {
+                chunk.normalCount++;
+            }
+            else if (StartsWithKeyword(token, lineEnd, "vt", 2)) {
+                chunk.texcoordCount++;
+            }
+        }
+    }
+
+    // Faces of one shape, possibly spread over several chunks
+    struct ObjShapeRanges {
+
+        std::string name;
+        int materialId;
+        std::vector<std::pair<const ObjIndex*, size_t> > ranges;
+    };
+
+    // Work of one ParallelFor, shared with the pool jobs helping with it
+    struct ParallelForState {
+
+        std::function<void(size_t)> job;
+        size_t count;
+        std::atomic<size_t> next;
+        // helpers inside job, the caller waits for them once it runs out of work
+        int activeHelpers;
+        // set by the caller when it is done, helpers starting later do nothing
+        bool finished;
+        std::mutex mutex;
+        std::condition_variable helpersDone;
+    };
+
+    static void RunParallelFor(ParallelForState& state) {
+
+        for (size_t i = state.next++; i < state.count; i = state.next++) {
+            state.job(i);
+        }
+    }
+
+    // Runs job(i) for i in [0, count) on the calling thread and up to threadCount - 1 workers of the shared pool
+    // The caller takes whatever the helpers have not started, so it finishes even when every worker is busy,
+    // which is the usual case when a model is read by a loader job in the same pool
+    template<typename Job>
+    static void ParallelFor(size_t count, unsigned int threadCount, Job job) {
+
+        std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+        state->job = job;
+        state->count = count;
+        state->next = 0;
+        state->activeHelpers = 0;
+        state->finished = false;
+
+        for (unsigned int t = 1; t < threadCount && t < count; t++) {
+
+            ThreadPool::GetShared().Submit([state]() {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (state->finished) {
+                        return;
+                    }
+                    state->activeHelpers++;
+                }
+                RunParallelFor(*state);
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->activeHelpers--;
+                }
+                state->helpersDone.notify_all();
+            });
+        }
+
+        RunParallelFor(*state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished = true;
+        state->helpersDone.wait(lock, [&state]() { return state->activeHelpers == 0; });
+    }
+
+    // below this size the threads cost more than they save
+    static const size_t MIN_CHUNK_SIZE = 4 * 1024 * 1024;
+
+    ObjReader::ObjReader() {
+
+        threadCount = 0;
+        throughput = 0.0;
+    }
+
+    void ObjReader::SetThreadCount(unsigned int count) {
+
+        threadCount = count;
+    }
+
+    double ObjReader::GetThroughput() const {
+
+        return throughput;
+    }
+
+    bool ObjReader::Read(std::string fileName, std::string basePath, ObjModel& model) {
+
+        MappedFile file;
+        if (!VirtualFileSystem::GetShared().Open(fileName, file)) {
+            std::cerr << "ERROR: could not open " << fileName << std::endl;
+            return false;
+        }
+
+        return Parse((const char*)file.GetData(), file.GetSize(), basePath, model);
+    }
+
+    bool ObjReader::Parse(const char* data, size_t size, std::string basePath, ObjModel& model) {
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        unsigned int chunkCount = threadCount;
+        if (chunkCount == 0) {
+            chunkCount = ThreadPool::GetShared().GetThreadCount();
+        }
+        chunkCount = (unsigned int)std::min((size_t)chunkCount, std::max((size_t)1, size / MIN_CHUNK_SIZE));
+
+        if (chunkCount > 1) {
+            ParseParallel(data, size, basePath, model, chunkCount);
+        }
+        else {
+            ParseSerial(data, size, basePath, model);
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        throughput = seconds > 0.0 ? (size / 1000000.0) / seconds : 0.0;
+
+        return true;
+    }
+
+    void ObjReader::ParseSerial(const char* data, size_t size, std::string basePath, ObjModel& model) {
+
+        ObjStreamSink sink(model, basePath);
+        ParseLines(data, data + size, sink);
+        sink.Flush();
+    }
+
+    void ObjReader::ParseParallel(const char* data, size_t size, std::string basePath, ObjModel& model, unsigned int chunkCount) {
+
+        const char* end = data + size;
+
+        // split at line boundaries
+        std::vector<ObjChunkSink> chunks(chunkCount);
+        const char* chunkBegin = data;
+
+        for (unsigned int c = 0; c < chunkCount; c++) {
+
+            const char* chunkEnd = end;
+            if (c + 1 < chunkCount) {
+
+                chunkEnd = std::max(chunkBegin, data + size / chunkCount * (c + 1));
+                const char* newline = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+                chunkEnd = (newline != NULL) ? newline + 1 : end;
+            }
+
+            chunks[c].begin = chunkBegin;
+            chunks[c].end = chunkEnd;
+            chunkBegin = chunkEnd;
+        }
+
+        // count the attributes of every chunk, then place them in the global arrays
+        ParallelFor(chunks.size(), chunkCount, [&chunks](size_t c) {
+            CountAttributes(chunks[c]);
+        });
+
+        size_t positionCount = 0, normalCount = 0, texcoordCount = 0;
+        for (size_t c = 0; c < chunks.size(); c++) {
+
+            chunks[c].positionBase = positionCount;
+            chunks[c].normalBase = normalCount;
+            chunks[c].texcoordBase = texcoordCount;
+            positionCount += chunks[c].positionCount;
+            normalCount += chunks[c].normalCount;
+            texcoordCount += chunks[c].texcoordCount;
+        }
+
+        std::vector<float> positions(3 * positionCount);
+        std::vector<float> normals(3 * normalCount);
+        std::vector<float> texcoords(2 * texcoordCount);
+
+        for (size_t c = 0; c < chunks.size(); c++) {
+
+            chunks[c].positionCount = chunks[c].normalCount = chunks[c].texcoordCount = 0;
+            chunks[c].positions = positions.data();
+            chunks[c].normals = normals.data();
+            chunks[c].texcoords = texcoords.data();
+        }
+
+        ParallelFor(chunks.size(), chunkCount, [&chunks](size_t c) {
+            ParseLines(chunks[c].begin, chunks[c].end, chunks[c]);
+        });
+
+        // replay the records in file order to rebuild the shapes, one per group and material
+        std::vector<ObjShapeRanges> shapes;
+        std::map<std::string, int> materialMap;
+        std::vector<ObjShapeRanges> groupShapes;
+        std::string groupName;
+        int currentMaterial = -1;
+
+        for (size_t c = 0; c < chunks.size(); c++) {
+            for (size_t e = 0; e < chunks[c].events.size(); e++) {
+
+                const ObjChunkEvent& event = chunks[c].events[e];
+
+                if (event.type == ObjChunkEvent::FACES) {
+
+                    size_t s = 0;
+                    while (s < groupShapes.size() && groupShapes[s].materialId != currentMaterial) {
+                        s++;
+                    }
+                    if (s == groupShapes.size()) {
+
+                        groupShapes.push_back(ObjShapeRanges());
+                        groupShapes.back().name = groupName;
+                        groupShapes.back().materialId = currentMaterial;
+                    }
+                    groupShapes[s].ranges.push_back(std::make_pair(chunks[c].corners.data() + event.cornerBegin, event.cornerEnd - event.cornerBegin));
+                }
+                else if (event.type == ObjChunkEvent::USE_MATERIAL) {
+
+                    std::map<std::string, int>::iterator found = materialMap.find(event.name);
+                    currentMaterial = (found != materialMap.end()) ? found->second : -1;
+                }
+                else if (event.type == ObjChunkEvent::MATERIAL_LIBRARY) {
+
+                    ReadMaterialLibrary(basePath + event.name, model, materialMap);
+                }
+                else if (event.type == ObjChunkEvent::BEGIN_SHAPE) {
+
+                    shapes.insert(shapes.end(), groupShapes.begin(), groupShapes.end());
+                    groupShapes.clear();
+                    groupName = event.name;
+                }
+            }
+        }
+        shapes.insert(shapes.end(), groupShapes.begin(), groupShapes.end());
+
+        // shapes are independent, so they are welded in parallel
+        std::vector<ObjShape> welded(shapes.size());
+
+        ParallelFor(shapes.size(), chunkCount, [&](size_t s) {
+
+            ObjVertexTable table;
+            ObjShape& shape = welded[s];
+            shape.name = shapes[s].name;
+            shape.materialId = shapes[s].materialId;
+
+            for (size_t r = 0; r < shapes[s].ranges.size(); r++) {
+                for (size_t i = 0; i < shapes[s].ranges[r].second; i++) {
+                    WeldCorner(shape, table, positions, normals, texcoords, shapes[s].ranges[r].first[i]);
+                }
+            }
+
+            shape.vertices.shrink_to_fit();
+            shape.indices.shrink_to_fit();
+        });
+
+        for (size_t s = 0; s < welded.size(); s++) {
+            FinishShape(welded[s], model);
+        }
+    }
+}
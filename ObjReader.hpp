@@ -0,0 +1,109 @@
+#ifndef ObjReader_hpp
+#define ObjReader_hpp
+
+#include "Mesh.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Material declared in a .mtl library
+    struct ObjMaterial {
+
+        std::string name;
+        glm::vec3 ambient;
+        glm::vec3 diffuse;
+        glm::vec3 specular;
+        std::string ambientTexture;
+        std::string diffuseTexture;
+        std::string specularTexture;
+    };
+
+    // The faces of a group/object of the .obj file using one material, as welded, triangulated geometry
+    struct ObjShape {
+
+        std::string name;
+        // material of every face of the shape, -1 if none
+        int materialId;
+        std::vector<Vertex> vertices;
+        std::vector<GLuint> indices;
+    };
+
+    struct ObjModel {
+
+        std::vector<ObjShape> shapes;
+        std::vector<ObjMaterial> materials;
+    };
+
+    // (position, normal, texcoord) index triple of a face corner, 0-based, -1 if absent
+    struct ObjIndex {
+
+        int vertexIndex;
+        int normalIndex;
+        int texcoordIndex;
+    };
+
+    // Open addressing table mapping face corners to welded vertex indices
+    class ObjVertexTable {
+
+    public:
+        ObjVertexTable();
+
+        // Returns the welded index of the corner, or adds it as vertex nextIndex
+        GLuint Insert(const ObjIndex& key, GLuint nextIndex, bool& inserted);
+        void Clear();
+
+    private:
+        // corners are stored inline so a lookup touches a single cache line
+        struct Slot {
+
+            ObjIndex key;
+            GLuint index;
+        };
+
+        std::vector<Slot> slots;
+        size_t count;
+
+        static size_t Hash(const ObjIndex& key, size_t mask);
+        void Grow();
+    };
+
+    // Single pass .obj reader working directly on the mapped file
+    //
+    // Faces are triangulated as fans and streamed straight into the welded
+    // vertex/index arrays of the current shape, so nothing but the raw v/vn/vt
+    // arrays is kept besides the final geometry. A group switching materials
+    // becomes one shape per material.
+    //
+    // Large files are split into line-aligned chunks that are parsed on all
+    // cores; the chunks are stitched back in file order and the shapes are
+    // welded in parallel, giving exactly the same result as the serial pass.
+    class ObjReader {
+
+    public:
+        ObjReader();
+
+        bool Read(std::string fileName, std::string basePath, ObjModel& model);
+
+        // Parses .obj text already in memory
+        bool Parse(const char* data, size_t size, std::string basePath, ObjModel& model);
+
+        // Number of parsing threads, the caller and workers of the shared ThreadPool
+        // 0 picks one per worker of the pool and 1 forces the serial pass
+        void SetThreadCount(unsigned int count);
+
+        // Parse speed of the last Read/Parse call, in MB/s
+        double GetThroughput() const;
+
+    private:
+        unsigned int threadCount;
+        double throughput;
+
+        void ParseSerial(const char* data, size_t size, std::string basePath, ObjModel& model);
+        void ParseParallel(const char* data, size_t size, std::string basePath, ObjModel& model, unsigned int chunkCount);
+    };
+}
+
+#endif /* ObjReader_hpp */
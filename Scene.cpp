@@ -0,0 +1,116 @@
+#include "Scene.hpp"
+
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <iostream>
+
+namespace gps {
+
+    bool Scene::Load(std::string fileName, ModelLoader& loader) {
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        if (!manifest.Load(fileName)) {
+            return false;
+        }
+
+        models.clear();
+        for (size_t i = 0; i < manifest.models.size(); i++) {
+
+            models.push_back(std::unique_ptr<Model3D>(new Model3D()));
+            models.back()->SetCpuGeometry(manifest.models[i].cpuGeometry);
+            loader.Add(*models.back(), manifest.models[i].fileName);
+        }
+
+        orbitAngles.assign(manifest.orbits.size(), 0.0f);
+
+        transforms.resize(manifest.instances.size());
+        lodStates.assign(manifest.instances.size(), LodState());
+        groupInstances.assign(manifest.groups.size(), std::vector<size_t>());
+        orbitingInstances.clear();
+
+        for (size_t i = 0; i < manifest.instances.size(); i++) {
+
+            transforms[i] = ComputeTransform(manifest.instances[i]);
+            groupInstances[manifest.instances[i].group].push_back(i);
+            if (manifest.instances[i].orbit >= 0) {
+                orbitingInstances.push_back(i);
+            }
+        }
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Scene " << fileName << ": " << manifest.models.size() << " models, " << manifest.instances.size() << " instances, "
+            << manifest.lights.size() << " lights (" << (manifest.IsCompiled() ? "compiled" : "parsed") << " in " << milliseconds << " ms)" << std::endl;
+
+        return true;
+    }
+
+    const SceneManifest& Scene::GetManifest() const {
+
+        return manifest;
+    }
+
+    Model3D& Scene::GetModel(size_t index) {
+
+        return *models[index];
+    }
+
+    size_t Scene::GetInstanceCount() const {
+
+        return manifest.instances.size();
+    }
+
+    void Scene::Update(float deltaTime) {
+
+        for (size_t i = 0; i < orbitAngles.size(); i++) {
+            orbitAngles[i] += manifest.orbits[i].speed * deltaTime;
+        }
+
+        for (size_t i = 0; i < orbitingInstances.size(); i++) {
+
+            size_t instance = orbitingInstances[i];
+            transforms[instance] = ComputeTransform(manifest.instances[instance]);
+        }
+    }
+
+    void Scene::DrawGroup(const gps::Shader& shader, int group, const glm::mat4& view, bool depthPass) {
+
+        if (group < 0 || (size_t)group >= groupInstances.size()) {
+            return;
+        }
+
+        shader.useShaderProgram();
+        int modelUniform = shader.GetUniform("model");
+        int normalMatrixUniform = shader.GetUniform("normalMatrix");
+
+        const std::vector<size_t>& instances = groupInstances[group];
+        for (size_t i = 0; i < instances.size(); i++) {
+
+            const glm::mat4& modelMatrix = transforms[instances[i]];
+            shader.SetUniform(modelUniform, modelMatrix);
+            if (!depthPass) {
+                shader.SetUniform(normalMatrixUniform, glm::mat3(glm::inverseTranspose(view * modelMatrix)));
+            }
+            models[manifest.instances[instances[i]].model]->Draw(shader, modelMatrix, lodStates[instances[i]]);
+        }
+    }
+
+    glm::mat4 Scene::ComputeTransform(const SceneInstance& instance) const {
+
+        glm::vec3 position = instance.position;
+        if (instance.orbit >= 0) {
+
+            const SceneOrbit& orbit = manifest.orbits[instance.orbit];
+            float angle = orbitAngles[instance.orbit];
+            position += orbit.center + glm::vec3(orbit.radius * cos(angle), 0.0f, orbit.radius * sin(angle));
+        }
+
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+        transform = glm::rotate(transform, glm::radians(instance.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        transform = glm::rotate(transform, glm::radians(instance.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        transform = glm::rotate(transform, glm::radians(instance.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        return glm::scale(transform, instance.scale);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef Scene_hpp
+#define Scene_hpp
+
+#include "Model3D.hpp"
+#include "ModelLoader.hpp"
+#include "SceneManifest.hpp"
+#include "Shader.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Models and instances of a scene manifest, ready to draw
+    //
+    // Each model of the manifest is loaded once, through a ModelLoader, so
+    // the models of a scene are prepared together on the worker threads and
+    // share their meshes and textures with anything else that loads the same
+    // files. Instances only keep a transform and their levels of detail.
+    class Scene {
+
+    public:
+        // Reads the manifest and adds its models to the loader, the caller's Finish uploads them
+        bool Load(std::string fileName, ModelLoader& loader);
+
+        const SceneManifest& GetManifest() const;
+
+        Model3D& GetModel(size_t index);
+
+        size_t GetInstanceCount() const;
+
+        // Moves the instances that follow an orbit
+        void Update(float deltaTime);
+
+        // Draws every instance of a group, -1 draws nothing
+        // Sets the model matrix and, outside depth passes, the normal matrix for the given view
+        void DrawGroup(const gps::Shader& shader, int group, const glm::mat4& view, bool depthPass);
+
+    private:
+        SceneManifest manifest;
+        std::vector<std::unique_ptr<Model3D> > models;
+        // of each instance, orbiting ones are updated every frame
+        std::vector<glm::mat4> transforms;
+        std::vector<LodState> lodStates;
+        std::vector<float> orbitAngles;
+        // instance indices of every group, in manifest order
+        std::vector<std::vector<size_t> > groupInstances;
+        std::vector<size_t> orbitingInstances;
+
+        glm::mat4 ComputeTransform(const SceneInstance& instance) const;
+    };
+}
+
+#endif /* Scene_hpp */
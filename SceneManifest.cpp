@@ -0,0 +1,611 @@
+#include "SceneManifest.hpp"
+#include "AssetBaker.hpp"
+#include "AssetRegistry.hpp"
+#include "MappedFile.hpp"
+#include "VirtualFileSystem.hpp"
+
+#include <string.h>
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+namespace gps {
+
+    static const char SCENE_MANIFEST_MAGIC[8] = { 'G', 'P', 'S', 'S', 'C', 'E', 'N', 'E' };
+
+    static const char* const CPU_GEOMETRY_NAMES[] = { "keep", "positions", "none" };
+
+    struct SceneManifestHeader {
+
+        char magic[8];
+        uint32_t version;
+        uint32_t hasCamera;
+        uint64_t fileSize;
+        uint64_t sourceHash;
+        uint32_t modelCount;
+        uint32_t groupCount;
+        uint32_t instanceCount;
+        uint32_t lightCount;
+        uint32_t orbitCount;
+        uint32_t emitterCount;
+        uint32_t pathCount;
+        float camera[6];
+    };
+
+    // Instances are the bulk of a big scene, stored as one array right after the header
+    struct SceneInstanceRecord {
+
+        uint32_t model;
+        uint32_t group;
+        int32_t orbit;
+        float position[3];
+        float rotation[3];
+        float scale[3];
+    };
+
+    // Writes the variable length part of a compiled scene
+    class SceneWriter {
+
+    public:
+        std::string data;
+
+        void Write(const void* bytes, size_t size) {
+
+            data.append((const char*)bytes, size);
+        }
+
+        void WriteUint(uint32_t value) {
+
+            Write(&value, sizeof(value));
+        }
+
+        void WriteFloat(float value) {
+
+            Write(&value, sizeof(value));
+        }
+
+        void WriteVec3(glm::vec3 value) {
+
+            WriteFloat(value.x);
+            WriteFloat(value.y);
+            WriteFloat(value.z);
+        }
+
+        // strings are stored as their length followed by their bytes
+        void WriteString(const std::string& value) {
+
+            WriteUint((uint32_t)value.size());
+            Write(value.data(), value.size());
+        }
+    };
+
+    // Reads it back, every read fails once the data runs out
+    class SceneReader {
+
+    public:
+        SceneReader(const unsigned char* data, size_t size, size_t offset) : data(data), size(size), offset(offset) {}
+
+        bool Read(void* bytes, size_t count) {
+
+            if (count > size - offset) {
+                return false;
+            }
+            memcpy(bytes, data + offset, count);
+            offset += count;
+            return true;
+        }
+
+        bool ReadUint(uint32_t& value) {
+
+            return Read(&value, sizeof(value));
+        }
+
+        bool ReadFloat(float& value) {
+
+            return Read(&value, sizeof(value));
+        }
+
+        bool ReadVec3(glm::vec3& value) {
+
+            return ReadFloat(value.x) && ReadFloat(value.y) && ReadFloat(value.z);
+        }
+
+        bool ReadString(std::string& value) {
+
+            uint32_t length;
+            if (!ReadUint(length) || length > size - offset) {
+                return false;
+            }
+            value.assign((const char*)data + offset, length);
+            offset += length;
+            return true;
+        }
+
+        bool IsAtEnd() const {
+
+            return offset == size;
+        }
+
+    private:
+        const unsigned char* data;
+        size_t size;
+        size_t offset;
+    };
+
+    static bool ReadVec3(std::istringstream& stream, glm::vec3& value) {
+
+        return (bool)(stream >> value.x >> value.y >> value.z);
+    }
+
+    template <typename T>
+    static int FindByName(const std::vector<T>& items, const std::string& name) {
+
+        for (size_t i = 0; i < items.size(); i++) {
+
+            if (items[i].name == name) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    SceneManifest::SceneManifest() {
+
+        Clear();
+    }
+
+    void SceneManifest::Clear() {
+
+        models.clear();
+        groups.clear();
+        instances.clear();
+        lights.clear();
+        orbits.clear();
+        emitters.clear();
+        paths.clear();
+        hasCamera = false;
+        camera.position = glm::vec3(0.0f);
+        camera.target = glm::vec3(0.0f, 0.0f, -1.0f);
+        compiled = false;
+    }
+
+    std::string SceneManifest::GetCompiledFileName(std::string sourceFileName) {
+
+        size_t dot = sourceFileName.find_last_of('.');
+        size_t slash = sourceFileName.find_last_of('/');
+
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+            return sourceFileName + ".gpsscene";
+        }
+        return sourceFileName.substr(0, dot) + ".gpsscene";
+    }
+
+    bool SceneManifest::Load(std::string fileName) {
+
+        if (GetCompiledFileName(fileName) == fileName) {
+
+            if (!ReadCompiled(fileName, "")) {
+                fprintf(stderr, "ERROR: could not read compiled scene %s\n", fileName.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        // a scene compiled by gps_bake wins over the one the loader writes itself
+        std::string compiledFileName = GetCompiledFileName(fileName);
+        std::string bakedFileName = AssetBaker::GetBakedFileName(compiledFileName);
+
+        if ((!bakedFileName.empty() && ReadCompiled(bakedFileName, fileName)) || ReadCompiled(compiledFileName, fileName)) {
+            return true;
+        }
+
+        if (!Parse(fileName)) {
+            return false;
+        }
+        if (!WriteCompiled(compiledFileName, fileName)) {
+            fprintf(stderr, "WARNING: could not write compiled scene for %s\n", fileName.c_str());
+        }
+        return true;
+    }
+
+    bool SceneManifest::Parse(std::string fileName) {
+
+        Clear();
+
+        MappedFile file;
+        if (!VirtualFileSystem::GetShared().Open(fileName, file)) {
+            fprintf(stderr, "ERROR: could not open scene %s\n", fileName.c_str());
+            return false;
+        }
+
+        std::istringstream input(std::string((const char*)file.GetData(), file.GetSize()));
+        std::string line;
+        int lineNumber = 0;
+
+        while (std::getline(input, line)) {
+
+            lineNumber++;
+
+            size_t comment = line.find('#');
+            if (comment != std::string::npos) {
+                line.erase(comment);
+            }
+
+            std::istringstream stream(line);
+            std::string keyword;
+            if (!(stream >> keyword)) {
+                continue;
+            }
+
+            bool valid = true;
+            std::string error;
+
+            if (keyword == "model") {
+
+                SceneModel model;
+                std::string cpuGeometry = "keep";
+                valid = (bool)(stream >> model.name >> model.fileName);
+                stream >> cpuGeometry;
+
+                size_t keep = 0;
+                while (keep < 3 && cpuGeometry != CPU_GEOMETRY_NAMES[keep]) {
+                    keep++;
+                }
+                if (valid && keep == 3) {
+                    error = "unknown CPU geometry " + cpuGeometry;
+                } else if (valid && FindModel(model.name) >= 0) {
+                    error = "model " + model.name + " declared twice";
+                }
+                model.cpuGeometry = (CpuGeometry)keep;
+                models.push_back(model);
+            } else if (keyword == "instance") {
+
+                SceneInstance instance;
+                std::string modelName, groupName, orbitName;
+                valid = stream >> modelName >> groupName && ReadVec3(stream, instance.position)
+                    && ReadVec3(stream, instance.rotation) && ReadVec3(stream, instance.scale);
+                stream >> orbitName;
+
+                int model = FindModel(modelName);
+                int orbit = orbitName.empty() ? -1 : FindOrbit(orbitName);
+                if (valid && model < 0) {
+                    error = "unknown model " + modelName;
+                } else if (valid && !orbitName.empty() && orbit < 0) {
+                    error = "unknown orbit " + orbitName;
+                }
+
+                int group = FindGroup(groupName);
+                if (group < 0) {
+                    group = (int)groups.size();
+                    groups.push_back(groupName);
+                }
+
+                instance.model = (uint32_t)model;
+                instance.group = (uint32_t)group;
+                instance.orbit = orbit;
+                instances.push_back(instance);
+            } else if (keyword == "light") {
+
+                SceneLight light;
+                valid = ReadVec3(stream, light.position) && ReadVec3(stream, light.color);
+                lights.push_back(light);
+            } else if (keyword == "orbit") {
+
+                SceneOrbit orbit;
+                valid = stream >> orbit.name && ReadVec3(stream, orbit.center) && stream >> orbit.radius >> orbit.speed;
+                if (valid && FindOrbit(orbit.name) >= 0) {
+                    error = "orbit " + orbit.name + " declared twice";
+                }
+                orbits.push_back(orbit);
+            } else if (keyword == "emitter") {
+
+                SceneEmitter emitter;
+                std::string modelName;
+                valid = stream >> emitter.name >> modelName >> emitter.count && ReadVec3(stream, emitter.spawnMin)
+                    && ReadVec3(stream, emitter.spawnMax) && ReadVec3(stream, emitter.velocity)
+                    && ReadVec3(stream, emitter.scale) && stream >> emitter.floor;
+
+                int model = FindModel(modelName);
+                if (valid && model < 0) {
+                    error = "unknown model " + modelName;
+                }
+                emitter.model = (uint32_t)model;
+                emitters.push_back(emitter);
+            } else if (keyword == "camera") {
+
+                valid = ReadVec3(stream, camera.position) && ReadVec3(stream, camera.target);
+                hasCamera = true;
+            } else if (keyword == "waypoint") {
+
+                std::string pathName;
+                SceneWaypoint waypoint;
+                valid = stream >> pathName && ReadVec3(stream, waypoint.position) && ReadVec3(stream, waypoint.target);
+
+                int path = FindPath(pathName);
+                if (path < 0) {
+                    path = (int)paths.size();
+                    paths.push_back(ScenePath());
+                    paths.back().name = pathName;
+                }
+                paths[path].waypoints.push_back(waypoint);
+            } else {
+                error = "unknown declaration " + keyword;
+            }
+
+            std::string extra;
+            if (valid && error.empty() && stream >> extra) {
+                error = "unexpected " + extra;
+            }
+            if (!valid && error.empty()) {
+                error = "malformed " + keyword;
+            }
+
+            if (!error.empty()) {
+                fprintf(stderr, "ERROR: %s:%d: %s\n", fileName.c_str(), lineNumber, error.c_str());
+                Clear();
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool SceneManifest::ReadCompiled(std::string compiledFileName, std::string sourceFileName) {
+
+        Clear();
+
+        MappedFile file;
+        if (!VirtualFileSystem::GetShared().Open(compiledFileName, file)) {
+            return false;
+        }
+
+        const unsigned char* data = file.GetData();
+        size_t size = file.GetSize();
+
+        SceneManifestHeader header;
+        if (size < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (memcmp(header.magic, SCENE_MANIFEST_MAGIC, sizeof(SCENE_MANIFEST_MAGIC)) != 0 || header.version != SCENE_MANIFEST_VERSION || header.fileSize != size) {
+            return false;
+        }
+
+        // the source is small next to what parsing it costs, so its contents always decide
+        if (!sourceFileName.empty() && AssetRegistry::HashFile(sourceFileName) != header.sourceHash) {
+            return false;
+        }
+
+        SceneReader reader(data, size, sizeof(header));
+        bool valid = true;
+
+        // every other record takes at least four bytes, larger counts cannot be right
+        uint64_t recordCount = (uint64_t)header.modelCount + header.groupCount + header.lightCount + header.orbitCount + header.emitterCount + header.pathCount;
+        if ((uint64_t)header.instanceCount * sizeof(SceneInstanceRecord) + recordCount * sizeof(uint32_t) > size - sizeof(header)) {
+            return false;
+        }
+
+        std::vector<SceneInstanceRecord> records(header.instanceCount);
+        valid = reader.Read(records.data(), records.size() * sizeof(SceneInstanceRecord));
+
+        models.resize(valid ? header.modelCount : 0);
+        for (size_t i = 0; i < models.size() && valid; i++) {
+
+            uint32_t cpuGeometry;
+            valid = reader.ReadString(models[i].name) && reader.ReadString(models[i].fileName) && reader.ReadUint(cpuGeometry)
+                && cpuGeometry <= CPU_GEOMETRY_NONE;
+            models[i].cpuGeometry = (CpuGeometry)cpuGeometry;
+        }
+
+        groups.resize(valid ? header.groupCount : 0);
+        for (size_t i = 0; i < groups.size() && valid; i++) {
+            valid = reader.ReadString(groups[i]);
+        }
+
+        lights.resize(valid ? header.lightCount : 0);
+        for (size_t i = 0; i < lights.size() && valid; i++) {
+            valid = reader.ReadVec3(lights[i].position) && reader.ReadVec3(lights[i].color);
+        }
+
+        orbits.resize(valid ? header.orbitCount : 0);
+        for (size_t i = 0; i < orbits.size() && valid; i++) {
+
+            valid = reader.ReadString(orbits[i].name) && reader.ReadVec3(orbits[i].center)
+                && reader.ReadFloat(orbits[i].radius) && reader.ReadFloat(orbits[i].speed);
+        }
+
+        emitters.resize(valid ? header.emitterCount : 0);
+        for (size_t i = 0; i < emitters.size() && valid; i++) {
+
+            SceneEmitter& emitter = emitters[i];
+            valid = reader.ReadString(emitter.name) && reader.ReadUint(emitter.model) && reader.ReadUint(emitter.count)
+                && reader.ReadVec3(emitter.spawnMin) && reader.ReadVec3(emitter.spawnMax) && reader.ReadVec3(emitter.velocity)
+                && reader.ReadVec3(emitter.scale) && reader.ReadFloat(emitter.floor) && emitter.model < header.modelCount;
+        }
+
+        paths.resize(valid ? header.pathCount : 0);
+        for (size_t i = 0; i < paths.size() && valid; i++) {
+
+            uint32_t waypointCount;
+            valid = reader.ReadString(paths[i].name) && reader.ReadUint(waypointCount) && waypointCount <= size;
+            paths[i].waypoints.resize(valid ? waypointCount : 0);
+            for (size_t w = 0; w < paths[i].waypoints.size() && valid; w++) {
+                valid = reader.ReadVec3(paths[i].waypoints[w].position) && reader.ReadVec3(paths[i].waypoints[w].target);
+            }
+        }
+
+        if (!valid || !reader.IsAtEnd()) {
+            Clear();
+            return false;
+        }
+
+        instances.resize(records.size());
+        for (size_t i = 0; i < records.size(); i++) {
+
+            const SceneInstanceRecord& record = records[i];
+            if (record.model >= header.modelCount || record.group >= header.groupCount || record.orbit < -1 || record.orbit >= (int32_t)header.orbitCount) {
+                Clear();
+                return false;
+            }
+
+            instances[i].model = record.model;
+            instances[i].group = record.group;
+            instances[i].orbit = record.orbit;
+            instances[i].position = glm::vec3(record.position[0], record.position[1], record.position[2]);
+            instances[i].rotation = glm::vec3(record.rotation[0], record.rotation[1], record.rotation[2]);
+            instances[i].scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+        }
+
+        hasCamera = header.hasCamera != 0;
+        camera.position = glm::vec3(header.camera[0], header.camera[1], header.camera[2]);
+        camera.target = glm::vec3(header.camera[3], header.camera[4], header.camera[5]);
+        compiled = true;
+
+        return true;
+    }
+
+    bool SceneManifest::WriteCompiled(std::string compiledFileName, std::string sourceFileName) const {
+
+        SceneManifestHeader header;
+        memcpy(header.magic, SCENE_MANIFEST_MAGIC, sizeof(SCENE_MANIFEST_MAGIC));
+        header.version = SCENE_MANIFEST_VERSION;
+        header.hasCamera = hasCamera ? 1 : 0;
+        header.sourceHash = AssetRegistry::HashFile(sourceFileName);
+        header.modelCount = (uint32_t)models.size();
+        header.groupCount = (uint32_t)groups.size();
+        header.instanceCount = (uint32_t)instances.size();
+        header.lightCount = (uint32_t)lights.size();
+        header.orbitCount = (uint32_t)orbits.size();
+        header.emitterCount = (uint32_t)emitters.size();
+        header.pathCount = (uint32_t)paths.size();
+        for (int c = 0; c < 3; c++) {
+            header.camera[c] = camera.position[c];
+            header.camera[3 + c] = camera.target[c];
+        }
+
+        if (header.sourceHash == 0) {
+            return false;
+        }
+
+        std::vector<SceneInstanceRecord> records(instances.size());
+        for (size_t i = 0; i < instances.size(); i++) {
+
+            records[i].model = instances[i].model;
+            records[i].group = instances[i].group;
+            records[i].orbit = instances[i].orbit;
+            for (int c = 0; c < 3; c++) {
+                records[i].position[c] = instances[i].position[c];
+                records[i].rotation[c] = instances[i].rotation[c];
+                records[i].scale[c] = instances[i].scale[c];
+            }
+        }
+
+        SceneWriter writer;
+        for (size_t i = 0; i < models.size(); i++) {
+
+            writer.WriteString(models[i].name);
+            writer.WriteString(models[i].fileName);
+            writer.WriteUint((uint32_t)models[i].cpuGeometry);
+        }
+        for (size_t i = 0; i < groups.size(); i++) {
+            writer.WriteString(groups[i]);
+        }
+        for (size_t i = 0; i < lights.size(); i++) {
+
+            writer.WriteVec3(lights[i].position);
+            writer.WriteVec3(lights[i].color);
+        }
+        for (size_t i = 0; i < orbits.size(); i++) {
+
+            writer.WriteString(orbits[i].name);
+            writer.WriteVec3(orbits[i].center);
+            writer.WriteFloat(orbits[i].radius);
+            writer.WriteFloat(orbits[i].speed);
+        }
+        for (size_t i = 0; i < emitters.size(); i++) {
+
+            writer.WriteString(emitters[i].name);
+            writer.WriteUint(emitters[i].model);
+            writer.WriteUint(emitters[i].count);
+            writer.WriteVec3(emitters[i].spawnMin);
+            writer.WriteVec3(emitters[i].spawnMax);
+            writer.WriteVec3(emitters[i].velocity);
+            writer.WriteVec3(emitters[i].scale);
+            writer.WriteFloat(emitters[i].floor);
+        }
+        for (size_t i = 0; i < paths.size(); i++) {
+
+            writer.WriteString(paths[i].name);
+            writer.WriteUint((uint32_t)paths[i].waypoints.size());
+            for (size_t w = 0; w < paths[i].waypoints.size(); w++) {
+
+                writer.WriteVec3(paths[i].waypoints[w].position);
+                writer.WriteVec3(paths[i].waypoints[w].target);
+            }
+        }
+
+        header.fileSize = sizeof(header) + records.size() * sizeof(SceneInstanceRecord) + writer.data.size();
+
+        // write to a temporary file so a crash never leaves a truncated scene behind
+        std::string tempFileName = compiledFileName + ".tmp";
+        std::ofstream output(tempFileName.c_str(), std::ios::binary | std::ios::trunc);
+        if (!output) {
+            return false;
+        }
+
+        output.write((const char*)&header, sizeof(header));
+        output.write((const char*)records.data(), (std::streamsize)(records.size() * sizeof(SceneInstanceRecord)));
+        output.write(writer.data.data(), (std::streamsize)writer.data.size());
+
+        output.close();
+        if (!output) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        remove(compiledFileName.c_str());
+        if (rename(tempFileName.c_str(), compiledFileName.c_str()) != 0) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool SceneManifest::IsCompiled() const {
+
+        return compiled;
+    }
+
+    int SceneManifest::FindModel(std::string name) const {
+
+        return FindByName(models, name);
+    }
+
+    int SceneManifest::FindGroup(std::string name) const {
+
+        for (size_t i = 0; i < groups.size(); i++) {
+
+            if (groups[i] == name) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    int SceneManifest::FindOrbit(std::string name) const {
+
+        return FindByName(orbits, name);
+    }
+
+    int SceneManifest::FindEmitter(std::string name) const {
+
+        return FindByName(emitters, name);
+    }
+
+    int SceneManifest::FindPath(std::string name) const {
+
+        return FindByName(paths, name);
+    }
+}
@@ -0,0 +1,146 @@
+#ifndef SceneManifest_hpp
+#define SceneManifest_hpp
+
+#include "Mesh.hpp"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Bump whenever the layout of the compiled scene changes
+    const uint32_t SCENE_MANIFEST_VERSION = 1;
+
+    // A model file the scene uses, loaded once however many instances it has
+    struct SceneModel {
+
+        std::string name;
+        std::string fileName;
+        // what the meshes keep in system memory after the upload
+        CpuGeometry cpuGeometry;
+    };
+
+    // One placement of a model
+    struct SceneInstance {
+
+        uint32_t model;
+        // instances of a group are drawn together, with the same shader and state
+        uint32_t group;
+        // orbit the instance follows, its position is then relative to the orbit, -1 for none
+        int32_t orbit;
+        glm::vec3 position;
+        // degrees around x, y and z, applied in that order
+        glm::vec3 rotation;
+        glm::vec3 scale;
+    };
+
+    struct SceneLight {
+
+        glm::vec3 position;
+        glm::vec3 color;
+    };
+
+    // Horizontal circle around center, speed in radians per second
+    struct SceneOrbit {
+
+        std::string name;
+        glm::vec3 center;
+        float radius;
+        float speed;
+    };
+
+    // Particles spawned in a box and moving at a constant velocity, respawned once they fall below floor
+    struct SceneEmitter {
+
+        std::string name;
+        uint32_t model;
+        uint32_t count;
+        glm::vec3 spawnMin;
+        glm::vec3 spawnMax;
+        // distance per frame
+        glm::vec3 velocity;
+        glm::vec3 scale;
+        float floor;
+    };
+
+    struct SceneWaypoint {
+
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+
+    // Camera path, the waypoints in the order they are visited
+    struct ScenePath {
+
+        std::string name;
+        std::vector<SceneWaypoint> waypoints;
+    };
+
+    // Everything a scene is made of, as declared in a .scene file
+    //
+    // The text form has one declaration per line, '#' starts a comment:
+    //
+    //   model <name> <file> [keep|positions|none]
+    //   instance <model> <group> <position> <rotation> <scale> [orbit]
+    //   light <position> <color>
+    //   orbit <name> <center> <radius> <speed>
+    //   emitter <name> <model> <count> <spawn min> <spawn max> <velocity> <scale> <floor>
+    //   camera <position> <target>
+    //   waypoint <path> <position> <target>
+    //
+    // where vectors are three numbers. Models and orbits are declared before
+    // they are used, groups and paths come into being with their first use.
+    //
+    // Parsing thousands of instances takes a while, so the manifest is also
+    // compiled to a binary .gpsscene file, either next to the source the
+    // first time it is loaded or into the baked tree by gps_bake, and read
+    // back from there as long as the source has not changed.
+    class SceneManifest {
+
+    public:
+        std::vector<SceneModel> models;
+        std::vector<std::string> groups;
+        std::vector<SceneInstance> instances;
+        std::vector<SceneLight> lights;
+        std::vector<SceneOrbit> orbits;
+        std::vector<SceneEmitter> emitters;
+        std::vector<ScenePath> paths;
+        bool hasCamera;
+        SceneWaypoint camera;
+
+        SceneManifest();
+
+        void Clear();
+
+        // Reads the compiled scene, baked or next to the source, and parses the source when neither is current
+        // A .gpsscene file is read as it is
+        bool Load(std::string fileName);
+
+        // Parses a .scene file, errors name the line they were found on
+        bool Parse(std::string fileName);
+
+        // Reads a compiled scene, checked against the source it was compiled from unless sourceFileName is empty
+        bool ReadCompiled(std::string compiledFileName, std::string sourceFileName);
+
+        bool WriteCompiled(std::string compiledFileName, std::string sourceFileName) const;
+
+        // Whether the last Load came from a compiled scene
+        bool IsCompiled() const;
+
+        // Index of a declaration by name, -1 if there is none
+        int FindModel(std::string name) const;
+        int FindGroup(std::string name) const;
+        int FindOrbit(std::string name) const;
+        int FindEmitter(std::string name) const;
+        int FindPath(std::string name) const;
+
+        // Compiled scene used for a given source file
+        static std::string GetCompiledFileName(std::string sourceFileName);
+
+    private:
+        bool compiled;
+    };
+}
+
+#endif /* SceneManifest_hpp */
@@ -8,29 +8,29 @@
 
 #include "Shader.hpp"
 
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
 namespace gps {
-    std::string Shader::readShaderFile(std::string fileName) {
 
-        std::ifstream shaderFile;
-        std::string shaderString;
-        
-        //open shader file
-        shaderFile.open(fileName);
-        
-        std::stringstream shaderStringStream;
-        
-        //read shader content into stream
-        shaderStringStream << shaderFile.rdbuf();
-        
-        //close shader file
-        shaderFile.close();
-        
-        //convert stream into GLchar array
-        shaderString = shaderStringStream.str();
-        return shaderString;
+    unsigned long Shader::uniformSetCount = 0;
+    unsigned long Shader::redundantUniformSetCount = 0;
+
+    bool Shader::readShaderFile(std::string fileName, MappedFile& shaderFile) {
+
+        //map the shader file, from the asset archive when it holds it
+        if (!VirtualFileSystem::GetShared().Open(fileName, shaderFile)) {
+
+            std::cout << "Shader file " << fileName << " not found" << std::endl;
+            return false;
+        }
+        return true;
     }
     
-    void Shader::shaderCompileLog(GLuint shaderId) {
+    void Shader::shaderCompileLog(GLuint shaderId, std::string fileName) {
 
         GLint success;
         GLchar infoLog[512];
@@ -41,7 +41,7 @@ namespace gps {
         if(!success) {
 
             glGetShaderInfoLog(shaderId, 512, NULL, infoLog);
-            std::cout << "Shader compilation error\n" << infoLog << std::endl;
+            std::cout << "Shader compilation error in " << fileName << "\n" << infoLog << std::endl;
         }
     }
     
@@ -58,27 +58,103 @@ namespace gps {
         }
     }
     
-    void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName) {
+    bool Shader::ReadShaderSource(std::string fileName, std::string& source, std::vector<std::string>& included, int depth) {
 
-        //read, parse and compile the vertex shader
-        std::string v = readShaderFile(vertexShaderFileName);
-        const GLchar* vertexShaderString = v.c_str();
-        GLuint vertexShader;
-        vertexShader = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertexShader, 1, &vertexShaderString, NULL);
-        glCompileShader(vertexShader);
-        //check compilation status
-        shaderCompileLog(vertexShader);
-        
-        //read, parse and compile the vertex shader
-        std::string f = readShaderFile(fragmentShaderFileName);
-        const GLchar* fragmentShaderString = f.c_str();
-        GLuint fragmentShader;
-        fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragmentShader, 1, &fragmentShaderString, NULL);
-        glCompileShader(fragmentShader);
+        if (std::find(included.begin(), included.end(), fileName) != included.end()) {
+            return true;
+        }
+        if (depth > 16) {
+            fprintf(stderr, "ERROR: %s: includes nest too deep\n", fileName.c_str());
+            return false;
+        }
+        included.push_back(fileName);
+
+        MappedFile file;
+        if (!readShaderFile(fileName, file)) {
+            return false;
+        }
+
+        //includes are relative to the including file
+        std::string directory;
+        size_t slash = fileName.find_last_of("/\\");
+        if (slash != std::string::npos) {
+            directory = fileName.substr(0, slash + 1);
+        }
+
+        const char* text = (const char*)file.GetData();
+        size_t size = file.GetSize();
+        bool succeeded = true;
+
+        for (size_t lineStart = 0; lineStart < size; ) {
+
+            size_t lineEnd = lineStart;
+            while (lineEnd < size && text[lineEnd] != '\n') {
+                lineEnd++;
+            }
+            std::string line(text + lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 1;
+
+            size_t first = line.find_first_not_of(" \t");
+            if (first == std::string::npos || line.compare(first, 8, "#include") != 0) {
+                source += line;
+                source += '\n';
+                continue;
+            }
+
+            size_t open = line.find('"', first + 8);
+            size_t close = open != std::string::npos ? line.find('"', open + 1) : std::string::npos;
+            if (close == std::string::npos) {
+                fprintf(stderr, "ERROR: %s: malformed include: %s\n", fileName.c_str(), line.c_str());
+                succeeded = false;
+                continue;
+            }
+            succeeded = ReadShaderSource(directory + line.substr(open + 1, close - open - 1), source, included, depth + 1) && succeeded;
+        }
+
+        return succeeded;
+    }
+
+    GLuint Shader::CompileStage(GLenum type, std::string fileName, const std::vector<std::string>& defines) {
+
+        std::string body;
+        std::vector<std::string> included;
+        ReadShaderSource(fileName, body, included, 0);
+
+        //#version has to come first, the defines follow it
+        std::string source;
+        size_t version = body.find("#version");
+        if (version != std::string::npos) {
+
+            size_t versionEnd = body.find('\n', version);
+            versionEnd = versionEnd != std::string::npos ? versionEnd + 1 : body.size();
+            source = body.substr(0, versionEnd);
+            body.erase(0, versionEnd);
+        }
+        for (size_t i = 0; i < defines.size(); i++) {
+            source += "#define " + defines[i] + "\n";
+        }
+        source += body;
+
+        const GLchar* shaderString = source.c_str();
+        GLint shaderLength = (GLint)source.size();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &shaderString, &shaderLength);
+        glCompileShader(shader);
         //check compilation status
-        shaderCompileLog(fragmentShader);
+        shaderCompileLog(shader, fileName);
+        return shader;
+    }
+
+    void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName) {
+
+        loadShader(vertexShaderFileName, fragmentShaderFileName, std::vector<std::string>());
+    }
+
+    void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName, const std::vector<std::string>& defines) {
+
+        //read, parse and compile both stages
+        GLuint vertexShader = CompileStage(GL_VERTEX_SHADER, vertexShaderFileName, defines);
+        GLuint fragmentShader = CompileStage(GL_FRAGMENT_SHADER, fragmentShaderFileName, defines);
         
         //attach and link the shader programs
         this->shaderProgram = glCreateProgram();
@@ -89,11 +165,192 @@ namespace gps {
         glDeleteShader(fragmentShader);
         //check linking info
         shaderLinkLog(this->shaderProgram);
+        //look up every uniform once
+        ReflectUniforms();
+        BindUniformBlocks();
     }
     
-    void Shader::useShaderProgram() {
+    void Shader::useShaderProgram() const {
 
         glUseProgram(this->shaderProgram);
     }
 
+    void Shader::ReflectUniforms() {
+
+        uniforms.clear();
+        uniformIndices.clear();
+
+        GLint uniformCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(this->shaderProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+        glGetProgramiv(this->shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+        std::vector<GLchar> name(maxNameLength > 0 ? maxNameLength : 1);
+
+        for (GLint i = 0; i < uniformCount; i++) {
+
+            ShaderUniform uniform;
+            GLsizei nameLength = 0;
+            glGetActiveUniform(this->shaderProgram, (GLuint)i, (GLsizei)name.size(), &nameLength, &uniform.size, &uniform.type, name.data());
+            uniform.name = std::string(name.data(), nameLength);
+
+            //arrays are reported as their first element
+            if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0) {
+                uniform.name.erase(uniform.name.size() - 3);
+            }
+
+            //members of uniform blocks have no location
+            uniform.location = glGetUniformLocation(this->shaderProgram, uniform.name.c_str());
+            if (uniform.location < 0) {
+                continue;
+            }
+            uniform.valueSet = false;
+
+            uniformIndices[uniform.name] = (int)uniforms.size();
+            uniforms.push_back(uniform);
+        }
+    }
+
+    std::unordered_map<std::string, GLuint>& Shader::GetUniformBlockBindings() {
+
+        static std::unordered_map<std::string, GLuint> bindings;
+        return bindings;
+    }
+
+    void Shader::SetUniformBlockBinding(const std::string& blockName, GLuint binding) {
+
+        GetUniformBlockBindings()[blockName] = binding;
+    }
+
+    void Shader::BindUniformBlocks() {
+
+        GLint blockCount = 0;
+        GLint maxNameLength = 0;
+        glGetProgramiv(this->shaderProgram, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+        glGetProgramiv(this->shaderProgram, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxNameLength);
+
+        std::vector<GLchar> name(maxNameLength > 0 ? maxNameLength : 1);
+        const std::unordered_map<std::string, GLuint>& bindings = GetUniformBlockBindings();
+
+        for (GLint i = 0; i < blockCount; i++) {
+
+            GLsizei nameLength = 0;
+            glGetActiveUniformBlockName(this->shaderProgram, (GLuint)i, (GLsizei)name.size(), &nameLength, name.data());
+            std::string blockName(name.data(), nameLength);
+
+            std::unordered_map<std::string, GLuint>::const_iterator found = bindings.find(blockName);
+            if (found == bindings.end()) {
+                fprintf(stderr, "WARNING: uniform block %s has no buffer, it reads zeros\n", blockName.c_str());
+                continue;
+            }
+            glUniformBlockBinding(this->shaderProgram, (GLuint)i, found->second);
+        }
+    }
+
+    int Shader::GetUniform(const std::string& name) const {
+
+        std::unordered_map<std::string, int>::const_iterator found = uniformIndices.find(name);
+        return found != uniformIndices.end() ? found->second : -1;
+    }
+
+    const std::vector<ShaderUniform>& Shader::GetUniforms() const {
+
+        return uniforms;
+    }
+
+    bool Shader::UpdateShadow(int uniform, const void* value, size_t size) const {
+
+        if (uniform < 0 || (size_t)uniform >= uniforms.size()) {
+            return false;
+        }
+
+        ShaderUniform& shadow = uniforms[uniform];
+        uniformSetCount++;
+
+        if (shadow.valueSet && memcmp(shadow.value, value, size) == 0) {
+            redundantUniformSetCount++;
+            return false;
+        }
+
+        memcpy(shadow.value, value, size);
+        shadow.valueSet = true;
+        return true;
+    }
+
+    void Shader::SetUniform(int uniform, GLint value) const {
+
+        if (UpdateShadow(uniform, &value, sizeof(value))) {
+            glProgramUniform1i(this->shaderProgram, uniforms[uniform].location, value);
+        }
+    }
+
+    void Shader::SetUniform(int uniform, GLfloat value) const {
+
+        if (UpdateShadow(uniform, &value, sizeof(value))) {
+            glProgramUniform1f(this->shaderProgram, uniforms[uniform].location, value);
+        }
+    }
+
+    void Shader::SetUniform(int uniform, const glm::vec3& value) const {
+
+        if (UpdateShadow(uniform, glm::value_ptr(value), sizeof(value))) {
+            glProgramUniform3fv(this->shaderProgram, uniforms[uniform].location, 1, glm::value_ptr(value));
+        }
+    }
+
+    void Shader::SetUniform(int uniform, const glm::mat3& value) const {
+
+        if (UpdateShadow(uniform, glm::value_ptr(value), sizeof(value))) {
+            glProgramUniformMatrix3fv(this->shaderProgram, uniforms[uniform].location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+    }
+
+    void Shader::SetUniform(int uniform, const glm::mat4& value) const {
+
+        if (UpdateShadow(uniform, glm::value_ptr(value), sizeof(value))) {
+            glProgramUniformMatrix4fv(this->shaderProgram, uniforms[uniform].location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+    }
+
+    void Shader::SetUniform(const std::string& name, GLint value) const {
+
+        SetUniform(GetUniform(name), value);
+    }
+
+    void Shader::SetUniform(const std::string& name, GLfloat value) const {
+
+        SetUniform(GetUniform(name), value);
+    }
+
+    void Shader::SetUniform(const std::string& name, const glm::vec3& value) const {
+
+        SetUniform(GetUniform(name), value);
+    }
+
+    void Shader::SetUniform(const std::string& name, const glm::mat3& value) const {
+
+        SetUniform(GetUniform(name), value);
+    }
+
+    void Shader::SetUniform(const std::string& name, const glm::mat4& value) const {
+
+        SetUniform(GetUniform(name), value);
+    }
+
+    unsigned long Shader::GetUniformSetCount() {
+
+        return uniformSetCount;
+    }
+
+    unsigned long Shader::GetRedundantUniformSetCount() {
+
+        return redundantUniformSetCount;
+    }
+
+    void Shader::ResetStats() {
+
+        uniformSetCount = 0;
+        redundantUniformSetCount = 0;
+    }
+
 }
@@ -17,24 +17,113 @@
     #include <GL/glew.h>
 #endif
 
+#include "MappedFile.hpp"
+#include "VirtualFileSystem.hpp"
+
+#include <glm/glm.hpp>
+
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 
 namespace gps {
-    
+
+    // Active uniform of a linked program, with the value last set through the shader
+    struct ShaderUniform {
+
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint size;
+        // unknown until the first set, the program may start from an initializer in the source
+        bool valueSet;
+        GLfloat value[16];
+    };
+
+    // A linked program and its uniforms
+    //
+    // Every active uniform is looked up once, after linking, and kept in a
+    // table hashed by name. The setters go through that table instead of
+    // glGetUniformLocation and remember what they set, so a value the
+    // program already holds costs a compare and no GL call. They use
+    // glProgramUniform, the program does not have to be in use.
+    //
+    // Uniforms set straight through the GL bypass the shadow values, so a
+    // program's uniforms go through the setters or not at all.
+    //
+    // Uniform blocks are pointed at the binding registered for their name
+    // when the program is linked, so blocks shared through a UniformBuffer
+    // need no setup per program.
+    //
+    // Sources may pull in other files with #include "file", relative to the
+    // including file and read through the virtual file system. A file is
+    // included once per stage, later includes of it are dropped.
     class Shader {
 
     public:
         GLuint shaderProgram;
         void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName);
-        void useShaderProgram();
-    
+        // Compiles both stages with a #define for each entry, "NAME" or "NAME VALUE"
+        void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName, const std::vector<std::string>& defines);
+        void useShaderProgram() const;
+
+        // Index of an active uniform, -1 for names the program does not use, which the setters ignore
+        // Resolving the index once saves the hash lookup of the setters taking a name
+        int GetUniform(const std::string& name) const;
+
+        const std::vector<ShaderUniform>& GetUniforms() const;
+
+        void SetUniform(int uniform, GLint value) const;
+        void SetUniform(int uniform, GLfloat value) const;
+        void SetUniform(int uniform, const glm::vec3& value) const;
+        void SetUniform(int uniform, const glm::mat3& value) const;
+        void SetUniform(int uniform, const glm::mat4& value) const;
+
+        void SetUniform(const std::string& name, GLint value) const;
+        void SetUniform(const std::string& name, GLfloat value) const;
+        void SetUniform(const std::string& name, const glm::vec3& value) const;
+        void SetUniform(const std::string& name, const glm::mat3& value) const;
+        void SetUniform(const std::string& name, const glm::mat4& value) const;
+
+        // Uniform sets of every shader since the last reset, and how many of them were skipped as redundant
+        static unsigned long GetUniformSetCount();
+        static unsigned long GetRedundantUniformSetCount();
+        static void ResetStats();
+
+        // Binds the blocks named blockName of programs linked from now on to binding
+        static void SetUniformBlockBinding(const std::string& blockName, GLuint binding);
+
     private:
-        std::string readShaderFile(std::string fileName);
-        void shaderCompileLog(GLuint shaderId);
+        // the shadow values change on sets through a const shader, like the program they mirror
+        mutable std::vector<ShaderUniform> uniforms;
+        std::unordered_map<std::string, int> uniformIndices;
+
+        static unsigned long uniformSetCount;
+        static unsigned long redundantUniformSetCount;
+        static std::unordered_map<std::string, GLuint>& GetUniformBlockBindings();
+
+        bool readShaderFile(std::string fileName, MappedFile& shaderFile);
+        void shaderCompileLog(GLuint shaderId, std::string fileName);
         void shaderLinkLog(GLuint shaderProgramId);
+
+        // Appends a file to source with its includes expanded, false if any of them is missing
+        bool ReadShaderSource(std::string fileName, std::string& source, std::vector<std::string>& included, int depth);
+
+        // Reads, expands and compiles one stage, the defines go right after its #version line
+        GLuint CompileStage(GLenum type, std::string fileName, const std::vector<std::string>& defines);
+
+        // Fills the uniform table of the linked program
+        void ReflectUniforms();
+
+        // Binds the uniform blocks of the linked program to their registered binding points
+        void BindUniformBlocks();
+
+        // Records a set, returns false when the uniform is unknown or already holds the value
+        bool UpdateShadow(int uniform, const void* value, size_t size) const;
     };
     
 }
@@ -0,0 +1,101 @@
+#include "ShaderVariants.hpp"
+
+#include <chrono>
+#include <stdio.h>
+
+namespace gps {
+
+    struct ShaderFeatureName {
+
+        ShaderFeature feature;
+        const char* define;
+    };
+
+    static const ShaderFeatureName SHADER_FEATURE_NAMES[] = {
+        { SHADER_NIGHT, "NIGHT" },
+        { SHADER_FOG, "FOG" },
+        { SHADER_SHADOWS, "SHADOWS" },
+        { SHADER_ALPHA_TEST, "ALPHA_TEST" }
+    };
+
+    ShaderVariants::ShaderVariants() {
+
+        fallback = NULL;
+    }
+
+    void ShaderVariants::Load(std::string vertexShaderFileName, std::string fragmentShaderFileName) {
+
+        this->vertexShaderFileName = vertexShaderFileName;
+        this->fragmentShaderFileName = fragmentShaderFileName;
+        variants.clear();
+        fallback = NULL;
+        reportedMisses.clear();
+    }
+
+    void ShaderVariants::Compile(const ShaderPermutation& permutation) {
+
+        std::unique_ptr<Shader>& variant = variants[GetKey(permutation)];
+        if (variant) {
+            return;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<std::string> defines = GetDefines(permutation);
+        variant.reset(new Shader());
+        variant->loadShader(vertexShaderFileName, fragmentShaderFileName, defines);
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Shader " << fragmentShaderFileName << ":";
+        for (size_t i = 0; i < defines.size(); i++) {
+            std::cout << " " << defines[i];
+        }
+        std::cout << " (compiled in " << milliseconds << " ms)" << std::endl;
+
+        if (!fallback) {
+            fallback = variant.get();
+        }
+    }
+
+    const Shader& ShaderVariants::Get(const ShaderPermutation& permutation) const {
+
+        unsigned int key = GetKey(permutation);
+        std::unordered_map<unsigned int, std::unique_ptr<Shader> >::const_iterator found = variants.find(key);
+        if (found != variants.end()) {
+            return *found->second;
+        }
+
+        if (reportedMisses.insert(key).second) {
+
+            std::vector<std::string> defines = GetDefines(permutation);
+            std::string names;
+            for (size_t i = 0; i < defines.size(); i++) {
+                names += " " + defines[i];
+            }
+            fprintf(stderr, "ERROR: %s was not compiled with%s\n", fragmentShaderFileName.c_str(), names.c_str());
+        }
+        return *fallback;
+    }
+
+    size_t ShaderVariants::GetVariantCount() const {
+
+        return variants.size();
+    }
+
+    std::vector<std::string> ShaderVariants::GetDefines(const ShaderPermutation& permutation) {
+
+        std::vector<std::string> defines;
+        for (size_t i = 0; i < sizeof(SHADER_FEATURE_NAMES) / sizeof(SHADER_FEATURE_NAMES[0]); i++) {
+            if (permutation.features & SHADER_FEATURE_NAMES[i].feature) {
+                defines.push_back(SHADER_FEATURE_NAMES[i].define);
+            }
+        }
+        defines.push_back("POINT_LIGHT_COUNT " + std::to_string(permutation.pointLightCount));
+        return defines;
+    }
+
+    unsigned int ShaderVariants::GetKey(const ShaderPermutation& permutation) {
+
+        return permutation.features | ((unsigned int)permutation.pointLightCount << 16);
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef ShaderVariants_hpp
+#define ShaderVariants_hpp
+
+#include "Shader.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace gps {
+
+    // Features a variant compiles in, each one a #define of the same name without the prefix
+    enum ShaderFeature {
+
+        // no sun, only the point lights
+        SHADER_NIGHT = 1 << 0,
+        SHADER_FOG = 1 << 1,
+        // sun light is tested against the shadow map
+        SHADER_SHADOWS = 1 << 2,
+        // fragments with almost no alpha are discarded
+        SHADER_ALPHA_TEST = 1 << 3
+    };
+
+    // What a draw needs from the lit shaders
+    struct ShaderPermutation {
+
+        // ShaderFeature bits
+        unsigned int features;
+        // becomes POINT_LIGHT_COUNT, lights past it are not evaluated
+        int pointLightCount;
+    };
+
+    // The specializations of one pair of shader files
+    //
+    // Instead of branching on uniforms, the sources test #defines, and every
+    // combination of features a draw asks for is compiled into a program of
+    // its own, so a fragment only pays for the lighting actually in use.
+    // Every permutation a draw can ask for is compiled while loading, a
+    // compile in the middle of a frame would stall it. Each variant keeps
+    // its own uniform table.
+    class ShaderVariants {
+
+    public:
+        ShaderVariants();
+
+        void Load(std::string vertexShaderFileName, std::string fragmentShaderFileName);
+
+        // Compiles the program for a permutation unless it already exists
+        void Compile(const ShaderPermutation& permutation);
+
+        // The program compiled for a permutation, never compiles
+        // A permutation that was not compiled is reported once and drawn with the first variant
+        const Shader& Get(const ShaderPermutation& permutation) const;
+
+        size_t GetVariantCount() const;
+
+        // The defines a permutation compiles with
+        static std::vector<std::string> GetDefines(const ShaderPermutation& permutation);
+
+    private:
+        std::string vertexShaderFileName;
+        std::string fragmentShaderFileName;
+        // by features and light count, see GetKey
+        std::unordered_map<unsigned int, std::unique_ptr<Shader> > variants;
+        const Shader* fallback;
+        mutable std::unordered_set<unsigned int> reportedMisses;
+
+        static unsigned int GetKey(const ShaderPermutation& permutation);
+    };
+}
+
+#endif /* ShaderVariants_hpp */
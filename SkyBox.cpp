@@ -7,63 +7,174 @@
 //
 
 #include "SkyBox.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <future>
 
 namespace gps {
     
+    // Faces of one cubemap, in the order of GL_TEXTURE_CUBE_MAP_POSITIVE_X onwards
+    static const size_t CUBEMAP_FACE_COUNT = 6;
+    
     SkyBox::SkyBox()
     {
-        
+        skyboxVAO = 0;
+        skyboxVBO = 0;
+        night = false;
+        nightBlend = 0.0f;
     }
     
-    void SkyBox::Load(std::vector<const GLchar*> cubeMapFaces)
+    void SkyBox::Load(std::vector<const GLchar*> dayFaces, std::vector<const GLchar*> nightFaces)
     {
-        cubemapTexture = LoadSkyBoxTextures(cubeMapFaces);
-        InitSkyBox();
+        AssetRegistry& registry = AssetRegistry::GetShared();
+        
+        std::vector<const GLchar*>* faceSets[2] = { &dayFaces, &nightFaces };
+        std::shared_ptr<TextureAsset>* cubemaps[2] = { &dayCubemap, &nightCubemap };
+        std::string keys[2];
+        uint64_t contentHashes[2] = { 0, 0 };
+        
+        // decoded faces of both cubemaps, filled by the pool
+        TextureData faces[2][CUBEMAP_FACE_COUNT];
+        int loaded[2][CUBEMAP_FACE_COUNT] = { { 0 } };
+        std::vector<std::future<void> > decoding;
+        
+        for (size_t c = 0; c < 2; c++)
+        {
+            if (faceSets[c]->size() != CUBEMAP_FACE_COUNT)
+            {
+                fprintf(stderr, "ERROR: a cubemap needs %zu faces, got %zu\n", CUBEMAP_FACE_COUNT, faceSets[c]->size());
+                continue;
+            }
+            
+            // the six faces together identify the cubemap
+            for (size_t i = 0; i < CUBEMAP_FACE_COUNT; i++)
+            {
+                keys[c] += AssetRegistry::GetCanonicalPath((*faceSets[c])[i]) + "\n";
+                contentHashes[c] = contentHashes[c] * 31 + AssetRegistry::HashFile((*faceSets[c])[i]);
+            }
+            
+            *cubemaps[c] = std::static_pointer_cast<TextureAsset>(registry.Find(ASSET_CUBEMAP, keys[c], contentHashes[c]));
+            if (*cubemaps[c])
+            {
+                continue;
+            }
+            
+            // block compressed from the texture cache when possible, faces need no mipmaps
+            for (size_t i = 0; i < CUBEMAP_FACE_COUNT; i++)
+            {
+                std::string path = (*faceSets[c])[i];
+                TextureData* face = &faces[c][i];
+                int* faceLoaded = &loaded[c][i];
+                decoding.push_back(ThreadPool::GetShared().Submit([path, face, faceLoaded]() {
+                    *faceLoaded = TextureCache::Load(path, false, false, *face) ? 1 : 0;
+                }));
+            }
+        }
+        
+        for (size_t i = 0; i < decoding.size(); i++)
+        {
+            decoding[i].wait();
+        }
+        
+        for (size_t c = 0; c < 2; c++)
+        {
+            if (*cubemaps[c] || keys[c].empty())
+            {
+                continue;
+            }
+            
+            bool complete = true;
+            for (size_t i = 0; i < CUBEMAP_FACE_COUNT; i++)
+            {
+                if (!loaded[c][i])
+                {
+                    fprintf(stderr, "ERROR: could not load cubemap face %s\n", (*faceSets[c])[i]);
+                    complete = false;
+                }
+            }
+            if (!complete)
+            {
+                continue;
+            }
+            
+            size_t gpuBytes = 0;
+            GLuint textureID = UploadCubemap(faces[c], gpuBytes);
+            *cubemaps[c] = std::make_shared<TextureAsset>(textureID, gpuBytes);
+            registry.Add(ASSET_CUBEMAP, keys[c], contentHashes[c], *cubemaps[c]);
+        }
+        
+        if (skyboxVAO == 0)
+        {
+            InitSkyBox();
+        }
     }
     
-    void SkyBox::Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix)
+    void SkyBox::Draw(const gps::Shader& shader)
     {
         shader.useShaderProgram();
         
-        //set the view and projection matrices
-        glm::mat4 transformedView = glm::mat4(glm::mat3(viewMatrix));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(transformedView));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
+        //the vertex shader drops the translation of the view
+        shader.SetUniform("nightBlend", nightBlend);
         
         glDepthFunc(GL_LEQUAL);
         
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
-        glUniform1i(glGetUniformLocation(shader.shaderProgram, "skybox"), 0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        shader.SetUniform("skybox", 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, GetTextureId());
+        glActiveTexture(GL_TEXTURE1);
+        shader.SetUniform("nightSkybox", 1);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, GetNightTextureId());
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        
         glDepthFunc(GL_LESS);
     }
     
-    GLuint SkyBox::LoadSkyBoxTextures(std::vector<const GLchar*> skyBoxFaces)
+    void SkyBox::SetNight(bool night)
+    {
+        this->night = night;
+    }
+    
+    void SkyBox::Update(float deltaSeconds)
+    {
+        float step = deltaSeconds / SKYBOX_FADE_SECONDS;
+        nightBlend = night ? std::min(nightBlend + step, 1.0f) : std::max(nightBlend - step, 0.0f);
+    }
+    
+    float SkyBox::GetNightBlend()
+    {
+        return nightBlend;
+    }
+    
+    GLuint SkyBox::UploadCubemap(const TextureData* faces, size_t& gpuBytes)
     {
         GLuint textureID;
         glGenTextures(1, &textureID);
         glActiveTexture(GL_TEXTURE0);
         
-        int width,height, n;
-        unsigned char* image;
-        int force_channels = 3;
-        
         glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-        for(GLuint i = 0; i < skyBoxFaces.size(); i++)
+        for(GLuint i = 0; i < CUBEMAP_FACE_COUNT; i++)
         {
-            image = stbi_load(skyBoxFaces[i], &width, &height, &n, force_channels);
-            if (!image) {
-                fprintf(stderr, "ERROR: could not load %s\n", skyBoxFaces[i]);
-                return false;
+            const TextureData& face = faces[i];
+            const TextureLevel& level = face.levels[0];
+            if (face.compressed) {
+                glCompressedTexImage2D(
+                                       GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
+                                       face.internalFormat, level.width, level.height, 0, (GLsizei)level.size, face.GetData() + level.offset
+                                       );
+            } else {
+                glTexImage2D(
+                             GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
+                             GL_RGBA, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, face.GetData() + level.offset
+                             );
             }
-            glTexImage2D(
-                         GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
-                         GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image
-                         );
+            gpuBytes += level.size;
         }
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -136,6 +247,11 @@ namespace gps {
     
     GLuint SkyBox::GetTextureId()
     {
-        return cubemapTexture;
+        return dayCubemap ? dayCubemap->id : 0;
+    }
+    
+    GLuint SkyBox::GetNightTextureId()
+    {
+        return nightCubemap ? nightCubemap->id : 0;
     }
 }
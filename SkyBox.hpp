@@ -11,27 +11,55 @@
 
 
 #include "Shader.hpp"
+#include "AssetRegistry.hpp"
+#include "TextureCache.hpp"
 #include "stb_image.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <memory>
+#include <string>
 #include <vector>
 #include <stdio.h>
 
 namespace gps {
+
+    // Seconds the sky takes to fade between day and night
+    const float SKYBOX_FADE_SECONDS = 1.5f;
+
+    // Day and night cubemaps, both resident once loaded
+    //
+    // The twelve faces are decoded together on the shared thread pool and
+    // uploaded when all are done. Switching between day and night only moves
+    // the blend factor the fragment shader mixes the two samplers with, so a
+    // toggle allocates nothing and never waits on the disk.
     class SkyBox
     {
     public:
         SkyBox();
-        void Load(std::vector<const GLchar*> cubeMapFaces);
-        void Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix);
+        void Load(std::vector<const GLchar*> dayFaces, std::vector<const GLchar*> nightFaces);
+        // The view and projection come from the FrameConstants block
+        void Draw(const gps::Shader& shader);
+
+        // Starts fading towards the night (or day) sky
+        void SetNight(bool night);
+        // Advances the fade, once per frame
+        void Update(float deltaSeconds);
+        // 0 for day, 1 for night, in between while fading
+        float GetNightBlend();
+
         GLuint GetTextureId();
+        GLuint GetNightTextureId();
     private:
         GLuint skyboxVAO;
         GLuint skyboxVBO;
-        GLuint cubemapTexture;
-        GLuint LoadSkyBoxTextures(std::vector<const GLchar*> cubeMapFaces);
+        // keep the cubemaps alive, shared with any other skybox using the same faces
+        std::shared_ptr<TextureAsset> dayCubemap;
+        std::shared_ptr<TextureAsset> nightCubemap;
+        bool night;
+        float nightBlend;
+        GLuint UploadCubemap(const TextureData* faces, size_t& gpuBytes);
         void InitSkyBox();
     };
 }
@@ -0,0 +1,175 @@
+#include "TextureBenchmark.hpp"
+#include "TextureCache.hpp"
+
+#include "stb_image.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdio.h>
+
+namespace gps {
+
+    // best of a few runs, the first one also pays for the disk cache
+    static const int BENCHMARK_RUNS = 3;
+
+    static double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Scalar byte swap the loader used before
+    static void FlipRows(unsigned char* image_data, int x, int y) {
+
+        int width_in_bytes = x * 4;
+        unsigned char *top = NULL;
+        unsigned char *bottom = NULL;
+        unsigned char temp = 0;
+        int half_height = y / 2;
+
+        for (int row = 0; row < half_height; row++) {
+
+            top = image_data + row * width_in_bytes;
+            bottom = image_data + (y - row - 1) * width_in_bytes;
+
+            for (int col = 0; col < width_in_bytes; col++) {
+
+                temp = *top;
+                *top = *bottom;
+                *bottom = temp;
+                top++;
+                bottom++;
+            }
+        }
+    }
+
+    struct StageTimes {
+
+        double decode;
+        double mips;
+        double upload;
+    };
+
+    static void KeepBest(StageTimes& best, const StageTimes& run) {
+
+        best.decode = run.decode < best.decode ? run.decode : best.decode;
+        best.mips = run.mips < best.mips ? run.mips : best.mips;
+        best.upload = run.upload < best.upload ? run.upload : best.upload;
+    }
+
+    static void PrintStages(const char* name, const StageTimes& times, double megapixels) {
+
+        printf("  %-28s decode+flip %7.2f  mips %7.2f  upload %7.2f  total %7.2f ms/MP\n", name,
+            times.decode / megapixels, times.mips / megapixels, times.upload / megapixels,
+            (times.decode + times.mips + times.upload) / megapixels);
+    }
+
+    // stb_image decode, scalar flip, glTexImage2D then glGenerateMipmap on the driver
+    static StageTimes RunOldPath(const std::string& fileName) {
+
+        StageTimes times;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        int x, y, n;
+        stbi_set_flip_vertically_on_load_thread(0);
+        unsigned char* image_data = stbi_load(fileName.c_str(), &x, &y, &n, 4);
+        FlipRows(image_data, x, y);
+        times.decode = MillisecondsSince(start);
+
+        GLuint textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+
+        start = std::chrono::steady_clock::now();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
+        glFinish();
+        times.upload = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+        times.mips = MillisecondsSince(start);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDeleteTextures(1, &textureID);
+        stbi_image_free(image_data);
+
+        return times;
+    }
+
+    // flip while decoding, CPU mip chain, immutable storage and one upload per level
+    static StageTimes RunNewPath(const std::string& fileName, MipFilter filter) {
+
+        StageTimes times;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        int x, y;
+        unsigned char* image_data = TextureCache::DecodeImage(fileName.c_str(), true, x, y);
+        times.decode = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        TextureData texture;
+        TextureCache::BuildMipChain(image_data, x, y, true, filter, texture);
+        times.mips = MillisecondsSince(start);
+
+        GLuint textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+
+        start = std::chrono::steady_clock::now();
+        bool immutable = TextureCache::IsStorageSupported();
+        if (immutable) {
+            glTexStorage2D(GL_TEXTURE_2D, (GLsizei)texture.levels.size(), GL_RGBA8, x, y);
+        }
+        for (size_t i = 0; i < texture.levels.size(); i++) {
+
+            const TextureLevel& level = texture.levels[i];
+            if (immutable) {
+                glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    texture.GetData() + level.offset);
+            } else {
+                glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                    texture.GetData() + level.offset);
+            }
+        }
+        glFinish();
+        times.upload = MillisecondsSince(start);
+
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDeleteTextures(1, &textureID);
+        stbi_image_free(image_data);
+
+        return times;
+    }
+
+    void RunTextureBenchmark(const std::vector<std::string>& fileNames) {
+
+        std::cout << "Texture path benchmark, best of " << BENCHMARK_RUNS << " runs, "
+            << (TextureCache::IsStorageSupported() ? "glTexStorage2D" : "glTexImage2D per level") << " on the new path" << std::endl;
+
+        for (size_t f = 0; f < fileNames.size(); f++) {
+
+            int x, y, n;
+            if (!stbi_info(fileNames[f].c_str(), &x, &y, &n)) {
+                fprintf(stderr, "ERROR: could not load %s\n", fileNames[f].c_str());
+                continue;
+            }
+            double megapixels = x * (double)y / 1e6;
+
+            StageTimes oldPath = { 1e30, 1e30, 1e30 };
+            StageTimes boxPath = { 1e30, 1e30, 1e30 };
+            StageTimes kaiserPath = { 1e30, 1e30, 1e30 };
+
+            for (int run = 0; run < BENCHMARK_RUNS; run++) {
+
+                KeepBest(oldPath, RunOldPath(fileNames[f]));
+                KeepBest(boxPath, RunNewPath(fileNames[f], MIP_FILTER_BOX));
+                KeepBest(kaiserPath, RunNewPath(fileNames[f], MIP_FILTER_KAISER));
+            }
+
+            std::cout << fileNames[f] << " (" << x << "x" << y << ", " << megapixels << " MP)" << std::endl;
+            PrintStages("old (driver mips)", oldPath, megapixels);
+            PrintStages("new (sRGB box mips)", boxPath, megapixels);
+            PrintStages("new (sRGB Kaiser mips)", kaiserPath, megapixels);
+        }
+    }
+}
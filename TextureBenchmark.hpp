@@ -0,0 +1,16 @@
+#ifndef TextureBenchmark_hpp
+#define TextureBenchmark_hpp
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Times the old texture path (scalar flip, glTexImage2D + glGenerateMipmap)
+    // against the new one (flip while decoding, CPU mips, immutable storage with
+    // per-level uploads) and prints the cost of each stage per megapixel.
+    // Needs a current GL context.
+    void RunTextureBenchmark(const std::vector<std::string>& fileNames);
+}
+
+#endif /* TextureBenchmark_hpp */
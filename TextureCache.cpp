@@ -0,0 +1,599 @@
+#include "TextureCache.hpp"
+#include "AssetBaker.hpp"
+#include "AssetRegistry.hpp"
+#include "BlockCompression.hpp"
+#include "VirtualFileSystem.hpp"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace gps {
+
+    static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    static const uint32_t KTX_ENDIANNESS = 0x04030201;
+    // key/value entry identifying the source image, keys starting with KTX are reserved
+    static const char SOURCE_KEY[] = "GPSsource";
+
+    static const uint32_t FLAG_FLIPPED = 1;
+    static const uint32_t FLAG_MIPMAPS = 2;
+
+    struct KtxHeader {
+
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    struct SourceKey {
+
+        uint32_t version;
+        uint32_t flags;
+        uint64_t sourceSize;
+        int64_t sourceModifiedTime;
+        uint64_t sourceHash;
+    };
+
+    // sRGB <-> linear tables, the mips are filtered in linear light so they do not darken
+    struct SrgbTables {
+
+        float toLinear[256];
+        unsigned char toSrgb[4096];
+
+        SrgbTables() {
+
+            for (int i = 0; i < 256; i++) {
+
+                float value = i / 255.0f;
+                toLinear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < 4096; i++) {
+
+                float value = i / 4095.0f;
+                float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+                toSrgb[i] = (unsigned char)(encoded * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    static const SrgbTables& GetSrgbTables() {
+
+        static SrgbTables tables;
+        return tables;
+    }
+
+    static unsigned char EncodeSrgb(const SrgbTables& tables, float linear) {
+
+        linear = linear < 0.0f ? 0.0f : (linear > 1.0f ? 1.0f : linear);
+        return tables.toSrgb[(int)(linear * 4095.0f + 0.5f)];
+    }
+
+    static unsigned char EncodeUnorm(float value) {
+
+        value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+        return (unsigned char)(value * 255.0f + 0.5f);
+    }
+
+    // 2x2 average, the last row/column is repeated for odd sizes
+    static void DownsampleBox(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight) {
+
+        const SrgbTables& tables = GetSrgbTables();
+
+        for (int y = 0; y < dstHeight; y++) {
+
+            const unsigned char* row0 = src + (size_t)(y * 2 < srcHeight ? y * 2 : srcHeight - 1) * srcWidth * 4;
+            const unsigned char* row1 = src + (size_t)(y * 2 + 1 < srcHeight ? y * 2 + 1 : srcHeight - 1) * srcWidth * 4;
+
+            for (int x = 0; x < dstWidth; x++) {
+
+                int x0 = (x * 2 < srcWidth ? x * 2 : srcWidth - 1) * 4;
+                int x1 = (x * 2 + 1 < srcWidth ? x * 2 + 1 : srcWidth - 1) * 4;
+                unsigned char* out = dst + ((size_t)y * dstWidth + x) * 4;
+
+                for (int c = 0; c < 3; c++) {
+
+                    float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]]
+                        + tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+                    out[c] = EncodeSrgb(tables, sum * 0.25f);
+                }
+                out[3] = (unsigned char)((row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3] + 2) / 4);
+            }
+        }
+    }
+
+    // Taps of the Kaiser filter, centered between two source pixels
+    static const int KAISER_TAPS = 6;
+
+    static double BesselI0(double x) {
+
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 20; k++) {
+
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Kaiser windowed sinc for a 2x reduction, normalized to 1
+    static void GetKaiserWeights(float* weights) {
+
+        const double pi = 3.14159265358979323846;
+        const double beta = 4.0;
+        const double radius = KAISER_TAPS / 2.0;
+
+        double total = 0.0;
+        double values[KAISER_TAPS];
+        for (int t = 0; t < KAISER_TAPS; t++) {
+
+            // distance of the tap from the center of the target pixel, in source pixels
+            double distance = t - (KAISER_TAPS - 1) / 2.0;
+            double x = distance / 2.0;
+            double sinc = x == 0.0 ? 1.0 : sin(pi * x) / (pi * x);
+            double ratio = distance / radius;
+            double window = BesselI0(beta * sqrt(1.0 - ratio * ratio)) / BesselI0(beta);
+
+            values[t] = sinc * window;
+            total += values[t];
+        }
+        for (int t = 0; t < KAISER_TAPS; t++) {
+            weights[t] = (float)(values[t] / total);
+        }
+    }
+
+    // Separable Kaiser filter, sharper than the box with far less aliasing
+    static void DownsampleKaiser(const unsigned char* src, int srcWidth, int srcHeight, unsigned char* dst, int dstWidth, int dstHeight) {
+
+        const SrgbTables& tables = GetSrgbTables();
+
+        float weights[KAISER_TAPS];
+        GetKaiserWeights(weights);
+
+        // horizontally filtered source rows in linear light, each one is computed once
+        // and kept while the next target rows still need it
+        std::vector<float> rows((size_t)KAISER_TAPS * dstWidth * 4);
+        int rowTags[KAISER_TAPS];
+        for (int t = 0; t < KAISER_TAPS; t++) {
+            rowTags[t] = -1;
+        }
+
+        std::vector<float> sum((size_t)dstWidth * 4);
+
+        for (int y = 0; y < dstHeight; y++) {
+
+            std::fill(sum.begin(), sum.end(), 0.0f);
+
+            for (int t = 0; t < KAISER_TAPS; t++) {
+
+                int sourceRow = y * 2 - (KAISER_TAPS / 2 - 1) + t;
+                sourceRow = sourceRow < 0 ? 0 : (sourceRow >= srcHeight ? srcHeight - 1 : sourceRow);
+
+                float* row = rows.data() + (size_t)(sourceRow % KAISER_TAPS) * dstWidth * 4;
+                if (rowTags[sourceRow % KAISER_TAPS] != sourceRow) {
+
+                    const unsigned char* in = src + (size_t)sourceRow * srcWidth * 4;
+                    for (int x = 0; x < dstWidth; x++) {
+
+                        float pixel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                        for (int k = 0; k < KAISER_TAPS; k++) {
+
+                            int column = x * 2 - (KAISER_TAPS / 2 - 1) + k;
+                            column = column < 0 ? 0 : (column >= srcWidth ? srcWidth - 1 : column);
+                            const unsigned char* texel = in + column * 4;
+
+                            pixel[0] += weights[k] * tables.toLinear[texel[0]];
+                            pixel[1] += weights[k] * tables.toLinear[texel[1]];
+                            pixel[2] += weights[k] * tables.toLinear[texel[2]];
+                            pixel[3] += weights[k] * texel[3] * (1.0f / 255.0f);
+                        }
+                        memcpy(row + x * 4, pixel, sizeof(pixel));
+                    }
+                    rowTags[sourceRow % KAISER_TAPS] = sourceRow;
+                }
+
+                for (size_t i = 0; i < sum.size(); i++) {
+                    sum[i] += weights[t] * row[i];
+                }
+            }
+
+            unsigned char* out = dst + (size_t)y * dstWidth * 4;
+            for (int x = 0; x < dstWidth; x++) {
+
+                out[x * 4 + 0] = EncodeSrgb(tables, sum[x * 4 + 0]);
+                out[x * 4 + 1] = EncodeSrgb(tables, sum[x * 4 + 1]);
+                out[x * 4 + 2] = EncodeSrgb(tables, sum[x * 4 + 2]);
+                out[x * 4 + 3] = EncodeUnorm(sum[x * 4 + 3]);
+            }
+        }
+    }
+
+    const unsigned char* TextureData::GetData() const {
+
+        if (file) {
+            return file->GetData() + fileOffset;
+        }
+        return storage.data();
+    }
+
+    bool TextureCache::Load(std::string sourceFileName, bool flipVertically, bool mipmaps, TextureData& texture) {
+
+        std::string cacheFileName = GetCacheFileName(sourceFileName);
+        bool compress = IsFormatSupported(GL_COMPRESSED_RGB_S3TC_DXT1_EXT) && IsFormatSupported(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+
+        // textures baked by gps_bake first, then the cache written by earlier runs
+        if (compress) {
+
+            std::string bakedFileName = AssetBaker::GetBakedFileName(cacheFileName);
+            if (!bakedFileName.empty() && Read(bakedFileName, sourceFileName, flipVertically, mipmaps, texture)) {
+                return true;
+            }
+            if (Read(cacheFileName, sourceFileName, flipVertically, mipmaps, texture)) {
+                return true;
+            }
+        }
+
+        int width, height;
+        unsigned char* pixels = DecodeImage(sourceFileName.c_str(), flipVertically, width, height);
+        if (!pixels) {
+            return false;
+        }
+
+        TextureData levels;
+        BuildMipChain(pixels, width, height, mipmaps, MIP_FILTER_KAISER, levels);
+        stbi_image_free(pixels);
+
+        if (!compress) {
+
+            texture = std::move(levels);
+            return true;
+        }
+
+        Compress(levels, texture);
+        if (!Write(cacheFileName, sourceFileName, flipVertically, mipmaps, texture)) {
+            fprintf(stderr, "WARNING: could not write texture cache for %s\n", sourceFileName.c_str());
+        }
+
+        return true;
+    }
+
+    bool TextureCache::Read(std::string cacheFileName, std::string sourceFileName, bool flipVertically, bool mipmaps, TextureData& texture) {
+
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+        if (!VirtualFileSystem::GetShared().Open(cacheFileName, *file)) {
+            return false;
+        }
+
+        const unsigned char* data = file->GetData();
+        size_t size = file->GetSize();
+
+        KtxHeader header;
+        if (size < sizeof(header)) {
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header.endianness != KTX_ENDIANNESS
+            || header.glType != 0 || header.pixelDepth != 0 || header.numberOfArrayElements != 0 || header.numberOfFaces != 1
+            || header.pixelWidth == 0 || header.pixelHeight == 0 || !IsFormatSupported(header.glInternalFormat)) {
+            return false;
+        }
+
+        size_t offset = sizeof(header);
+        if (offset + header.bytesOfKeyValueData > size) {
+            return false;
+        }
+
+        // files made by other tools carry no source key and are trusted as they are
+        size_t keyValueEnd = offset + header.bytesOfKeyValueData;
+        while (offset + 4 <= keyValueEnd) {
+
+            uint32_t entrySize;
+            memcpy(&entrySize, data + offset, sizeof(entrySize));
+            offset += 4;
+            if (offset + entrySize > keyValueEnd) {
+                return false;
+            }
+
+            if (entrySize == sizeof(SOURCE_KEY) + sizeof(SourceKey) && memcmp(data + offset, SOURCE_KEY, sizeof(SOURCE_KEY)) == 0) {
+
+                SourceKey key;
+                memcpy(&key, data + offset + sizeof(SOURCE_KEY), sizeof(key));
+
+                uint32_t flags = (flipVertically ? FLAG_FLIPPED : 0) | (mipmaps ? FLAG_MIPMAPS : 0);
+                if (key.version != TEXTURE_CACHE_VERSION || key.flags != flags) {
+                    return false;
+                }
+
+                // a matching size and timestamp is trusted, otherwise the contents decide
+                FileInfo info;
+                if (!VirtualFileSystem::GetShared().GetFileInfo(sourceFileName, info) || info.size != key.sourceSize) {
+                    return false;
+                }
+                if (info.modifiedTime != key.sourceModifiedTime && AssetRegistry::HashFile(sourceFileName) != key.sourceHash) {
+                    return false;
+                }
+            }
+
+            offset += (entrySize + 3) & ~(size_t)3;
+        }
+        offset = keyValueEnd;
+
+        uint32_t levelCount = header.numberOfMipmapLevels > 0 ? header.numberOfMipmapLevels : 1;
+        size_t blockSize = header.glInternalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? BC1_BLOCK_SIZE : BC3_BLOCK_SIZE;
+
+        texture.internalFormat = header.glInternalFormat;
+        texture.compressed = true;
+        texture.levels.clear();
+        texture.storage.clear();
+        texture.fileOffset = offset;
+
+        for (uint32_t i = 0; i < levelCount; i++) {
+
+            uint32_t imageSize;
+            if (offset + 4 > size) {
+                return false;
+            }
+            memcpy(&imageSize, data + offset, sizeof(imageSize));
+            offset += 4;
+
+            TextureLevel level;
+            level.width = (int)(header.pixelWidth >> i) > 0 ? (int)(header.pixelWidth >> i) : 1;
+            level.height = (int)(header.pixelHeight >> i) > 0 ? (int)(header.pixelHeight >> i) : 1;
+            level.offset = offset - texture.fileOffset;
+            level.size = imageSize;
+
+            if (imageSize != GetCompressedSize(level.width, level.height, blockSize) || offset + imageSize > size) {
+                return false;
+            }
+
+            texture.levels.push_back(level);
+            offset += (imageSize + 3) & ~(size_t)3;
+        }
+
+        texture.size = offset - texture.fileOffset;
+        texture.file = file;
+
+        return true;
+    }
+
+    bool TextureCache::Write(std::string cacheFileName, std::string sourceFileName, bool flipVertically, bool mipmaps, const TextureData& texture) {
+
+        FileInfo info;
+        if (!texture.compressed || texture.levels.empty() || !VirtualFileSystem::GetShared().GetFileInfo(sourceFileName, info)) {
+            return false;
+        }
+
+        SourceKey key;
+        key.version = TEXTURE_CACHE_VERSION;
+        key.flags = (flipVertically ? FLAG_FLIPPED : 0) | (mipmaps ? FLAG_MIPMAPS : 0);
+        key.sourceSize = info.size;
+        key.sourceModifiedTime = info.modifiedTime;
+        key.sourceHash = AssetRegistry::HashFile(sourceFileName);
+
+        uint32_t entrySize = sizeof(SOURCE_KEY) + sizeof(SourceKey);
+
+        KtxHeader header;
+        memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+        header.endianness = KTX_ENDIANNESS;
+        header.glType = 0;
+        header.glTypeSize = 1;
+        header.glFormat = 0;
+        header.glInternalFormat = texture.internalFormat;
+        header.glBaseInternalFormat = texture.internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? GL_RGB : GL_RGBA;
+        header.pixelWidth = texture.levels[0].width;
+        header.pixelHeight = texture.levels[0].height;
+        header.pixelDepth = 0;
+        header.numberOfArrayElements = 0;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = (uint32_t)texture.levels.size();
+        header.bytesOfKeyValueData = 4 + ((entrySize + 3) & ~(uint32_t)3);
+
+        // write to a temporary file so a crash never leaves a truncated cache behind
+        std::string tempFileName = cacheFileName + ".tmp";
+        std::ofstream output(tempFileName.c_str(), std::ios::binary | std::ios::trunc);
+        if (!output) {
+            return false;
+        }
+
+        static const char padding[4] = { 0 };
+
+        output.write((const char*)&header, sizeof(header));
+        output.write((const char*)&entrySize, sizeof(entrySize));
+        output.write(SOURCE_KEY, sizeof(SOURCE_KEY));
+        output.write((const char*)&key, sizeof(key));
+        output.write(padding, ((entrySize + 3) & ~(uint32_t)3) - entrySize);
+
+        const unsigned char* data = texture.GetData();
+        for (size_t i = 0; i < texture.levels.size(); i++) {
+
+            uint32_t imageSize = (uint32_t)texture.levels[i].size;
+            output.write((const char*)&imageSize, sizeof(imageSize));
+            output.write((const char*)data + texture.levels[i].offset, imageSize);
+            output.write(padding, ((imageSize + 3) & ~(uint32_t)3) - imageSize);
+        }
+
+        output.close();
+        if (!output) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        remove(cacheFileName.c_str());
+        if (rename(tempFileName.c_str(), cacheFileName.c_str()) != 0) {
+            remove(tempFileName.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    std::string TextureCache::GetCacheFileName(std::string sourceFileName) {
+
+        return sourceFileName + ".ktx";
+    }
+
+    void TextureCache::BuildMipChain(const unsigned char* pixels, int width, int height, bool mipmaps, MipFilter filter, TextureData& texture) {
+
+        texture.internalFormat = GL_RGBA8;
+        texture.compressed = false;
+        texture.levels.clear();
+        texture.file.reset();
+        texture.fileOffset = 0;
+
+        // lay out every level first so the storage is allocated once
+        TextureLevel level;
+        level.width = width;
+        level.height = height;
+        level.offset = 0;
+        while (true) {
+
+            level.size = (size_t)level.width * level.height * 4;
+            texture.levels.push_back(level);
+            level.offset += level.size;
+
+            if (!mipmaps || (level.width == 1 && level.height == 1)) {
+                break;
+            }
+            level.width = level.width > 1 ? level.width / 2 : 1;
+            level.height = level.height > 1 ? level.height / 2 : 1;
+        }
+
+        texture.size = level.offset;
+        texture.storage.resize(texture.size);
+        memcpy(texture.storage.data(), pixels, texture.levels[0].size);
+
+        // each level is filtered from the one above it
+        for (size_t i = 1; i < texture.levels.size(); i++) {
+
+            const TextureLevel& source = texture.levels[i - 1];
+            const TextureLevel& target = texture.levels[i];
+            const unsigned char* src = texture.storage.data() + source.offset;
+            unsigned char* dst = texture.storage.data() + target.offset;
+
+            if (filter == MIP_FILTER_KAISER) {
+                DownsampleKaiser(src, source.width, source.height, dst, target.width, target.height);
+            } else {
+                DownsampleBox(src, source.width, source.height, dst, target.width, target.height);
+            }
+        }
+    }
+
+    void TextureCache::Compress(const TextureData& source, TextureData& compressed) {
+
+        const unsigned char* data = source.GetData();
+
+        bool opaque = true;
+        for (size_t i = 3; i < source.levels[0].size && opaque; i += 4) {
+            opaque = data[i] == 255;
+        }
+
+        size_t blockSize = opaque ? BC1_BLOCK_SIZE : BC3_BLOCK_SIZE;
+
+        compressed.internalFormat = opaque ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        compressed.compressed = true;
+        compressed.levels.clear();
+        compressed.file.reset();
+        compressed.fileOffset = 0;
+
+        size_t offset = 0;
+        for (size_t i = 0; i < source.levels.size(); i++) {
+
+            TextureLevel level = source.levels[i];
+            level.offset = offset;
+            level.size = GetCompressedSize(level.width, level.height, blockSize);
+            compressed.levels.push_back(level);
+            offset += level.size;
+        }
+
+        compressed.size = offset;
+        compressed.storage.resize(offset);
+
+        for (size_t i = 0; i < source.levels.size(); i++) {
+
+            const TextureLevel& level = source.levels[i];
+            unsigned char* output = compressed.storage.data() + compressed.levels[i].offset;
+
+            if (opaque) {
+                CompressImageBC1(data + level.offset, level.width, level.height, output);
+            } else {
+                CompressImageBC3(data + level.offset, level.width, level.height, output);
+            }
+        }
+    }
+
+    bool TextureCache::IsFormatSupported(GLenum internalFormat) {
+
+        switch (internalFormat) {
+
+            case GL_RGBA8:
+                return true;
+#if defined (__APPLE__)
+            // S3TC is always there on macOS, BPTC never is
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                return true;
+#else
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                return GLEW_EXT_texture_compression_s3tc;
+            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+                return GLEW_ARB_texture_compression_bptc;
+#endif
+            default:
+                return false;
+        }
+    }
+
+    bool TextureCache::IsStorageSupported() {
+
+#if defined (__APPLE__)
+        // macOS stops at GL 4.1 without ARB_texture_storage
+        return false;
+#else
+        return GLEW_ARB_texture_storage || GLEW_VERSION_4_2;
+#endif
+    }
+
+    unsigned char* TextureCache::DecodeImage(const char* fileName, bool flipVertically, int& width, int& height) {
+
+        int n;
+        int force_channels = 4;
+        // stb_image flips whole rows with memcpy while decoding, the setting is per thread
+        stbi_set_flip_vertically_on_load_thread(flipVertically ? 1 : 0);
+        // decoded straight from the mapping, packed images are never copied out of the archive
+        MappedFile file;
+        unsigned char* image_data = NULL;
+        if (VirtualFileSystem::GetShared().Open(fileName, file)) {
+            image_data = stbi_load_from_memory(file.GetData(), (int)file.GetSize(), &width, &height, &n, force_channels);
+        }
+
+        if (!image_data) {
+            fprintf(stderr, "ERROR: could not load %s\n", fileName);
+            return NULL;
+        }
+        // NPOT check
+        if ((width & (width - 1)) != 0 || (height & (height - 1)) != 0) {
+            fprintf(
+                stderr, "WARNING: texture %s is not power-of-2 dimensions\n", fileName
+            );
+        }
+
+        return image_data;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef TextureCache_hpp
+#define TextureCache_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include "MappedFile.hpp"
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// S3TC is an extension and not every header declares it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+    #define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+namespace gps {
+
+    // Bump whenever the encoder, the mip filter or the metadata changes
+    const uint32_t TEXTURE_CACHE_VERSION = 2;
+
+    // Downsampling filter of the mip chain, both work in linear light
+    enum MipFilter { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+
+    // One mip level inside TextureData
+    struct TextureLevel {
+
+        int width;
+        int height;
+        size_t offset;
+        size_t size;
+    };
+
+    // A texture ready for upload, every mip level in one contiguous block
+    struct TextureData {
+
+        // GL_RGBA8 or one of the block compressed formats
+        GLenum internalFormat;
+        bool compressed;
+        std::vector<TextureLevel> levels;
+        size_t size;
+
+        // the levels live either in storage or in the mapped cache file, at fileOffset
+        std::vector<unsigned char> storage;
+        std::shared_ptr<MappedFile> file;
+        size_t fileOffset;
+
+        const unsigned char* GetData() const;
+    };
+
+    // Block compressed textures stored next to their source images as KTX 1.1 files
+    //
+    // A miss decodes the source, builds its mip chain and encodes every level
+    // as BC1 (opaque) or BC3 (with alpha); the result is written for the next
+    // start. A hit maps the file and hands the levels out as they are. Files
+    // holding BC7 made by other tools are uploaded too when the GL supports it.
+    class TextureCache {
+
+    public:
+        // Loads a texture, from the cache when possible, transcoding the source otherwise
+        // Without GPU support for the formats the plain RGBA8 levels are returned
+        static bool Load(std::string sourceFileName, bool flipVertically, bool mipmaps, TextureData& texture);
+
+        // Maps a cache file and checks it against its source, returns false on a miss
+        static bool Read(std::string cacheFileName, std::string sourceFileName, bool flipVertically, bool mipmaps, TextureData& texture);
+
+        static bool Write(std::string cacheFileName, std::string sourceFileName, bool flipVertically, bool mipmaps, const TextureData& texture);
+
+        // Cache file used for a given image
+        static std::string GetCacheFileName(std::string sourceFileName);
+
+        // Builds the RGBA8 levels of a decoded sRGB image, down to 1x1 if mipmaps is set
+        static void BuildMipChain(const unsigned char* pixels, int width, int height, bool mipmaps, MipFilter filter, TextureData& texture);
+
+        // Encodes every level of an RGBA8 texture, BC1 when it is opaque and BC3 otherwise
+        static void Compress(const TextureData& source, TextureData& compressed);
+
+        // Whether the current context can sample the block compressed formats
+        static bool IsFormatSupported(GLenum internalFormat);
+
+        // Whether the current context has glTexStorage2D
+        static bool IsStorageSupported();
+
+        // Decodes an image to RGBA8 with stb_image
+        static unsigned char* DecodeImage(const char* fileName, bool flipVertically, int& width, int& height);
+    };
+}
+
+#endif /* TextureCache_hpp */
@@ -0,0 +1,238 @@
+#include "TextureStreamer.hpp"
+#include "ThreadPool.hpp"
+
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+
+namespace gps {
+
+    // pixel buffers in the ring, i.e. textures staged at the same time
+    static const size_t UPLOAD_SLOT_COUNT = 3;
+    static const size_t DEFAULT_UPLOAD_BUDGET = 4 * 1024 * 1024;
+    // neutral grey shown until the real image arrives
+    static const unsigned char PLACEHOLDER_PIXEL[4] = { 128, 128, 128, 255 };
+
+    TextureStreamer::TextureStreamer() {
+
+        decoded = std::make_shared<DecodedQueue>();
+        uploadBudget = DEFAULT_UPLOAD_BUDGET;
+        pendingCount = 0;
+        streamedCount = 0;
+
+        slots.resize(UPLOAD_SLOT_COUNT);
+        for (size_t i = 0; i < slots.size(); i++) {
+
+            slots[i].buffer = 0;
+            slots[i].state = SLOT_FREE;
+            slots[i].mapped = NULL;
+            slots[i].fence = 0;
+        }
+    }
+
+    // GL objects are left to the context, it is usually gone by the time statics are destroyed
+    TextureStreamer::~TextureStreamer() {
+
+    }
+
+    GLuint TextureStreamer::Load(std::string path, bool flipVertically) {
+
+        GLuint textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, PLACEHOLDER_PIXEL);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        if (pendingCount == 0) {
+            streamStart = std::chrono::steady_clock::now();
+            streamedCount = 0;
+        }
+        pendingCount++;
+
+        std::shared_ptr<DecodedQueue> queue = decoded;
+        ThreadPool::GetShared().Submit([queue, textureID, path, flipVertically]() {
+
+            DecodedImage image;
+            image.textureID = textureID;
+            image.path = path;
+            image.loaded = TextureCache::Load(path, flipVertically, true, image.texture);
+
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->images.push_back(image);
+        });
+
+        return textureID;
+    }
+
+    void TextureStreamer::Update() {
+
+        if (pendingCount == 0) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(decoded->mutex);
+            for (size_t i = 0; i < decoded->images.size(); i++) {
+
+                if (decoded->images[i].loaded) {
+                    waiting.push_back(std::move(decoded->images[i]));
+                } else {
+                    // the placeholder stays, the error was reported by the decoder
+                    pendingCount--;
+                }
+            }
+            decoded->images.clear();
+        }
+
+        size_t budget = uploadBudget;
+
+        for (size_t i = 0; i < slots.size(); i++) {
+
+            UploadSlot& slot = slots[i];
+
+            // a buffer is reused once the GL has consumed its last upload
+            if (slot.state == SLOT_UPLOADING) {
+
+                GLenum status = glClientWaitSync(slot.fence, 0, 0);
+                if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+                    continue;
+                }
+                glDeleteSync(slot.fence);
+                slot.fence = 0;
+                slot.state = SLOT_FREE;
+            }
+
+            if (slot.state == SLOT_FREE && !waiting.empty() && budget > 0) {
+
+                slot.image = std::move(waiting.front());
+                waiting.pop_front();
+                BeginStaging(slot);
+            }
+
+            if (slot.state == SLOT_STAGING && budget > 0) {
+
+                size_t count = slot.size - slot.copied;
+                if (count > budget) {
+                    count = budget;
+                }
+
+                memcpy(slot.mapped + slot.copied, slot.source + slot.copied, count);
+                slot.copied += count;
+                slot.frames++;
+                budget -= count;
+
+                if (slot.copied == slot.size) {
+                    FinishStaging(slot);
+                }
+            }
+        }
+
+        if (pendingCount == 0) {
+
+            double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - streamStart).count();
+            std::cout << "Streamed " << streamedCount << " textures in " << milliseconds << " ms" << std::endl;
+        }
+    }
+
+    void TextureStreamer::SetUploadBudget(size_t bytes) {
+
+        uploadBudget = bytes;
+    }
+
+    size_t TextureStreamer::GetPendingCount() const {
+
+        return pendingCount;
+    }
+
+    TextureStreamer& TextureStreamer::GetShared() {
+
+        static TextureStreamer sharedStreamer;
+        return sharedStreamer;
+    }
+
+    // Maps a buffer of the ring large enough for the whole image
+    void TextureStreamer::BeginStaging(UploadSlot& slot) {
+
+        slot.source = slot.image.texture.GetData();
+        slot.size = slot.image.texture.size;
+        slot.copied = 0;
+        slot.frames = 0;
+
+        if (slot.buffer == 0) {
+            glGenBuffers(1, &slot.buffer);
+        }
+
+        // reallocating orphans the previous storage instead of waiting on it
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, slot.size, NULL, GL_STREAM_DRAW);
+        slot.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slot.size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        slot.state = SLOT_STAGING;
+    }
+
+    // Replaces the placeholder with the staged image
+    void TextureStreamer::FinishStaging(UploadSlot& slot) {
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+        // the model owning the texture may have been destroyed meanwhile
+        const TextureData& texture = slot.image.texture;
+        if (glIsTexture(slot.image.textureID)) {
+
+            glBindTexture(GL_TEXTURE_2D, slot.image.textureID);
+
+            // immutable storage replaces the placeholder in one allocation, the driver
+            // then only copies pixels instead of validating every level again
+            bool immutable = TextureCache::IsStorageSupported();
+            if (immutable) {
+                glTexStorage2D(GL_TEXTURE_2D, (GLsizei)texture.levels.size(), texture.internalFormat,
+                    texture.levels[0].width, texture.levels[0].height);
+            }
+
+            // every level comes precomputed, offsets are relative to the start of the buffer
+            for (size_t i = 0; i < texture.levels.size(); i++) {
+
+                const TextureLevel& level = texture.levels[i];
+                const GLvoid* offset = (const GLvoid*)level.offset;
+
+                if (immutable && texture.compressed) {
+                    glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height,
+                        texture.internalFormat, (GLsizei)level.size, offset);
+                } else if (immutable) {
+                    glTexSubImage2D(GL_TEXTURE_2D, (GLint)i, 0, 0, level.width, level.height, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+                } else if (texture.compressed) {
+                    glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, texture.internalFormat, level.width, level.height, 0,
+                        (GLsizei)level.size, offset);
+                } else {
+                    glTexImage2D(GL_TEXTURE_2D, (GLint)i, GL_RGBA, level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, offset);
+                }
+            }
+            if (!immutable) {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.mapped = NULL;
+        slot.state = SLOT_UPLOADING;
+
+        std::cout << "Streamed " << slot.image.path << " (" << texture.levels[0].width << "x" << texture.levels[0].height
+            << ", " << texture.levels.size() << " levels, " << texture.size / 1024 << " KB"
+            << (texture.compressed ? " compressed" : "") << ") over " << slot.frames << " frame(s)" << std::endl;
+
+        // drops the decoded pixels or unmaps the cache file
+        slot.image.texture = TextureData();
+        pendingCount--;
+        streamedCount++;
+    }
+}
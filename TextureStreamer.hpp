@@ -0,0 +1,102 @@
+#ifndef TextureStreamer_hpp
+#define TextureStreamer_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include "TextureCache.hpp"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // A texture loaded on a worker thread, waiting for its upload
+    struct DecodedImage {
+
+        GLuint textureID;
+        std::string path;
+        bool loaded;
+        TextureData texture;
+    };
+
+    // Streams textures into the video memory without stalling the render loop
+    //
+    // Load hands out a texture name at once, backed by a 1x1 placeholder, and
+    // loads the image through the texture cache on the shared thread pool.
+    // Update, called once per frame on the context thread, copies the loaded
+    // mip levels into a ring of pixel unpack buffers, at most uploadBudget
+    // bytes per frame, and swaps in the full image once it is completely staged.
+    class TextureStreamer {
+
+    public:
+        TextureStreamer();
+        ~TextureStreamer();
+
+        // Returns a texture showing the placeholder until the image is streamed in
+        // OBJ texture coordinates start at the bottom row, glTF ones at the top and need no flip
+        GLuint Load(std::string path, bool flipVertically = true);
+
+        // Advances the uploads, must be called once per frame on the context thread
+        void Update();
+
+        // Bytes copied to the pixel buffers per frame
+        void SetUploadBudget(size_t bytes);
+
+        // Number of textures not yet fully uploaded
+        size_t GetPendingCount() const;
+
+        // Process-wide streamer used by the model loader
+        static TextureStreamer& GetShared();
+
+    private:
+        enum SlotState { SLOT_FREE, SLOT_STAGING, SLOT_UPLOADING };
+
+        // One pixel unpack buffer of the ring
+        struct UploadSlot {
+
+            GLuint buffer;
+            SlotState state;
+            DecodedImage image;
+            const unsigned char* source;
+            unsigned char* mapped;
+            size_t size;
+            size_t copied;
+            int frames;
+            GLsync fence;
+        };
+
+        // Decoded images handed over by the workers, shared with the jobs so
+        // it outlives the streamer should a job still be running at exit
+        struct DecodedQueue {
+
+            std::mutex mutex;
+            std::vector<DecodedImage> images;
+        };
+
+        std::shared_ptr<DecodedQueue> decoded;
+        std::deque<DecodedImage> waiting;
+        std::vector<UploadSlot> slots;
+        size_t uploadBudget;
+        size_t pendingCount;
+        size_t streamedCount;
+        std::chrono::steady_clock::time_point streamStart;
+
+        void BeginStaging(UploadSlot& slot);
+        void FinishStaging(UploadSlot& slot);
+
+        TextureStreamer(const TextureStreamer&);
+        TextureStreamer& operator=(const TextureStreamer&);
+    };
+}
+
+#endif /* TextureStreamer_hpp */
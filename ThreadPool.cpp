@@ -0,0 +1,80 @@
+#include "ThreadPool.hpp"
+
+namespace gps {
+
+    ThreadPool::ThreadPool(unsigned int threadCount) {
+
+        stopping = false;
+
+        if (threadCount == 0) {
+            threadCount = std::thread::hardware_concurrency();
+        }
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+
+        for (unsigned int i = 0; i < threadCount; i++) {
+            workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        jobAvailable.notify_all();
+
+        for (size_t i = 0; i < workers.size(); i++) {
+            workers[i].join();
+        }
+    }
+
+    std::future<void> ThreadPool::Submit(std::function<void()> job) {
+
+        std::packaged_task<void()> task(job);
+        std::future<void> result = task.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(task));
+        }
+        jobAvailable.notify_one();
+
+        return result;
+    }
+
+    unsigned int ThreadPool::GetThreadCount() const {
+
+        return (unsigned int)workers.size();
+    }
+
+    ThreadPool& ThreadPool::GetShared() {
+
+        static ThreadPool sharedPool;
+        return sharedPool;
+    }
+
+    void ThreadPool::WorkerLoop() {
+
+        while (true) {
+
+            std::packaged_task<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                jobAvailable.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+                // pending jobs are drained before the workers exit
+                if (jobs.empty()) {
+                    return;
+                }
+
+                task = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            task();
+        }
+    }
+}
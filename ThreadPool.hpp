@@ -0,0 +1,44 @@
+#ifndef ThreadPool_hpp
+#define ThreadPool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gps {
+
+    // Fixed set of worker threads running submitted jobs in FIFO order
+    class ThreadPool {
+
+    public:
+        // 0 creates one worker per hardware thread
+        explicit ThreadPool(unsigned int threadCount = 0);
+        ~ThreadPool();
+
+        // Queues a job, the returned future becomes ready once it has run
+        std::future<void> Submit(std::function<void()> job);
+
+        unsigned int GetThreadCount() const;
+
+        // Process-wide pool shared by the asset loaders
+        static ThreadPool& GetShared();
+
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::packaged_task<void()> > jobs;
+        std::mutex mutex;
+        std::condition_variable jobAvailable;
+        bool stopping;
+
+        void WorkerLoop();
+
+        ThreadPool(const ThreadPool&);
+        ThreadPool& operator=(const ThreadPool&);
+    };
+}
+
+#endif /* ThreadPool_hpp */
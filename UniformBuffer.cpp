@@ -0,0 +1,73 @@
+#include "UniformBuffer.hpp"
+#include "Shader.hpp"
+
+#include <string.h>
+
+namespace gps {
+
+    unsigned long UniformBuffer::uploadCount = 0;
+    unsigned long UniformBuffer::uploadBytes = 0;
+
+    UniformBuffer::UniformBuffer() {
+
+        buffer = 0;
+        uploaded = false;
+    }
+
+    UniformBuffer::~UniformBuffer() {
+
+        if (buffer != 0) {
+            glDeleteBuffers(1, &buffer);
+        }
+    }
+
+    void UniformBuffer::Create(std::string blockName, GLuint binding, size_t size) {
+
+        if (buffer == 0) {
+            glGenBuffers(1, &buffer);
+        }
+
+        contents.assign(size, 0);
+        uploaded = false;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+
+        Shader::SetUniformBlockBinding(blockName, binding);
+    }
+
+    void UniformBuffer::Update(const void* data) {
+
+        if (uploaded && memcmp(contents.data(), data, contents.size()) == 0) {
+            return;
+        }
+        memcpy(contents.data(), data, contents.size());
+        uploaded = true;
+
+        // the whole block changes, so the old storage is orphaned instead of waiting for draws still reading it
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, contents.size(), contents.data(), GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        uploadCount++;
+        uploadBytes += contents.size();
+    }
+
+    unsigned long UniformBuffer::GetUploadCount() {
+
+        return uploadCount;
+    }
+
+    unsigned long UniformBuffer::GetUploadBytes() {
+
+        return uploadBytes;
+    }
+
+    void UniformBuffer::ResetStats() {
+
+        uploadCount = 0;
+        uploadBytes = 0;
+    }
+}
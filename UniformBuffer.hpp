@@ -0,0 +1,94 @@
+#ifndef UniformBuffer_hpp
+#define UniformBuffer_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Binding points of the blocks every program shares
+    const GLuint FRAME_CONSTANTS_BINDING = 0;
+    const GLuint LIGHT_CONSTANTS_BINDING = 1;
+
+    // Point lights the shaders loop over, unused ones are black
+    const int MAX_POINT_LIGHTS = 4;
+
+    // std140 layout of the FrameConstants block, written once per frame
+    // A vec3 takes 16 bytes unless a scalar follows it, so each one is paired with one
+    struct FrameConstants {
+
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::mat4 lightSpaceMatrix;
+        // eye space direction towards the sun
+        glm::vec3 lightDir;
+        float fogDensity;
+        glm::vec3 lightColor;
+        float padding0;
+    };
+
+    // std140 layout of the PointLight structures of the LightConstants block
+    struct PointLightConstants {
+
+        glm::vec3 position;
+        float padding0;
+        glm::vec3 color;
+        float padding1;
+    };
+
+    struct LightConstants {
+
+        PointLightConstants pointLights[MAX_POINT_LIGHTS];
+    };
+
+    static_assert(sizeof(FrameConstants) == 224, "FrameConstants does not match its std140 layout");
+    static_assert(sizeof(LightConstants) == 32 * MAX_POINT_LIGHTS, "LightConstants does not match its std140 layout");
+
+    // A uniform block shared by every program that declares it
+    //
+    // The buffer stays bound to its binding point and each program is
+    // pointed at it when it is linked, so one upload per frame reaches all
+    // of them. Update keeps a copy of what it uploaded and skips the upload
+    // when nothing changed.
+    class UniformBuffer {
+
+    public:
+        UniformBuffer();
+        ~UniformBuffer();
+
+        // Creates the buffer at binding, programs linked afterwards find blockName there
+        void Create(std::string blockName, GLuint binding, size_t size);
+
+        // Uploads size bytes of block contents if they differ from the last upload
+        void Update(const void* data);
+
+        // Uploads since the last reset and their size
+        static unsigned long GetUploadCount();
+        static unsigned long GetUploadBytes();
+        static void ResetStats();
+
+    private:
+        GLuint buffer;
+        std::vector<unsigned char> contents;
+        bool uploaded;
+
+        static unsigned long uploadCount;
+        static unsigned long uploadBytes;
+
+        UniformBuffer(const UniformBuffer&);
+        UniformBuffer& operator=(const UniformBuffer&);
+    };
+}
+
+#endif /* UniformBuffer_hpp */
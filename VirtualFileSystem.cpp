@@ -0,0 +1,111 @@
+#include "VirtualFileSystem.hpp"
+
+#include <stdlib.h>
+
+namespace gps {
+
+    bool VirtualFileSystem::Mount(std::string archiveFileName) {
+
+        std::unique_ptr<AssetArchive> archive(new AssetArchive());
+        if (!archive->Open(archiveFileName)) {
+            return false;
+        }
+
+        archives.push_back(std::move(archive));
+        return true;
+    }
+
+    const AssetArchiveEntry* VirtualFileSystem::Find(std::string fileName, const AssetArchive*& archive) {
+
+        for (size_t i = 0; i < archives.size(); i++) {
+
+            const AssetArchiveEntry* entry = archives[i]->Find(fileName);
+            if (entry != NULL) {
+
+                archive = archives[i].get();
+                return entry;
+            }
+        }
+        return NULL;
+    }
+
+    bool VirtualFileSystem::ParseRange(const std::string& fileName, std::string& containerFileName, size_t& offset, size_t& size) {
+
+        size_t hash = fileName.find_last_of('#');
+        size_t dash = fileName.find_last_of('-');
+        if (hash == std::string::npos || dash == std::string::npos || dash < hash + 2 || dash + 1 == fileName.size()
+            || fileName.find('-', hash + 1) != dash || fileName.find_first_not_of("0123456789-", hash + 1) != std::string::npos) {
+            return false;
+        }
+
+        containerFileName = fileName.substr(0, hash);
+        offset = (size_t)strtoull(fileName.c_str() + hash + 1, NULL, 10);
+        size = (size_t)strtoull(fileName.c_str() + dash + 1, NULL, 10);
+        return true;
+    }
+
+    std::string VirtualFileSystem::GetRangeFileName(std::string fileName, size_t offset, size_t size) {
+
+        return fileName + "#" + std::to_string(offset) + "-" + std::to_string(size);
+    }
+
+    bool VirtualFileSystem::Open(std::string fileName, MappedFile& file) {
+
+        // the container stays mapped as long as the view of its range
+        std::string containerFileName;
+        size_t offset, size;
+        if (ParseRange(fileName, containerFileName, offset, size)) {
+
+            std::shared_ptr<MappedFile> container = std::make_shared<MappedFile>();
+            return Open(containerFileName, *container) && file.OpenView(container, offset, size);
+        }
+
+        const AssetArchive* archive = NULL;
+        const AssetArchiveEntry* entry = Find(fileName, archive);
+        if (entry != NULL) {
+            return archive->OpenFile(entry, file);
+        }
+
+        return file.Open(fileName);
+    }
+
+    bool VirtualFileSystem::GetFileInfo(std::string fileName, FileInfo& info) {
+
+        std::string containerFileName;
+        size_t offset, size;
+        if (ParseRange(fileName, containerFileName, offset, size)) {
+
+            if (!GetFileInfo(containerFileName, info) || offset > info.size || size > info.size - offset) {
+                return false;
+            }
+            info.size = size;
+            return true;
+        }
+
+        const AssetArchive* archive = NULL;
+        const AssetArchiveEntry* entry = Find(fileName, archive);
+        if (entry != NULL) {
+
+            info.size = entry->size;
+            info.modifiedTime = entry->modifiedTime;
+            return true;
+        }
+
+        return MappedFile::GetFileInfo(fileName, info);
+    }
+
+    size_t VirtualFileSystem::GetArchivedFileCount() {
+
+        size_t count = 0;
+        for (size_t i = 0; i < archives.size(); i++) {
+            count += archives[i]->GetFileCount();
+        }
+        return count;
+    }
+
+    VirtualFileSystem& VirtualFileSystem::GetShared() {
+
+        static VirtualFileSystem fileSystem;
+        return fileSystem;
+    }
+}
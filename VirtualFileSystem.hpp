@@ -0,0 +1,51 @@
+#ifndef VirtualFileSystem_hpp
+#define VirtualFileSystem_hpp
+
+#include "AssetArchive.hpp"
+#include "MappedFile.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Where the loaders read their files from
+    //
+    // Mounted archives are searched first, in the order they were mounted;
+    // anything they do not hold is mapped from disk, so loose files keep
+    // working during development and without an archive at all. Mount
+    // before loading starts, lookups are not synchronized with it.
+    //
+    // "file#offset-size" names a byte range of another file, such as an
+    // image embedded in a .glb, so it can be loaded like any other file.
+    class VirtualFileSystem {
+
+    public:
+        // Adds an archive, its files hide loose files with the same path
+        bool Mount(std::string archiveFileName);
+
+        // Maps a file from an archive or from disk, zero-copy either way
+        bool Open(std::string fileName, MappedFile& file);
+
+        // Size and modification time of a file, as packed for archived files
+        bool GetFileInfo(std::string fileName, FileInfo& info);
+
+        size_t GetArchivedFileCount();
+
+        // Name of a byte range of a file, as Open and GetFileInfo understand it
+        static std::string GetRangeFileName(std::string fileName, size_t offset, size_t size);
+
+        static VirtualFileSystem& GetShared();
+
+    private:
+        std::vector<std::unique_ptr<AssetArchive> > archives;
+
+        const AssetArchiveEntry* Find(std::string fileName, const AssetArchive*& archive);
+
+        // Splits "file#offset-size", returns false for plain file names
+        static bool ParseRange(const std::string& fileName, std::string& containerFileName, size_t& offset, size_t& size);
+    };
+}
+
+#endif /* VirtualFileSystem_hpp */
@@ -15,9 +15,18 @@
 
 #include "Window.h"
 #include "Shader.hpp"
+#include "ShaderVariants.hpp"
 #include "Camera.hpp"
 #include "Model3D.hpp"
+#include "AssetRegistry.hpp"
+#include "ModelLoader.hpp"
+#include "Scene.hpp"
+#include "ModelBenchmark.hpp"
+#include "TextureBenchmark.hpp"
+#include "TextureStreamer.hpp"
+#include "VirtualFileSystem.hpp"
 #include "Skybox.hpp"
+#include "UniformBuffer.hpp"
 
 #include <iostream>
 
@@ -38,22 +47,6 @@ glm::mat4 lightRotation; // matrix for rotating the light
 GLuint lightRotationLoc; // shader location for light rotation
 GLfloat lightAngle; // current angle of the light rotation
 
-// basic shader uniform locations
-GLint modelLoc;
-GLint viewLoc;
-GLint projectionLoc;
-GLint normalMatrixLoc;
-GLint lightDirLoc;
-GLint lightColorLoc;
-
-// trees shader uniform locations
-GLint treesModelLoc;
-GLint treesViewLoc;
-GLint treesProjectionLoc;
-GLint treesNormalMatrixLoc;
-GLint treesLightDirLoc;
-GLint treesLightColorLoc;
-
 // camera setup
 //gps::Camera myCamera(
 //    glm::vec3(27.25f, 7.64f, -3.42f), // camera position
@@ -71,24 +64,27 @@ GLfloat cameraSpeed = 0.5f;
 // array to track keyboard input
 GLboolean pressedKeys[1024]; 
 
+// models, instances, lights and paths of the scene, read from its manifest
+std::string sceneFileName = "scenes/village.scene";
+gps::Scene world;
+int opaqueGroup = -1; // instances drawn with the basic shader
+int foliageGroup = -1; // instances drawn with the trees shader, both faces
+const gps::SceneEmitter* rainEmitter = NULL;
+
 // 3D model objects
-gps::Model3D scene;
-gps::Model3D trees;
 gps::Model3D tractor;
 gps::Model3D screenQuad;
 gps::Model3D lightCube1;
 gps::Model3D lightCube2;
-gps::Model3D balloon;
 gps::Model3D lake;
-gps::Model3D raindrop;
 
 gps::SkyBox skyBox; // Skybox object
 
 // shader programs
-gps::Shader basicShader;
+gps::ShaderVariants basicShaders; // specialized for the lighting in use, see getShaderPermutation
 gps::Shader skyboxShader;
 gps::Shader shadowShader;
-gps::Shader treesShader;
+gps::ShaderVariants treesShaders;
 gps::Shader screenQuadShader;
 gps::Shader lightCubeShader;
 
@@ -98,23 +94,18 @@ GLuint depthMapFBO; // framebuffer for shadow mapping
 GLuint depthMapTexture; // depth texture for shadow mapping
 float near_plane = 0.1f, far_plane = 70.0f;
 glm::mat4 lightSpaceMatrix; // matrix for light space transformation
-GLint lightSpaceMatrixLoc;
 bool showDepthMap = false;
 
 // point light parameters
-glm::vec3 pointLightPos;
-glm::vec3 pointLightColor;
-glm::vec3 pointLightPos1;
-glm::vec3 pointLightColor1;
-glm::vec3 pointLightPos2;
-glm::vec3 pointLightColor2;
-glm::vec3 pointLightPos3;
-glm::vec3 pointLightColor3;
+gps::LightConstants pointLights; // as the LightConstants block holds them
 bool pointLightFlag;
 
+// uniform blocks every program reads, uploaded once per frame
+gps::UniformBuffer frameUniforms;
+gps::UniformBuffer lightUniforms;
+
 //alpha channel for transparent objects
 float alpha;
-GLuint alphaLoc;
 
 // fog parameters
 bool fogFlag = true;
@@ -125,26 +116,39 @@ bool isRaining = false;
 struct Rain {
 	glm::vec3 position;
 	glm::vec3 velocity;
+	gps::LodState lod; // level of detail of this drop
 };
 
 std::vector<Rain> raindrops;
 
 GLint isNight = 0; // toggle for day/night state
 
-glm::vec3 balloonPosition(-6.32f, 5.0f, 1.49f); // initial position for the balloon
-
 float lastFrameTime = 0.0f;
 
 // tour animation variable
 bool inTour = false;
+std::vector<gps::SceneWaypoint> tourPath; // waypoints of the scene's tour path
 
 bool captureMouse = false;
 
+// random position in the spawn box of the rain emitter
+glm::vec3 spawnRaindrop() {
+    glm::vec3 t((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+    return rainEmitter->spawnMin + (rainEmitter->spawnMax - rainEmitter->spawnMin) * t;
+}
+
 void initRain() {
-	for (int i = 0; i < 3000; i++) {
+    rainEmitter = NULL;
+    int emitter = world.GetManifest().FindEmitter("rain");
+    if (emitter < 0) {
+        return; // a scene without rain
+    }
+    rainEmitter = &world.GetManifest().emitters[emitter];
+
+	for (uint32_t i = 0; i < rainEmitter->count; i++) {
 		Rain raindrop;
-		raindrop.position = glm::vec3((rand() % 100) - 50, 15.0f + (rand() % 5), (rand() % 100) - 50);
-		raindrop.velocity = glm::vec3(-0.02f, -0.3f, 0.01f);
+		raindrop.position = spawnRaindrop();
+		raindrop.velocity = rainEmitter->velocity;
 		raindrops.push_back(raindrop);
 	}
 }
@@ -152,8 +156,8 @@ void initRain() {
 void updateRain() {
     for (int i = 0; i < raindrops.size(); i++) {
 		raindrops[i].position += raindrops[i].velocity; // update raindrop position
-		if (raindrops[i].position.y < -1.0f) { // reset raindrop when it falls below ground level
-            raindrops[i].position = glm::vec3((rand() % 100) - 50, 15.0f + (rand() % 5), (rand() % 100) - 50);
+		if (raindrops[i].position.y < rainEmitter->floor) { // reset raindrop when it falls below ground level
+            raindrops[i].position = spawnRaindrop();
         }
     }
 }
@@ -193,8 +197,8 @@ void windowResizeCallback(GLFWwindow* window, int width, int height) {
     glViewport(0, 0, width, height);
     myWindow.setWindowDimensions({ width, height });
 
-    // Update projection matrix for new aspect ratio
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(glm::perspective(glm::radians(45.0f), width / (float)height, 0.1f, 70.0f)));
+    // Update projection matrix for new aspect ratio, the next frame uploads it
+    projection = glm::perspective(glm::radians(45.0f), width / (float)height, 0.1f, 70.0f);
 }
 
 // Initialize the OpenGL window
@@ -209,55 +213,112 @@ void initOpenGLState() {
     glEnable(GL_FRAMEBUFFER_SRGB); // enable gamma correction
     glEnable(GL_DEPTH_TEST);  // enable depth-testing
     glDepthFunc(GL_LESS); // depth-testing interprets a smaller value as "closer"
-    glEnable(GL_CULL_FACE); // enable face culling
+    gps::Model3D::SetFaceCulling(true); // enable face culling, the meshlet culling follows it
     glCullFace(GL_BACK); // cull back faces
     glFrontFace(GL_CCW); // set front faces as counter-clockwise
 }
 
 // Load 3D models
 void initModels() {
-    scene.LoadModel("models/scene/scene.obj");
-    trees.LoadModel("models/scene/trees.obj");
-    screenQuad.LoadModel("models/quad/quad.obj");
-    lightCube1.LoadModel("models/cube/cube.obj");
-    lightCube2.LoadModel("models/cube/cube.obj");
-    balloon.LoadModel("models/balloon/balloon1.obj");
-	raindrop.LoadModel("models/rain/drop.obj");
-	//lake.LoadModel("models/lake/lake.obj");
+    // the helper models are never read back, what the scene models keep is up to its manifest
+    screenQuad.SetCpuGeometry(gps::CPU_GEOMETRY_NONE);
+    lightCube1.SetCpuGeometry(gps::CPU_GEOMETRY_NONE);
+    lightCube2.SetCpuGeometry(gps::CPU_GEOMETRY_NONE);
+
+    // all models are parsed at once on the worker threads, the GL objects are created here
+    gps::ModelLoader loader;
+    if (!world.Load(sceneFileName, loader)) {
+        exit(1);
+    }
+    loader.Add(screenQuad, "models/quad/quad.obj");
+    loader.Add(lightCube1, "models/cube/cube.obj");
+    loader.Add(lightCube2, "models/cube/cube.obj");
+	//loader.Add(lake, "models/lake/lake.obj");
+    loader.Finish();
+
+    opaqueGroup = world.GetManifest().FindGroup("opaque");
+    foliageGroup = world.GetManifest().FindGroup("foliage");
+
+    // start where the scene puts the camera
+    if (world.GetManifest().hasCamera) {
+        initialCameraPosition = world.GetManifest().camera.position;
+        initialCameraTarget = world.GetManifest().camera.target;
+        myCamera.setCameraPosition(initialCameraPosition);
+        myCamera.setCameraTarget(initialCameraTarget);
+    }
+
+    int tour = world.GetManifest().FindPath("tour");
+    if (tour >= 0) {
+        tourPath = world.GetManifest().paths[tour].waypoints;
+    }
+}
+
+// Copies the first point lights of the scene to the ones the shaders have, turned off they keep their place
+void setPointLights(bool on) {
+    const std::vector<gps::SceneLight>& lights = world.GetManifest().lights;
+
+    for (size_t i = 0; i < (size_t)gps::MAX_POINT_LIGHTS; i++) {
+        pointLights.pointLights[i].position = i < lights.size() ? lights[i].position : glm::vec3(0.0f);
+        pointLights.pointLights[i].padding0 = 0.0f;
+        pointLights.pointLights[i].color = i < lights.size() && on ? lights[i].color : glm::vec3(0.0f);
+        pointLights.pointLights[i].padding1 = 0.0f;
+    }
+}
+
+// Create the uniform blocks before the shaders, so linking finds their binding points
+void initUniformBuffers() {
+    frameUniforms.Create("FrameConstants", gps::FRAME_CONSTANTS_BINDING, sizeof(gps::FrameConstants));
+    lightUniforms.Create("LightConstants", gps::LIGHT_CONSTANTS_BINDING, sizeof(gps::LightConstants));
 }
 
 // Initialize shader programs
 void initShaders() {
-    basicShader.loadShader("shaders/basic.vert", "shaders/basic.frag");
+    basicShaders.Load("shaders/basic.vert", "shaders/basic.frag");
     skyboxShader.loadShader("shaders/skybox.vert", "shaders/skybox.frag");
     shadowShader.loadShader("shaders/shadow.vert", "shaders/shadow.frag");
-    treesShader.loadShader("shaders/trees.vert", "shaders/trees.frag");
+    treesShaders.Load("shaders/trees.vert", "shaders/trees.frag");
     screenQuadShader.loadShader("shaders/screenQuad.vert", "shaders/screenQuad.frag");
     lightCubeShader.loadShader("shaders/lightCube.vert", "shaders/lightCube.frag");
-}
 
-// Initialize skybox with appropriate textures
-void initSkybox(bool isNightTime) {
-    std::vector<const GLchar*> faces;
-    if (!isNightTime) {
-        // Day time skybox textures
-        faces.push_back("skybox/posx.tga");
-        faces.push_back("skybox/negx.tga");
-        faces.push_back("skybox/posy.tga");
-        faces.push_back("skybox/negy.tga");
-        faces.push_back("skybox/posz.tga");
-        faces.push_back("skybox/negz.tga");
-    }
-    else {
-        // Night time skybox textures
-        faces.push_back("skybox/night_right.tga");
-        faces.push_back("skybox/night_left.tga");
-        faces.push_back("skybox/night_top.tga");
-        faces.push_back("skybox/night_bottom.tga");
-        faces.push_back("skybox/night_back.tga");
-        faces.push_back("skybox/night_front.tga");
+    // every permutation getShaderPermutation can return, so toggling night, fog or the lights never compiles mid-frame
+    // the sun is the only shadow caster, so shadows come with the day and never with NIGHT
+    int lightCount = glm::min((int)world.GetManifest().lights.size(), gps::MAX_POINT_LIGHTS);
+    for (int night = 0; night < 2; night++) {
+        for (int fog = 0; fog < 2; fog++) {
+            for (int lightsOn = 0; lightsOn < 2; lightsOn++) {
+
+                gps::ShaderPermutation permutation;
+                permutation.features = (night ? gps::SHADER_NIGHT : gps::SHADER_SHADOWS) | (fog ? gps::SHADER_FOG : 0) | gps::SHADER_ALPHA_TEST;
+                permutation.pointLightCount = lightsOn ? lightCount : 0;
+                basicShaders.Compile(permutation);
+                treesShaders.Compile(permutation);
+            }
+        }
     }
-    skyBox.Load(faces);
+}
+
+// Initialize skybox with the day and night textures, both stay loaded
+void initSkybox() {
+    // Day time skybox textures
+    std::vector<const GLchar*> dayFaces;
+    dayFaces.push_back("skybox/posx.jpg");
+    dayFaces.push_back("skybox/negx.jpg");
+    dayFaces.push_back("skybox/posy.jpg");
+    dayFaces.push_back("skybox/negy.jpg");
+    dayFaces.push_back("skybox/posz.jpg");
+    dayFaces.push_back("skybox/negz.jpg");
+
+    // Night time skybox textures
+    std::vector<const GLchar*> nightFaces;
+    nightFaces.push_back("skybox/night_right.tga");
+    nightFaces.push_back("skybox/night_left.tga");
+    nightFaces.push_back("skybox/night_top.tga");
+    nightFaces.push_back("skybox/night_bottom.tga");
+    nightFaces.push_back("skybox/night_back.tga");
+    nightFaces.push_back("skybox/night_front.tga");
+
+    skyBox.Load(dayFaces, nightFaces);
+    skyBox.SetNight(isNight != 0);
 }
 
 // Callback function for mouse movement
@@ -265,7 +326,6 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
     if (!captureMouse) return;  // don't process mouse movement if cursor is not captured
 
     //myCamera.mouse_callback(xpos, ypos);
-    basicShader.useShaderProgram();
     static double currentX = 0.0;
     static double currentY = 0.0;
     const float sensitivity = 0.10f;
@@ -295,7 +355,6 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
     myCamera.rotate(-yoffset, -xoffset);
     normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
     view = myCamera.getViewMatrix();
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 }
 
 // Callback function for keyboard input
@@ -308,19 +367,7 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
     if (key == GLFW_KEY_L && action == GLFW_PRESS) {
 		pointLightFlag = !pointLightFlag;  // toggle flag for point lights
 
-        if (!pointLightFlag) {
-            // turn off all lights
-            pointLightColor = glm::vec3(0.0f);
-            pointLightColor1 = glm::vec3(0.0f);
-            pointLightColor2 = glm::vec3(0.0f);
-            pointLightColor3 = glm::vec3(0.0f);
-        }
-        else {
-            pointLightColor = glm::vec3(1.0f); // white
-            pointLightColor1 = glm::vec3(1.50f, 0.0f, 1.0f); // purple
-            pointLightColor2 = glm::vec3(1.0f, 1.0f, 0.0f); // yellow
-            pointLightColor3 = glm::vec3(1.0f, 0.5f, 0.0f); // orange
-        }
+        setPointLights(pointLightFlag); // turn all lights off, or back to their colors in the scene
     }
 
     if (key == GLFW_KEY_F && action == GLFW_PRESS) {
@@ -346,19 +393,23 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
             isNight = 1;
         else
             isNight = 0;
-        if(isNight == 0) // initialize the skybox for the corresponding state
-		{
-			initSkybox(false);
-		}
-		else {
-			initSkybox(true);
-		}
+        skyBox.SetNight(isNight != 0); // the sky fades over, both cubemaps are already loaded
     }
 
 	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
 		isRaining = !isRaining; // toggle rain
     }
 
+    if (key == GLFW_KEY_K && action == GLFW_PRESS) {
+        gps::Model3D::SetLodEnabled(!gps::Model3D::IsLodEnabled()); // toggle levels of detail
+        printf("Levels of detail %s\n", gps::Model3D::IsLodEnabled() ? "on" : "off");
+    }
+
+    if (key == GLFW_KEY_J && action == GLFW_PRESS) {
+        gps::Model3D::SetCullingEnabled(!gps::Model3D::IsCullingEnabled()); // toggle mesh and meshlet culling
+        printf("Meshlet culling %s\n", gps::Model3D::IsCullingEnabled() ? "on" : "off");
+    }
+
     if (key == GLFW_KEY_C && action == GLFW_PRESS) {
         // Print the current camera position when the C key is pressed
 		printf("Camera position: x = %.2f, y = %.2f, z = %.2f\n", myCamera.getCameraPosition().x, myCamera.getCameraPosition().y, myCamera.getCameraPosition().z);
@@ -398,48 +449,36 @@ void processMovement() {
     if (pressedKeys[GLFW_KEY_W]) {
         myCamera.move(gps::MOVE_FORWARD, cameraSpeed);
         view = myCamera.getViewMatrix();
-        basicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
     }
 
     if (pressedKeys[GLFW_KEY_S]) {
         myCamera.move(gps::MOVE_BACKWARD, cameraSpeed);
         view = myCamera.getViewMatrix();
-        basicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
     }
 
     if (pressedKeys[GLFW_KEY_D]) {
         myCamera.move(gps::MOVE_LEFT, cameraSpeed);
         view = myCamera.getViewMatrix();
-        basicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
     }
 
     if (pressedKeys[GLFW_KEY_A]) {
         myCamera.move(gps::MOVE_RIGHT, cameraSpeed);
         view = myCamera.getViewMatrix();
-        basicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
     }
 
     if (pressedKeys[GLFW_KEY_E]) {
         myCamera.move(gps::MOVE_UP, cameraSpeed);
         view = myCamera.getViewMatrix();
-        basicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
     }
 
     if (pressedKeys[GLFW_KEY_R]) {
         myCamera.move(gps::MOVE_DOWN, cameraSpeed);
         view = myCamera.getViewMatrix();
-        basicShader.useShaderProgram();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
         normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
     }
 
@@ -494,79 +533,42 @@ void processMovement() {
 }
 
 void initUniforms() {
-    // scene matrices
-    basicShader.useShaderProgram();
+    // scene matrices, the shaders looked up their uniforms when they were linked
+    // what every program shares goes into the uniform blocks at the start of each frame
 
     // create model matrix
     model = glm::mat4(1.0f);
-    modelLoc = glGetUniformLocation(basicShader.shaderProgram, "model");
    
     // get view matrix for current camera
     view = myCamera.getViewMatrix();
-    viewLoc = glGetUniformLocation(basicShader.shaderProgram, "view");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view)); // send view matrix to shader
 
     // compute normal matrix
     normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-    normalMatrixLoc = glGetUniformLocation(basicShader.shaderProgram, "normalMatrix");
 	
     // create projection matrix
     projection = glm::perspective(glm::radians(45.0f), (float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height, 0.1f, 70.0f);
-    projectionLoc = glGetUniformLocation(basicShader.shaderProgram, "projection");
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection)); // send projection matrix to shader
 
     // set the light direction (direction towards the light)
     lightDir = glm::vec3(4.0f, 4.0f, -9.0f);
-    lightDirLoc = glGetUniformLocation(basicShader.shaderProgram, "lightDir");
 	lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-
-    // send light dir to shader
-    glUniform3fv(lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(lightRotation)) * lightDir));
    
     //set light color
     lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
-    lightColorLoc = glGetUniformLocation(basicShader.shaderProgram, "lightColor");
-    // send light color to shader
-    glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
 
     // point lights
     pointLightFlag = true;
-    pointLightPos = glm::vec3(-15.3f, 1.4839f, -6.4227f);
-    pointLightColor = glm::vec3(1.0f, 1.0f, 1.0f);
-    pointLightPos1 = glm::vec3(-2.65f, 1.18f, 3.66f);
-    pointLightColor1 = glm::vec3(1.0f, 0.0f, 1.0f);
-    pointLightPos2 = glm::vec3(-1.58f, 1.09f, 3.64f);
-    pointLightColor2 = glm::vec3(1.0f, 1.0f, 0.0f);
-    pointLightPos3 = glm::vec3(-12.61f, 1.15f, 12.50f);
-    pointLightColor3 = glm::vec3(1.0f, 0.5f, 0.0f);
+    setPointLights(pointLightFlag);
+    if (world.GetManifest().lights.size() > (size_t)gps::MAX_POINT_LIGHTS) {
+        fprintf(stderr, "WARNING: %s has %d point lights, only the first %d are drawn\n", sceneFileName.c_str(), (int)world.GetManifest().lights.size(), gps::MAX_POINT_LIGHTS);
+    }
 
 	// alpha channel for transparent objects
     alpha = 0.85;
-	alphaLoc = glGetUniformLocation(basicShader.shaderProgram, "alpha");
-	glUniform1f(alphaLoc, alpha);
 
     // shadows
     glm::mat4 lightView = glm::lookAt(lightDir, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     glm::mat4 lightProjection = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, near_plane, far_plane);
     lightSpaceMatrix = lightProjection * lightView;
-    lightSpaceMatrixLoc = glGetUniformLocation(shadowShader.shaderProgram, "lightSpaceMatrix");
-
-    // trees
-    treesShader.useShaderProgram();
-    treesModelLoc = glGetUniformLocation(treesShader.shaderProgram, "model");
-    treesNormalMatrixLoc = glGetUniformLocation(treesShader.shaderProgram, "normalMatrix");
-    treesViewLoc = glGetUniformLocation(treesShader.shaderProgram, "view");
-    treesProjectionLoc = glGetUniformLocation(treesShader.shaderProgram, "projection");
-    treesLightDirLoc = glGetUniformLocation(treesShader.shaderProgram, "lightDir");
-    treesLightColorLoc = glGetUniformLocation(treesShader.shaderProgram, "lightColor");
-    glUniformMatrix4fv(treesViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(treesProjectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    glUniform3fv(treesLightDirLoc, 1, glm::value_ptr(lightDir));
-    glUniform3fv(treesLightColorLoc, 1, glm::value_ptr(lightColor));
-
-    // lightCube
-    lightCubeShader.useShaderProgram();
-	glUniformMatrix4fv(glGetUniformLocation(lightCubeShader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 }
 
 glm::mat4 computeLightSpaceTrMatrix() {
@@ -579,118 +581,124 @@ glm::mat4 computeLightSpaceTrMatrix() {
     return lightSpaceTrMatrix;
 }
 
-void renderMainScene(gps::Shader shader, bool depthPass) {
-    // select active shader program
-    shader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (!depthPass) {
-		glm::mat3 normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-		glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    scene.Draw(shader);
+void renderMainScene(const gps::Shader& shader, bool depthPass) {
+    // every opaque instance of the scene, each with its own model and normal matrix
+    world.DrawGroup(shader, opaqueGroup, view, depthPass);
 }
 
-void renderTrees(gps::Shader shader, bool depthPass) {
-    shader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (!depthPass) {
-        glm::mat3 normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(treesNormalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-    }
-    glUniformMatrix4fv(treesViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniform3fv(treesLightDirLoc, 1, glm::value_ptr(glm::mat3(view) * lightDir));
-    glUniform1f(glGetUniformLocation(shader.shaderProgram, "fogDensity"), fogDensity);
-    glUniform1i(glGetUniformLocation(shader.shaderProgram, "isNight"), isNight);
-    glUniform3fv(glGetUniformLocation(shader.shaderProgram, "pointLightColor"), 1, glm::value_ptr(pointLightColor));
-    glUniform3fv(glGetUniformLocation(shader.shaderProgram, "pointLightColor1"), 1, glm::value_ptr(pointLightColor1));
-    glUniform3fv(glGetUniformLocation(shader.shaderProgram, "pointLightColor1"), 1, glm::value_ptr(pointLightColor2));
-    glUniform3fv(glGetUniformLocation(shader.shaderProgram, "pointLightColor3"), 1, glm::value_ptr(pointLightColor3));
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(computeLightSpaceTrMatrix()));
-    glDisable(GL_CULL_FACE);
-    trees.Draw(shader);
-    glEnable(GL_CULL_FACE);
-}
-
-void renderLake(gps::Shader shader, bool depthPass) {
+void renderTrees(const gps::Shader& shader, bool depthPass) {
+    // lights, fog and matrices come from the uniform blocks, the same ones the basic shader reads
+    gps::Model3D::SetFaceCulling(false);
+    world.DrawGroup(shader, foliageGroup, view, depthPass);
+    gps::Model3D::SetFaceCulling(true);
+}
+
+void renderLake(const gps::Shader& shader, bool depthPass) {
     shader.useShaderProgram();
     //enable blending for transparent objects
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+    shader.SetUniform("model", model);
     if (!depthPass) {
-        glm::mat3 normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+        shader.SetUniform("normalMatrix", glm::mat3(glm::inverseTranspose(view * model)));
     }
     //set alpha channel
     alpha = 0.5f;
-    alphaLoc = glGetUniformLocation(shader.shaderProgram, "alpha");
-    glUniform1f(alphaLoc, alpha);
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+    shader.SetUniform("alpha", alpha);
     // Disable depth writing but keep depth testing
     glDepthMask(GL_FALSE);
-    lake.Draw(shader);
+    lake.Draw(shader, model);
     glDepthMask(GL_TRUE);
     // Disable blending after rendering
     glDisable(GL_BLEND);
 }
 
-void updateBalloon(float deltaTime) {
-    static float angle = 0.0f;
-    float radius = 1.0f; // Radius of the circular path
-    float speed = 1.0f;  // Speed of the circular motion
-
-    angle += speed * deltaTime;
-    balloonPosition.x = radius * cos(angle);
-    balloonPosition.z = radius * sin(angle);
-    balloonPosition.y = 5.0f; // Fixed height in the scene
-}
-
-void renderBalloon(gps::Shader shader, bool depthPass) {
-    shader.useShaderProgram();
-
-    // Set the model matrix for the balloon
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), balloonPosition);
-    model = glm::scale(model, glm::vec3(0.5f)); // apply scaling
-
-    glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    if (!depthPass) {
-        glm::mat3 normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-        glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+void renderRain(const gps::Shader& shader) {
+    if (rainEmitter == NULL) {
+        return;
     }
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    balloon.Draw(shader);
-}
-
-void renderRain(gps::Shader shader) {
 	shader.useShaderProgram();
+    gps::Model3D& raindrop = world.GetModel(rainEmitter->model);
+    int modelUniform = shader.GetUniform("model"); // looked up once for all the drops
 
     // render the raindrops
 	for (int i = 0; i < raindrops.size(); i++) {
 		glm::mat4 model = glm::mat4(1.0f);
 		model = glm::translate(model, raindrops[i].position);
-        model = glm::scale(model, glm::vec3(0.1f, 0.5f, 0.1f));
-		glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
-		raindrop.Draw(shader);
+        model = glm::scale(model, rainEmitter->scale);
+		shader.SetUniform(modelUniform, model);
+		raindrop.Draw(shader, model, raindrops[i].lod);
 	}
 }
 
+// Fills the uniform blocks for this frame, they upload only when something changed
+void updateUniformBuffers() {
+    view = myCamera.getViewMatrix();
+    lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // zeroed, so the padding compares equal from frame to frame
+    gps::FrameConstants frame = gps::FrameConstants();
+    frame.view = view;
+    frame.projection = projection;
+    frame.lightSpaceMatrix = computeLightSpaceTrMatrix();
+    frame.lightDir = glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir;
+    frame.fogDensity = fogDensity;
+    frame.lightColor = lightColor;
+    frameUniforms.Update(&frame);
+
+    lightUniforms.Update(&pointLights);
+}
+
+// Features the lit shaders need for the current state, whatever is off is left out of the variant
+gps::ShaderPermutation getShaderPermutation() {
+    gps::ShaderPermutation permutation;
+    // every lit draw drops the fragments with almost no alpha, cutouts can be anywhere in the scene
+    permutation.features = gps::SHADER_ALPHA_TEST;
+    if (isNight != 0) {
+        permutation.features |= gps::SHADER_NIGHT;
+    } else {
+        permutation.features |= gps::SHADER_SHADOWS; // only the sun casts shadows
+    }
+    if (fogFlag && fogDensity > 0.0f) {
+        permutation.features |= gps::SHADER_FOG;
+    }
+    // turned off lights are black, leaving them out changes nothing on screen
+    permutation.pointLightCount = pointLightFlag ? glm::min((int)world.GetManifest().lights.size(), gps::MAX_POINT_LIGHTS) : 0;
+    return permutation;
+}
+
 void renderScene() {
+    // one upload for every program and pass of the frame
+    updateUniformBuffers();
+
+    gps::ShaderPermutation permutation = getShaderPermutation();
+    bool shadows = (permutation.features & gps::SHADER_SHADOWS) != 0;
+
+    // levels of detail follow the main camera in every pass, so shadows match what is seen
+    gps::Model3D::SetLodView(myCamera.getCameraPosition(), projection, myWindow.getWindowDimensions().height);
+
     // Clear the color and depth buffers
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
     glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
     glClear(GL_DEPTH_BUFFER_BIT);
     shadowShader.useShaderProgram();
-    glUniformMatrix4fv(glGetUniformLocation(shadowShader.shaderProgram, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(computeLightSpaceTrMatrix()));
 
-    // render scene = draw objects
-	renderMainScene(shadowShader, true);
-    renderTrees(shadowShader, true);
-    // Update and render the balloon
+    // the shadow map only needs what the light sees, the light is directional so its eye is a direction
+    gps::Model3D::SetCullView(computeLightSpaceTrMatrix(), glm::vec4(glm::inverseTranspose(glm::mat3(lightRotation)) * lightDir, 0.0f));
+
+    // render scene = draw objects, unless nothing reads the shadow map this frame
+    if (shadows || showDepthMap) {
+        renderMainScene(shadowShader, true);
+        renderTrees(shadowShader, true);
+    }
+    // move the orbiting instances, the balloon among them
     float deltaTime = getDeltaTime();
-    updateBalloon(deltaTime);
-    renderBalloon(shadowShader, true);
-    renderLake(shadowShader, true);
+    world.Update(deltaTime);
+    skyBox.Update(deltaTime);
+    if (shadows || showDepthMap) {
+        renderLake(shadowShader, true);
+    }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
@@ -701,7 +709,7 @@ void renderScene() {
         //bind the depth map
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-        glUniform1i(glGetUniformLocation(screenQuadShader.shaderProgram, "depthMap"), 0);
+        screenQuadShader.SetUniform("depthMap", 0);
         glDisable(GL_DEPTH_TEST);
         screenQuad.Draw(screenQuadShader);
         glEnable(GL_DEPTH_TEST);
@@ -710,48 +718,117 @@ void renderScene() {
         glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        basicShader.useShaderProgram();
-
-        glUniform1f(glGetUniformLocation(basicShader.shaderProgram, "fogDensity"), fogDensity);
-        glUniform1i(glGetUniformLocation(basicShader.shaderProgram, "isNight"), isNight);
-
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightPos"), 1, glm::value_ptr(pointLightPos));
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightPos1"), 1, glm::value_ptr(pointLightPos1));
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightPos2"), 1, glm::value_ptr(pointLightPos2));
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightPos3"), 1, glm::value_ptr(pointLightPos3));
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightColor"), 1, glm::value_ptr(pointLightColor));
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightColor1"), 1, glm::value_ptr(pointLightColor1));
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightColor2"), 1, glm::value_ptr(pointLightColor2));
-        glUniform3fv(glGetUniformLocation(basicShader.shaderProgram, "pointLightColor3"), 1, glm::value_ptr(pointLightColor3));
+        const gps::Shader& basicShader = basicShaders.Get(permutation);
+        const gps::Shader& treesShader = treesShaders.Get(permutation);
 
-        view = myCamera.getViewMatrix();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniform3fv(lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir));
+        basicShader.useShaderProgram();
 
         //bind the shadow map
         glActiveTexture(GL_TEXTURE3);
         glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-        glUniform1i(glGetUniformLocation(basicShader.shaderProgram, "shadowMap"), 3);
-        glUniformMatrix4fv(glGetUniformLocation(basicShader.shaderProgram, "lightSpaceMatrix"), 1, GL_FALSE, glm::value_ptr(computeLightSpaceTrMatrix()));
+        basicShader.SetUniform("shadowMap", 3);
+        treesShader.SetUniform("shadowMap", 3);
+
+        gps::Model3D::SetCullView(projection * view, glm::vec4(myCamera.getCameraPosition(), 1.0f));
+
+        // move the orbiting instances again, then draw them with the rest of the scene
+        float deltaTime = getDeltaTime();
+        world.Update(deltaTime);
 
         renderMainScene(basicShader, false);
         renderTrees(treesShader, false);
 
-        // Update and render the balloon
-        float deltaTime = getDeltaTime(); 
-        updateBalloon(deltaTime);
-        renderBalloon(basicShader, false);
-
 		if (isRaining) {
 			renderRain(basicShader);
 		}
 
         //renderLake(shadowShader, false);
 
-        skyBox.Draw(skyboxShader, view, projection);
+        skyBox.Draw(skyboxShader);
+    }
+}
+
+// frame statistics, averaged over a few seconds
+const double FRAME_STATS_INTERVAL = 5.0;
+double frameStatsStart;
+unsigned int frameStatsFrames = 0;
+unsigned long frameStatsDraws = 0;
+unsigned long frameStatsTextureBinds = 0;
+unsigned long frameStatsUnbatchedTextureBinds = 0;
+unsigned long frameStatsTriangles = 0;
+unsigned long frameStatsFullDetailTriangles = 0;
+unsigned long frameStatsCulledTriangles = 0;
+unsigned long frameStatsUniformSets = 0;
+unsigned long frameStatsRedundantUniformSets = 0;
+unsigned long frameStatsUniformBlockUploads = 0;
+
+// culling along the tour, reported once it ends
+unsigned long tourTriangles = 0;
+unsigned long tourFrustumCulledTriangles = 0;
+unsigned long tourBackfaceCulledTriangles = 0;
+
+void updateTourStats() {
+    if (inTour) {
+        tourTriangles += gps::Mesh::GetTriangleCount();
+        tourFrustumCulledTriangles += gps::Mesh::GetFrustumCulledTriangleCount();
+        tourBackfaceCulledTriangles += gps::Mesh::GetBackfaceCulledTriangleCount();
+        return;
+    }
+
+    unsigned long culled = tourFrustumCulledTriangles + tourBackfaceCulledTriangles;
+    if (tourTriangles + culled == 0) {
+        return;
+    }
+    std::cout << "Tour: culling rejected " << 100.0 * culled / (tourTriangles + culled) << "% of the triangles of both passes ("
+        << 100.0 * tourFrustumCulledTriangles / (tourTriangles + culled) << "% outside the frustum, "
+        << 100.0 * tourBackfaceCulledTriangles / (tourTriangles + culled) << "% back-facing meshlets)" << std::endl;
+
+    tourTriangles = 0;
+    tourFrustumCulledTriangles = 0;
+    tourBackfaceCulledTriangles = 0;
+}
+
+void updateFrameStats() {
+    updateTourStats();
+
+    frameStatsDraws += gps::Mesh::GetDrawCount();
+    frameStatsTextureBinds += gps::Mesh::GetTextureBindCount();
+    frameStatsUnbatchedTextureBinds += gps::Mesh::GetUnbatchedTextureBindCount();
+    frameStatsTriangles += gps::Mesh::GetTriangleCount();
+    frameStatsFullDetailTriangles += gps::Mesh::GetFullDetailTriangleCount();
+    frameStatsCulledTriangles += gps::Mesh::GetFrustumCulledTriangleCount() + gps::Mesh::GetBackfaceCulledTriangleCount();
+    gps::Mesh::ResetStats();
+    frameStatsUniformSets += gps::Shader::GetUniformSetCount();
+    frameStatsRedundantUniformSets += gps::Shader::GetRedundantUniformSetCount();
+    frameStatsUniformBlockUploads += gps::UniformBuffer::GetUploadCount();
+    gps::Shader::ResetStats();
+    gps::UniformBuffer::ResetStats();
+    frameStatsFrames++;
+
+    double now = glfwGetTime();
+    if (now - frameStatsStart >= FRAME_STATS_INTERVAL) {
+        std::cout << "Frame stats: " << frameStatsFrames / (now - frameStatsStart) << " fps, "
+            << (double)frameStatsDraws / frameStatsFrames << " draws/frame, "
+            << (double)frameStatsTextureBinds / frameStatsFrames << " texture binds/frame ("
+            << (double)frameStatsUnbatchedTextureBinds / frameStatsFrames << " without batching), "
+            << frameStatsTriangles / frameStatsFrames << " triangles/frame ("
+            << frameStatsFullDetailTriangles / frameStatsFrames << " without LOD), "
+            << frameStatsCulledTriangles / frameStatsFrames << " culled/frame, "
+            << frameStatsUniformSets / frameStatsFrames << " uniform sets/frame ("
+            << frameStatsRedundantUniformSets / frameStatsFrames << " redundant, skipped), "
+            << (double)frameStatsUniformBlockUploads / frameStatsFrames << " uniform block uploads/frame" << std::endl;
+
+        frameStatsStart = now;
+        frameStatsFrames = 0;
+        frameStatsDraws = 0;
+        frameStatsTextureBinds = 0;
+        frameStatsUnbatchedTextureBinds = 0;
+        frameStatsTriangles = 0;
+        frameStatsFullDetailTriangles = 0;
+        frameStatsCulledTriangles = 0;
+        frameStatsUniformSets = 0;
+        frameStatsRedundantUniformSets = 0;
+        frameStatsUniformBlockUploads = 0;
     }
 }
 
@@ -794,36 +871,8 @@ void resetCamera() {
     myCamera.setCameraPosition(initialCameraPosition);
     myCamera.setCameraTarget(initialCameraTarget);
     view = myCamera.getViewMatrix();
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
 }
 
-// Define tour waypoints for camera movement
-struct Waypoint {
-    glm::vec3 position;
-    glm::vec3 target;
-};
-
-// Tour path definition with waypoints
-std::vector<Waypoint> tourPath = {
-    {{27.0f, 8.0f, -3.5f}, {0.0f, 2.0f, 0.0f}},
-    //{{27.25f, 7.64f, -3.42f}, {0.0f, 2.0f, 0.0f}},
-    //{{26.68f, 7.64f, 6.06f}, {0.0f, 2.0f, 0.0f}},
-    {{20.0f, 7.0f, 5.0f}, {-2.0f, 2.0f, 0.0f}},
-    {{13.46f, 3.83f, 15.18f}, {-3.0f, 2.0f, -2.0f}},
-    //{{4.21f, 4.99f, 16.25f}, {-8.0f, 2.0f, -2.0f}},
-    {{-3.87f, 4.99f, 20.11f}, {-10.0f, 2.0f, -3.0f}},
-    //{{-9.83f, 4.99f, 20.76f}, {-10.0f, 2.0f, -3.0f}},
-    {{-14.63f, 4.99f, 19.33f}, {3.15f, 2.97f, -2.40f}},
-   // {{-18.04f, 3.37f, 12.93f}, {5.0f, 7.0f, -8.0f}},
-    {{-17.06f, 2.0f, 7.32f}, {0.0f, 2.0f, 0.0f}},
-    {{-23.73f, 1.05f, -10.42f}, {0.0f, 2.0f, 0.0f}},
-    {{-20.88f, 1.05f, -16.81f}, {0.0f, 2.0f, 0.0f}},
-    //{{-7.77f, 2.72f, -15.41f}, {0.0f, 2.0f, 0.0f}},
-    {{-3.62f, 2.72f, -13.68f}, {0.0f, 2.0f, 0.0f}},
-    {{27.0f, 8.0f, -3.5f}, {0.0f, 2.0f, 0.0f}}
-};
-
-
 glm::vec3 interpolate(glm::vec3 start, glm::vec3 end, float t) {
     return start * (1.0f - t) + end * t;
 }
@@ -838,16 +887,55 @@ int main(int argc, const char* argv[]) {
     }
 
     initOpenGLState();
+
+    // assets packed by gps_bake --pack, loose files fill in whatever the archive lacks
+    if (gps::VirtualFileSystem::GetShared().Mount("assets.gpspack")) {
+        std::cout << "Mounted assets.gpspack (" << gps::VirtualFileSystem::GetShared().GetArchivedFileCount() << " files)" << std::endl;
+    }
+
+    // --bench-textures: time the texture ingest paths on the scene textures and quit
+    if (argc > 1 && std::string(argv[1]) == "--bench-textures") {
+
+        std::vector<std::string> textures;
+        textures.push_back("models/balloon/cos.jpg");
+        textures.push_back("models/balloon/culori.jpg");
+        textures.push_back("skybox/negx.jpg");
+        gps::RunTextureBenchmark(textures);
+        cleanup();
+        return EXIT_SUCCESS;
+    }
+
+    // --bench-models: time the scene models loaded as OBJ, from the mesh cache and as GLB, and quit
+    if (argc > 1 && std::string(argv[1]) == "--bench-models") {
+
+        std::vector<std::string> models;
+        models.push_back("models/scene/scene.obj");
+        models.push_back("models/balloon/balloon1.obj");
+        models.push_back("models/rain/drop.obj");
+        gps::RunModelBenchmark(models);
+        cleanup();
+        return EXIT_SUCCESS;
+    }
+
+    // --scene FILE: load another scene manifest, as text or compiled
+    if (argc > 2 && std::string(argv[1]) == "--scene") {
+        sceneFileName = argv[2];
+    }
+
     initModels();
+    initUniformBuffers();
     initShaders();
     initUniforms();
     setWindowCallbacks();
-    initSkybox(false);
+    initSkybox();
     initFBO();
     initRain();
+    gps::AssetRegistry::GetShared().PrintReport();
 
     //glCheckError();
 
+    frameStatsStart = glfwGetTime();
+
     // application loop
     while (!glfwWindowShouldClose(myWindow.getWindow())) {
         processMovement();
@@ -860,7 +948,7 @@ int main(int argc, const char* argv[]) {
             static int currentWaypoint = 0;
             static float t = 0.0f;
 
-            if (currentWaypoint < tourPath.size() - 1) {
+            if (currentWaypoint + 1 < tourPath.size()) {
                 glm::vec3 newPosition = interpolate(tourPath[currentWaypoint].position, tourPath[currentWaypoint + 1].position, t);
                 glm::vec3 newTarget = tourPath[currentWaypoint + 1].target;  // Focus on next point
                 myCamera.setCameraPosition(newPosition);
@@ -878,7 +966,11 @@ int main(int argc, const char* argv[]) {
             }
         }
 
+        // textures fill in progressively, a few MB per frame
+        gps::TextureStreamer::GetShared().Update();
+
         renderScene();
+        updateFrameStats();
 
         glfwPollEvents();
         glfwSwapBuffers(myWindow.getWindow());
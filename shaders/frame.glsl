@@ -0,0 +1,12 @@
+// Frame constants shared by every program, written once per frame
+layout(std140) uniform FrameConstants
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceMatrix;
+	// eye space direction towards the sun
+	vec3 lightDir;
+	float fogDensity;
+	vec3 lightColor;
+	float padding0;
+};
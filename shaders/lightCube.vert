@@ -1,14 +1,14 @@
 #version 410 core
 
-layout(location=0) in vec3 vPosition;
-layout(location=1) in vec3 vNormal;
-layout(location=2) in vec2 vTexCoords;
+#include "vertex.glsl"
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+#include "frame.glsl"
 
 void main() 
 {
-	gl_Position = projection * view * model * vec4(vPosition, 1.0f);
+	vec3 position = decodePosition();
+
+	gl_Position = projection * view * model * vec4(position, 1.0f);
 }
@@ -0,0 +1,98 @@
+// Lighting shared by the basic and trees fragment shaders
+// The including shader declares fPosition, fNormal, fragPosLightSpace, the
+// model and normalMatrix uniforms and the ambient, diffuse and specular
+// components with their ambientStrength and specularStrength
+
+#include "frame.glsl"
+
+// Lights evaluated per fragment, the variant defines how many
+#ifndef POINT_LIGHT_COUNT
+#define POINT_LIGHT_COUNT 4
+#endif
+
+// Point lights of the scene, the block always holds four
+struct PointLight
+{
+	vec3 position;
+	vec3 color;
+};
+
+layout(std140) uniform LightConstants
+{
+	PointLight pointLights[4];
+};
+
+// Uniform variables for fog
+uniform vec3 fogColor = vec3(0.5, 0.5, 0.5);
+
+// Uniform variable for shadow mapping
+uniform sampler2D shadowMap;
+
+// Function to compute point light contribution
+void computePointLight(vec3 pointLightPos, vec3 pointLightColor)
+{
+    float constant = 1.0f;
+    float linear = 0.35f;
+    float quadratic = 0.44f;
+
+    vec3 normalEye = normalize(normalMatrix * fNormal);
+    
+
+    vec3 lightDir2 = normalize(pointLightPos - fPosition);
+
+    vec3 halfVector = normalize(lightDir2 + lightDir2);
+    float specCoeff = pow(max(dot(normalEye, halfVector), 0.0f), 32);
+
+    float distance2 = length(pointLightPos - fPosition.xyz);
+    float attenuation2 = 1.0 / (constant + linear * distance2 + quadratic * (distance2 * distance2));
+
+    ambient += ambientStrength * pointLightColor * attenuation2;
+
+    diffuse += max(dot(normalEye, lightDir2), 0.0f) * pointLightColor * attenuation2;
+    specular += specularStrength * pow(max(dot(normalEye, reflect(-lightDir2, normalEye)), 0.0f), 32) * pointLightColor * attenuation2;
+}
+
+// Adds the point lights the variant was built for
+void computePointLights()
+{
+    for (int i = 0; i < POINT_LIGHT_COUNT; i++)
+        computePointLight(pointLights[i].position, pointLights[i].color);
+}
+
+// Function to compute shadow contribution
+float computeShadow()
+{
+	// perform perspective divide
+	vec3 normalizedCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
+	// Transform to [0,1] range
+	normalizedCoords = normalizedCoords * 0.5 + 0.5;
+	if (normalizedCoords.z > 1.0f)
+		return 0.0f;
+	// Get closest depth value from light's perspective
+	float closestDepth = texture(shadowMap, normalizedCoords.xy).r;
+	// Get depth of current fragment from light's perspective
+	float currentDepth = normalizedCoords.z;
+	// Check whether current frag pos is in shadow
+	float bias = 0.005f;
+	float shadow = currentDepth - bias > closestDepth ? 1.0f : 0.0f;
+	return shadow;
+}
+
+// Function to compute fog contribution
+float computeFog()
+{
+	vec4 fPosEye = view * model * vec4(fPosition, 1.0f);
+	float fragDist  = length(fPosEye.xyz);
+	float factor = exp(-pow(fragDist * fogDensity, 2));
+	return clamp(factor, 0.0f, 1.0f);
+}
+
+// Final color, fogged when the variant has fog
+vec4 applyFog(vec3 color)
+{
+#ifdef FOG
+	return mix(vec4(fogColor, 1.0f), vec4(color, 1.0f), computeFog());
+#else
+	return vec4(color, 1.0f);
+#endif
+}
@@ -1,15 +1,15 @@
 #version 410 core
 
-layout(location=0) in vec3 vPosition;
-layout(location=1) in vec3 vNormal;
-layout(location=2) in vec2 vTexCoords;
+#include "vertex.glsl"
 
-uniform mat4 lightSpaceMatrix;
 uniform mat4 model;
 
+#include "frame.glsl"
 
 void main()
 {
-  gl_Position = lightSpaceMatrix * model * vec4(vPosition, 1.0f);
+  vec3 position = decodePosition();
+
+  gl_Position = lightSpaceMatrix * model * vec4(position, 1.0f);
 }
 
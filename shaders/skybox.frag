@@ -4,8 +4,11 @@ in vec3 textureCoordinates;
 out vec4 color;
 
 uniform samplerCube skybox;
+uniform samplerCube nightSkybox;
+// 0 is day, 1 is night, in between while the sky fades
+uniform float nightBlend;
 
 void main()
 {
-    color = texture(skybox, textureCoordinates);
+    color = mix(texture(skybox, textureCoordinates), texture(nightSkybox, textureCoordinates), nightBlend);
 }
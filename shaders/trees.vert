@@ -1,8 +1,6 @@
 #version 410 core
 
-layout(location=0) in vec3 vPosition;
-layout(location=1) in vec3 vNormal;
-layout(location=2) in vec2 vTexCoords;
+#include "vertex.glsl"
 
 out vec3 fPosition;
 out vec3 fNormal;
@@ -10,17 +8,21 @@ out vec2 fTexCoords;
 out vec4 fragPosLightSpace;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform mat3 normalMatrix;
-uniform mat4 lightSpaceMatrix;
+
+#include "frame.glsl"
 
 void main() 
 {
-    gl_Position = projection * view * vec4(vPosition, 1.0f);
+	vec3 position = decodePosition();
+	vec3 normal = decodeNormal();
+
+    gl_Position = projection * view * vec4(position, 1.0f);
 
-	fPosition = vPosition;
-	fNormal = vNormal;
+	fPosition = position;
+	fNormal = normal;
 	fTexCoords = vTexCoords;
-	fragPosLightSpace = lightSpaceMatrix * model * vec4(vPosition, 1.0f);
+#ifdef SHADOWS
+	fragPosLightSpace = lightSpaceMatrix * model * vec4(position, 1.0f);
+#endif
 }
@@ -0,0 +1,27 @@
+// Vertex attributes of a Mesh, float or packed, and their decoding
+layout(location=0) in vec3 vPosition;
+layout(location=1) in vec3 vNormal;
+layout(location=2) in vec2 vTexCoords;
+
+// Dequantization constants of packed vertices, set by Mesh for every draw
+// position = offset + position * scale.xyz, scale.w is 1 for octahedral normals
+layout(location=3) in vec4 vDecodeScale;
+layout(location=4) in vec3 vDecodeOffset;
+
+vec3 decodePosition()
+{
+	return vDecodeOffset + vPosition * vDecodeScale.xyz;
+}
+
+vec3 decodeNormal()
+{
+	if (vDecodeScale.w < 0.5f)
+		return vNormal;
+
+	// unfold the octahedron, the lower half was mirrored over the diagonals
+	vec3 n = vec3(vNormal.xy, 1.0f - abs(vNormal.x) - abs(vNormal.y));
+	float t = max(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
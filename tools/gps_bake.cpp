@@ -0,0 +1,83 @@
+//
+//  gps_bake.cpp
+//
+//  Offline build of the runtime assets - run from the directory the game
+//  starts in, the baked tree is found relative to it.
+//
+//  Built as its own executable from this file and the project sources
+//  except main.cpp; it links the same libraries but never opens a window
+//  or a GL context.
+//
+
+#include "../AssetBaker.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void printUsage() {
+
+    fprintf(stderr, "usage: gps_bake [--force] [--jobs N] [--models DIR]... [--skybox DIR]... [--scenes DIR]... [--pack FILE [--include DIR]...]\n");
+    fprintf(stderr, "  bakes models/, skybox/ and scenes/ when no directory is given, into %s\n", gps::BAKED_ASSET_DIRECTORY);
+    fprintf(stderr, "  --pack also writes the sources, the baked assets and shaders/ (or the --include directories) to one archive\n");
+}
+
+int main(int argc, const char* argv[]) {
+
+    gps::AssetBaker baker;
+    bool rootGiven = false;
+    std::string archiveFileName;
+    std::vector<std::string> includeRoots;
+
+    for (int i = 1; i < argc; i++) {
+
+        if (strcmp(argv[i], "--force") == 0) {
+            baker.SetForce(true);
+        } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            baker.SetThreadCount((unsigned int)atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--models") == 0 && i + 1 < argc) {
+            baker.AddModelRoot(argv[++i]);
+            rootGiven = true;
+        } else if (strcmp(argv[i], "--skybox") == 0 && i + 1 < argc) {
+            baker.AddCubemapRoot(argv[++i]);
+            rootGiven = true;
+        } else if (strcmp(argv[i], "--scenes") == 0 && i + 1 < argc) {
+            baker.AddSceneRoot(argv[++i]);
+            rootGiven = true;
+        } else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+            archiveFileName = argv[++i];
+        } else if (strcmp(argv[i], "--include") == 0 && i + 1 < argc) {
+            includeRoots.push_back(argv[++i]);
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    if (!rootGiven) {
+        baker.AddModelRoot("models");
+        baker.AddCubemapRoot("skybox");
+        baker.AddSceneRoot("scenes");
+    }
+
+    gps::BakeStats stats;
+    bool succeeded = baker.Bake(stats);
+
+    std::cout << "Baked " << stats.built << " assets, " << stats.skipped << " up to date, " << stats.failed << " failed, "
+        << stats.removed << " removed in " << stats.milliseconds << " ms" << std::endl;
+
+    // a partial bake is not worth shipping
+    if (succeeded && !archiveFileName.empty()) {
+
+        if (includeRoots.empty()) {
+            includeRoots.push_back("shaders");
+        }
+        succeeded = baker.Pack(archiveFileName, includeRoots);
+    }
+
+    return succeeded ? 0 : 1;
+}